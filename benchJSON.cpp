@@ -0,0 +1,1611 @@
+
+/*
+ * benchmark driver for jvalue
+ *
+ * generates deterministic corpora in memory and measures
+ *   parse MB/s, serialize MB/s, random-access lookup ns,
+ *   peak RSS, heap bytes held by each tree, and heap allocations per operation
+ *
+ * output is one json object per line (machine-readable), e.g.
+ *   {"bench":"parse","corpus":"twitter","bytes":1048576,"mb_per_s":45.2,...}
+ *
+ * use:
+ *   benchJSON [scale [corpus]]
+ *     scale  -- multiplies the size of each corpus (default 1)
+ *     corpus -- only run the named corpus
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <new>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "jvalue.h"
+#include "jcbor.h"
+#include "jmsgpack.h"
+#include "jsnapshot.h"
+#include "jtape.h"
+#include "jbind.h"
+#include "jpush.h"
+#include "jreadahead.h"
+#include "jpatch.h"
+#include "jdedup.h"
+#include "jindex.h"
+#include "jquery.h"
+#include "jcolumns.h"
+#include "jshape.h"
+#include "jbatch.h"
+
+using namespace std;
+
+/*
+ * allocation counting
+ *   replaces the global operator new/delete for this program only
+ *
+ */
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"	// gcc cannot see that new/delete are paired below
+
+static size_t gAllocCount = 0;
+static size_t gAllocBytes = 0;
+static size_t gLiveBytes = 0;	// currently held, as seen by malloc
+
+void *
+operator new( size_t xSize )
+{
+	gAllocCount++;
+	gAllocBytes += xSize;
+	if ( void *P = malloc( xSize ? xSize : 1 ) )
+	{
+		gLiveBytes += malloc_usable_size( P );
+		return P;
+	}
+	throw std::bad_alloc();
+}
+
+static inline void
+release( void *xPtr )
+{
+	if ( xPtr )
+		gLiveBytes -= malloc_usable_size( xPtr );
+	free( xPtr );
+}
+
+void *
+operator new[]( size_t xSize )
+{
+	return operator new( xSize );
+}
+
+void operator delete( void *xPtr ) noexcept           { release( xPtr ); }
+void operator delete[]( void *xPtr ) noexcept         { release( xPtr ); }
+void operator delete( void *xPtr, size_t ) noexcept   { release( xPtr ); }
+void operator delete[]( void *xPtr, size_t ) noexcept { release( xPtr ); }
+
+/*
+ * timing and memory helpers
+ *
+ */
+
+static double
+now()
+{
+	struct timespec TS;
+	clock_gettime( CLOCK_MONOTONIC, &TS );
+	return TS.tv_sec + TS.tv_nsec * 1e-9;
+}
+
+static long
+peakRSS()	// kilobytes
+{
+	struct rusage RU;
+	getrusage( RUSAGE_SELF, &RU );
+	return RU.ru_maxrss;
+}
+
+/*
+ * deterministic corpus generation
+ *   a small LCG so every run (and every machine) sees the same bytes
+ *
+ */
+
+class lcg
+{
+	public:
+		lcg( unsigned long long xSeed ) : mState( xSeed ) {}
+		unsigned int next()
+			{ mState = mState * 6364136223846793005ULL + 1442695040888963407ULL; return (unsigned int)(mState >> 33); }
+		unsigned int below( unsigned int xLimit ) { return next() % xLimit; }
+	private:
+		unsigned long long mState;
+};
+
+static const char *gWords[] =
+{
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+	"sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+	"magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+	"exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo",
+};
+
+static void
+words( string& xOut, lcg& xR, unsigned int xCount )
+{
+	for ( unsigned int i = 0; i < xCount; i++ )
+	{
+		if ( i ) xOut += ' ';
+		xOut += gWords[xR.below( sizeof(gWords) / sizeof(gWords[0]) )];
+	}
+}
+
+static void
+number( string& xOut, long long xValue )
+{
+	char buffer[32];
+	snprintf( buffer, sizeof(buffer), "%lld", xValue );
+	xOut += buffer;
+}
+
+static void
+real( string& xOut, double xValue )
+{
+	char buffer[32];
+	snprintf( buffer, sizeof(buffer), "%.6f", xValue );
+	xOut += buffer;
+}
+
+static void
+twitterStatus( string& xOut, lcg& xR, unsigned int xIndex )
+{
+	unsigned long long Id = 1000000000000ULL + xIndex * 7919ULL;
+	xOut += "{\"id\":";              number( xOut, Id );
+	xOut += ",\"id_str\":\"";        number( xOut, Id );
+	xOut += "\",\"text\":\"";        words( xOut, xR, 8 + xR.below( 16 ) );
+	xOut += "\",\"user\":{\"id\":";  number( xOut, xR.next() );
+	xOut += ",\"name\":\"";          words( xOut, xR, 2 );
+	xOut += "\",\"screen_name\":\"user";  number( xOut, xR.below( 100000 ) );
+	xOut += "\",\"followers_count\":";    number( xOut, xR.below( 1000000 ) );
+	xOut += ",\"verified\":";        xOut += xR.below( 10 ) ? "false" : "true";
+	xOut += "},\"entities\":{\"hashtags\":[";
+	for ( unsigned int i = 0, N = xR.below( 4 ); i < N; i++ )
+	{
+		if ( i ) xOut += ',';
+		xOut += "{\"text\":\"";
+		words( xOut, xR, 1 );
+		xOut += "\",\"indices\":[";
+		number( xOut, xR.below( 100 ) );
+		xOut += ',';
+		number( xOut, xR.below( 100 ) + 100 );
+		xOut += "]}";
+	}
+	xOut += "],\"urls\":[]},\"retweet_count\":";  number( xOut, xR.below( 5000 ) );
+	xOut += ",\"favorited\":false,\"coordinates\":null,\"lang\":\"en\"}";
+}
+
+static string
+corpusTwitter( unsigned int xScale )
+{
+	lcg R( 26 );
+	string Out = "{\"statuses\":[";
+	for ( unsigned int i = 0, N = 2000 * xScale; i < N; i++ )
+	{
+		if ( i ) Out += ',';
+		twitterStatus( Out, R, i );
+	}
+	Out += "],\"search_metadata\":{\"count\":";
+	number( Out, 2000 * xScale );
+	Out += ",\"query\":\"lorem\"}}";
+	return Out;
+}
+
+static string
+corpusNumbers( unsigned int xScale )
+{
+	lcg R( 27 );
+	string Out = "[";
+	for ( unsigned int i = 0, N = 20000 * xScale; i < N; i++ )
+	{
+		if ( i ) Out += ',';
+		Out += '[';
+		real( Out, R.next() / 4294967.296 - 500.0 );
+		Out += ',';
+		real( Out, R.next() / 4294967.296 - 500.0 );
+		Out += ',';
+		number( Out, (long long)R.next() - 2147483648LL );
+		Out += ']';
+	}
+	Out += ']';
+	return Out;
+}
+
+static string
+corpusLogs( unsigned int xScale )
+{
+	lcg R( 28 );
+	static const char *Levels[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+	string Out = "[";
+	for ( unsigned int i = 0, N = 2000 * xScale; i < N; i++ )
+	{
+		if ( i ) Out += ',';
+		Out += "{\"ts\":";
+		number( Out, 1500000000000LL + i * 37 );
+		Out += ",\"level\":\"";
+		Out += Levels[R.below( 4 )];
+		Out += "\",\"msg\":\"";
+		words( Out, R, 60 + R.below( 120 ) );
+		Out += "\\n\\tat frame ";
+		number( Out, R.below( 1000 ) );
+		Out += "\"}";
+	}
+	Out += ']';
+	return Out;
+}
+
+static string
+corpusNested( unsigned int xScale )
+{
+	lcg R( 29 );
+	string Out = "[";
+	for ( unsigned int d = 0, N = 200 * xScale; d < N; d++ )
+	{
+		if ( d ) Out += ',';
+		unsigned int Depth = 100 + R.below( 400 );
+		for ( unsigned int i = 0; i < Depth; i++ )
+			Out += (i & 1) ? "[" : "{\"k\":";
+		number( Out, d );
+		for ( unsigned int i = Depth; i-- > 0; )
+			Out += (i & 1) ? "]" : "}";
+	}
+	Out += ']';
+	return Out;
+}
+
+static string
+corpusNDJSON( unsigned int xScale )
+{
+	lcg R( 30 );
+	string Out;
+	for ( unsigned int i = 0, N = 5000 * xScale; i < N; i++ )
+	{
+		Out += "{\"seq\":";
+		number( Out, i );
+		Out += ",\"host\":\"web";
+		number( Out, R.below( 64 ) );
+		Out += "\",\"status\":";
+		number( Out, R.below( 10 ) ? 200 : 500 );
+		Out += ",\"latency\":";
+		real( Out, R.next() / 4294967296.0 );
+		Out += ",\"path\":\"/";
+		words( Out, R, 1 );
+		Out += "/";
+		words( Out, R, 1 );
+		Out += "\"}\n";
+	}
+	return Out;
+}
+
+/*
+ * reporting
+ *
+ */
+
+static void
+report( const char *xBench, const char *xCorpus, size_t xBytes, size_t xOps, double xSeconds,
+		size_t xAllocs, size_t xAllocBytes, const char *xExtra = "" )
+{
+	printf( "{\"bench\":\"%s\",\"corpus\":\"%s\",\"bytes\":%zu,\"ops\":%zu,\"seconds\":%.6f",
+			xBench, xCorpus, xBytes, xOps, xSeconds );
+	if ( xBytes )
+		printf( ",\"mb_per_s\":%.2f", xBytes * (double)xOps / (1024.0 * 1024.0) / xSeconds );
+	else
+		printf( ",\"ns_per_op\":%.1f", xSeconds * 1e9 / xOps );
+	printf( ",\"allocs_per_op\":%.1f,\"alloc_bytes_per_op\":%.1f,\"peak_rss_kb\":%ld%s}\n",
+			(double)xAllocs / xOps, (double)xAllocBytes / xOps, peakRSS(), xExtra );
+	fflush( stdout );
+}
+
+/*
+ * the individual measurements
+ *
+ */
+
+static unsigned int
+repeats( size_t xBytes )	// enough repetitions to run ~ a few hundred MB per measurement
+{
+	size_t R = (64u << 20) / (xBytes + 1);
+	return R < 1 ? 1 : (R > 50 ? 50 : (unsigned int)R);
+}
+
+static void
+benchParse( const char *xName, const string& xText, jvalue& xOut )
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0, Held = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		istringstream IS( xText );
+		size_t Live = gLiveBytes;
+		jvalue V;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		V.parse( IS );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+		Held = gLiveBytes - Live;
+		if ( i + 1 == N )
+			xOut = V;
+	}
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"tree_bytes\":%zu", Held );
+	report( "parse", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static void
+benchLimits( const char *xName, const string& xText, const jvalue& xTree )	// parse under limits it stays inside; memoryUsage() against malloc
+{
+	unsigned int N = repeats( xText.size() );
+	jlimits L;
+	L.mBytes = xTree.memoryUsage();
+	L.mDepth = 1000;
+	L.mString = xText.size();
+	L.mElements = xText.size();
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		istringstream IS( xText );
+		jvalue::limits( IS, L );
+		jvalue V;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		V.parse( IS );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	report( "parse_limited", xName, xText.size(), N, Elapsed, Allocs, Bytes );
+
+	istringstream IS( xText );
+	size_t Live = gLiveBytes;
+	jvalue V;
+	V.parse( IS );
+	size_t Held = gLiveBytes - Live;
+	N *= 10;
+	size_t Usage = 0;
+	size_t A = gAllocCount, B = gAllocBytes;
+	double T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		Usage = V.memoryUsage();
+	Elapsed = now() - T;
+	char Extra[96];
+	snprintf( Extra, sizeof(Extra), ",\"memory_usage\":%zu,\"malloc_bytes\":%zu", Usage, Held );
+	report( "memory_usage", xName, 0, N, Elapsed, gAllocCount - A, gAllocBytes - B, Extra );
+}
+
+static void
+benchValidate( const char *xName, const string& xText )	// strict grammar and UTF-8, no tree
+{
+	unsigned int N = repeats( xText.size() ) * 10;
+	size_t Valid = 0;
+	size_t A = gAllocCount, B = gAllocBytes;
+	double T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		Valid += jvalue::validate( xText );
+	double Elapsed = now() - T;
+	if ( Valid != N )
+		cerr << "validate: " << xName << " is not strict json" << endl;
+	report( "validate", xName, xText.size(), N, Elapsed, gAllocCount - A, gAllocBytes - B );
+}
+
+static void
+benchParseNDJSON( const char *xName, const string& xText, bool xReuse )	// a new tree per record, or one rewritten
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0, Records = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		istringstream IS( xText );
+		jvalue V;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		while ( xReuse ? V.reparse( IS ) : V.parse( IS ) )
+			Records++;
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"records_per_op\":%zu", Records / N );
+	report( xReuse ? "reparse" : "parse", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static void
+benchShape( const char *xName, const string& xText )	// records read against the shape of the ones before
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	jshape S;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		jvalue V;
+		size_t Used, A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		for ( const char *P = xText.data(), *End = P + xText.size(); S.parse( P, End - P, V, &Used ); P += Used )
+			;
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	char Extra[96];
+	snprintf( Extra, sizeof(Extra), ",\"records_per_op\":%zu,\"hit_rate\":%.3f", S.records() / N, S.hits() / (double)S.records() );
+	report( "parse_shape", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static void
+benchPush( const char *xName, const string& xText, size_t xChunk )	// text arriving in xChunk pieces
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0, Records = 0;
+	jpush P;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		for ( size_t At = 0; At < xText.size(); At += xChunk )
+		{
+			const char *C = xText.data() + At;
+			size_t L = min( xChunk, xText.size() - At );
+			while ( L > 0 )
+			{
+				size_t Used = P.feed( C, L );
+				C += Used;
+				L -= Used;
+				if ( P.done() )
+				{
+					P.take();
+					Records++;
+				}
+			}
+		}
+		if ( P.finish() )
+		{
+			P.take();
+			Records++;
+		}
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	char Bench[32], Extra[64];
+	snprintf( Bench, sizeof(Bench), "push_parse_%zu", xChunk );
+	snprintf( Extra, sizeof(Extra), ",\"records_per_op\":%zu", Records / N );
+	report( Bench, xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static void
+evict( const char *xPath )	// drop the file from the page cache so each run reads the disk
+{
+	int FD = open( xPath, O_RDONLY );
+	if ( FD < 0 )
+		return;
+	fdatasync( FD );
+	posix_fadvise( FD, 0, 0, POSIX_FADV_DONTNEED );
+	close( FD );
+}
+
+static void
+benchReadAhead( const char *xName, const string& xText )	// read alone, read-then-parse, and the two overlapped
+{
+	const char *Dir = getenv( "TMPDIR" );
+	string Path = string( Dir ? Dir : "/var/tmp" ) + "/benchJSON.readahead";
+	FILE *F = fopen( Path.c_str(), "wb" );
+	if ( !F )
+		return;
+	fwrite( xText.data(), 1, xText.size(), F );
+	fclose( F );
+
+	unsigned int N = repeats( xText.size() );
+	vector<char> Buffer( jreadahead::BLOCK );
+	double Read = 0, Serial = 0, Overlapped = 0;
+	size_t Stalls = 0, SerialAllocs = 0, SerialBytes = 0, Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		evict( Path.c_str() );
+		double T = now();
+		int FD = open( Path.c_str(), O_RDONLY );
+		while ( read( FD, &Buffer[0], Buffer.size() ) > 0 )
+			;
+		close( FD );
+		Read += now() - T;
+
+		evict( Path.c_str() );
+		size_t A = gAllocCount, B = gAllocBytes;
+		T = now();
+		FD = open( Path.c_str(), O_RDONLY );
+		jpush P;
+		ssize_t L;
+		while ( (L = read( FD, &Buffer[0], Buffer.size() )) > 0 )	// the disk waits while we parse
+			for ( const char *C = &Buffer[0]; L > 0; )
+			{
+				size_t Used = P.feed( C, L );
+				C += Used;
+				L -= Used;
+				if ( P.done() )
+					P.take();
+			}
+		if ( P.finish() )
+			P.take();
+		close( FD );
+		Serial += now() - T;
+		SerialAllocs += gAllocCount - A;
+		SerialBytes += gAllocBytes - B;
+
+		evict( Path.c_str() );
+		A = gAllocCount, B = gAllocBytes;
+		T = now();
+		{
+			jreadahead R( Path.c_str() );
+			jvalue V;
+			while ( R.parse( V ) )
+				;
+			Stalls += R.stalls();
+		}
+		Overlapped += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	unlink( Path.c_str() );
+
+	char Extra[64];
+	report( "file_read", xName, xText.size(), N, Read, 0, 0 );
+	report( "file_read_then_parse", xName, xText.size(), N, Serial, SerialAllocs, SerialBytes );
+	snprintf( Extra, sizeof(Extra), ",\"stalls_per_op\":%.1f", (double)Stalls / N );
+	report( "file_readahead_parse", xName, xText.size(), N, Overlapped, Allocs, Bytes, Extra );
+}
+
+static void
+benchTape( const char *xName, const string& xText )	// one jtape reused across runs, as a reader loop would
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	jtape T;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T0 = now();
+		T.parse( xText );
+		Elapsed += now() - T0;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	char Extra[96];
+	snprintf( Extra, sizeof(Extra), ",\"tape_bytes\":%zu", T.tapeSize() * sizeof(uint64_t) + T.stringBytes() );
+	report( "tape_parse", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+/*
+ * typed binding of the twitter-like corpus
+ *
+ */
+
+struct hashtag
+{
+	string text;
+	vector<int> indices;
+};
+
+JBIND_BEGIN( hashtag )
+	JBIND_FIELD( text )
+	JBIND_FIELD( indices )
+JBIND_END()
+
+struct tweetUser
+{
+	long long id;
+	string name;
+	string screen_name;
+	long long followers_count;
+	bool verified;
+};
+
+JBIND_BEGIN( tweetUser )
+	JBIND_FIELD( id )
+	JBIND_FIELD( name )
+	JBIND_FIELD( screen_name )
+	JBIND_FIELD( followers_count )
+	JBIND_FIELD( verified )
+JBIND_END()
+
+struct tweetEntities
+{
+	vector<hashtag> hashtags;
+};
+
+JBIND_BEGIN( tweetEntities )
+	JBIND_FIELD( hashtags )
+JBIND_END()
+
+struct tweet
+{
+	long long id;
+	string id_str;
+	string text;
+	tweetUser user;
+	tweetEntities entities;
+	long long retweet_count;
+	bool favorited;
+	string lang;
+};
+
+JBIND_BEGIN( tweet )
+	JBIND_FIELD( id )
+	JBIND_FIELD( id_str )
+	JBIND_FIELD( text )
+	JBIND_FIELD( user )
+	JBIND_FIELD( entities )
+	JBIND_FIELD( retweet_count )
+	JBIND_FIELD( favorited )
+	JBIND_FIELD( lang )
+JBIND_END()
+
+struct timeline
+{
+	vector<tweet> statuses;
+};
+
+JBIND_BEGIN( timeline )
+	JBIND_FIELD( statuses )
+JBIND_END()
+
+static void
+benchBind( const char *xName, const string& xText, timeline& xOut )
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0, Statuses = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		timeline TL;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jbind::parse( xText, TL );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+		Statuses += TL.statuses.size();
+		if ( i + 1 == N )
+			xOut = TL;
+	}
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"records_per_op\":%zu", Statuses / N );
+	report( "bind_parse", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static jvalue
+toJvalue( const timeline& xIn )	// what callers do without jbind: build a tree member by member
+{
+	jvalue Out;
+	jvalue Statuses;
+	for ( size_t i = 0; i < xIn.statuses.size(); i++ )
+	{
+		const tweet& T = xIn.statuses[i];
+		jvalue S;
+		S["id"] = T.id;
+		S["id_str"] = T.id_str.c_str();
+		S["text"] = T.text.c_str();
+		jvalue U;
+		U["id"] = T.user.id;
+		U["name"] = T.user.name.c_str();
+		U["screen_name"] = T.user.screen_name.c_str();
+		U["followers_count"] = T.user.followers_count;
+		U["verified"] = T.user.verified;
+		S["user"] = U;
+		jvalue Tags;
+		Tags.Array( NULL );
+		for ( size_t h = 0; h < T.entities.hashtags.size(); h++ )
+		{
+			jvalue H;
+			H["text"] = T.entities.hashtags[h].text.c_str();
+			jvalue Indices;
+			for ( size_t x = 0; x < T.entities.hashtags[h].indices.size(); x++ )
+				Indices.push_back( (long long)T.entities.hashtags[h].indices[x] );
+			H["indices"] = Indices;
+			Tags.push_back( H );
+		}
+		S["entities"]["hashtags"] = Tags;
+		S["retweet_count"] = T.retweet_count;
+		S["favorited"] = T.favorited;
+		S["lang"] = T.lang.c_str();
+		Statuses.push_back( S );
+	}
+	Out["statuses"] = Statuses;
+	return Out;
+}
+
+static void
+benchBindPrint( const char *xName, const timeline& xIn )
+{
+	string Out;
+	jbind::print( xIn, Out );
+	unsigned int N = repeats( Out.size() );
+
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		Out.clear();	// keeps its capacity, as a reused output buffer would
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jbind::print( xIn, Out );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	report( "bind_serialize", xName, Out.size(), N, Elapsed, Allocs, Bytes );
+
+	Elapsed = 0;
+	Allocs = Bytes = 0;
+	size_t Size = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		ostringstream OS;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		toJvalue( xIn ).print( OS );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+		Size = OS.str().size();
+	}
+	report( "build_and_serialize", xName, Size, N, Elapsed, Allocs, Bytes );
+}
+
+static void
+benchPrint( const char *xName, const jvalue& xValue )
+{
+	size_t Size;
+	{
+		ostringstream OS;
+		OS << xValue;
+		Size = OS.str().size();
+	}
+	unsigned int N = repeats( Size );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		ostringstream OS;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		OS << xValue;
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	report( "serialize", xName, Size, N, Elapsed, Allocs, Bytes );
+}
+
+/*
+ * binary formats on the same documents
+ *   bytes are the encoded size; text_bytes in the output is the printed size for comparison
+ *
+ */
+
+template <class CODEC>
+static void
+benchCodec( const char *xCodec, const char *xName, const jvalue& xValue, size_t xTextBytes )
+{
+	string Encoded = CODEC::encode( xValue );
+	unsigned int N = repeats( Encoded.size() );
+	char Bench[64];
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"text_bytes\":%zu", xTextBytes );
+
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		string Out;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		CODEC::encode( xValue, Out );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	snprintf( Bench, sizeof(Bench), "%s_encode", xCodec );
+	report( Bench, xName, Encoded.size(), N, Elapsed, Allocs, Bytes, Extra );
+
+	Elapsed = 0;
+	Allocs = Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jvalue V = CODEC::decode( Encoded.data(), Encoded.size() );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	snprintf( Bench, sizeof(Bench), "%s_decode", xCodec );
+	report( Bench, xName, Encoded.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static size_t
+walk( const jsnapshot_value& xValue )	// touch every value; returns how many
+{
+	size_t N = 1;
+	if ( xValue.isArray() )
+		for ( size_t i = 0; i < xValue.size(); i++ )
+			N += walk( xValue[i] );
+	else if ( xValue.isObject() )
+		for ( size_t i = 0; i < xValue.size(); i++ )
+			N += walk( xValue.value( i ) );
+	return N;
+}
+
+static void
+benchSnapshot( const char *xName, const jvalue& xValue, size_t xTextBytes )
+{
+	string Image;
+	jsnapshot::write( xValue, Image );
+	unsigned int N = repeats( Image.size() );
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"text_bytes\":%zu", xTextBytes );
+
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		string Out;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jsnapshot::write( xValue, Out );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	report( "snapshot_write", xName, Image.size(), N, Elapsed, Allocs, Bytes, Extra );
+
+	// open and visit every value: the cost that replaces parsing at startup
+	Elapsed = 0;
+	Allocs = Bytes = 0;
+	size_t Values = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jsnapshot S( Image.data(), Image.size() );
+		Values += walk( S.root() );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+	}
+	snprintf( Extra, sizeof(Extra), ",\"text_bytes\":%zu,\"values\":%zu", xTextBytes, Values / N );
+	report( "snapshot_open_walk", xName, Image.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+/*
+ * random access: collect up to N leaf paths, then time walking them
+ *   a path element is either an object key or an array index
+ *
+ */
+
+struct pathStep
+{
+	string mKey;
+	size_t mIndex;
+	bool   mIsKey;
+};
+typedef vector<pathStep> path_t;
+
+static void
+collectPaths( jvalue& xValue, path_t& xPath, vector<path_t>& xOut, lcg& xR, size_t xLimit )
+{
+	if ( xOut.size() >= xLimit )
+		return;
+	if ( xValue.isObject() )
+	{
+		for ( object_map_t::const_iterator IT = xValue.begin(); IT != xValue.end(); IT++ )
+		{
+			pathStep S = { IT->first, 0, true };
+			xPath.push_back( S );
+			jvalue Child = IT->second;
+			collectPaths( Child, xPath, xOut, xR, xLimit );
+			xPath.pop_back();
+		}
+	}
+	else if ( xValue.isArray() )
+	{
+		for ( size_t i = 0, N = xValue.size(); i < N && xOut.size() < xLimit; i += 1 + xR.below( 16 ) )
+		{
+			pathStep S = { string(), i, false };
+			xPath.push_back( S );
+			collectPaths( xValue[i], xPath, xOut, xR, xLimit );
+			xPath.pop_back();
+		}
+	}
+	else
+		xOut.push_back( xPath );
+}
+
+static void
+benchLookup( const char *xName, jvalue& xRoot )
+{
+	vector<path_t> Paths;
+	path_t Path;
+	lcg R( 31 );
+	collectPaths( xRoot, Path, Paths, R, 4096 );
+	if ( Paths.empty() )
+		return;
+
+	size_t Steps = 0;
+	for ( size_t i = 0; i < Paths.size(); i++ )
+		Steps += Paths[i].size();
+
+	const size_t Rounds = 200;
+	size_t Found = 0;
+	size_t A = gAllocCount, B = gAllocBytes;
+	double T = now();
+	for ( size_t r = 0; r < Rounds; r++ )
+		for ( size_t i = 0; i < Paths.size(); i++ )
+		{
+			const path_t& P = Paths[(i * 2654435761u + r) % Paths.size()];
+			jvalue *V = &xRoot;
+			for ( size_t s = 0; s < P.size(); s++ )
+				V = P[s].mIsKey ? &(*V)[P[s].mKey] : &(*V)[P[s].mIndex];
+			Found += V->type() != JBAD;
+		}
+	double Elapsed = now() - T;
+	char Extra[96];
+	snprintf( Extra, sizeof(Extra), ",\"paths\":%zu,\"avg_depth\":%.1f,\"found\":%zu",
+			Paths.size(), (double)Steps / Paths.size(), Found / Rounds );
+	report( "lookup", xName, 0, Rounds * Paths.size(), Elapsed, gAllocCount - A, gAllocBytes - B, Extra );
+}
+
+static void
+benchReprint( const char *xName, const jvalue& xTree )	// change one leaf, print the whole document; with and without the print cache
+{
+	for ( int Cached = 0; Cached < 2; Cached++ )
+	{
+		jvalue Doc = jpatch::copy( xTree );
+		vector<path_t> Paths;
+		path_t Path;
+		lcg R( 37 );
+		collectPaths( Doc, Path, Paths, R, 1024 );
+		if ( Paths.empty() )
+			return;
+		size_t Size;
+		{
+			ostringstream OS;
+			OS << Doc;
+			Size = OS.str().size();
+		}
+		if ( Cached )
+		{
+			Doc.printCache();
+			ostringstream OS;
+			OS << Doc;	// fill the caches
+		}
+		unsigned int N = repeats( Size ) * 4;
+		double Elapsed = 0;
+		size_t Allocs = 0, Bytes = 0;
+		for ( unsigned int i = 0; i < N; i++ )
+		{
+			ostringstream OS;
+			size_t A = gAllocCount, B = gAllocBytes;
+			double T = now();
+			const path_t& P = Paths[i % Paths.size()];
+			jvalue *V = &Doc;
+			for ( size_t s = 0; s < P.size(); s++ )
+				V = P[s].mIsKey ? &(*V)[P[s].mKey] : &(*V)[P[s].mIndex];
+			*V = (long long)i;
+			OS << Doc;
+			Elapsed += now() - T;
+			Allocs += gAllocCount - A;
+			Bytes += gAllocBytes - B;
+		}
+		report( Cached ? "reprint_cached" : "reprint", xName, Size, N, Elapsed, Allocs, Bytes );
+	}
+}
+
+static void
+benchRehash( const char *xName, const jvalue& xTree )	// change one leaf, hash the whole document; with and without cached hashes
+{
+	for ( int Cached = 0; Cached < 2; Cached++ )
+	{
+		jvalue Doc = jpatch::copy( xTree );
+		vector<path_t> Paths;
+		path_t Path;
+		lcg R( 37 );
+		collectPaths( Doc, Path, Paths, R, 1024 );
+		if ( Paths.empty() )
+			return;
+		size_t Size;
+		{
+			ostringstream OS;
+			OS << Doc;
+			Size = OS.str().size();
+		}
+		if ( Cached )
+		{
+			Doc.hashCache();
+			Doc.hash();	// fill the caches
+		}
+		unsigned int N = repeats( Size ) * 4;
+		double Elapsed = 0;
+		size_t Allocs = 0, Bytes = 0;
+		for ( unsigned int i = 0; i < N; i++ )
+		{
+			size_t A = gAllocCount, B = gAllocBytes;
+			double T = now();
+			const path_t& P = Paths[i % Paths.size()];
+			jvalue *V = &Doc;
+			for ( size_t s = 0; s < P.size(); s++ )
+				V = P[s].mIsKey ? &(*V)[P[s].mKey] : &(*V)[P[s].mIndex];
+			*V = (long long)i;
+			Doc.hash();
+			Elapsed += now() - T;
+			Allocs += gAllocCount - A;
+			Bytes += gAllocBytes - B;
+		}
+		report( Cached ? "rehash_cached" : "rehash", xName, Size, N, Elapsed, Allocs, Bytes );
+	}
+
+	jvalue Copy = jpatch::copy( xTree );	// no shared nodes: every member is compared
+	size_t Size;
+	{
+		ostringstream OS;
+		OS << xTree;
+		Size = OS.str().size();
+	}
+	unsigned int N = repeats( Size );
+	bool Same = true;
+	double T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		Same = Same && xTree.equals( Copy );
+	report( "equals_copy", xName, Size, N, now() - T, 0, 0 );
+	if ( !Same )
+		cerr << "equals_copy: " << xName << " differs from its copy" << endl;
+}
+
+static void
+benchDedup( const char *xName, const string& xText )	// share repeated values: after parsing, and while parsing
+{
+	unsigned int N = repeats( xText.size() );
+	double Elapsed = 0;
+	size_t Allocs = 0, Bytes = 0, Held = 0, Shared = 0, Saved = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		istringstream IS( xText );
+		size_t Live = gLiveBytes;
+		jvalue V;
+		V.parse( IS );
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jdedup D;
+		D.share( V );
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+		Shared = D.shared();
+		Saved = D.saved();
+		D.clear();
+		Held = gLiveBytes - Live;
+	}
+	char Extra[128];
+	snprintf( Extra, sizeof(Extra), ",\"tree_bytes\":%zu,\"shared\":%zu,\"saved_bytes\":%zu", Held, Shared, Saved );
+	report( "dedup_share", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+
+	Elapsed = 0;
+	Allocs = Bytes = 0;
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		size_t Live = gLiveBytes;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		jdedup D;
+		jpush P;
+		P.dedup( &D );
+		for ( size_t At = 0; At < xText.size(); At += 65536 )
+			P.feed( xText.data() + At, min( (size_t)65536, xText.size() - At ) );
+		P.finish();
+		jvalue V = P.take();
+		Elapsed += now() - T;
+		Allocs += gAllocCount - A;
+		Bytes += gAllocBytes - B;
+		D.clear();
+		Held = gLiveBytes - Live;
+	}
+	snprintf( Extra, sizeof(Extra), ",\"tree_bytes\":%zu", Held );
+	report( "push_parse_dedup", xName, xText.size(), N, Elapsed, Allocs, Bytes, Extra );
+}
+
+static void
+benchIndex( const char *xName, jvalue& xTree, const char *xPath, const char *xKey )	// find an element by key: scan, or index
+{
+	array_vector_t *A = xTree->Array();
+	if ( !A || A->empty() )
+		return;
+	vector<jvalue> Keys;	// every one present
+	lcg R( 43 );
+	for ( int i = 0; i < 1000; i++ )
+		Keys.push_back( (*A)[R.below( A->size() )][xKey] );
+
+	size_t Allocs = gAllocCount, Bytes = gAllocBytes;
+	double T = now();
+	jindex Index( xTree, xPath );
+	report( "index_build", xName, 0, 1, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes );
+
+	unsigned int N = 200;
+	size_t Found = 0;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		const jvalue& K = Keys[i % Keys.size()];
+		for ( size_t j = 0; j < A->size(); j++ )
+		{
+			const object_map_t *O = (*A)[j]->Object();
+			object_map_t::const_iterator IT;
+			if ( O && (IT = O->find( xKey )) != O->end() && IT->second.equals( K ) )
+			{
+				Found++;
+				break;
+			}
+		}
+	}
+	report( "find_linear", xName, 0, N, now() - T, 0, 0 );
+
+	N = 1000000;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		Found += Index.find( Keys[i % Keys.size()] ) != jindex::npos;
+	report( "find_indexed", xName, 0, N, now() - T, 0, 0 );
+	if ( Found != 200 + N )
+		cerr << "find: " << xName << " missed keys" << endl;
+}
+
+static void
+benchQuery( const char *xName, const jvalue& xTree )	// a compiled query against the loop one would write instead
+{
+	const array_vector_t *A = xTree->Array();
+	if ( !A || A->empty() )
+		return;
+	unsigned int N = 200;
+	jquery Errors( "[.[] | select(.level == \"ERROR\") | .ts] | length" );
+	jquery Levels( "group_by(.level) | map({level: .[0].level, n: length})" );
+	long long Want = 0;
+	map<string,long long> Counts;
+	double T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		Want = 0;
+		for ( size_t j = 0; j < A->size(); j++ )
+		{
+			const object_map_t *O = (*A)[j]->Object();
+			object_map_t::const_iterator IT;
+			if ( O && (IT = O->find( "level" )) != O->end() && IT->second == "ERROR" && O->find( "ts" ) != O->end() )
+				Want++;
+		}
+	}
+	report( "filter_loop", xName, 0, N, now() - T, 0, 0 );
+	for ( unsigned int Threads = 1; Threads <= 4; Threads *= 4 )
+	{
+		size_t Allocs = gAllocCount, Bytes = gAllocBytes;
+		jvalue R;
+		T = now();
+		for ( unsigned int i = 0; i < N; i++ )
+			R = Errors.first( xTree, Threads );
+		char Extra[64];
+		snprintf( Extra, sizeof(Extra), ",\"threads\":%u", Threads );
+		report( "filter_query", xName, 0, N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes, Extra );
+		if ( R->Integer() != Want )
+			cerr << "query: " << xName << " counted " << R << " errors, not " << Want << endl;
+	}
+
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		Counts.clear();
+		for ( size_t j = 0; j < A->size(); j++ )
+		{
+			const object_map_t *O = (*A)[j]->Object();
+			object_map_t::const_iterator IT;
+			if ( O && (IT = O->find( "level" )) != O->end() )
+				Counts[string( IT->second->String(), IT->second.size() )]++;
+		}
+	}
+	report( "group_loop", xName, 0, N, now() - T, 0, 0 );
+	for ( unsigned int Threads = 1; Threads <= 4; Threads *= 4 )
+	{
+		size_t Allocs = gAllocCount, Bytes = gAllocBytes;
+		jvalue R;
+		T = now();
+		for ( unsigned int i = 0; i < N; i++ )
+			R = Levels.first( xTree, Threads );
+		char Extra[64];
+		snprintf( Extra, sizeof(Extra), ",\"threads\":%u", Threads );
+		report( "group_query", xName, 0, N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes, Extra );
+		if ( R.size() != Counts.size() )
+			cerr << "query: " << xName << " found " << R.size() << " levels, not " << Counts.size() << endl;
+	}
+}
+
+static void
+benchQueryText( const char *xName, const string& xText )	// select() decided on a tape, against parsing everything
+{
+	unsigned int N = repeats( xText.size() );
+	jquery Failed( "select(.status == 500) | .seq" );
+	size_t Allocs = gAllocCount, Bytes = gAllocBytes, Want = 0, Got = 0;
+	double T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		istringstream IS( xText );
+		jvalue V;
+		vector<jvalue> Out;
+		while ( V.parse( IS ) )
+			if ( V["status"] == 500 )
+				Out.push_back( V["seq"] );
+		Want += Out.size();
+	}
+	report( "select_parse_all", xName, xText.size(), N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes );
+
+	Allocs = gAllocCount, Bytes = gAllocBytes;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		vector<jvalue> Out;
+		Failed.runText( xText, Out );
+		Got += Out.size();
+	}
+	char Extra[64];
+	snprintf( Extra, sizeof(Extra), ",\"pushdown\":%s", Failed.pushdown() ? "true" : "false" );
+	report( "select_query_text", xName, xText.size(), N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes, Extra );
+	if ( Got != Want )
+		cerr << "query: " << xName << " selected " << Got << " values, not " << Want << endl;
+}
+
+static void
+benchColumns( const char *xName, const string& xText, const char *xSum, const char *xKey, const jvalue& xWant )	// rows against columns
+{
+	unsigned int N = repeats( xText.size() );
+	jcolumns C;
+	size_t Allocs = gAllocCount, Bytes = gAllocBytes, Live = gLiveBytes;
+	double T = now();
+	C.parse( xText );
+	T = now() - T;
+	char Extra[96];
+	snprintf( Extra, sizeof(Extra), ",\"rows\":%zu,\"columns\":%zu,\"live_bytes\":%zu", C.size(), C.columns(), gLiveBytes - Live );
+	report( "columns_parse", xName, xText.size(), 1, T, gAllocCount - Allocs, gAllocBytes - Bytes, Extra );
+
+	jvalue Rows;	// the same records as a tree: an array of objects
+	Rows->Array( NULL );
+	jtape Tape;
+	for ( size_t At = 0, Used; Tape.parse( xText.data() + At, xText.size() - At, &Used ); At += Used )
+	{
+		jvalue V = Tape.root().toJvalue();
+		if ( V.isArray() )
+			Rows->Array()->insert( Rows->Array()->end(), V->Array()->begin(), V->Array()->end() );
+		else
+			Rows->Array()->push_back( V );
+	}
+	const array_vector_t *A = Rows->Array();
+	Allocs = gAllocCount, Bytes = gAllocBytes;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		jcolumns( Rows ).size();
+	report( "columns_build", xName, 0, N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes );
+
+	N *= 20;
+	double Sum = 0;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		for ( size_t j = 0; j < A->size(); j++ )
+		{
+			const object_map_t *O = (*A)[j]->Object();
+			object_map_t::const_iterator IT = O->find( xSum );
+			if ( IT != O->end() )
+				Sum += IT->second->Double();
+		}
+	report( "sum_rows", xName, 0, N, now() - T, 0, 0 );
+	jvalue Total;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		Total = C.sum( xSum );
+	report( "sum_columns", xName, 0, N, now() - T, 0, 0 );
+	if ( fabs( Total->Double() * N - Sum ) > 1e-6 * fabs( Sum ) )
+		cerr << "columns: " << xName << " sum " << Total << " differs" << endl;
+
+	size_t Loop = 0, Found = 0;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		for ( size_t j = 0; j < A->size(); j++ )
+		{
+			const object_map_t *O = (*A)[j]->Object();
+			object_map_t::const_iterator IT = O->find( xKey );
+			Loop += IT != O->end() && IT->second.equals( xWant );
+		}
+	report( "filter_rows", xName, 0, N, now() - T, 0, 0 );
+	jcolumns::mask_t M;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+	{
+		M.clear();
+		Found += C.filter( xKey, jcolumns::EQ, xWant, M );
+	}
+	report( "filter_columns", xName, 0, N, now() - T, 0, 0 );
+	if ( Found != Loop )
+		cerr << "columns: " << xName << " filter found " << Found << ", not " << Loop << endl;
+
+	N /= 20;
+	Allocs = gAllocCount, Bytes = gAllocBytes;
+	T = now();
+	for ( unsigned int i = 0; i < N; i++ )
+		C.toJvalue();
+	report( "columns_to_rows", xName, 0, N, now() - T, gAllocCount - Allocs, gAllocBytes - Bytes );
+}
+
+static jvalue
+edited( const jvalue& xValue )	// copies the nodes on one path down the middle and changes its leaf; the rest is shared
+{
+	jvalue R;
+	*R = *xValue;	// node copy: the children are shared
+	if ( R.isObject() && !R.empty() )
+	{
+		object_map_t::iterator IT = R->begin();
+		advance( IT, R.size() / 2 );
+		IT->second = edited( IT->second );
+	}
+	else if ( R.isArray() && !R.empty() )
+	{
+		jvalue& E = (*R->Array())[R.size() / 2];
+		E = edited( E );
+	}
+	else
+		R = jvalue( "edited" );
+	return R;
+}
+
+static void
+benchDiff( const char *xName, jvalue& xTree )	// one leaf changed: against a deep copy, then against a copy sharing the rest
+{
+	jvalue Deep = edited( jpatch::copy( xTree ) );
+	jvalue Shared = edited( xTree );
+	const char *Names[] = { "diff_deep_copy", "diff_shared" };
+	jvalue *Edits[] = { &Deep, &Shared };
+	for ( int k = 0; k < 2; k++ )
+	{
+		unsigned int N = k == 0 ? 20 : 20000;
+		jvalue Patch;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		for ( unsigned int i = 0; i < N; i++ )
+			Patch = jpatch::diff( xTree, *Edits[k] );
+		double Elapsed = now() - T;
+		ostringstream OS;
+		OS << Patch;
+		char Extra[64];
+		snprintf( Extra, sizeof(Extra), ",\"patch_ops\":%zu,\"patch_bytes\":%zu", Patch.size(), OS.str().size() );
+		report( Names[k], xName, 0, N, Elapsed, gAllocCount - A, gAllocBytes - B, Extra );
+	}
+}
+
+static void
+benchNode()	// what one value costs in this build
+{
+#if defined(SINGLE_THREAD)
+	const char *Locks = "none";
+#elif defined(JVALUE_STRIPED_LOCKS)
+	const char *Locks = "striped";
+#else
+	const char *Locks = "embedded";
+#endif
+	size_t Live = gLiveBytes;
+	jvalue V( 1 );
+	size_t Held = gLiveBytes - Live;	// node + shared_ptr control block, as malloc sees them
+	printf( "{\"bench\":\"node\",\"locks\":\"%s\",\"node_bytes\":%zu,\"heap_bytes_per_value\":%zu}\n",
+			Locks, sizeof(private_jvalue_data), Held );
+}
+
+static void
+benchReject()	// small bad documents: caught as a jerr, against told by a jparse_status
+{
+	static const char *Bad[] = {
+		"{\"id\":17,\"user\":\"ann\",\"tags\":[1,2,3],\"ok\":tru}",
+		"{\"id\":18,\"user\":\"bob\",\"tags\":[1,2,3] \"ok\":true}",
+		"{\"id\":19,\"user\":\"cy\",\"tags\":[1,2,3],\"ok\":@}",
+		"{\"id\":20,\"user\":\"dee\",\"tags\":[1,2,3"
+	};
+	const size_t Kinds = sizeof(Bad) / sizeof(Bad[0]);
+	const unsigned int N = 200000;
+	for ( int Status = 0; Status < 2; Status++ )
+	{
+		size_t Rejected = 0;
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		for ( unsigned int i = 0; i < N; i++ )
+		{
+			istringstream IS( Bad[i % Kinds] );
+			jvalue V;
+			if ( Status )
+			{
+				jparse_status S;
+				Rejected += !V.parse( IS, S ) && S.mCode != JPARSE_EMPTY;
+			}
+			else
+				try
+				{
+					V.parse( IS );
+				}
+				catch ( jerr *E )
+				{
+					Rejected++;
+				}
+		}
+		double Elapsed = now() - T;
+		if ( Rejected != N )
+			cerr << "reject: " << N - Rejected << " bad documents taken" << endl;
+		report( Status ? "reject_status" : "reject_throw", "bad", 0, N, Elapsed, gAllocCount - A, gAllocBytes - B );
+	}
+}
+
+static void
+benchBatch( const char *xName, jvalue& xTree )	// 1-4KB documents: a loop of parse() against a jbatch of 1, 2 and 4 threads
+{
+	jvalue Statuses = xTree["statuses"];
+	vector<string> Docs;
+	lcg R( 50 );
+	for ( size_t i = 0; i < Statuses.size(); )
+	{
+		size_t Want = 1024 + R.below( 3072 );
+		ostringstream OS;
+		OS << '[';
+		for ( size_t n = 0; i < Statuses.size() && (n == 0 || (size_t)OS.tellp() < Want); n++ )
+			OS << (n ? "," : "") << Statuses[i++];
+		OS << ']';
+		Docs.push_back( OS.str() );
+	}
+	vector<jbatch::text> In;
+	size_t Size = 0;
+	for ( size_t i = 0; i < Docs.size(); i++ )
+	{
+		In.push_back( jbatch::text( Docs[i].data(), Docs[i].size() ) );
+		Size += Docs[i].size();
+	}
+	unsigned int N = repeats( Size );
+	char Extra[96];
+
+	{
+		vector<jvalue> Out( Docs.size() );
+		size_t A = gAllocCount, B = gAllocBytes;
+		double T = now();
+		for ( unsigned int r = 0; r < N; r++ )
+			for ( size_t i = 0; i < Docs.size(); i++ )
+			{
+				istringstream IS( Docs[i] );
+				jparse_status S;
+				Out[i].parse( IS, S );
+			}
+		double Elapsed = now() - T;
+		snprintf( Extra, sizeof(Extra), ",\"threads\":1,\"docs\":%zu,\"docs_per_s\":%.0f", Docs.size(), Docs.size() * (double)N / Elapsed );
+		report( "batch_loop", xName, Size, N, Elapsed, gAllocCount - A, gAllocBytes - B, Extra );
+	}
+
+	static const unsigned int Threads[] = { 1, 2, 4 };
+	for ( int Reuse = 0; Reuse < 2; Reuse++ )
+		for ( size_t t = 0; t < sizeof(Threads) / sizeof(Threads[0]); t++ )
+		{
+			jbatch Pool( Threads[t] );
+			Pool.reuse( Reuse );
+			vector<jvalue> Out;
+			Pool.parse( In, Out );	// started, and for reuse, trees to rewrite
+			size_t A = gAllocCount, B = gAllocBytes;	// counted racily by the pool threads: a guide only
+			double T = now();
+			size_t Good = 0;
+			for ( unsigned int r = 0; r < N; r++ )
+				Good += Pool.parse( In, Out );
+			double Elapsed = now() - T;
+			if ( Good != Docs.size() * N )
+				cerr << "batch: " << Docs.size() * N - Good << " documents not parsed" << endl;
+			snprintf( Extra, sizeof(Extra), ",\"threads\":%u,\"docs\":%zu,\"docs_per_s\":%.0f,\"steals\":%zu",
+					Pool.threads(), Docs.size(), Docs.size() * (double)N / Elapsed, Pool.steals() );
+			report( Reuse ? "batch_reuse" : "batch", xName, Size, N, Elapsed, gAllocCount - A, gAllocBytes - B, Extra );
+		}
+}
+
+typedef string (*corpus_fn)( unsigned int );
+
+struct corpus
+{
+	const char *mName;
+	corpus_fn   mMake;
+	bool        mNDJSON;
+};
+
+static const corpus gCorpora[] =
+{
+	{ "twitter", corpusTwitter, false },
+	{ "numbers", corpusNumbers, false },
+	{ "logs",    corpusLogs,    false },
+	{ "nested",  corpusNested,  false },
+	{ "ndjson",  corpusNDJSON,  true  },
+};
+
+int
+main( int argc, char **argv )
+{
+	unsigned int Scale = argc > 1 ? atoi( argv[1] ) : 1;
+	const char *Only = argc > 2 ? argv[2] : NULL;
+	if ( Scale < 1 ) Scale = 1;
+
+	benchNode();
+	benchReject();
+
+	for ( size_t c = 0; c < sizeof(gCorpora) / sizeof(gCorpora[0]); c++ )
+	{
+		const corpus& C = gCorpora[c];
+		if ( Only && strcmp( Only, C.mName ) != 0 )
+			continue;
+		string Text = C.mMake( Scale );
+		if ( C.mNDJSON )
+		{
+			benchParseNDJSON( C.mName, Text, false );
+			benchParseNDJSON( C.mName, Text, true );
+			benchShape( C.mName, Text );
+			benchPush( C.mName, Text, 1460 );
+			benchReadAhead( C.mName, Text );
+			benchQueryText( C.mName, Text );
+			benchColumns( C.mName, Text, "latency", "status", 500 );
+			continue;
+		}
+		jvalue Tree;
+		benchParse( C.mName, Text, Tree );
+		benchLimits( C.mName, Text, Tree );
+		benchValidate( C.mName, Text );
+		benchPush( C.mName, Text, 1460 );	// one TCP segment at a time
+		benchPush( C.mName, Text, 65536 );
+		benchReadAhead( C.mName, Text );
+		benchTape( C.mName, Text );
+		if ( strcmp( C.mName, "twitter" ) == 0 )
+		{
+			timeline TL;
+			benchBind( C.mName, Text, TL );
+			benchBindPrint( C.mName, TL );
+			benchBatch( C.mName, Tree );
+		}
+		benchPrint( C.mName, Tree );
+		benchLookup( C.mName, Tree );
+		benchDiff( C.mName, Tree );
+		benchReprint( C.mName, Tree );
+		benchRehash( C.mName, Tree );
+		benchDedup( C.mName, Text );
+		if ( strcmp( C.mName, "logs" ) == 0 )
+		{
+			benchIndex( C.mName, Tree, "/ts", "ts" );
+			benchQuery( C.mName, Tree );
+			benchColumns( C.mName, Text, "ts", "level", "ERROR" );
+		}
+		benchCodec<jcbor>( "cbor", C.mName, Tree, Text.size() );
+		benchCodec<jmsgpack>( "msgpack", C.mName, Tree, Text.size() );
+		benchSnapshot( C.mName, Tree, Text.size() );
+	}
+
+	return 0;
+}
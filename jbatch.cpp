@@ -0,0 +1,220 @@
+
+#include "jbatch.h"
+#include <unistd.h>
+#include <istream>
+#include <streambuf>
+using namespace std;
+
+class text_inbuf : public std::streambuf	// a stream over text held elsewhere, pointed at one document after another
+{
+	public:
+		void set( const char *xData, size_t xLength )
+			{ char *P = const_cast<char *>( xData ); setg( P, P, P + xLength ); }
+	protected:
+		pos_type seekoff( off_type xOff, ios_base::seekdir xDir, ios_base::openmode xMode )	// lets a jparse_status find line and column
+			{
+				off_type At = xOff + (xDir == ios_base::beg ? 0 : (xDir == ios_base::cur ? gptr() - eback() : egptr() - eback()));
+				if ( !(xMode & ios_base::in) || At < 0 || At > egptr() - eback() )
+					return pos_type( off_type( -1 ) );
+				setg( eback(), eback() + At, egptr() );
+				return pos_type( At );
+			}
+		pos_type seekpos( pos_type xPos, ios_base::openmode xMode )
+			{ return seekoff( off_type( xPos ), ios_base::beg, xMode ); }
+};
+
+struct jbatch::worker
+{
+	worker( jbatch *xOwner, size_t xIndex ) : mOwner( xOwner ), mIndex( xIndex ), mIn( &mBuf ), mNext( 0 ), mEnd( 0 ), mSeen( 0 )
+		{ pthread_mutex_init( &mLock, NULL ); }
+	~worker() { pthread_mutex_destroy( &mLock ); }
+
+	jbatch         *mOwner;
+	size_t          mIndex;
+	text_inbuf      mBuf;
+	istream         mIn;
+	pthread_mutex_t mLock;		// guards the run
+	size_t          mNext;		// chunks [mNext, mEnd) are this worker's to take; others steal from the end
+	size_t          mEnd;
+	unsigned long   mSeen;		// the last batch this thread went through
+};
+
+jbatch::jbatch( unsigned int xThreads ) :
+	mReuse( false ), mSteals( 0 ),
+	mIn( NULL ), mOut( NULL ), mStatus( NULL ), mCount( 0 ), mGood( 0 ), mGeneration( 0 ), mBusy( 0 ), mStop( false )
+{
+	if ( xThreads == 0 )
+	{
+		long Cores = sysconf( _SC_NPROCESSORS_ONLN );
+		xThreads = Cores > 0 ? (unsigned int)Cores : 1;
+	}
+#ifdef SINGLE_THREAD
+	xThreads = 1;	// the trees have no locks to share them with
+#endif
+	pthread_mutex_init( &mLock, NULL );
+	pthread_cond_init( &mStart, NULL );
+	pthread_cond_init( &mDone, NULL );
+	mWorkers.push_back( new worker( this, 0 ) );
+#ifndef SINGLE_THREAD
+	for ( unsigned int t = 1; t < xThreads; t++ )
+	{
+		worker *W = new worker( this, t );
+		pthread_t ID;
+		if ( pthread_create( &ID, NULL, run, W ) != 0 )	// fewer threads, then
+		{
+			delete W;
+			break;
+		}
+		mWorkers.push_back( W );
+		mThreads.push_back( ID );
+	}
+#endif
+}
+
+jbatch::~jbatch()
+{
+	pthread_mutex_lock( &mLock );
+	mStop = true;
+	pthread_cond_broadcast( &mStart );
+	pthread_mutex_unlock( &mLock );
+	for ( size_t t = 0; t < mThreads.size(); t++ )
+		pthread_join( mThreads[t], NULL );
+	for ( size_t w = 0; w < mWorkers.size(); w++ )
+		delete mWorkers[w];
+	pthread_cond_destroy( &mDone );
+	pthread_cond_destroy( &mStart );
+	pthread_mutex_destroy( &mLock );
+}
+
+void
+jbatch::strict( bool xOn )
+{
+	for ( size_t w = 0; w < mWorkers.size(); w++ )
+		jvalue::strict( mWorkers[w]->mIn, xOn );
+}
+
+void
+jbatch::limits( const jlimits& xLimits )
+{
+	for ( size_t w = 0; w < mWorkers.size(); w++ )
+		jvalue::limits( mWorkers[w]->mIn, xLimits );
+}
+
+size_t
+jbatch::parse( const vector<text>& xIn, vector<jvalue>& xOut, vector<jparse_status> *xStatus )
+{
+	xOut.resize( xIn.size() );
+	if ( xStatus )
+		xStatus->resize( xIn.size() );
+	return xIn.empty() ? 0 : parse( &xIn[0], xIn.size(), &xOut[0], xStatus ? &(*xStatus)[0] : NULL );
+}
+
+size_t
+jbatch::parse( const text *xIn, size_t xCount, jvalue *xOut, jparse_status *xStatus )
+{
+	size_t Chunks = (xCount + CHUNK - 1) / CHUNK;
+	size_t Workers = mWorkers.size();
+	for ( size_t w = 0; w < Workers; w++ )	// an even run each
+	{
+		worker *W = mWorkers[w];
+		pthread_mutex_lock( &W->mLock );
+		W->mNext = Chunks * w / Workers;
+		W->mEnd = Chunks * (w + 1) / Workers;
+		pthread_mutex_unlock( &W->mLock );
+	}
+
+	pthread_mutex_lock( &mLock );
+	mIn = xIn;
+	mOut = xOut;
+	mStatus = xStatus;
+	mCount = xCount;
+	mGood = 0;
+	mGeneration++;
+	mBusy = mThreads.size();
+	pthread_cond_broadcast( &mStart );
+	pthread_mutex_unlock( &mLock );
+
+	work( 0 );
+
+	pthread_mutex_lock( &mLock );
+	while ( mBusy )
+		pthread_cond_wait( &mDone, &mLock );
+	size_t Good = mGood;
+	pthread_mutex_unlock( &mLock );
+	return Good;
+}
+
+void *	// static, private; a pool thread: one batch after another until told to stop
+jbatch::run( void *xArg )
+{
+	worker *W = (worker *)xArg;
+	jbatch *B = W->mOwner;
+	for ( ;; )
+	{
+		pthread_mutex_lock( &B->mLock );
+		while ( !B->mStop && W->mSeen == B->mGeneration )
+			pthread_cond_wait( &B->mStart, &B->mLock );
+		if ( B->mStop )
+		{
+			pthread_mutex_unlock( &B->mLock );
+			return NULL;
+		}
+		W->mSeen = B->mGeneration;
+		pthread_mutex_unlock( &B->mLock );
+
+		B->work( W->mIndex );
+
+		pthread_mutex_lock( &B->mLock );
+		if ( --B->mBusy == 0 )
+			pthread_cond_signal( &B->mDone );
+		pthread_mutex_unlock( &B->mLock );
+	}
+}
+
+bool	// private; the next chunk of xWorker's own run, or one stolen from the end of another's
+jbatch::take( size_t xWorker, size_t& xChunk )
+{
+	size_t Workers = mWorkers.size();
+	for ( size_t i = 0; i < Workers; i++ )
+	{
+		worker *W = mWorkers[(xWorker + i) % Workers];
+		pthread_mutex_lock( &W->mLock );
+		bool Found = W->mNext < W->mEnd;
+		if ( Found )
+			xChunk = i ? --W->mEnd : W->mNext++;
+		pthread_mutex_unlock( &W->mLock );
+		if ( Found )
+		{
+			if ( i )
+				__sync_fetch_and_add( &mSteals, 1 );
+			return true;
+		}
+	}
+	return false;
+}
+
+void	// private
+jbatch::work( size_t xWorker )
+{
+	worker *W = mWorkers[xWorker];
+	size_t Good = 0;
+	size_t Chunk;
+	while ( take( xWorker, Chunk ) )
+		for ( size_t i = Chunk * CHUNK, End = min( i + CHUNK, mCount ); i < End; i++ )
+		{
+			W->mBuf.set( mIn[i].mData, mIn[i].mLength );
+			W->mIn.clear();
+			jparse_status Unwanted;
+			jparse_status& S = mStatus ? mStatus[i] : Unwanted;
+			bool OK = mReuse ? mOut[i].reparse( W->mIn, S ) : mOut[i].parse( W->mIn, S );
+			if ( !OK )
+				mOut[i].Null();
+			Good += OK;
+		}
+	if ( Good )
+	{
+		pthread_mutex_lock( &mLock );
+		mGood += Good;
+		pthread_mutex_unlock( &mLock );
+	}
+}
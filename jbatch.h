@@ -0,0 +1,92 @@
+
+#ifndef jbatchHeader
+#define jbatchHeader
+
+/*
+ * many small documents parsed at once, on a pool of threads that take work
+ * from one another
+ *
+ *   jbatch Pool;				// a thread per core, started once
+ *   vector<jbatch::text> In;		// { data, length }: one document each, not copied
+ *   vector<jvalue> Out;
+ *   vector<jparse_status> Status;
+ *   size_t Good = Pool.parse( In, Out, &Status );	// Out[i] is In[i]; bad ones are null
+ *
+ * the batch is cut into chunks of CHUNK documents, and each thread is given
+ * an even run of chunks.  a thread takes chunks from the front of its own
+ * run; when that is empty it steals from the back of another's, so a run of
+ * slow documents does not leave the other threads idle.  the thread calling
+ * parse() is one of the workers, and it returns once every chunk is done.
+ *
+ * each worker keeps one input stream over the documents it is given, so no
+ * per-document stream is set up or text copied.  jvalue nodes come from the
+ * heap one shared_ptr at a time and cannot come from an arena; instead,
+ * reuse( true ) makes each Out[i] a reparse() of the tree already there, so a
+ * batch shaped like the last one allocates next to nothing.
+ *
+ * errors are those of jvalue::parse( is, jparse_status& ): nothing throws.
+ * only the first value of each text is read.  strict() and limits() apply
+ * to every document.  one batch at a time: parse() is not reentrant.  built
+ * with SINGLE_THREAD the caller parses the whole batch itself.
+ *
+ */
+
+#include "jvalue.h"
+#include <pthread.h>
+#include <vector>
+
+class jbatch
+{
+		jbatch( const jbatch& );            // not implemented
+		jbatch& operator=( const jbatch& ); // not implemented
+	public:
+		enum { CHUNK = 16 };	// documents taken at a time
+
+		struct text
+		{
+			text( const char *xData = NULL, size_t xLength = 0 ) : mData( xData ), mLength( xLength ) {}
+			const char *mData;
+			size_t      mLength;
+		};
+
+		explicit jbatch( unsigned int xThreads = 0 );	// 0: one per core, the caller's included
+		~jbatch();
+
+		// xOut[i] from xIn[i]; returns how many parsed.  xStatus, if given, holds xCount entries
+		size_t parse( const text *xIn, size_t xCount, jvalue *xOut, jparse_status *xStatus = NULL );
+		size_t parse( const vector<text>& xIn, vector<jvalue>& xOut, vector<jparse_status> *xStatus = NULL );
+
+		void strict( bool xOn = true );
+		void limits( const jlimits& xLimits );
+		void reuse( bool xOn = true ) { mReuse = xOn; }
+
+		unsigned int threads() const { return mWorkers.size(); }
+		size_t steals() const { return mSteals; }	// chunks taken from another thread's run, all batches
+
+	private:
+		struct worker;
+
+		vector<worker *> mWorkers;	// [0] is the caller's
+		vector<pthread_t> mThreads;	// for mWorkers[1] on
+		bool             mReuse;
+		size_t           mSteals;
+
+		// the batch under way; guarded by mLock
+		const text      *mIn;
+		jvalue          *mOut;
+		jparse_status   *mStatus;
+		size_t           mCount;
+		size_t           mGood;
+		unsigned long    mGeneration;	// batches started
+		unsigned int     mBusy;			// pool threads not yet through this one
+		bool             mStop;
+		pthread_mutex_t  mLock;
+		pthread_cond_t   mStart;
+		pthread_cond_t   mDone;
+
+		static void *run( void *xArg );
+		void work( size_t xWorker );
+		bool take( size_t xWorker, size_t& xChunk );
+};
+
+#endif
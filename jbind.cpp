@@ -0,0 +1,356 @@
+
+#include "jbind.h"
+#include <ctype.h>
+#include <math.h>
+#include <sstream>
+using namespace std;
+
+enum { MAX_DEPTH = 4096 };	// nesting limit when skipping unknown values
+
+/*
+ * the reader
+ *
+ */
+
+int
+jbind_reader::peek()
+{
+	while ( mPos < mEnd && isspace( (unsigned char)*mPos ) )
+		mPos++;
+	return mPos < mEnd ? (unsigned char)*mPos : EOF;
+}
+
+void
+jbind_reader::expect( char xChar, const char *xError )
+{
+	if ( peek() != (unsigned char)xChar )
+		throw jerr::error( xError );
+	mPos++;
+}
+
+bool
+jbind_reader::null()
+{
+	int C = peek();
+	if ( C != 'n' && C != 'N' )
+		return false;
+	if ( mEnd - mPos < 4 || strncasecmp( "null", mPos, 4 ) != 0 )
+		throw jerr::error( "jbind : string is not 'null'" );
+	mPos += 4;
+	return true;
+}
+
+bool
+jbind_reader::Bool()
+{
+	int C = peek();
+	if ( (C == 't' || C == 'T') && mEnd - mPos >= 4 && strncasecmp( "true", mPos, 4 ) == 0 )
+	{
+		mPos += 4;
+		return true;
+	}
+	if ( (C == 'f' || C == 'F') && mEnd - mPos >= 5 && strncasecmp( "false", mPos, 5 ) == 0 )
+	{
+		mPos += 5;
+		return false;
+	}
+	throw jerr::error( "jbind : expected true or false" );
+}
+
+bool	// same number grammar as the jvalue parser
+jbind_reader::number( long long& xInteger, double& xDouble )
+{
+	int C = peek();
+	if ( !isdigit( C ) && C != '-' && C != '.' )
+		throw jerr::error( "jbind : expected a number" );
+	const char *Start = mPos;
+	bool Negative = *mPos == '-';
+	bool Integral = true;
+	unsigned long long U = 0;
+	if ( Negative )
+		mPos++;
+	while ( mPos < mEnd && isdigit( (unsigned char)*mPos ) )
+		U = U * 10 + (*mPos++ - '0');
+	if ( mPos < mEnd && *mPos == '.' )
+	{
+		Integral = false;
+		for ( mPos++; mPos < mEnd && isdigit( (unsigned char)*mPos ); )
+			mPos++;
+	}
+	if ( mPos < mEnd && (*mPos == 'e' || *mPos == 'E') )
+	{
+		Integral = false;
+		mPos++;
+		if ( mPos < mEnd && (*mPos == '-' || *mPos == '+') )
+			mPos++;
+		if ( mPos >= mEnd || !isdigit( (unsigned char)*mPos ) )
+			throw jerr::error( "jbind : bad exponential format" );
+		while ( mPos < mEnd && isdigit( (unsigned char)*mPos ) )
+			mPos++;
+	}
+	size_t L = mPos - Start;
+	if ( Integral && L - Negative < 19 )	// accumulated exactly
+	{
+		xInteger = Negative ? -(long long)U : (long long)U;
+		xDouble = (double)xInteger;
+		return true;
+	}
+	string Text( Start, L );	// the conversions need a terminated copy
+	if ( Integral )
+	{
+		xInteger = Negative ? atoll( Text.c_str() ) : (long long)strtoull( Text.c_str(), NULL, 10 );
+		xDouble = Negative ? (double)xInteger : (double)strtoull( Text.c_str(), NULL, 10 );
+		return true;
+	}
+	xDouble = atof( Text.c_str() );
+	xInteger = (long long)xDouble;
+	return false;
+}
+
+long long
+jbind_reader::Integer()
+{
+	long long I;
+	double D;
+	number( I, D );
+	return I;
+}
+
+unsigned long long
+jbind_reader::Unsigned()
+{
+	long long I;
+	double D;
+	number( I, D );
+	return (unsigned long long)I;
+}
+
+double
+jbind_reader::Double()
+{
+	long long I;
+	double D;
+	number( I, D );
+	return D;
+}
+
+void	// appends; same escapes as the jvalue parser (jutf8 decodes \u)
+jbind_reader::String( string& xOut )
+{
+	expect( '"', "jbind : expected a string" );
+	for ( ;; )
+	{
+		const char *Run = mPos;	// copy plain runs in one go
+		while ( mPos < mEnd && *mPos != '"' && *mPos != '\\' )
+			mPos++;
+		xOut.append( Run, mPos - Run );
+		if ( mPos >= mEnd )
+			throw jerr::error( "jbind : found EOF inside string" );
+		if ( *mPos++ == '"' )
+			return;
+		if ( mPos >= mEnd )
+			throw jerr::error( "jbind : found EOF inside string" );
+		char C = *mPos++;
+		switch( C )
+		{
+			case 'b': xOut += '\b'; break;
+			case 'f': xOut += '\f'; break;
+			case 'n': xOut += '\n'; break;
+			case 'r': xOut += '\r'; break;
+			case 't': xOut += '\t'; break;
+			case 'u':
+				if ( !(mPos = jutf8::escape( mPos, mEnd, xOut )) )
+					throw jerr::error( "bad hex character" );
+				break;
+			default:  xOut += C;    break;
+		}
+	}
+}
+
+void	// the value's text, parsed by the ordinary jvalue parser
+jbind_reader::Jvalue( jvalue& xOut )
+{
+	peek();
+	const char *Start = mPos;
+	skip();
+	istringstream IS( string( Start, mPos - Start ) );
+	xOut.parse( IS );
+}
+
+void
+jbind_reader::skip()
+{
+	skip( 0 );
+}
+
+void
+jbind_reader::skip( unsigned int xDepth )
+{
+	if ( xDepth > MAX_DEPTH )
+		throw jerr::error( "jbind : nesting too deep" );
+	int C = peek();
+	if ( C == '"' )
+	{
+		mKey.clear();	// scratch; the caller is done with the key
+		String( mKey );
+	}
+	else if ( C == '[' )
+	{
+		if ( beginArray() )
+			do
+				skip( xDepth + 1 );
+			while ( moreElements() );
+	}
+	else if ( C == '{' )
+	{
+		if ( beginObject() )
+			do
+			{
+				key();
+				skip( xDepth + 1 );
+			} while ( moreEntries() );
+	}
+	else if ( C == 't' || C == 'T' || C == 'f' || C == 'F' )
+		Bool();
+	else if ( !null() )
+		Double();
+}
+
+bool
+jbind_reader::beginArray()
+{
+	expect( '[', "jbind : expected an array" );
+	if ( peek() != ']' )
+		return true;
+	mPos++;
+	return false;
+}
+
+bool
+jbind_reader::moreElements()
+{
+	int C = peek();
+	if ( C != ',' && C != ']' )
+		throw jerr::error( "jbind : missing comma between values" );
+	mPos++;
+	return C == ',';
+}
+
+bool
+jbind_reader::beginObject()
+{
+	expect( '{', "jbind : expected an object" );
+	if ( peek() != '}' )
+		return true;
+	mPos++;
+	return false;
+}
+
+void
+jbind_reader::key()
+{
+	mKey.clear();
+	String( mKey );
+	uint64_t H = 14695981039346656037ULL;	// jbind_hash, at run time
+	for ( size_t i = 0; i < mKey.size(); i++ )
+		H = (H ^ (unsigned char)mKey[i]) * 1099511628211ULL;
+	mHash = H;
+	expect( ':', "jbind : bad pair in object" );
+}
+
+bool
+jbind_reader::moreEntries()
+{
+	int C = peek();
+	if ( C != ',' && C != '}' )
+		throw jerr::error( "jbind : missing comma" );
+	mPos++;
+	return C == ',';
+}
+
+/*
+ * the writer
+ *
+ */
+
+void
+jbind_writer::Unsigned( unsigned long long xValue )
+{
+	char Buffer[24];
+	char *P = Buffer + sizeof(Buffer);
+	do
+		*--P = '0' + xValue % 10;
+	while ( xValue /= 10 );
+	mOut.append( P, Buffer + sizeof(Buffer) - P );
+}
+
+void
+jbind_writer::Integer( long long xValue )
+{
+	if ( xValue < 0 )
+	{
+		put( '-' );
+		Unsigned( 0 - (unsigned long long)xValue );
+	}
+	else
+		Unsigned( xValue );
+}
+
+void
+jbind_writer::Double( double xValue )
+{
+	if ( !isfinite( xValue ) )
+	{
+		Null();
+		return;
+	}
+	char Buffer[32];
+	int L = snprintf( Buffer, sizeof(Buffer), "%.15g", xValue );
+	if ( strtod( Buffer, NULL ) != xValue )
+		L = snprintf( Buffer, sizeof(Buffer), "%.17g", xValue );
+	mOut.append( Buffer, L );
+}
+
+void
+jbind_writer::String( const char *xText, size_t xLength )
+{
+	static const char Hex[] = "0123456789abcdef";
+	const unsigned char *P = (const unsigned char *)xText;
+	const unsigned char *End = P + xLength;
+	put( '"' );
+	while ( P < End )
+	{
+		const unsigned char *Run = P;	// copy plain runs in one go
+		while ( P < End && *P >= 32 && *P != '"' && *P != '\\' && *P != 127 )
+			P++;
+		mOut.append( (const char *)Run, P - Run );
+		if ( P >= End )
+			break;
+		unsigned char C = *P++;
+		switch( C )
+		{
+			case '"':  mOut.append( "\\\"", 2 ); break;
+			case '\\': mOut.append( "\\\\", 2 ); break;
+			case '\b': mOut.append( "\\b", 2 );  break;
+			case '\f': mOut.append( "\\f", 2 );  break;
+			case '\n': mOut.append( "\\n", 2 );  break;
+			case '\r': mOut.append( "\\r", 2 );  break;
+			case '\t': mOut.append( "\\t", 2 );  break;
+			default:
+			{
+				char U[6] = { '\\', 'u', '0', '0', Hex[C >> 4], Hex[C & 15] };
+				mOut.append( U, sizeof(U) );
+				break;
+			}
+		}
+	}
+	put( '"' );
+}
+
+void
+jbind_writer::Jvalue( const jvalue& xValue )
+{
+	ostringstream OS;
+	xValue.print( OS );
+	mOut += OS.str();
+}
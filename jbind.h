@@ -0,0 +1,432 @@
+
+#ifndef jbindHeader
+#define jbindHeader
+
+/*
+ * typed binding: parse json straight into C++ structs, and print them back
+ *
+ * describe a struct once, at global scope:
+ *   struct user { string name; long long id; vector<string> tags; jbind_optional<double> score; };
+ *   JBIND_BEGIN( user )
+ *       JBIND_FIELD( name )
+ *       JBIND_FIELD( id )
+ *       JBIND_KEY( tags, "hash-tags" )	// json key differs from the member name
+ *       JBIND_FIELD( score )
+ *   JBIND_END()
+ *
+ * then:
+ *   user U;
+ *   jbind::parse( Text, U );
+ *   vector<user> All;
+ *   jbind::parse( Text, All );
+ *
+ * no jvalue is built: the reader walks the text once and stores each value
+ * into its member.  field keys are hashed at compile time; a key in the
+ * input is hashed once and compared against the table, starting with the
+ * field after the last one matched (input usually follows declaration order).
+ *
+ * supported member types: bool, integer and floating types, string,
+ * vector<T>, map<string,T>, jbind_optional<T>, jvalue (parsed as usual),
+ * and any other described struct
+ *
+ * unknown keys are skipped, missing keys and nulls leave the member as it
+ * was (a null clears a jbind_optional); a value of the wrong kind throws
+ * jerr::error
+ *
+ * printing writes straight into the caller's string: keys are emitted from
+ * literals ( ,"name": ) built at compile time, numbers are formatted in
+ * place, and unset jbind_optional members are left out.  strings are
+ * escaped as json requires; UTF-8 is passed through unchanged.
+ *
+ */
+
+#include "jvalue.h"
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <type_traits>
+
+// FNV-1a, usable in constant expressions
+constexpr uint64_t jbind_hash( const char *xKey, uint64_t xHash = 14695981039346656037ULL )
+{
+	return *xKey ? jbind_hash( xKey + 1, (xHash ^ (unsigned char)*xKey) * 1099511628211ULL ) : xHash;
+}
+
+// true if the key can be printed without escapes
+constexpr bool jbind_plain( const char *xKey )
+{
+	return !*xKey || ((unsigned char)*xKey >= 32 && *xKey != '"' && *xKey != '\\' && *xKey != 127 && jbind_plain( xKey + 1 ));
+}
+
+template <class T>
+class jbind_optional
+{
+	public:
+		jbind_optional() : mSet( false ), mValue() {}
+		jbind_optional( const T& xValue ) : mSet( true ), mValue( xValue ) {}
+
+		jbind_optional& operator=( const T& xValue ) { mSet = true; mValue = xValue; return *this; }
+
+		bool has() const { return mSet; }
+		void reset() { mSet = false; mValue = T(); }
+		const T& get() const { return mValue; }
+		T& set() { mSet = true; return mValue; }	// mark present; returns the value to fill in
+
+	private:
+		bool mSet;
+		T    mValue;
+};
+
+/*
+ * the reader: a cursor over the text with typed reads
+ *
+ */
+
+class jbind_reader
+{
+	public:
+		jbind_reader( const char *xText, size_t xLength )
+			: mStart( xText ), mPos( xText ), mEnd( xText + xLength ), mHash( 0 ) {}
+
+		int  peek();		// next non-space character, or EOF
+		bool null();		// consumes a null if that is what comes next
+
+		bool               Bool();
+		long long          Integer();
+		unsigned long long Unsigned();
+		double             Double();
+		void               String( string& xOut );
+		void               Jvalue( jvalue& xOut );
+		void               skip();	// any value
+
+		bool beginArray();		// consumes '['; false if the array is empty
+		bool moreElements();	// consumes ',' (true) or ']' (false)
+		bool beginObject();		// consumes '{'; false if the object is empty
+		void key();				// reads a key and its ':'
+		bool moreEntries();		// consumes ',' (true) or '}' (false)
+
+		const string& keyText() const { return mKey; }	// valid until the next key()
+		uint64_t keyHash() const { return mHash; }
+		bool keyIs( const char *xKey, size_t xLength ) const
+			{ return mKey.size() == xLength && memcmp( mKey.data(), xKey, xLength ) == 0; }
+
+		size_t used() const { return mPos - mStart; }
+
+	private:
+		const char *mStart;
+		const char *mPos;
+		const char *mEnd;
+		string      mKey;
+		uint64_t    mHash;
+
+		void expect( char xChar, const char *xError );
+		bool number( long long& xInteger, double& xDouble );	// true if integral
+		void skip( unsigned int xDepth );
+};
+
+/*
+ * the writer: appends compact json to a string
+ *
+ */
+
+class jbind_writer
+{
+	public:
+		jbind_writer( string& xOut ) : mOut( xOut ) {}
+
+		void raw( const char *xText, size_t xLength ) { mOut.append( xText, xLength ); }
+		void put( char xChar ) { mOut += xChar; }
+
+		void Null() { mOut.append( "null", 4 ); }
+		void Bool( bool xValue ) { if ( xValue ) mOut.append( "true", 4 ); else mOut.append( "false", 5 ); }
+		void Integer( long long xValue );
+		void Unsigned( unsigned long long xValue );
+		void Double( double xValue );	// shortest form that reads back exactly; null if not finite
+		void String( const char *xText, size_t xLength );
+		void Jvalue( const jvalue& xValue );
+
+		// xLiteral is ,"key": -- the comma is dropped for the first member
+		void key( bool xFirst, const char *xLiteral, size_t xLength, bool xPlain, const char *xKey, size_t xKeyLength )
+			{
+				if ( xPlain )
+					raw( xLiteral + xFirst, xLength - xFirst );
+				else
+				{
+					if ( !xFirst )
+						put( ',' );
+					String( xKey, xKeyLength );
+					put( ':' );
+				}
+			}
+
+	private:
+		string& mOut;
+};
+
+/*
+ * codecs: one per C++ type; the primary template handles described structs
+ *
+ */
+
+template <class T, class Enable = void>
+struct jbind_codec;
+
+template <class T>
+struct jbind_field
+{
+	const char *mKey;
+	size_t      mLength;
+	uint64_t    mHash;
+	void      (*mRead)( jbind_reader&, T& );
+	const char *mLiteral;	// ,"key":
+	size_t      mLiteralLength;
+	bool        mPlain;		// mLiteral needs no escaping
+	bool      (*mWrite)( jbind_writer&, const T&, bool xFirst, const jbind_field& );	// false if left out
+};
+
+template <class M>
+struct jbind_present	// members printed even when "empty"
+{
+	static bool test( const M& ) { return true; }
+};
+
+template <class T>
+struct jbind_traits;	// specialized by JBIND_BEGIN ... JBIND_END
+
+template <class T, class M, M T::*P>
+struct jbind_member
+{
+	static void read( jbind_reader& xR, T& xOut ) { jbind_codec<M>::read( xR, xOut.*P ); }
+	static bool write( jbind_writer& xW, const T& xIn, bool xFirst, const jbind_field<T>& xF )
+	{
+		if ( !jbind_present<M>::test( xIn.*P ) )
+			return false;
+		xW.key( xFirst, xF.mLiteral, xF.mLiteralLength, xF.mPlain, xF.mKey, xF.mLength );
+		jbind_codec<M>::write( xW, xIn.*P );
+		return true;
+	}
+};
+
+template <class T, class Enable>
+struct jbind_codec
+{
+	static void read( jbind_reader& xR, T& xOut )
+	{
+		size_t N;
+		const jbind_field<T> *F = jbind_traits<T>::fields( N );
+		if ( xR.null() || !xR.beginObject() )
+			return;
+		size_t Next = 0;
+		do
+		{
+			xR.key();
+			size_t i = 0;
+			for ( ; i < N; i++, Next = Next + 1 < N ? Next + 1 : 0 )
+				if ( F[Next].mHash == xR.keyHash() && xR.keyIs( F[Next].mKey, F[Next].mLength ) )
+					break;
+			if ( i < N )
+			{
+				F[Next].mRead( xR, xOut );
+				Next = Next + 1 < N ? Next + 1 : 0;
+			}
+			else
+				xR.skip();
+		} while ( xR.moreEntries() );
+	}
+	static void write( jbind_writer& xW, const T& xIn )
+	{
+		size_t N;
+		const jbind_field<T> *F = jbind_traits<T>::fields( N );
+		bool First = true;
+		xW.put( '{' );
+		for ( size_t i = 0; i < N; i++ )
+			if ( F[i].mWrite( xW, xIn, First, F[i] ) )
+				First = false;
+		xW.put( '}' );
+	}
+};
+
+template <>
+struct jbind_codec<bool>
+{
+	static void read( jbind_reader& xR, bool& xOut ) { if ( !xR.null() ) xOut = xR.Bool(); }
+	static void write( jbind_writer& xW, bool xIn ) { xW.Bool( xIn ); }
+};
+
+template <class T>
+struct jbind_codec<T, typename enable_if<is_integral<T>::value && is_signed<T>::value>::type>
+{
+	static void read( jbind_reader& xR, T& xOut ) { if ( !xR.null() ) xOut = (T)xR.Integer(); }
+	static void write( jbind_writer& xW, T xIn ) { xW.Integer( xIn ); }
+};
+
+template <class T>
+struct jbind_codec<T, typename enable_if<is_integral<T>::value && is_unsigned<T>::value && !is_same<T,bool>::value>::type>
+{
+	static void read( jbind_reader& xR, T& xOut ) { if ( !xR.null() ) xOut = (T)xR.Unsigned(); }
+	static void write( jbind_writer& xW, T xIn ) { xW.Unsigned( xIn ); }
+};
+
+template <class T>
+struct jbind_codec<T, typename enable_if<is_floating_point<T>::value>::type>
+{
+	static void read( jbind_reader& xR, T& xOut ) { if ( !xR.null() ) xOut = (T)xR.Double(); }
+	static void write( jbind_writer& xW, T xIn ) { xW.Double( xIn ); }
+};
+
+template <>
+struct jbind_codec<string>
+{
+	static void read( jbind_reader& xR, string& xOut ) { if ( !xR.null() ) { xOut.clear(); xR.String( xOut ); } }
+	static void write( jbind_writer& xW, const string& xIn ) { xW.String( xIn.data(), xIn.size() ); }
+};
+
+template <>
+struct jbind_codec<jvalue>
+{
+	static void read( jbind_reader& xR, jvalue& xOut ) { xR.Jvalue( xOut ); }
+	static void write( jbind_writer& xW, const jvalue& xIn ) { xW.Jvalue( xIn ); }
+};
+
+template <class E>
+struct jbind_codec< vector<E> >
+{
+	static void read( jbind_reader& xR, vector<E>& xOut )
+	{
+		xOut.clear();
+		if ( xR.null() || !xR.beginArray() )
+			return;
+		do
+		{
+			xOut.push_back( E() );
+			jbind_codec<E>::read( xR, xOut.back() );
+		} while ( xR.moreElements() );
+	}
+	static void write( jbind_writer& xW, const vector<E>& xIn )
+	{
+		xW.put( '[' );
+		for ( size_t i = 0; i < xIn.size(); i++ )
+		{
+			if ( i )
+				xW.put( ',' );
+			jbind_codec<E>::write( xW, xIn[i] );
+		}
+		xW.put( ']' );
+	}
+};
+
+template <class E>
+struct jbind_codec< map<string,E> >
+{
+	static void read( jbind_reader& xR, map<string,E>& xOut )
+	{
+		xOut.clear();
+		if ( xR.null() || !xR.beginObject() )
+			return;
+		do
+		{
+			xR.key();
+			jbind_codec<E>::read( xR, xOut[xR.keyText()] );
+		} while ( xR.moreEntries() );
+	}
+	static void write( jbind_writer& xW, const map<string,E>& xIn )
+	{
+		xW.put( '{' );
+		for ( typename map<string,E>::const_iterator IT = xIn.begin(); IT != xIn.end(); IT++ )
+		{
+			if ( IT != xIn.begin() )
+				xW.put( ',' );
+			xW.String( IT->first.data(), IT->first.size() );
+			xW.put( ':' );
+			jbind_codec<E>::write( xW, IT->second );
+		}
+		xW.put( '}' );
+	}
+};
+
+template <class E>
+struct jbind_codec< jbind_optional<E> >
+{
+	static void read( jbind_reader& xR, jbind_optional<E>& xOut )
+	{
+		if ( xR.null() )
+			xOut.reset();
+		else
+			jbind_codec<E>::read( xR, xOut.set() );
+	}
+	static void write( jbind_writer& xW, const jbind_optional<E>& xIn )
+	{
+		if ( xIn.has() )
+			jbind_codec<E>::write( xW, xIn.get() );
+		else
+			xW.Null();
+	}
+};
+
+template <class E>
+struct jbind_present< jbind_optional<E> >	// unset optional members are left out
+{
+	static bool test( const jbind_optional<E>& xIn ) { return xIn.has(); }
+};
+
+/*
+ * describing a struct
+ *
+ */
+
+#define JBIND_BEGIN( xType ) \
+	template <> struct jbind_traits<xType> \
+	{ \
+		typedef xType type; \
+		static const jbind_field<xType> *fields( size_t& xCount ) \
+		{ \
+			static const jbind_field<xType> F[] = \
+			{
+
+#define JBIND_KEY( xMember, xKey ) \
+				{ xKey, sizeof(xKey) - 1, jbind_hash( xKey ), &jbind_member<type, decltype(type::xMember), &type::xMember>::read, \
+				  ",\"" xKey "\":", sizeof(",\"" xKey "\":") - 1, jbind_plain( xKey ), &jbind_member<type, decltype(type::xMember), &type::xMember>::write },
+
+#define JBIND_FIELD( xMember ) JBIND_KEY( xMember, #xMember )
+
+#define JBIND_END() \
+			}; \
+			xCount = sizeof(F) / sizeof(F[0]); \
+			return F; \
+		} \
+	};
+
+/*
+ * entry points
+ *
+ */
+
+class jbind
+{
+	public:
+		// parse one value into xOut; xUsed (if given) receives the number of bytes consumed
+		template <class T>
+		static void parse( const char *xText, size_t xLength, T& xOut, size_t *xUsed = NULL )
+		{
+			jbind_reader R( xText, xLength );
+			jbind_codec<T>::read( R, xOut );
+			if ( xUsed )
+				*xUsed = R.used();
+		}
+		template <class T>
+		static void parse( const string& xText, T& xOut, size_t *xUsed = NULL )
+			{ parse( xText.data(), xText.size(), xOut, xUsed ); }
+
+		// append xIn as compact json
+		template <class T>
+		static void print( const T& xIn, string& xOut )
+		{
+			jbind_writer W( xOut );
+			jbind_codec<T>::write( W, xIn );
+		}
+		template <class T>
+		static string print( const T& xIn )
+			{ string Out; print( xIn, Out ); return Out; }
+};
+
+#endif
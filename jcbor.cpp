@@ -0,0 +1,377 @@
+
+#include "jcbor.h"
+#include <math.h>
+#include <sstream>
+using namespace std;
+
+enum { MAX_DEPTH = 4096 };	// nesting limit when decoding untrusted input
+
+/*
+ * encoding
+ *
+ */
+
+static void
+head( string& xOut, unsigned int xMajor, unsigned long long xArgument )	// initial byte + shortest argument
+{
+	unsigned char B[9];
+	size_t N;
+	B[0] = xMajor << 5;
+	if ( xArgument < 24 )
+	{
+		B[0] |= xArgument;
+		N = 1;
+	}
+	else if ( xArgument <= 0xFF )
+	{
+		B[0] |= 24;
+		B[1] = xArgument;
+		N = 2;
+	}
+	else if ( xArgument <= 0xFFFF )
+	{
+		B[0] |= 25;
+		B[1] = xArgument >> 8;
+		B[2] = xArgument;
+		N = 3;
+	}
+	else if ( xArgument <= 0xFFFFFFFFULL )
+	{
+		B[0] |= 26;
+		for ( int i = 0; i < 4; i++ )
+			B[1 + i] = xArgument >> (24 - 8 * i);
+		N = 5;
+	}
+	else
+	{
+		B[0] |= 27;
+		for ( int i = 0; i < 8; i++ )
+			B[1 + i] = xArgument >> (56 - 8 * i);
+		N = 9;
+	}
+	xOut.append( (const char *)B, N );
+}
+
+static void
+real( string& xOut, double xValue )	// float32 when that loses nothing
+{
+	unsigned char B[9];
+	float F = (float)xValue;
+	if ( (double)F == xValue || isnan( xValue ) )
+	{
+		unsigned int Bits;
+		if ( isnan( xValue ) ) F = NAN;
+		memcpy( &Bits, &F, sizeof(Bits) );
+		B[0] = 0xFA;
+		for ( int i = 0; i < 4; i++ )
+			B[1 + i] = Bits >> (24 - 8 * i);
+		xOut.append( (const char *)B, 5 );
+	}
+	else
+	{
+		unsigned long long Bits;
+		memcpy( &Bits, &xValue, sizeof(Bits) );
+		B[0] = 0xFB;
+		for ( int i = 0; i < 8; i++ )
+			B[1 + i] = Bits >> (56 - 8 * i);
+		xOut.append( (const char *)B, 9 );
+	}
+}
+
+void	// static
+jcbor::encode( const jvalue& xValue, string& xOut )
+{
+	private_jvalue_data *V = xValue.get();
+	switch( V->type() )
+	{
+		case JNULL:
+			xOut += (char)0xF6;
+			break;
+		case JBOOL:
+			xOut += (char)(V->Bool() ? 0xF5 : 0xF4);
+			break;
+		case JINTEGER:
+		{
+			long long I = V->Integer();
+			if ( I >= 0 )
+				head( xOut, 0, (unsigned long long)I );
+			else
+				head( xOut, 1, (unsigned long long)(-1 - I) );
+			break;
+		}
+		case JUNSIGNED:
+			head( xOut, 0, V->Unsigned() );
+			break;
+		case JDOUBLE:
+			real( xOut, V->Double() );
+			break;
+		case JSTRING:
+		{
+			const char *S = V->String();
+			size_t L = V->size();
+			head( xOut, 3, L );
+			xOut.append( S, L );
+			break;
+		}
+		case JBINARY:
+			head( xOut, 2, V->Binary()->size() );
+			xOut += *V->Binary();
+			break;
+		case JARRAY:
+		{
+			const array_vector_t& A = *V->Array();
+			head( xOut, 4, A.size() );
+			for ( size_t i = 0; i < A.size(); i++ )
+				encode( A[i], xOut );
+			break;
+		}
+		case JOBJECT:
+		{
+			const object_map_t& O = *V->Object();
+			head( xOut, 5, O.size() );
+			for ( object_map_t::const_iterator IT = O.begin(); IT != O.end(); IT++ )
+			{
+				head( xOut, 3, IT->first.size() );
+				xOut += IT->first;
+				encode( IT->second, xOut );
+			}
+			break;
+		}
+		case JBAD:
+			throw jerr::error( "jcbor::encode : accessing deleted jvalue" );
+	}
+}
+
+/*
+ * decoding
+ *
+ */
+
+class cborReader
+{
+	public:
+		cborReader( const void *xBuffer, size_t xLength )
+			: mStart( (const unsigned char *)xBuffer ), mPos( mStart ), mEnd( mStart + xLength ), mDepth( 0 ) {}
+
+		void value( jvalue& xOut );
+		size_t used() const { return mPos - mStart; }
+
+	private:
+		const unsigned char *mStart;
+		const unsigned char *mPos;
+		const unsigned char *mEnd;
+		unsigned int mDepth;
+
+		void need( unsigned long long xCount )
+			{
+				if ( xCount > (unsigned long long)(mEnd - mPos) )
+					throw jerr::error( "jcbor::decode : truncated input" );
+			}
+		unsigned char byte() { need( 1 ); return *mPos++; }
+		unsigned long long big( unsigned int xBytes )
+			{
+				need( xBytes );
+				unsigned long long R = 0;
+				while ( xBytes-- > 0 )
+					R = (R << 8) | *mPos++;
+				return R;
+			}
+		unsigned long long argument( unsigned int xInfo )
+			{
+				if ( xInfo < 24 ) return xInfo;
+				if ( xInfo == 24 ) return big( 1 );
+				if ( xInfo == 25 ) return big( 2 );
+				if ( xInfo == 26 ) return big( 4 );
+				if ( xInfo == 27 ) return big( 8 );
+				throw jerr::error( "jcbor::decode : reserved additional information" );
+			}
+		bool isBreak()
+			{
+				need( 1 );
+				if ( *mPos != 0xFF )
+					return false;
+				mPos++;
+				return true;
+			}
+
+		void bytes( unsigned int xMajor, unsigned int xInfo, string& xOut );
+		void key( string& xOut );
+		static double half( unsigned int xBits );
+};
+
+double	// static
+cborReader::half( unsigned int xBits )
+{
+	int Exp = (xBits >> 10) & 0x1F;
+	int Mant = xBits & 0x3FF;
+	double V;
+	if ( Exp == 0 )
+		V = ldexp( Mant, -24 );
+	else if ( Exp != 31 )
+		V = ldexp( Mant + 1024, Exp - 25 );
+	else
+		V = Mant == 0 ? INFINITY : NAN;
+	return (xBits & 0x8000) ? -V : V;
+}
+
+void	// byte or text string, possibly in indefinite-length chunks
+cborReader::bytes( unsigned int xMajor, unsigned int xInfo, string& xOut )
+{
+	if ( xInfo != 31 )
+	{
+		unsigned long long L = argument( xInfo );
+		need( L );
+		xOut.append( (const char *)mPos, L );
+		mPos += L;
+		return;
+	}
+	while ( !isBreak() )
+	{
+		unsigned char B = byte();
+		if ( (unsigned int)(B >> 5) != xMajor || (B & 31) == 31 )
+			throw jerr::error( "jcbor::decode : bad chunk in indefinite-length string" );
+		bytes( xMajor, B & 31, xOut );
+	}
+}
+
+void	// object keys: text as-is, anything else as its json text
+cborReader::key( string& xOut )
+{
+	need( 1 );
+	if ( (*mPos >> 5) == 3 )
+	{
+		unsigned char B = *mPos++;
+		bytes( 3, B & 31, xOut );
+		return;
+	}
+	jvalue K;
+	value( K );
+	ostringstream OS;
+	OS << K;
+	xOut = OS.str();
+}
+
+void
+cborReader::value( jvalue& xOut )
+{
+	unsigned char B = byte();
+	unsigned int Major = B >> 5;
+	unsigned int Info = B & 31;
+
+	if ( ++mDepth > MAX_DEPTH )
+		throw jerr::error( "jcbor::decode : nesting too deep" );
+
+	switch( Major )
+	{
+		case 0:
+			xOut.Number( argument( Info ) );
+			break;
+		case 1:
+		{
+			unsigned long long N = argument( Info );
+			if ( N <= LLONG_MAX )
+				xOut.Integer( -1 - (long long)N );
+			else
+				xOut.Double( -1.0 - (double)N );	// beyond long long
+			break;
+		}
+		case 2:
+		case 3:
+		{
+			string S;
+			bytes( Major, Info, S );
+			if ( Major == 2 )
+				xOut.Binary( S.data(), S.size() );
+			else
+				xOut.String( S.data(), S.size() );
+			break;
+		}
+		case 4:
+		{
+			xOut.Array( NULL );
+			array_vector_t& A = *xOut.Array();
+			if ( Info == 31 )
+			{
+				while ( !isBreak() )
+				{
+					A.push_back( jvalue() );
+					value( A.back() );
+				}
+				break;
+			}
+			unsigned long long N = argument( Info );
+			need( N );	// every item is at least one byte
+			A.resize( N );
+			for ( size_t i = 0; i < N; i++ )
+				value( A[i] );
+			break;
+		}
+		case 5:
+		{
+			xOut.Object( NULL );
+			object_map_t& O = *xOut.Object();
+			unsigned long long N = Info == 31 ? ~0ULL : argument( Info );
+			if ( Info != 31 && N > (unsigned long long)(mEnd - mPos) / 2 )
+				throw jerr::error( "jcbor::decode : truncated input" );	// every entry is at least two bytes
+			for ( unsigned long long i = 0; i < N; i++ )
+			{
+				if ( Info == 31 && isBreak() )
+					break;
+				string K;
+				key( K );
+				value( O[K] );
+			}
+			break;
+		}
+		case 6:
+			argument( Info );	// tag number; the tagged item stands for itself
+			value( xOut );
+			break;
+		case 7:
+			switch( Info )
+			{
+				case 20: xOut.Bool( false ); break;
+				case 21: xOut.Bool( true );  break;
+				case 22:
+				case 23: xOut.Null();        break;
+				case 24: byte(); xOut.Null(); break;	// unassigned simple value
+				case 25: xOut.Double( half( big( 2 ) ) ); break;
+				case 26:
+				{
+					unsigned int Bits = big( 4 );
+					float F;
+					memcpy( &F, &Bits, sizeof(F) );
+					xOut.Double( F );
+					break;
+				}
+				case 27:
+				{
+					unsigned long long Bits = big( 8 );
+					double D;
+					memcpy( &D, &Bits, sizeof(D) );
+					xOut.Double( D );
+					break;
+				}
+				case 31:
+					throw jerr::error( "jcbor::decode : unexpected break" );
+				default:
+					if ( Info >= 28 )
+						throw jerr::error( "jcbor::decode : reserved additional information" );
+					xOut.Null();	// unassigned simple value
+					break;
+			}
+			break;
+	}
+	mDepth--;
+}
+
+jvalue	// static
+jcbor::decode( const void *xBuffer, size_t xLength, size_t *xUsed )
+{
+	cborReader R( xBuffer, xLength );
+	jvalue V;
+	R.value( V );
+	if ( xUsed )
+		*xUsed = R.used();
+	return V;
+}
@@ -0,0 +1,42 @@
+
+#ifndef jcborHeader
+#define jcborHeader
+
+/*
+ * CBOR (RFC 8949) reader/writer for jvalue
+ *
+ * mapping:
+ *   JNULL     <-> simple 22 (null); undefined decodes as null
+ *   JBOOL     <-> simple 20/21
+ *   JINTEGER  <-> major 0 / major 1 (shortest length)
+ *   JUNSIGNED <-> major 0 beyond LLONG_MAX
+ *   JDOUBLE   <-> float32 when exact, else float64; float16 decodes
+ *   JSTRING   <-> major 3 (text)
+ *   JBINARY   <-> major 2 (bytes)
+ *   JARRAY    <-> major 4
+ *   JOBJECT   <-> major 5; non-text keys are decoded as their json text
+ *   tags are skipped; indefinite-length items are accepted when decoding
+ *
+ * use:
+ *   string Bytes;
+ *   jcbor::encode( V, Bytes );	// appends to Bytes
+ *   jvalue W = jcbor::decode( Bytes.data(), Bytes.size() );
+ *
+ * errors throw jerr::error, like the text parser
+ *
+ */
+
+#include "jvalue.h"
+
+class jcbor
+{
+	public:
+		static void encode( const jvalue& xValue, string& xOut );
+		static string encode( const jvalue& xValue )
+			{ string Out; encode( xValue, Out ); return Out; }
+
+		// decode one item; xUsed (if given) receives the number of bytes consumed
+		static jvalue decode( const void *xBuffer, size_t xLength, size_t *xUsed = NULL );
+};
+
+#endif
@@ -0,0 +1,750 @@
+
+#include "jcolumns.h"
+#include "jtape.h"
+#include <math.h>
+#include <string.h>
+using namespace std;
+
+static const long long EXACT = 1LL << 53;	// integers a double holds exactly
+
+/*
+ * the same questions asked of a jvalue or of a value on a tape
+ *
+ */
+
+static inline jType kind( const jvalue& xValue )             { return xValue.type(); }
+static inline jType kind( const jtape_value& xValue )        { return xValue.type(); }
+static inline bool asBool( const jvalue& xValue )            { return xValue->Bool(); }
+static inline bool asBool( const jtape_value& xValue )       { return xValue.Bool(); }
+static inline long long asInteger( const jvalue& xValue )    { return xValue->Integer(); }
+static inline long long asInteger( const jtape_value& xValue ) { return xValue.Integer(); }
+static inline double asDouble( const jvalue& xValue )        { return xValue->Double(); }
+static inline double asDouble( const jtape_value& xValue )   { return xValue.Double(); }
+static inline const char *asString( const jvalue& xValue )   { return xValue->String(); }
+static inline const char *asString( const jtape_value& xValue ) { return xValue.String(); }
+static inline jvalue whole( const jvalue& xValue )           { return xValue; }
+static inline jvalue whole( const jtape_value& xValue )      { return xValue.toJvalue(); }
+
+static inline bool
+bit( const vector<uint64_t>& xBits, size_t xRow )
+{
+	return (xBits[xRow >> 6] >> (xRow & 63)) & 1;
+}
+
+static inline void
+setBit( vector<uint64_t>& xBits, size_t xRow )
+{
+	xBits[xRow >> 6] |= 1ULL << (xRow & 63);
+}
+
+static inline void
+clearBit( vector<uint64_t>& xBits, size_t xRow )
+{
+	xBits[xRow >> 6] &= ~(1ULL << (xRow & 63));
+}
+
+template<class T> static void
+release( T& xContainer )	// clear() keeps the capacity
+{
+	T().swap( xContainer );
+}
+
+/*
+ * building
+ *
+ */
+
+void
+jcolumns::append( const jvalue& xRows )
+{
+	if ( const array_vector_t *A = xRows->Array() )
+		for ( size_t i = 0; i < A->size(); i++ )
+			appendRow( (*A)[i] );
+	else
+		appendRow( xRows );
+}
+
+size_t
+jcolumns::parse( const char *xText, size_t xLength )
+{
+	size_t Before = mRows;
+	jtape T;
+	for ( size_t At = 0, Used; At < xLength && T.parse( xText + At, xLength - At, &Used ); At += Used )
+	{
+		jtape_value R = T.root();
+		if ( R.isArray() )
+			for ( jtape_iterator IT = R.begin(); IT != R.end(); ++IT )
+				appendRow( *IT );
+		else
+			appendRow( R );
+	}
+	return mRows - Before;
+}
+
+void
+jcolumns::clear()
+{
+	release( mColumns );
+	release( mByName );
+	mShape.clear();
+	mRows = 0;
+}
+
+void	// private
+jcolumns::appendRow( const jvalue& xRow )
+{
+	const object_map_t *O = xRow->Object();
+	if ( !O )
+		throw jerr::error( "jcolumns : a row must be an object" );
+	beginRow();
+	size_t k = 0;
+	for ( object_map_t::const_iterator IT = O->begin(); IT != O->end(); ++IT )
+		member( k++, IT->first.data(), IT->first.size(), IT->second );
+	endRow();
+}
+
+void	// private
+jcolumns::appendRow( const jtape_value& xRow )
+{
+	if ( !xRow.isObject() )
+		throw jerr::error( "jcolumns : a row must be an object" );
+	beginRow();
+	size_t k = 0;
+	for ( jtape_iterator IT = xRow.begin(); IT != xRow.end(); ++IT )
+		member( k++, IT.key(), IT.keySize(), *IT );
+	endRow();
+}
+
+void	// private
+jcolumns::beginRow()
+{
+	if ( mRows % 64 == 0 )
+		for ( size_t c = 0; c < mColumns.size(); c++ )
+		{
+			mColumns[c].mNulls.push_back( 0 );
+			mColumns[c].mMissing.push_back( 0 );
+		}
+}
+
+size_t	// private; rows of the same shape find their columns by position
+jcolumns::at( size_t xPosition, const char *xName, size_t xLength )
+{
+	if ( xPosition < mShape.size() )
+	{
+		const string& N = mColumns[mShape[xPosition]].mName;
+		if ( N.size() == xLength && memcmp( N.data(), xName, xLength ) == 0 )
+			return mShape[xPosition];
+	}
+	mScratch.assign( xName, xLength );
+	unordered_map<string, size_t>::const_iterator IT = mByName.find( mScratch );
+	size_t c;
+	if ( IT != mByName.end() )
+		c = IT->second;
+	else
+	{
+		c = mColumns.size();
+		mColumns.push_back( column() );
+		column& C = mColumns.back();
+		C.mName = mScratch;
+		C.mType = JNULL;
+		C.mBig = false;
+		C.mLast = (size_t)-1;
+		C.mNulls.assign( mRows / 64 + 1, 0 );	// every row so far lacks it
+		for ( size_t r = 0; r < mRows; r++ )
+			setBit( C.mNulls, r );
+		C.mMissing = C.mNulls;
+		mByName[mScratch] = c;
+	}
+	if ( xPosition >= mShape.size() )
+		mShape.resize( xPosition + 1 );
+	mShape[xPosition] = c;
+	return c;
+}
+
+template<class V> void	// private
+jcolumns::member( size_t xPosition, const char *xName, size_t xLength, const V& xValue )
+{
+	column& C = mColumns[at( xPosition, xName, xLength )];
+	if ( C.mLast == mRows )	// a repeated name (only a tape has those): the last one wins, as in toJvalue()
+	{
+		switch( C.mType )
+		{
+			case JINTEGER: C.mIntegers.pop_back(); break;
+			case JDOUBLE:  C.mDoubles.pop_back();  break;
+			case JBOOL:    C.mBools.pop_back();    break;
+			case JSTRING:  C.mCodes.pop_back();    break;
+			case JBAD:     C.mValues.pop_back();   break;
+			default:       break;
+		}
+		clearBit( C.mNulls, mRows );
+	}
+	put( C, xValue );
+	C.mLast = mRows;
+}
+
+template<class V> void	// private; one more value at the end of xColumn, which may change its type
+jcolumns::put( column& xColumn, const V& xValue )
+{
+	column& C = xColumn;
+	size_t Row = mRows;
+	jType T = kind( xValue );
+	if ( T == JNULL )
+	{
+		switch( C.mType )
+		{
+			case JINTEGER: C.mIntegers.push_back( 0 ); break;
+			case JDOUBLE:  C.mDoubles.push_back( 0 );  break;
+			case JBOOL:    C.mBools.push_back( 0 );    break;
+			case JSTRING:  C.mCodes.push_back( 0 );    break;
+			case JBAD:     C.mValues.push_back( jvalue() ); break;
+			default:       break;	// still JNULL: no slots yet
+		}
+		setBit( C.mNulls, Row );
+		return;
+	}
+	if ( C.mType == JBAD )
+	{
+		C.mValues.push_back( whole( xValue ) );
+		return;
+	}
+	switch( T )
+	{
+		case JINTEGER:
+		{
+			long long I = asInteger( xValue );
+			bool Big = I >= EXACT || I <= -EXACT;
+			if ( C.mType == JNULL )
+			{
+				C.mType = JINTEGER;
+				C.mIntegers.resize( Row );
+			}
+			if ( C.mType == JINTEGER )
+			{
+				C.mIntegers.push_back( I );
+				C.mBig = C.mBig || Big;
+				return;
+			}
+			if ( C.mType == JDOUBLE && !Big )
+			{
+				C.mDoubles.push_back( (double)I );
+				return;
+			}
+			break;
+		}
+		case JDOUBLE:
+			if ( C.mType == JNULL )
+			{
+				C.mType = JDOUBLE;
+				C.mDoubles.resize( Row );
+			}
+			if ( C.mType == JINTEGER && !C.mBig )
+			{
+				C.mDoubles.assign( C.mIntegers.begin(), C.mIntegers.end() );
+				release( C.mIntegers );
+				C.mType = JDOUBLE;
+			}
+			if ( C.mType == JDOUBLE )
+			{
+				C.mDoubles.push_back( asDouble( xValue ) );
+				return;
+			}
+			break;
+		case JBOOL:
+			if ( C.mType == JNULL )
+			{
+				C.mType = JBOOL;
+				C.mBools.resize( Row );
+			}
+			if ( C.mType == JBOOL )
+			{
+				C.mBools.push_back( asBool( xValue ) );
+				return;
+			}
+			break;
+		case JSTRING:
+			if ( C.mType == JNULL )
+			{
+				C.mType = JSTRING;
+				C.mCodes.resize( Row );
+			}
+			if ( C.mType == JSTRING )
+			{
+				mScratch.assign( asString( xValue ), xValue.size() );
+				unordered_map<string, uint32_t>::const_iterator IT = C.mLookup.find( mScratch );
+				if ( IT != C.mLookup.end() )
+					C.mCodes.push_back( IT->second );
+				else
+				{
+					uint32_t Code = C.mDictionary.size();
+					C.mDictionary.push_back( mScratch );
+					C.mLookup[mScratch] = Code;
+					C.mCodes.push_back( Code );
+				}
+				return;
+			}
+			break;
+		default:	// unsigned beyond long long, binary, objects and arrays
+			break;
+	}
+	mixed( C );
+	C.mValues.push_back( whole( xValue ) );
+}
+
+void	// private; rows the current one did not mention are missing
+jcolumns::endRow()
+{
+	for ( size_t c = 0; c < mColumns.size(); c++ )
+	{
+		column& C = mColumns[c];
+		if ( C.mLast == mRows )
+			continue;
+		switch( C.mType )
+		{
+			case JINTEGER: C.mIntegers.push_back( 0 ); break;
+			case JDOUBLE:  C.mDoubles.push_back( 0 );  break;
+			case JBOOL:    C.mBools.push_back( 0 );    break;
+			case JSTRING:  C.mCodes.push_back( 0 );    break;
+			case JBAD:     C.mValues.push_back( jvalue() ); break;
+			default:       break;
+		}
+		setBit( C.mNulls, mRows );
+		setBit( C.mMissing, mRows );
+	}
+	mRows++;
+}
+
+void	// private; the rows so far become jvalues
+jcolumns::mixed( column& xColumn )
+{
+	vector<jvalue> Values;
+	Values.reserve( mRows + 1 );
+	for ( size_t r = 0; r < mRows; r++ )
+		Values.push_back( cell( xColumn, r ) );
+	release( xColumn.mIntegers );
+	release( xColumn.mDoubles );
+	release( xColumn.mBools );
+	release( xColumn.mCodes );
+	release( xColumn.mDictionary );
+	release( xColumn.mLookup );
+	xColumn.mValues.swap( Values );
+	xColumn.mType = JBAD;
+}
+
+/*
+ * reading back
+ *
+ */
+
+const jcolumns::column *	// private
+jcolumns::find( const string& xName ) const
+{
+	unordered_map<string, size_t>::const_iterator IT = mByName.find( xName );
+	return IT == mByName.end() ? NULL : &mColumns[IT->second];
+}
+
+jType
+jcolumns::type( const string& xColumn ) const
+{
+	const column *C = find( xColumn );
+	return C ? C->mType : JNULL;
+}
+
+size_t
+jcolumns::distinct( const string& xColumn ) const
+{
+	const column *C = find( xColumn );
+	return C ? C->mDictionary.size() : 0;
+}
+
+size_t
+jcolumns::bytes() const
+{
+	size_t Bytes = sizeof(*this) + mColumns.capacity() * sizeof(column);
+	for ( size_t c = 0; c < mColumns.size(); c++ )
+	{
+		const column& C = mColumns[c];
+		Bytes += C.mIntegers.capacity() * sizeof(long long) + C.mDoubles.capacity() * sizeof(double)
+			+ C.mBools.capacity() + C.mCodes.capacity() * sizeof(uint32_t)
+			+ (C.mNulls.capacity() + C.mMissing.capacity()) * sizeof(uint64_t)
+			+ C.mValues.capacity() * sizeof(jvalue);
+		for ( size_t i = 0; i < C.mDictionary.size(); i++ )	// the string, the table's copy, their nodes
+			Bytes += 2 * (sizeof(string) + C.mDictionary[i].capacity()) + 32;
+	}
+	return Bytes;
+}
+
+jvalue	// private; null for null and missing
+jcolumns::cell( const column& xColumn, size_t xRow ) const
+{
+	const column& C = xColumn;
+	if ( bit( C.mNulls, xRow ) )
+		return jvalue();
+	switch( C.mType )
+	{
+		case JINTEGER: return jvalue( C.mIntegers[xRow] );
+		case JDOUBLE:  return jvalue( C.mDoubles[xRow] );
+		case JBOOL:    return jvalue( (bool)C.mBools[xRow] );
+		case JSTRING:  return jvalue( C.mDictionary[C.mCodes[xRow]] );
+		case JBAD:     return C.mValues[xRow];
+		default:       return jvalue();
+	}
+}
+
+jvalue
+jcolumns::row( size_t xRow ) const
+{
+	if ( xRow >= mRows )
+		throw jerr::error( "jcolumns : row out of range" );
+	jvalue R;
+	R->Object( NULL );
+	for ( size_t c = 0; c < mColumns.size(); c++ )
+		if ( !bit( mColumns[c].mMissing, xRow ) )
+			R.insert( mColumns[c].mName, cell( mColumns[c], xRow ) );
+	return R;
+}
+
+jvalue
+jcolumns::toJvalue() const
+{
+	jvalue A;
+	A->Array( NULL );
+	A->Array()->reserve( mRows );
+	for ( size_t r = 0; r < mRows; r++ )
+		A->Array()->push_back( row( r ) );
+	return A;
+}
+
+void
+jcolumns::rows( const mask_t& xMask, vector<jvalue>& xOut ) const
+{
+	for ( size_t w = 0; w < xMask.size() && w * 64 < mRows; w++ )
+		for ( uint64_t M = xMask[w]; M; M &= M - 1 )
+		{
+			size_t r = w * 64 + __builtin_ctzll( M );
+			if ( r < mRows )
+				xOut.push_back( row( r ) );
+		}
+}
+
+/*
+ * kernels: 64 rows make one word of the mask, without a branch per row
+ *
+ */
+
+template<class T, class P> static void
+scan( const T *xData, size_t xRows, const uint64_t *xNulls, uint64_t *xMask, P xPass )
+{
+	for ( size_t w = 0, W = (xRows + 63) / 64; w < W; w++ )
+	{
+		if ( !xMask[w] )
+			continue;
+		const T *D = xData + w * 64;
+		size_t N = xRows - w * 64 < 64 ? xRows - w * 64 : 64;
+		uint64_t Bits = 0;
+		for ( size_t j = 0; j < N; j++ )
+			Bits |= (uint64_t)xPass( D[j] ) << j;
+		xMask[w] &= Bits & ~xNulls[w];
+	}
+}
+
+template<class T> static void
+compareScan( const T *xData, size_t xRows, const uint64_t *xNulls, uint64_t *xMask, jcolumns::cmp_t xOp, T xValue )
+{
+	switch( xOp )
+	{
+		case jcolumns::EQ: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V == xValue; } ); break;
+		case jcolumns::NE: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V != xValue; } ); break;
+		case jcolumns::LT: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V < xValue; } );  break;
+		case jcolumns::LE: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V <= xValue; } ); break;
+		case jcolumns::GT: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V > xValue; } );  break;
+		case jcolumns::GE: scan( xData, xRows, xNulls, xMask, [xValue]( T V ) { return V >= xValue; } ); break;
+	}
+}
+
+static bool
+passes( jcolumns::cmp_t xOp, int xCompare )
+{
+	switch( xOp )
+	{
+		case jcolumns::EQ: return xCompare == 0;
+		case jcolumns::NE: return xCompare != 0;
+		case jcolumns::LT: return xCompare < 0;
+		case jcolumns::LE: return xCompare <= 0;
+		case jcolumns::GT: return xCompare > 0;
+		case jcolumns::GE: return xCompare >= 0;
+	}
+	return false;
+}
+
+static void
+keep( bool xAll, const uint64_t *xNulls, uint64_t *xMask, size_t xWords )	// every value passes, or none
+{
+	for ( size_t w = 0; w < xWords; w++ )
+		xMask[w] = xAll ? xMask[w] & ~xNulls[w] : 0;
+}
+
+static int
+compareText( const string& xA, const char *xB, size_t xLength )	// as jvalue::compare orders strings
+{
+	int C = memcmp( xA.data(), xB, xA.size() < xLength ? xA.size() : xLength );
+	return C != 0 ? C : (xA.size() < xLength ? -1 : (xA.size() > xLength ? 1 : 0));
+}
+
+size_t
+jcolumns::filter( const string& xColumn, cmp_t xOp, const jvalue& xValue, mask_t& xMask ) const
+{
+	size_t W = (mRows + 63) / 64;
+	if ( xMask.empty() )
+	{
+		xMask.assign( W, ~0ULL );
+		if ( mRows % 64 )
+			xMask[W - 1] = (1ULL << (mRows % 64)) - 1;
+	}
+	xMask.resize( W, 0 );	// rows appended since the mask was made are not in it
+	if ( W == 0 )
+		return 0;
+	const column *C = find( xColumn );
+	if ( !C || C->mType == JNULL )	// nothing but nulls
+	{
+		if ( !(xValue.isNull() && xOp == EQ) )
+			xMask.assign( W, 0 );
+		return count( xMask );
+	}
+	const uint64_t *Nulls = C->mNulls.data();
+	uint64_t *Mask = xMask.data();
+	if ( xValue.isNull() )
+	{
+		for ( size_t w = 0; w < W; w++ )
+			Mask[w] &= xOp == EQ ? Nulls[w] : (xOp == NE ? ~Nulls[w] : 0);
+		return count( xMask );
+	}
+
+	// a value of another kind: every row passes, or none does
+	bool Number = xValue.isInteger() || xValue.isUnsigned() || xValue.isDouble();
+	jvalue Probe;
+	switch( C->mType )
+	{
+		case JINTEGER: case JDOUBLE: if ( !Number ) Probe = jvalue( 0 ); break;
+		case JBOOL:    if ( !xValue.isBool() ) Probe = jvalue( false ); break;
+		case JSTRING:  if ( !xValue.isString() ) Probe = jvalue( "" ); break;
+		default:       break;
+	}
+	if ( !Probe.isNull() )
+	{
+		keep( passes( xOp, Probe.compare( xValue ) ), Nulls, Mask, W );
+		return count( xMask );
+	}
+
+	switch( C->mType )
+	{
+		case JINTEGER:
+		{
+			double D = xValue->Double();
+			if ( xValue.isInteger() )
+				compareScan( C->mIntegers.data(), mRows, Nulls, Mask, xOp, xValue->Integer() );
+			else if ( D == floor( D ) && D >= -9223372036854775808.0 && D < 9223372036854775808.0 )
+				compareScan( C->mIntegers.data(), mRows, Nulls, Mask, xOp, (long long)D );
+			else if ( xOp == EQ || xOp == NE )	// no integer equals it
+				keep( xOp == NE, Nulls, Mask, W );
+			else	// v < 2.5 is v <= 2, v > 2.5 is v >= 3
+			{
+				bool Below = xOp == LT || xOp == LE;
+				double B = Below ? floor( D ) : ceil( D );
+				if ( B >= 9223372036854775808.0 )
+					keep( Below, Nulls, Mask, W );
+				else if ( B < -9223372036854775808.0 )
+					keep( !Below, Nulls, Mask, W );
+				else
+					compareScan( C->mIntegers.data(), mRows, Nulls, Mask, Below ? LE : GE, (long long)B );
+			}
+			break;
+		}
+		case JDOUBLE:
+			compareScan( C->mDoubles.data(), mRows, Nulls, Mask, xOp, xValue->Double() );
+			break;
+		case JBOOL:
+		{
+			uint8_t Pass[2] = { passes( xOp, xValue->Bool() ? -1 : 0 ), passes( xOp, xValue->Bool() ? 0 : 1 ) };
+			scan( C->mBools.data(), mRows, Nulls, Mask, [&Pass]( uint8_t V ) { return Pass[V & 1]; } );
+			break;
+		}
+		case JSTRING:
+		{
+			string Text( xValue->String(), xValue.size() );
+			if ( xOp == EQ || xOp == NE )
+			{
+				unordered_map<string, uint32_t>::const_iterator IT = C->mLookup.find( Text );
+				if ( IT == C->mLookup.end() )
+					keep( xOp == NE, Nulls, Mask, W );
+				else
+					compareScan( C->mCodes.data(), mRows, Nulls, Mask, xOp, IT->second );
+				break;
+			}
+			vector<uint8_t> Pass( C->mDictionary.size() );	// one answer per distinct string
+			for ( size_t i = 0; i < Pass.size(); i++ )
+				Pass[i] = passes( xOp, compareText( C->mDictionary[i], Text.data(), Text.size() ) );
+			const uint8_t *P = Pass.data();
+			scan( C->mCodes.data(), mRows, Nulls, Mask, [P]( uint32_t V ) { return P[V]; } );
+			break;
+		}
+		default:	// mixed: one jvalue at a time
+			for ( size_t r = 0; r < mRows; r++ )
+				if ( bit( xMask, r ) && (bit( C->mNulls, r ) || !passes( xOp, C->mValues[r].compare( xValue ) )) )
+					clearBit( xMask, r );
+			break;
+	}
+	return count( xMask );
+}
+
+size_t
+jcolumns::count( const mask_t& xMask ) const
+{
+	size_t N = 0;
+	for ( size_t w = 0; w < xMask.size(); w++ )
+		N += __builtin_popcountll( xMask[w] );
+	return N;
+}
+
+static inline uint64_t	// the rows of word w that count: in the mask and not null
+present( const vector<uint64_t>& xNulls, const jcolumns::mask_t *xMask, size_t xWord, size_t xRows )
+{
+	uint64_t M = ~xNulls[xWord];
+	if ( xMask )
+		M &= xWord < xMask->size() ? (*xMask)[xWord] : 0;
+	if ( xRows - xWord * 64 < 64 )
+		M &= (1ULL << (xRows - xWord * 64)) - 1;
+	return M;
+}
+
+jvalue
+jcolumns::sum( const string& xColumn, const mask_t *xMask ) const
+{
+	const column *C = find( xColumn );
+	if ( !C || (C->mType != JINTEGER && C->mType != JDOUBLE) )
+		return jvalue();
+	size_t W = (mRows + 63) / 64, Rows = 0;
+	if ( C->mType == JINTEGER )
+	{
+		long long Total = 0;
+		bool Over = false;
+		for ( size_t w = 0; w < W && !Over; w++ )
+		{
+			uint64_t M = present( C->mNulls, xMask, w, mRows );
+			const long long *D = C->mIntegers.data() + w * 64;
+			size_t N = mRows - w * 64 < 64 ? mRows - w * 64 : 64;
+			long long S = 0;
+			Rows += __builtin_popcountll( M );
+			if ( !C->mBig )	// 64 values below 2^53 cannot overflow
+				for ( size_t j = 0; j < N; j++ )
+					S += D[j] & -(long long)((M >> j) & 1);
+			else
+				for ( size_t j = 0; j < N && !Over; j++ )
+					Over = __builtin_add_overflow( S, D[j] & -(long long)((M >> j) & 1), &S );
+			Over = Over || __builtin_add_overflow( Total, S, &Total );
+		}
+		if ( !Over )
+			return Rows ? jvalue( Total ) : jvalue();
+		double Sum = 0;	// too large for an integer
+		for ( size_t r = 0; r < mRows; r++ )
+			if ( (present( C->mNulls, xMask, r / 64, mRows ) >> (r & 63)) & 1 )
+				Sum += (double)C->mIntegers[r];
+		return jvalue( Sum );
+	}
+	double Total = 0;
+	for ( size_t w = 0; w < W; w++ )
+	{
+		uint64_t M = present( C->mNulls, xMask, w, mRows );
+		const double *D = C->mDoubles.data() + w * 64;
+		size_t N = mRows - w * 64 < 64 ? mRows - w * 64 : 64;
+		double S = 0;
+		Rows += __builtin_popcountll( M );
+		for ( size_t j = 0; j < N; j++ )
+			S += (M >> j) & 1 ? D[j] : 0.0;
+		Total += S;
+	}
+	return Rows ? jvalue( Total ) : jvalue();
+}
+
+template<class T> static bool	// xSign -1: the least of the present values, 1: the greatest
+extremeOf( const T *xData, const vector<uint64_t>& xNulls, const jcolumns::mask_t *xMask, size_t xRows, int xSign, T& xOut )
+{
+	bool Found = false;
+	for ( size_t w = 0, W = (xRows + 63) / 64; w < W; w++ )
+	{
+		uint64_t M = present( xNulls, xMask, w, xRows );
+		const T *D = xData + w * 64;
+		if ( !M )
+			continue;
+		if ( !Found )
+		{
+			xOut = D[__builtin_ctzll( M )];
+			Found = true;
+		}
+		T E = xOut;
+		if ( M == ~0ULL )	// a whole word: no test per row
+		{
+			if ( xSign < 0 )
+				for ( size_t j = 0; j < 64; j++ )
+					E = D[j] < E ? D[j] : E;
+			else
+				for ( size_t j = 0; j < 64; j++ )
+					E = D[j] > E ? D[j] : E;
+		}
+		else
+			for ( ; M; M &= M - 1 )
+			{
+				T V = D[__builtin_ctzll( M )];
+				E = (xSign < 0 ? V < E : V > E) ? V : E;
+			}
+		xOut = E;
+	}
+	return Found;
+}
+
+jvalue	// private
+jcolumns::extreme( const string& xColumn, const mask_t *xMask, int xSign ) const
+{
+	const column *C = find( xColumn );
+	if ( !C )
+		return jvalue();
+	switch( C->mType )
+	{
+		case JINTEGER:
+		{
+			long long E = 0;
+			return extremeOf( C->mIntegers.data(), C->mNulls, xMask, mRows, xSign, E ) ? jvalue( E ) : jvalue();
+		}
+		case JDOUBLE:
+		{
+			double E = 0;
+			return extremeOf( C->mDoubles.data(), C->mNulls, xMask, mRows, xSign, E ) ? jvalue( E ) : jvalue();
+		}
+		case JBOOL:
+		{
+			uint8_t E = 0;
+			return extremeOf( C->mBools.data(), C->mNulls, xMask, mRows, xSign, E ) ? jvalue( (bool)E ) : jvalue();
+		}
+		case JSTRING:	// the distinct strings present decide
+		{
+			vector<uint8_t> Used( C->mDictionary.size(), 0 );
+			for ( size_t w = 0, W = (mRows + 63) / 64; w < W; w++ )
+				for ( uint64_t M = present( C->mNulls, xMask, w, mRows ); M; M &= M - 1 )
+					Used[C->mCodes[w * 64 + __builtin_ctzll( M )]] = 1;
+			const string *E = NULL;
+			for ( size_t i = 0; i < Used.size(); i++ )
+				if ( Used[i] && (!E || compareText( C->mDictionary[i], E->data(), E->size() ) * xSign > 0) )
+					E = &C->mDictionary[i];
+			return E ? jvalue( *E ) : jvalue();
+		}
+		case JBAD:
+		{
+			const jvalue *E = NULL;
+			for ( size_t r = 0; r < mRows; r++ )
+				if ( ((present( C->mNulls, xMask, r / 64, mRows ) >> (r & 63)) & 1) && (!E || C->mValues[r].compare( *E ) * xSign > 0) )
+					E = &C->mValues[r];
+			return E ? *E : jvalue();
+		}
+		default:
+			return jvalue();
+	}
+}
@@ -0,0 +1,118 @@
+
+#ifndef jcolumnsHeader
+#define jcolumnsHeader
+
+/*
+ * an array of like-shaped objects held column by column
+ *
+ *   jcolumns C( Requests );			// from a tree: an array of objects
+ *   C.parse( NDJSON );				// or straight from text, no tree built
+ *   jcolumns::mask_t Slow;
+ *   C.filter( "status", jcolumns::EQ, 500, Slow );
+ *   C.filter( "latency", jcolumns::GT, 0.25, Slow );	// filters AND together
+ *   jvalue Total = C.sum( "latency", &Slow );
+ *   vector<jvalue> Rows;
+ *   C.rows( Slow, Rows );			// back to objects
+ *
+ * each member name becomes a column of one type: integers and doubles in
+ * contiguous vectors, booleans one byte each, strings as 32-bit codes into a
+ * dictionary of the distinct values.  a column with both integers and
+ * doubles holds doubles (unless an integer is too large for one to be exact);
+ * any other mix, and objects or arrays, are kept as jvalues (type() JBAD).
+ *
+ * null and missing members are bits in a per-column bitmap (the slot holds a
+ * zero), and come back as they went in: null members as null, missing ones
+ * left out.  they never pass a filter other than EQ null, and sum, min and
+ * max skip them.
+ *
+ * filter() compares as jvalue::compare does (1 == 1.0; a number is less
+ * than any string) and sets one bit per row in a mask_t; the kernels run 64
+ * rows to a word without branches, which lets the compiler vectorize them.
+ * sum(), min() and max() take an optional mask.
+ *
+ * rows may be appended at any time; nothing else changes them.  none of this
+ * locks.
+ *
+ */
+
+#include "jvalue.h"
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+class jtape_value;
+
+class jcolumns
+{
+		jcolumns( const jcolumns& );            // not implemented
+		jcolumns& operator=( const jcolumns& ); // not implemented
+	public:
+		enum cmp_t { EQ, NE, LT, LE, GT, GE };
+		typedef vector<uint64_t> mask_t;	// bit i % 64 of word i / 64 is row i
+
+		jcolumns() : mRows( 0 ) {}
+		explicit jcolumns( const jvalue& xRows ) : mRows( 0 ) { append( xRows ); }
+
+		void append( const jvalue& xRows );	// an object, or an array of them
+		size_t parse( const char *xText, size_t xLength );	// objects, arrays of objects, one after another; returns rows added
+		size_t parse( const string& xText ) { return parse( xText.data(), xText.size() ); }
+		void clear();
+
+		size_t size() const { return mRows; }
+		size_t columns() const { return mColumns.size(); }
+		const string& name( size_t xColumn ) const { return mColumns[xColumn].mName; }
+		jType type( const string& xColumn ) const;	// JINTEGER JDOUBLE JBOOL JSTRING, JNULL if only nulls, JBAD if mixed
+		size_t distinct( const string& xColumn ) const;	// dictionary entries of a string column
+		size_t bytes() const;	// memory held, roughly
+
+		jvalue row( size_t xRow ) const;
+		jvalue toJvalue() const;	// the array of every row
+		void rows( const mask_t& xMask, vector<jvalue>& xOut ) const;	// appends the rows set in xMask
+
+		// ANDs into xMask (every row when it is empty); returns the rows left
+		size_t filter( const string& xColumn, cmp_t xOp, const jvalue& xValue, mask_t& xMask ) const;
+		size_t count( const mask_t& xMask ) const;
+
+		// null when there is nothing to add or compare; sum() takes numbers only
+		jvalue sum( const string& xColumn, const mask_t *xMask = NULL ) const;
+		jvalue min( const string& xColumn, const mask_t *xMask = NULL ) const { return extreme( xColumn, xMask, -1 ); }
+		jvalue max( const string& xColumn, const mask_t *xMask = NULL ) const { return extreme( xColumn, xMask, 1 ); }
+
+	private:
+		struct column
+		{
+			string             mName;
+			jType              mType;
+			bool               mBig;		// an integer beyond 2^53: not exact as a double
+			vector<long long>  mIntegers;
+			vector<double>     mDoubles;
+			vector<uint8_t>    mBools;
+			vector<uint32_t>   mCodes;		// strings
+			vector<string>     mDictionary;
+			unordered_map<string, uint32_t> mLookup;
+			vector<jvalue>     mValues;		// JBAD
+			vector<uint64_t>   mNulls;		// null or missing
+			vector<uint64_t>   mMissing;
+			size_t             mLast;		// the last row written
+		};
+
+		vector<column>                   mColumns;
+		unordered_map<string, size_t>    mByName;
+		vector<size_t>                   mShape;	// the column of each member of the last row, by position
+		size_t                           mRows;
+		string                           mScratch;
+
+		const column *find( const string& xName ) const;
+		size_t at( size_t xPosition, const char *xName, size_t xLength );	// the column for a member, made if new
+		void appendRow( const jvalue& xRow );
+		void appendRow( const jtape_value& xRow );
+		void beginRow();
+		template<class V> void member( size_t xPosition, const char *xName, size_t xLength, const V& xValue );
+		template<class V> void put( column& xColumn, const V& xValue );
+		void endRow();
+		void mixed( column& xColumn );
+		jvalue cell( const column& xColumn, size_t xRow ) const;
+		jvalue extreme( const string& xColumn, const mask_t *xMask, int xSign ) const;
+};
+
+#endif
@@ -0,0 +1,179 @@
+
+#include "jdedup.h"
+#include <string.h>
+using namespace std;
+
+/*
+ * the table: values are told apart by their own contents, containers by
+ * their members' nodes
+ *
+ */
+
+static inline size_t
+mix( size_t xHash, size_t xValue )
+{
+	return xHash ^ (xValue + 0x9e3779b97f4a7c15ULL + (xHash << 6) + (xHash >> 2));
+}
+
+size_t
+jdedup::shallow_hash::operator()( const jvalue& xValue ) const
+{
+	size_t H = xValue.type();
+	if ( xValue.isArray() )
+	{
+		const array_vector_t& A = *xValue->Array();
+		for ( size_t i = 0; i < A.size(); i++ )
+			H = mix( H, (size_t)A[i].get() );
+	}
+	else if ( xValue.isObject() )
+	{
+		const object_map_t& O = *xValue->Object();
+		for ( object_map_t::const_iterator IT = O.begin(); IT != O.end(); ++IT )
+			H = mix( mix( H, std::hash<string>()( IT->first ) ), (size_t)IT->second.get() );
+	}
+	else
+		H = mix( H, (size_t)xValue.hash() );
+	return H;
+}
+
+bool
+jdedup::shallow_equal::operator()( const jvalue& xA, const jvalue& xB ) const
+{
+	if ( xA.get() == xB.get() )
+		return true;
+	if ( xA.type() != xB.type() )
+		return false;
+	switch( xA.type() )
+	{
+		case JARRAY:
+		{
+			const array_vector_t& A = *xA->Array();
+			const array_vector_t& B = *xB->Array();
+			if ( A.size() != B.size() )
+				return false;
+			for ( size_t i = 0; i < A.size(); i++ )
+				if ( A[i].get() != B[i].get() )
+					return false;
+			return true;
+		}
+		case JOBJECT:
+		{
+			const object_map_t& A = *xA->Object();
+			const object_map_t& B = *xB->Object();
+			if ( A.size() != B.size() )
+				return false;
+			for ( object_map_t::const_iterator IT = A.begin(), JT = B.begin(); IT != A.end(); ++IT, ++JT )
+				if ( IT->second.get() != JT->second.get() || IT->first != JT->first )
+					return false;
+			return true;
+		}
+		case JDOUBLE:	// bit for bit: -0.0 prints differently from 0.0
+		{
+			double A = xA->Double(), B = xB->Double();
+			return memcmp( &A, &B, sizeof( A ) ) == 0;
+		}
+		default:
+			return xA.equals( xB );	// same type: exact
+	}
+}
+
+static size_t	// what freeing this node alone gives back; its children are shared
+shallowBytes( const jvalue& xValue )
+{
+	size_t Bytes = sizeof( private_jvalue_data ) + 3 * sizeof( void * );	// and the shared_ptr control block
+	switch( xValue.type() )
+	{
+		case JSTRING:
+			if ( xValue.size() >= sizeof( char * ) )	// not stored inline
+				Bytes += sizeof( size_t ) + xValue.size() + 1;	// the capacity goes before it
+			break;
+		case JBINARY:
+			Bytes += sizeof( binary_t ) + xValue->Binary()->capacity();
+			break;
+		case JARRAY:
+			Bytes += sizeof( array_vector_t ) + xValue->Array()->capacity() * sizeof( jvalue );
+			break;
+		case JOBJECT:
+		{
+			const object_map_t& O = *xValue->Object();
+			Bytes += sizeof( object_map_t ) + O.size() * (sizeof( object_map_t::value_type ) + 4 * sizeof( void * ));	// + tree node links
+			for ( object_map_t::const_iterator IT = O.begin(); IT != O.end(); ++IT )
+				if ( IT->first.capacity() > 15 )	// beyond the short string buffer
+					Bytes += IT->first.capacity() + 1;
+			break;
+		}
+		default:
+			break;
+	}
+	return Bytes;
+}
+
+/*
+ * the interface
+ *
+ */
+
+jdedup::jdedup() : mValues( 0 ), mShared( 0 ), mSaved( 0 )
+{
+}
+
+jvalue
+jdedup::intern( const jvalue& xValue )
+{
+	mValues++;
+	pair<unordered_set<jvalue, shallow_hash, shallow_equal>::iterator, bool> R = mTable.insert( xValue );
+	if ( R.second || R.first->get() == xValue.get() )
+		return xValue;
+	mShared++;
+	if ( xValue.use_count() == 1 )	// the caller's handle is the last: the node goes when it is replaced
+		mSaved += shallowBytes( xValue );
+	return *R.first;
+}
+
+void	// private; children first, so a container is interned after its members
+jdedup::shareChildren( const jvalue& xValue )
+{
+	if ( xValue.isObject() )
+	{
+		object_map_t& O = *xValue->Object();
+		for ( object_map_t::iterator IT = O.begin(); IT != O.end(); ++IT )
+		{
+			shareChildren( IT->second );
+			IT->second = intern( IT->second );
+		}
+	}
+	else if ( xValue.isArray() )
+	{
+		array_vector_t& A = *xValue->Array();
+		for ( size_t i = 0; i < A.size(); i++ )
+		{
+			shareChildren( A[i] );
+			A[i] = intern( A[i] );
+		}
+	}
+}
+
+void
+jdedup::share( jvalue& xRoot )
+{
+	shareChildren( xRoot );
+	xRoot = intern( xRoot );
+}
+
+void
+jdedup::clear()
+{
+	unordered_set<jvalue, shallow_hash, shallow_equal>().swap( mTable );	// clear() would keep the buckets
+}
+
+jvalue&	// static
+jdedup::own( jvalue& xSlot )
+{
+	if ( xSlot.use_count() > 1 )
+	{
+		jvalue Copy;
+		*Copy = *xSlot;	// shallow: members stay shared until they are owned in turn
+		xSlot = std::move( Copy );
+	}
+	return xSlot;
+}
@@ -0,0 +1,74 @@
+
+#ifndef jdedupHeader
+#define jdedupHeader
+
+/*
+ * hash-consing: equal values share one node
+ *
+ * large reference documents repeat themselves -- the same enum strings,
+ * the same address or metadata objects over and over.  jvalue children are
+ * shared_ptr handles, so any number of parents can point at one node; a
+ * jdedup keeps one node per distinct value and hands it out for every copy.
+ *
+ * after parsing:
+ *   jdedup D;
+ *   D.share( Doc );		// in place: duplicates replaced, then freed
+ *   cerr << D.saved();		// bytes given back (estimated from object sizes)
+ *
+ * while parsing (duplicates are never kept, so the peak is lower too):
+ *   jdedup D;
+ *   jpush P;
+ *   P.dedup( &D );		// every completed value goes through D.intern()
+ *
+ * equal means the same type and the same value as printed: 1 and 1.0 stay
+ * apart, and so do 0.0 and -0.0.  containers are compared by their
+ * children's nodes, which are already shared, so interning one costs time in
+ * proportion to its own members, not its subtree.
+ *
+ * copy on mutate: a shared node changed through any parent changes under all
+ * of them -- and Doc["a"] = 5 changes the node in place.  before editing a
+ * deduplicated tree, drop the jdedup (its table hashes nodes as they are
+ * now) and pass every node on the way down, the one assigned to included,
+ * through own(), which swaps a node shared with anyone else for a private
+ * shallow copy:
+ *   jdedup::own( jdedup::own( jdedup::own( Doc["users"] )[3] )["name"] ) = "x";
+ *
+ * the table holds a handle on every distinct value (about the size of a
+ * small value each) until clear() or destruction.  none of this locks.
+ *
+ */
+
+#include "jvalue.h"
+#include <unordered_set>
+
+class jdedup
+{
+		jdedup( const jdedup& );            // not implemented
+		jdedup& operator=( const jdedup& ); // not implemented
+	public:
+		jdedup();
+
+		jvalue intern( const jvalue& xValue );	// the shared value equal to xValue; its children must be interned
+		void share( jvalue& xRoot );			// intern the whole tree below xRoot, in place
+		void clear();							// forget the table; shared nodes stay shared
+
+		static jvalue& own( jvalue& xSlot );	// make xSlot's node private to it before changing it
+
+		size_t values() const { return mValues; }	// interned so far
+		size_t shared() const { return mShared; }	// of those, replaced by an equal node
+		size_t distinct() const { return mTable.size(); }
+		size_t saved() const { return mSaved; }		// bytes freed by the replacements
+
+	private:
+		struct shallow_hash  { size_t operator()( const jvalue& xValue ) const; };
+		struct shallow_equal { bool operator()( const jvalue& xA, const jvalue& xB ) const; };
+
+		unordered_set<jvalue, shallow_hash, shallow_equal> mTable;
+		size_t mValues;
+		size_t mShared;
+		size_t mSaved;
+
+		void shareChildren( const jvalue& xValue );
+};
+
+#endif
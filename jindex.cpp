@@ -0,0 +1,141 @@
+
+#include "jindex.h"
+#include "jpatch.h"
+#include <algorithm>
+using namespace std;
+
+const size_t jindex::npos;
+
+jindex::jindex( const jvalue& xArray, const string& xPath ) : mArray( xArray ), mSeen( 0 )
+{
+	jpatch::tokens( xPath, mPath );
+	catchUp();
+}
+
+const jvalue *	// private
+jindex::key( size_t xPosition ) const
+{
+	const jvalue *V = &(*mArray->Array())[xPosition];
+	for ( size_t i = 0; i < mPath.size(); i++ )
+	{
+		object_map_t *O = (*V)->Object();
+		if ( !O )
+			return NULL;
+		object_map_t::const_iterator IT = O->find( mPath[i] );
+		if ( IT == O->end() )
+			return NULL;
+		V = &IT->second;
+	}
+	return V;
+}
+
+void	// private
+jindex::add( size_t xPosition )
+{
+	if ( const jvalue *K = key( xPosition ) )
+		mTable.insert( table_t::value_type( K->hash(), xPosition ) );
+}
+
+void	// private
+jindex::remove( size_t xPosition )
+{
+	if ( const jvalue *K = key( xPosition ) )	// where it should be, if the key is as it was indexed
+	{
+		pair<table_t::iterator, table_t::iterator> R = mTable.equal_range( K->hash() );
+		for ( table_t::iterator IT = R.first; IT != R.second; ++IT )
+			if ( IT->second == xPosition )
+			{
+				mTable.erase( IT );
+				return;
+			}
+	}
+	for ( table_t::iterator IT = mTable.begin(); IT != mTable.end(); ++IT )	// changed in place: look everywhere
+		if ( IT->second == xPosition )
+		{
+			mTable.erase( IT );
+			return;
+		}
+}
+
+void	// private; index whatever was appended since the last look
+jindex::catchUp()
+{
+	array_vector_t *A = mArray->Array();
+	size_t Size = A ? A->size() : 0;
+	if ( Size < mSeen )	// shrunk behind our back
+	{
+		rebuild();
+		return;
+	}
+	if ( mTable.empty() )
+		mTable.reserve( Size );
+	for ( ; mSeen < Size; mSeen++ )
+		add( mSeen );
+}
+
+size_t
+jindex::find( const jvalue& xKey )
+{
+	catchUp();
+	size_t First = npos;
+	pair<table_t::iterator, table_t::iterator> R = mTable.equal_range( xKey.hash() );
+	for ( table_t::iterator IT = R.first; IT != R.second; ++IT )
+	{
+		const jvalue *K = key( IT->second );
+		if ( IT->second < First && K && K->equals( xKey ) )
+			First = IT->second;
+	}
+	return First;
+}
+
+vector<size_t>
+jindex::findAll( const jvalue& xKey )
+{
+	catchUp();
+	vector<size_t> All;
+	pair<table_t::iterator, table_t::iterator> R = mTable.equal_range( xKey.hash() );
+	for ( table_t::iterator IT = R.first; IT != R.second; ++IT )
+	{
+		const jvalue *K = key( IT->second );
+		if ( K && K->equals( xKey ) )
+			All.push_back( IT->second );
+	}
+	sort( All.begin(), All.end() );
+	return All;
+}
+
+jvalue
+jindex::get( const jvalue& xKey )
+{
+	size_t At = find( xKey );
+	return At == npos ? jvalue() : (*mArray->Array())[At];
+}
+
+void
+jindex::push_back( const jvalue& xElement )
+{
+	catchUp();
+	mArray->push_back( xElement );
+	catchUp();
+}
+
+void
+jindex::set( size_t xPosition, const jvalue& xElement )
+{
+	catchUp();
+	array_vector_t *A = mArray->Array();
+	if ( !A || xPosition >= A->size() )
+		throw jerr::error( "jindex : position out of range" );
+	remove( xPosition );
+	(*A)[xPosition] = xElement;
+	mArray->changed();	// as operator[] would
+	add( xPosition );
+}
+
+void
+jindex::rebuild()
+{
+	mTable.clear();
+	mSeen = 0;
+	catchUp();
+}
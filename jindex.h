@@ -0,0 +1,66 @@
+
+#ifndef jindexHeader
+#define jindexHeader
+
+/*
+ * a hash index over an array of objects: key value -> element positions
+ *
+ *   jindex ById( Users, "/id" );		// JSON Pointer into each element
+ *   size_t At = ById.find( 12345 );	// jindex::npos if there is none
+ *   jvalue U = ById.get( "u-77" );	// the element itself, or null
+ *   ById.push_back( NewUser );		// appends to Users and indexes it
+ *   ById.set( At, Replacement );		// replaces Users[At] and reindexes it
+ *
+ * keys compare as jvalue::equals() does, so 7 finds {"id":7.0}; elements
+ * without the key, or that are not objects, are left out.  several
+ * elements may share a key: find() gives the first, findAll() every one.
+ *
+ * keeping it right: elements appended to the array by anyone are picked up
+ * by the next lookup, and every hit is checked against the element, so a
+ * changed or removed element is never returned by mistake.  an element whose
+ * key is changed in place, or an insert or erase before the end, can make a
+ * present key look absent: go through set(), or rebuild() afterwards.
+ *
+ * the index holds a handle on the array, not on the elements.  none of this
+ * locks.
+ *
+ */
+
+#include "jvalue.h"
+#include <unordered_map>
+#include <vector>
+
+class jindex
+{
+		jindex( const jindex& );            // not implemented
+		jindex& operator=( const jindex& ); // not implemented
+	public:
+		static const size_t npos = (size_t)-1;
+
+		jindex( const jvalue& xArray, const string& xPath );
+
+		size_t find( const jvalue& xKey );
+		vector<size_t> findAll( const jvalue& xKey );
+		jvalue get( const jvalue& xKey );	// the element, or a new null
+
+		void push_back( const jvalue& xElement );
+		void set( size_t xPosition, const jvalue& xElement );
+		void rebuild();
+
+		size_t indexed() const { return mTable.size(); }	// elements with the key
+
+	private:
+		typedef unordered_multimap<uint64_t, size_t> table_t;	// key hash -> position
+
+		jvalue         mArray;
+		vector<string> mPath;
+		table_t        mTable;
+		size_t         mSeen;	// positions below this have been looked at
+
+		const jvalue *key( size_t xPosition ) const;	// NULL if the element has none
+		void add( size_t xPosition );
+		void remove( size_t xPosition );
+		void catchUp();
+};
+
+#endif
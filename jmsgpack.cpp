@@ -0,0 +1,358 @@
+
+#include "jmsgpack.h"
+#include <math.h>
+#include <sstream>
+using namespace std;
+
+enum { MAX_DEPTH = 4096 };	// nesting limit when decoding untrusted input
+
+/*
+ * encoding
+ *
+ */
+
+static void
+big( string& xOut, unsigned char xMarker, unsigned long long xValue, unsigned int xBytes )	// marker + big-endian value
+{
+	unsigned char B[9];
+	B[0] = xMarker;
+	for ( unsigned int i = 0; i < xBytes; i++ )
+		B[1 + i] = xValue >> (8 * (xBytes - 1 - i));
+	xOut.append( (const char *)B, xBytes + 1 );
+}
+
+static void
+natural( string& xOut, unsigned long long xValue )
+{
+	if ( xValue <= 0x7F )
+		xOut += (char)xValue;	// positive fixint
+	else if ( xValue <= 0xFF )
+		big( xOut, 0xCC, xValue, 1 );
+	else if ( xValue <= 0xFFFF )
+		big( xOut, 0xCD, xValue, 2 );
+	else if ( xValue <= 0xFFFFFFFFULL )
+		big( xOut, 0xCE, xValue, 4 );
+	else
+		big( xOut, 0xCF, xValue, 8 );
+}
+
+static void
+integer( string& xOut, long long xValue )
+{
+	if ( xValue >= 0 )
+		natural( xOut, xValue );
+	else if ( xValue >= -32 )
+		xOut += (char)xValue;	// negative fixint
+	else if ( xValue >= -128 )
+		big( xOut, 0xD0, xValue, 1 );
+	else if ( xValue >= -32768 )
+		big( xOut, 0xD1, xValue, 2 );
+	else if ( xValue >= -2147483648LL )
+		big( xOut, 0xD2, xValue, 4 );
+	else
+		big( xOut, 0xD3, xValue, 8 );
+}
+
+static void
+length( string& xOut, size_t xLength, unsigned char xFix, unsigned int xFixMax, unsigned char x8, unsigned char x16, unsigned char x32 )
+{
+	if ( xLength <= xFixMax && xFix )
+		xOut += (char)(xFix | xLength);
+	else if ( xLength <= 0xFF && x8 )
+		big( xOut, x8, xLength, 1 );
+	else if ( xLength <= 0xFFFF )
+		big( xOut, x16, xLength, 2 );
+	else if ( xLength <= 0xFFFFFFFFULL )
+		big( xOut, x32, xLength, 4 );
+	else
+		throw jerr::error( "jmsgpack::encode : item too large" );
+}
+
+void	// static
+jmsgpack::encode( const jvalue& xValue, string& xOut )
+{
+	private_jvalue_data *V = xValue.get();
+	switch( V->type() )
+	{
+		case JNULL:
+			xOut += (char)0xC0;
+			break;
+		case JBOOL:
+			xOut += (char)(V->Bool() ? 0xC3 : 0xC2);
+			break;
+		case JINTEGER:
+			integer( xOut, V->Integer() );
+			break;
+		case JUNSIGNED:
+			natural( xOut, V->Unsigned() );
+			break;
+		case JDOUBLE:
+		{
+			double D = V->Double();
+			float F = (float)D;
+			if ( (double)F == D || isnan( D ) )
+			{
+				unsigned int Bits;
+				if ( isnan( D ) ) F = NAN;
+				memcpy( &Bits, &F, sizeof(Bits) );
+				big( xOut, 0xCA, Bits, 4 );
+			}
+			else
+			{
+				unsigned long long Bits;
+				memcpy( &Bits, &D, sizeof(Bits) );
+				big( xOut, 0xCB, Bits, 8 );
+			}
+			break;
+		}
+		case JSTRING:
+		{
+			const char *S = V->String();
+			size_t L = V->size();
+			length( xOut, L, 0xA0, 31, 0xD9, 0xDA, 0xDB );
+			xOut.append( S, L );
+			break;
+		}
+		case JBINARY:
+			length( xOut, V->Binary()->size(), 0, 0, 0xC4, 0xC5, 0xC6 );
+			xOut += *V->Binary();
+			break;
+		case JARRAY:
+		{
+			const array_vector_t& A = *V->Array();
+			length( xOut, A.size(), 0x90, 15, 0, 0xDC, 0xDD );
+			for ( size_t i = 0; i < A.size(); i++ )
+				encode( A[i], xOut );
+			break;
+		}
+		case JOBJECT:
+		{
+			const object_map_t& O = *V->Object();
+			length( xOut, O.size(), 0x80, 15, 0, 0xDE, 0xDF );
+			for ( object_map_t::const_iterator IT = O.begin(); IT != O.end(); IT++ )
+			{
+				length( xOut, IT->first.size(), 0xA0, 31, 0xD9, 0xDA, 0xDB );
+				xOut += IT->first;
+				encode( IT->second, xOut );
+			}
+			break;
+		}
+		case JBAD:
+			throw jerr::error( "jmsgpack::encode : accessing deleted jvalue" );
+	}
+}
+
+/*
+ * decoding
+ *
+ */
+
+class msgpackReader
+{
+	public:
+		msgpackReader( const void *xBuffer, size_t xLength )
+			: mStart( (const unsigned char *)xBuffer ), mPos( mStart ), mEnd( mStart + xLength ), mDepth( 0 ) {}
+
+		void value( jvalue& xOut );
+		size_t used() const { return mPos - mStart; }
+
+	private:
+		const unsigned char *mStart;
+		const unsigned char *mPos;
+		const unsigned char *mEnd;
+		unsigned int mDepth;
+
+		void need( unsigned long long xCount )
+			{
+				if ( xCount > (unsigned long long)(mEnd - mPos) )
+					throw jerr::error( "jmsgpack::decode : truncated input" );
+			}
+		unsigned long long big( unsigned int xBytes )
+			{
+				need( xBytes );
+				unsigned long long R = 0;
+				while ( xBytes-- > 0 )
+					R = (R << 8) | *mPos++;
+				return R;
+			}
+		long long signedBig( unsigned int xBytes )	// sign-extend
+			{
+				unsigned long long R = big( xBytes );
+				unsigned int Shift = 64 - 8 * xBytes;
+				return (long long)(R << Shift) >> Shift;
+			}
+		const char *take( unsigned long long xCount )
+			{
+				need( xCount );
+				const char *P = (const char *)mPos;
+				mPos += xCount;
+				return P;
+			}
+
+		void array( jvalue& xOut, unsigned long long xCount );
+		void map( jvalue& xOut, unsigned long long xCount );
+		void key( string& xOut );
+};
+
+void
+msgpackReader::array( jvalue& xOut, unsigned long long xCount )
+{
+	need( xCount );	// every item is at least one byte
+	xOut.Array( NULL );
+	array_vector_t& A = *xOut.Array();
+	A.resize( xCount );
+	for ( size_t i = 0; i < xCount; i++ )
+		value( A[i] );
+}
+
+void
+msgpackReader::map( jvalue& xOut, unsigned long long xCount )
+{
+	if ( xCount > (unsigned long long)(mEnd - mPos) / 2 )	// every entry is at least two bytes
+		throw jerr::error( "jmsgpack::decode : truncated input" );
+	xOut.Object( NULL );
+	object_map_t& O = *xOut.Object();
+	for ( unsigned long long i = 0; i < xCount; i++ )
+	{
+		string K;
+		key( K );
+		value( O[K] );
+	}
+}
+
+void	// object keys: strings as-is, anything else as its json text
+msgpackReader::key( string& xOut )
+{
+	need( 1 );
+	unsigned char B = *mPos;
+	if ( (B & 0xE0) == 0xA0 )
+	{
+		mPos++;
+		xOut.assign( take( B & 0x1F ), B & 0x1F );
+		return;
+	}
+	if ( B == 0xD9 || B == 0xDA || B == 0xDB )
+	{
+		mPos++;
+		unsigned long long L = big( B == 0xD9 ? 1 : (B == 0xDA ? 2 : 4) );
+		xOut.assign( take( L ), L );
+		return;
+	}
+	jvalue K;
+	value( K );
+	ostringstream OS;
+	OS << K;
+	xOut = OS.str();
+}
+
+void
+msgpackReader::value( jvalue& xOut )
+{
+	need( 1 );
+	unsigned char B = *mPos++;
+
+	if ( ++mDepth > MAX_DEPTH )
+		throw jerr::error( "jmsgpack::decode : nesting too deep" );
+
+	if ( B <= 0x7F )
+		xOut.Integer( B );
+	else if ( B >= 0xE0 )
+		xOut.Integer( (signed char)B );
+	else if ( (B & 0xF0) == 0x80 )
+		map( xOut, B & 0x0F );
+	else if ( (B & 0xF0) == 0x90 )
+		array( xOut, B & 0x0F );
+	else if ( (B & 0xE0) == 0xA0 )
+	{
+		const char *P = take( B & 0x1F );
+		xOut.String( P, B & 0x1F );
+	}
+	else switch( B )
+	{
+		case 0xC0: xOut.Null();        break;
+		case 0xC2: xOut.Bool( false ); break;
+		case 0xC3: xOut.Bool( true );  break;
+		case 0xC4:
+		case 0xC5:
+		case 0xC6:
+		{
+			unsigned long long L = big( 1 << (B - 0xC4) );
+			const char *P = take( L );
+			xOut.Binary( P, L );
+			break;
+		}
+		case 0xC7:	// ext 8/16/32: length, type, data
+		case 0xC8:
+		case 0xC9:
+		{
+			unsigned long long L = big( 1 << (B - 0xC7) );
+			take( 1 );
+			const char *P = take( L );
+			xOut.Binary( P, L );
+			break;
+		}
+		case 0xCA:
+		{
+			unsigned int Bits = big( 4 );
+			float F;
+			memcpy( &F, &Bits, sizeof(F) );
+			xOut.Double( F );
+			break;
+		}
+		case 0xCB:
+		{
+			unsigned long long Bits = big( 8 );
+			double D;
+			memcpy( &D, &Bits, sizeof(D) );
+			xOut.Double( D );
+			break;
+		}
+		case 0xCC: xOut.Integer( big( 1 ) ); break;
+		case 0xCD: xOut.Integer( big( 2 ) ); break;
+		case 0xCE: xOut.Integer( big( 4 ) ); break;
+		case 0xCF: xOut.Number( big( 8 ) );  break;
+		case 0xD0: xOut.Integer( signedBig( 1 ) ); break;
+		case 0xD1: xOut.Integer( signedBig( 2 ) ); break;
+		case 0xD2: xOut.Integer( signedBig( 4 ) ); break;
+		case 0xD3: xOut.Integer( signedBig( 8 ) ); break;
+		case 0xD4:	// fixext 1/2/4/8/16: type, data
+		case 0xD5:
+		case 0xD6:
+		case 0xD7:
+		case 0xD8:
+		{
+			take( 1 );
+			unsigned int L = 1 << (B - 0xD4);
+			const char *P = take( L );
+			xOut.Binary( P, L );
+			break;
+		}
+		case 0xD9:
+		case 0xDA:
+		case 0xDB:
+		{
+			unsigned long long L = big( B == 0xD9 ? 1 : (B == 0xDA ? 2 : 4) );
+			const char *P = take( L );
+			xOut.String( P, L );
+			break;
+		}
+		case 0xDC: array( xOut, big( 2 ) ); break;
+		case 0xDD: array( xOut, big( 4 ) ); break;
+		case 0xDE: map( xOut, big( 2 ) );   break;
+		case 0xDF: map( xOut, big( 4 ) );   break;
+		default:
+			throw jerr::error( "jmsgpack::decode : unused type byte (0xc1)" );
+	}
+	mDepth--;
+}
+
+jvalue	// static
+jmsgpack::decode( const void *xBuffer, size_t xLength, size_t *xUsed )
+{
+	msgpackReader R( xBuffer, xLength );
+	jvalue V;
+	R.value( V );
+	if ( xUsed )
+		*xUsed = R.used();
+	return V;
+}
@@ -0,0 +1,41 @@
+
+#ifndef jmsgpackHeader
+#define jmsgpackHeader
+
+/*
+ * MessagePack reader/writer for jvalue
+ *
+ * mapping:
+ *   JNULL     <-> nil
+ *   JBOOL     <-> true/false
+ *   JINTEGER  <-> fixint / int 8..64 / uint 8..64 (shortest form)
+ *   JUNSIGNED <-> uint 64 beyond LLONG_MAX
+ *   JDOUBLE   <-> float 32 when exact, else float 64
+ *   JSTRING   <-> fixstr / str 8..32
+ *   JBINARY   <-> bin 8..32; ext types decode as their raw data
+ *   JARRAY    <-> fixarray / array 16..32
+ *   JOBJECT   <-> fixmap / map 16..32; non-string keys are decoded as their json text
+ *
+ * use:
+ *   string Bytes;
+ *   jmsgpack::encode( V, Bytes );	// appends to Bytes
+ *   jvalue W = jmsgpack::decode( Bytes.data(), Bytes.size() );
+ *
+ * errors throw jerr::error, like the text parser
+ *
+ */
+
+#include "jvalue.h"
+
+class jmsgpack
+{
+	public:
+		static void encode( const jvalue& xValue, string& xOut );
+		static string encode( const jvalue& xValue )
+			{ string Out; encode( xValue, Out ); return Out; }
+
+		// decode one item; xUsed (if given) receives the number of bytes consumed
+		static jvalue decode( const void *xBuffer, size_t xLength, size_t *xUsed = NULL );
+};
+
+#endif
@@ -0,0 +1,406 @@
+
+#include "jpatch.h"
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+using namespace std;
+
+/*
+ * deep equality and copy
+ *
+ */
+
+bool	// static
+jpatch::equal( const jvalue& xA, const jvalue& xB )
+{
+	return xA.equals( xB );
+}
+
+jvalue	// static
+jpatch::copy( const jvalue& xValue )
+{
+	jvalue R;
+	switch( xValue.type() )
+	{
+		case JOBJECT:
+			R->Object( NULL );
+			for ( object_map_t::const_iterator IT = xValue.begin(); IT != xValue.end(); ++IT )
+				R->insert( string( IT->first ), copy( IT->second ) );
+			break;
+		case JARRAY:
+		{
+			const array_vector_t& A = *xValue->Array();
+			R->Array( NULL );
+			R->Array()->reserve( A.size() );
+			for ( size_t i = 0; i < A.size(); i++ )
+				R->push_back( copy( A[i] ) );
+			break;
+		}
+		default:
+			*R = *xValue;	// scalars, strings and binary copy their own bytes
+			break;
+	}
+	return R;
+}
+
+/*
+ * JSON Pointer
+ *
+ */
+
+string	// static
+jpatch::escape( const string& xKey )
+{
+	if ( xKey.find_first_of( "~/" ) == string::npos )
+		return xKey;
+	string R;
+	for ( size_t i = 0; i < xKey.size(); i++ )
+		if ( xKey[i] == '~' )
+			R += "~0";
+		else if ( xKey[i] == '/' )
+			R += "~1";
+		else
+			R += xKey[i];
+	return R;
+}
+
+void	// static
+jpatch::tokens( const string& xPath, vector<string>& xOut )
+{
+	xOut.clear();
+	if ( xPath.empty() )
+		return;
+	if ( xPath[0] != '/' )
+		throw jerr::error( "jpatch : path does not start with '/'" );
+	for ( size_t i = 1; ; i++ )
+	{
+		string T;
+		for ( ; i < xPath.size() && xPath[i] != '/'; i++ )
+			if ( xPath[i] != '~' )
+				T += xPath[i];
+			else if ( i + 1 < xPath.size() && (xPath[i + 1] == '0' || xPath[i + 1] == '1') )
+				T += xPath[++i] == '0' ? '~' : '/';
+			else
+				throw jerr::error( "jpatch : bad '~' escape in path" );
+		xOut.push_back( T );
+		if ( i >= xPath.size() )
+			return;
+	}
+}
+
+static bool	// digits only, no leading zero
+position( const string& xToken, size_t& xOut )
+{
+	if ( xToken.empty() || xToken.size() > 18 || (xToken[0] == '0' && xToken.size() > 1) )
+		return false;
+	xOut = 0;
+	for ( size_t i = 0; i < xToken.size(); i++ )
+	{
+		if ( !isdigit( (unsigned char)xToken[i] ) )
+			return false;
+		xOut = xOut * 10 + (xToken[i] - '0');
+	}
+	return true;
+}
+
+static jvalue *	// the first xCount tokens of the path; NULL if there is nothing there
+locate( jvalue& xDocument, const vector<string>& xTokens, size_t xCount )
+{
+	jvalue *V = &xDocument;
+	for ( size_t t = 0; t < xCount; t++ )
+	{
+		(*V)->changed();	// the maps are edited directly below: drop cached text on the way down
+		if ( object_map_t *O = (*V)->Object() )
+		{
+			object_map_t::iterator IT = O->find( xTokens[t] );
+			if ( IT == O->end() )
+				return NULL;
+			V = &IT->second;
+		}
+		else if ( array_vector_t *A = (*V)->Array() )
+		{
+			size_t I;
+			if ( !position( xTokens[t], I ) || I >= A->size() )
+				return NULL;
+			V = &(*A)[I];
+		}
+		else
+			return NULL;
+	}
+	(*V)->changed();
+	return V;
+}
+
+/*
+ * JSON Patch
+ *
+ */
+
+static const jvalue&
+field( const jvalue& xOp, const char *xName, const char *xError )
+{
+	object_map_t *O = xOp->Object();
+	object_map_t::const_iterator IT;
+	if ( !O || (IT = O->find( xName )) == O->end() )
+		throw jerr::error( xError );
+	return IT->second;
+}
+
+static string
+text( const jvalue& xOp, const char *xName, const char *xError )
+{
+	const jvalue& V = field( xOp, xName, xError );
+	if ( !V.isString() )
+		throw jerr::error( xError );
+	return string( V->String(), V.size() );
+}
+
+static jvalue&
+target( jvalue& xDocument, const vector<string>& xTokens )
+{
+	jvalue *V = locate( xDocument, xTokens, xTokens.size() );
+	if ( !V )
+		throw jerr::error( "jpatch : path not found" );
+	return *V;
+}
+
+static void
+add( jvalue& xDocument, const vector<string>& xTokens, jvalue&& xValue )
+{
+	if ( xTokens.empty() )
+	{
+		*xDocument = *xValue;	// the root node stays; its contents change
+		return;
+	}
+	jvalue *Parent = locate( xDocument, xTokens, xTokens.size() - 1 );
+	if ( !Parent )
+		throw jerr::error( "jpatch : path not found" );
+	const string& Last = xTokens.back();
+	if ( (*Parent)->isObject() )
+		(*Parent)->insert( string( Last ), std::move( xValue ) );
+	else if ( array_vector_t *A = (*Parent)->Array() )
+	{
+		size_t I = A->size();
+		if ( Last != "-" && (!position( Last, I ) || I > A->size()) )
+			throw jerr::error( "jpatch : bad array index" );
+		A->insert( A->begin() + I, std::move( xValue ) );
+	}
+	else
+		throw jerr::error( "jpatch : parent is not an object or array" );
+}
+
+static jvalue	// the value taken out
+extract( jvalue& xDocument, const vector<string>& xTokens )
+{
+	jvalue R;
+	if ( xTokens.empty() )
+	{
+		*R = *xDocument;
+		xDocument->Null();
+		return R;
+	}
+	jvalue *Parent = locate( xDocument, xTokens, xTokens.size() - 1 );
+	if ( object_map_t *O = Parent ? (*Parent)->Object() : NULL )
+	{
+		object_map_t::iterator IT = O->find( xTokens.back() );
+		if ( IT == O->end() )
+			throw jerr::error( "jpatch : path not found" );
+		R = std::move( IT->second );
+		O->erase( IT );
+	}
+	else if ( array_vector_t *A = Parent ? (*Parent)->Array() : NULL )
+	{
+		size_t I;
+		if ( !position( xTokens.back(), I ) || I >= A->size() )
+			throw jerr::error( "jpatch : path not found" );
+		R = std::move( (*A)[I] );
+		A->erase( A->begin() + I );
+	}
+	else
+		throw jerr::error( "jpatch : path not found" );
+	return R;
+}
+
+void	// static
+jpatch::apply( jvalue& xDocument, const jvalue& xPatch )
+{
+	if ( xPatch.isNull() )	// no operations
+		return;
+	array_vector_t *Ops = xPatch->Array();
+	if ( !Ops )
+		throw jerr::error( "jpatch : patch is not an array" );
+	vector<string> Path, From;
+	for ( size_t i = 0; i < Ops->size(); i++ )
+	{
+		const jvalue& Op = (*Ops)[i];
+		string Name = text( Op, "op", "jpatch : operation has no 'op'" );
+		tokens( text( Op, "path", "jpatch : operation has no 'path'" ), Path );
+		if ( Name == "add" )
+			add( xDocument, Path, copy( field( Op, "value", "jpatch : operation has no 'value'" ) ) );
+		else if ( Name == "remove" )
+			extract( xDocument, Path );
+		else if ( Name == "replace" )
+		{
+			jvalue V = copy( field( Op, "value", "jpatch : operation has no 'value'" ) );
+			jvalue& T = target( xDocument, Path );
+			if ( Path.empty() )
+				*T = *V;
+			else
+				T = std::move( V );
+		}
+		else if ( Name == "move" )
+		{
+			tokens( text( Op, "from", "jpatch : operation has no 'from'" ), From );
+			if ( From.size() < Path.size() && std::equal( From.begin(), From.end(), Path.begin() ) )
+				throw jerr::error( "jpatch : cannot move a value into itself" );
+			if ( From != Path )
+				add( xDocument, Path, extract( xDocument, From ) );
+		}
+		else if ( Name == "copy" )
+		{
+			tokens( text( Op, "from", "jpatch : operation has no 'from'" ), From );
+			add( xDocument, Path, copy( target( xDocument, From ) ) );
+		}
+		else if ( Name == "test" )
+		{
+			if ( !equal( target( xDocument, Path ), field( Op, "value", "jpatch : operation has no 'value'" ) ) )
+				throw jerr::error( "jpatch : test failed" );
+		}
+		else
+			throw jerr::error( "jpatch : unknown operation" );
+	}
+}
+
+/*
+ * JSON Merge Patch
+ *
+ */
+
+static void
+mergeInto( jvalue& xTarget, const jvalue& xPatch, bool xRoot )
+{
+	if ( !xPatch.isObject() )
+	{
+		if ( xRoot )
+			*xTarget = *jpatch::copy( xPatch );
+		else
+			xTarget = jpatch::copy( xPatch );
+		return;
+	}
+	if ( !xTarget.isObject() )
+	{
+		if ( !xRoot )
+			xTarget = jvalue();	// a fresh node: whatever shared the old value keeps it
+		xTarget->Object( NULL );
+	}
+	xTarget->changed();
+	object_map_t *O = xTarget->Object();
+	for ( object_map_t::const_iterator IT = xPatch.begin(); IT != xPatch.end(); ++IT )
+		if ( IT->second.isNull() )
+			O->erase( IT->first );
+		else
+			mergeInto( (*O)[IT->first], IT->second, false );
+}
+
+void	// static
+jpatch::merge( jvalue& xTarget, const jvalue& xPatch )
+{
+	mergeInto( xTarget, xPatch, true );
+}
+
+/*
+ * diff
+ *
+ */
+
+static void
+operation( jvalue& xOps, const char *xName, const string& xPath, const jvalue *xValue )
+{
+	jvalue Op;
+	Op->insert( string( "op" ), jvalue( xName ) );
+	Op->insert( string( "path" ), jvalue( xPath ) );
+	if ( xValue )
+		Op->insert( string( "value" ), jvalue( *xValue ) );
+	xOps->push_back( std::move( Op ) );
+}
+
+static void
+diffInto( const jvalue& xA, const jvalue& xB, string& xPath, jvalue& xOps )
+{
+	if ( xA.get() == xB.get() )	// shared: nothing below can differ
+		return;
+	size_t Length = xPath.size();
+	if ( xA.isObject() && xB.isObject() )
+	{
+		object_map_t::const_iterator I = xA.begin(), J = xB.begin();
+		while ( I != xA.end() || J != xB.end() )
+		{
+			int C = I == xA.end() ? 1 : (J == xB.end() ? -1 : I->first.compare( J->first ));
+			if ( C == 0 && I->second.get() == J->second.get() )
+			{
+				++I;
+				++J;
+				continue;
+			}
+			xPath += '/';
+			xPath += jpatch::escape( C <= 0 ? I->first : J->first );
+			if ( C < 0 )
+				operation( xOps, "remove", xPath, NULL );
+			else if ( C > 0 )
+				operation( xOps, "add", xPath, &J->second );
+			else
+				diffInto( I->second, J->second, xPath, xOps );
+			xPath.resize( Length );
+			if ( C <= 0 )
+				++I;
+			if ( C >= 0 )
+				++J;
+		}
+		return;
+	}
+	if ( xA.isArray() && xB.isArray() )
+	{
+		const array_vector_t& A = *xA->Array();
+		const array_vector_t& B = *xB->Array();
+		size_t Prefix = 0, Suffix = 0;	// trimmed only when the lengths differ; otherwise matching by position is the answer
+		while ( A.size() != B.size() && Prefix < A.size() && Prefix < B.size() && jpatch::equal( A[Prefix], B[Prefix] ) )
+			Prefix++;
+		while ( A.size() != B.size() && Suffix < A.size() - Prefix && Suffix < B.size() - Prefix &&
+				jpatch::equal( A[A.size() - 1 - Suffix], B[B.size() - 1 - Suffix] ) )
+			Suffix++;
+		size_t InA = A.size() - Prefix - Suffix;
+		size_t InB = B.size() - Prefix - Suffix;
+		size_t Common = min( InA, InB );
+		char Index[24];
+		for ( size_t i = Prefix; i < Prefix + Common; i++ )
+		{
+			if ( A[i].get() == B[i].get() )	// before paying for the path
+				continue;
+			snprintf( Index, sizeof(Index), "/%zu", i );
+			xPath += Index;
+			diffInto( A[i], B[i], xPath, xOps );
+			xPath.resize( Length );
+		}
+		for ( size_t i = Prefix + Common; i < Prefix + InB; i++ )	// inserted, in order
+		{
+			snprintf( Index, sizeof(Index), "/%zu", i );
+			operation( xOps, "add", xPath + Index, &B[i] );
+		}
+		snprintf( Index, sizeof(Index), "/%zu", Prefix + Common );
+		for ( size_t i = InB; i < InA; i++ )	// deleted: each one moves the next into place
+			operation( xOps, "remove", xPath + Index, NULL );
+		return;
+	}
+	if ( !jpatch::equal( xA, xB ) )
+		operation( xOps, "replace", xPath, &xB );
+}
+
+jvalue	// static
+jpatch::diff( const jvalue& xFrom, const jvalue& xTo )
+{
+	jvalue Ops;
+	Ops->Array( NULL );
+	string Path;
+	diffInto( xFrom, xTo, Path, Ops );
+	return Ops;
+}
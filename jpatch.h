@@ -0,0 +1,52 @@
+
+#ifndef jpatchHeader
+#define jpatchHeader
+
+/*
+ * JSON Patch (RFC 6902), JSON Merge Patch (RFC 7396) and structural diff
+ *
+ * use:
+ *   jvalue Patch = jpatch::diff( Old, New );	// [{"op":"replace","path":"/a/0","value":2},...]
+ *   ... ship Patch instead of New ...
+ *   jpatch::apply( Copy, Patch );				// Copy now matches New
+ *   jpatch::merge( Config, Overrides );		// null members delete, objects merge, anything else replaces
+ *
+ * paths are JSON Pointers (RFC 6901): "" is the whole document, "/a/~1b/0"
+ * is member "a", then member "a/b", then element 0; "-" is the end of an array
+ *
+ * apply() and merge() work in place; values taken from the patch are copied,
+ * so the patch and the document never share nodes.  the root node is
+ * overwritten rather than replaced, so other handles on it see the result.
+ * an operation that fails throws jerr::error and leaves the operations
+ * before it applied (RFC 6902 does not require a rollback); patch a copy
+ * when that matters.
+ *
+ * diff() never descends into a subtree both sides share (same node), so
+ * diffing a document against an edited copy of itself costs time in
+ * proportion to the edited paths.  arrays of the same length are matched by
+ * position; otherwise a common prefix and suffix are trimmed first, which
+ * keeps a single insert or delete to one operation.  values in the result
+ * share nodes with xTo.
+ *
+ * none of this locks: no other thread may change the documents meanwhile
+ *
+ */
+
+#include "jvalue.h"
+#include <vector>
+
+class jpatch
+{
+	public:
+		static void apply( jvalue& xDocument, const jvalue& xPatch );
+		static void merge( jvalue& xTarget, const jvalue& xPatch );
+		static jvalue diff( const jvalue& xFrom, const jvalue& xTo );
+
+		static bool equal( const jvalue& xA, const jvalue& xB );	// jvalue::equals: deep, 1 == 1.0
+		static jvalue copy( const jvalue& xValue );				// deep
+
+		static string escape( const string& xKey );	// one JSON Pointer token
+		static void tokens( const string& xPath, vector<string>& xOut );	// a JSON Pointer, split and unescaped
+};
+
+#endif
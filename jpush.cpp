@@ -0,0 +1,347 @@
+
+#include "jpush.h"
+#include "jdedup.h"
+#include <ctype.h>
+#include <stdarg.h>
+using namespace std;
+
+/*
+ * the push parser
+ *
+ * one state per place the text can stop; feed() walks the chunk a byte at
+ * a time except inside strings, where plain runs are copied in one go
+ *
+ */
+
+static jerr *	// a message made up on the spot; held per thread until its next one
+error( const char *xFormat, ... )
+{
+	static thread_local char Message[128];
+	va_list Args;
+	va_start( Args, xFormat );
+	vsnprintf( Message, sizeof(Message), xFormat, Args );
+	va_end( Args );
+	return jerr::error( Message );
+}
+
+void
+jpush::reset()
+{
+	mStack.clear();
+	mState = VALUE;
+	mRoot = jvalue();
+	mConsumed = 0;
+	mText.clear();
+	mKey = false;
+	mUnicode = mHexDigits = mHigh = 0;
+	mPeriod = mExponent = false;
+	mExponentDigits = 0;
+	mLiteral = NULL;
+	mLiteralAt = 0;
+}
+
+jvalue
+jpush::take()
+{
+	jvalue R( std::move( mRoot ) );
+	reset();
+	return R;
+}
+
+void	// the value just finished goes into the open container, or becomes the result
+jpush::emit( jvalue&& xValue )
+{
+	if ( mDedup )
+		xValue = mDedup->intern( xValue );
+	if ( mStack.empty() )
+	{
+		mRoot = std::move( xValue );
+		mState = DONE;
+		return;
+	}
+	frame& F = mStack.back();
+	if ( F.mObject )
+		F.mContainer->insert( std::move( F.mKey ), std::move( xValue ) );
+	else
+		F.mContainer->push_back( std::move( xValue ) );
+	F.mKey.clear();	// moved-from: make it usable again
+	mState = NEXT;
+}
+
+void
+jpush::open( bool xObject )
+{
+	mStack.push_back( frame() );
+	frame& F = mStack.back();
+	if ( xObject )
+		F.mContainer->Object( NULL );
+	else
+		F.mContainer->Array( NULL );
+	F.mObject = xObject;
+	mState = xObject ? OBJECT_FIRST : ARRAY_FIRST;
+}
+
+void
+jpush::close( char C )
+{
+	if ( C != (mStack.back().mObject ? '}' : ']') )
+		throw jerr::error( mStack.back().mObject ? "jpush : missing comma" : "jpush : missing comma between values" );
+	jvalue V( std::move( mStack.back().mContainer ) );
+	mStack.pop_back();
+	emit( std::move( V ) );
+}
+
+void	// the first character of a value
+jpush::value( char C )
+{
+	if ( isdigit( (unsigned char)C ) || C == '.' || C == '-' )
+	{
+		mText.assign( 1, C );
+		mPeriod = C == '.';
+		mExponent = false;
+		mExponentDigits = 0;
+		mState = NUMBER;
+		return;
+	}
+	switch( C )
+	{
+		case '"': mText.clear(); mKey = false; mState = STRING; return;
+		case '{': open( true );  return;
+		case '[': open( false ); return;
+		case 'n': case 'N': mLiteral = "null";  break;
+		case 't': case 'T': mLiteral = "true";  break;
+		case 'f': case 'F': mLiteral = "false"; break;
+		default:
+			throw error( "jpush : could not determine json type from leading character: %c<%02x>", C, (unsigned char)C );
+	}
+	mLiteralAt = 1;
+	mState = LITERAL;
+}
+
+void
+jpush::endString()
+{
+	if ( mKey )
+	{
+		mStack.back().mKey.assign( mText );	// mText keeps its capacity for the next string
+		mText.clear();
+		mState = COLON;
+		return;
+	}
+	jvalue V;
+	V->String( mText.data(), mText.size() );
+	mText.clear();
+	emit( std::move( V ) );
+}
+
+void	// same conversions as parseNumber
+jpush::endNumber()
+{
+	if ( mExponentDigits < 0 )
+		throw jerr::error( "jpush : missing digits in exponent" );
+	jvalue V;
+	if ( mPeriod | mExponent )
+		V->Double( atof( mText.c_str() ) );
+	else if ( mText[0] != '-' && mText.size() >= 19 )	// may not fit in a long long
+		V->Number( strtoull( mText.c_str(), NULL, 10 ) );
+	else
+		V->Integer( atoll( mText.c_str() ) );
+	mText.clear();
+	emit( std::move( V ) );
+}
+
+void	// a \u escape's value: a high surrogate waits to see whether the low half follows, as in jutf8::escape()
+jpush::unicode( unsigned int xIn )
+{
+	if ( mHigh && jutf8::low( xIn ) )
+	{
+		jutf8::append( jutf8::pair( mHigh, xIn ), mText );
+		mHigh = 0;
+		return;
+	}
+	unpaired();
+	if ( jutf8::high( xIn ) )
+		mHigh = xIn;
+	else
+		jutf8::append( xIn, mText );
+}
+
+void	// something other than a \u escape follows a high surrogate: it stands alone
+jpush::unpaired()
+{
+	if ( mHigh )
+		jutf8::append( mHigh, mText );
+	mHigh = 0;
+}
+
+size_t
+jpush::feed( const char *xData, size_t xLength )
+{
+	const char *P = xData;
+	const char *End = xData + xLength;
+	try
+	{
+		while ( P < End && mState != DONE )
+		{
+			char C = *P;
+			switch( mState )
+			{
+				case STRING:
+				{
+					const char *Run = P;	// copy plain runs in one go
+					while ( P < End && *P != '"' && *P != '\\' )
+						P++;
+					if ( P > Run )
+					{
+						unpaired();
+						mText.append( Run, P - Run );
+					}
+					if ( P == End )
+						continue;
+					if ( *P++ == '"' )
+					{
+						unpaired();
+						endString();
+					}
+					else
+						mState = ESCAPE;
+					continue;
+				}
+				case ESCAPE:
+					if ( C != 'u' )
+						unpaired();
+					switch( C )
+					{
+						case 'b': mText += '\b'; break;
+						case 'f': mText += '\f'; break;
+						case 'n': mText += '\n'; break;
+						case 'r': mText += '\r'; break;
+						case 't': mText += '\t'; break;
+						case 'u': mUnicode = mHexDigits = 0; mState = UNICODE; P++; continue;
+						default:  mText += C;    break;
+					}
+					mState = STRING;
+					break;
+				case UNICODE:
+					if ( isdigit( (unsigned char)C ) )
+						mUnicode = (mUnicode << 4) | (C - '0');
+					else if ( 'A' <= C && C <= 'F' )
+						mUnicode = (mUnicode << 4) | (C - 'A' + 10);
+					else if ( 'a' <= C && C <= 'f' )
+						mUnicode = (mUnicode << 4) | (C - 'a' + 10);
+					else
+						throw jerr::error( "bad hex character" );
+					if ( ++mHexDigits == 4 )
+					{
+						unicode( mUnicode );
+						mState = STRING;
+					}
+					break;
+				case NUMBER:
+					if ( isdigit( (unsigned char)C ) )
+					{
+						mText += C;
+						if ( mExponentDigits < 0 )
+							mExponentDigits = 1;
+					}
+					else if ( mExponentDigits < 0 && mText[mText.size() - 1] == 'e' && (C == '-' || C == '+') )
+						mText += C;
+					else if ( mExponentDigits < 0 )
+						throw jerr::error( mText[mText.size() - 1] == 'e' ? "jpush : bad exponential format" : "jpush : missing digits in exponent" );
+					else if ( C == '.' && !mPeriod )
+					{
+						mText += C;
+						mPeriod = true;
+					}
+					else if ( (C == 'e' || C == 'E') && !mExponent )
+					{
+						mText += 'e';
+						mExponent = true;
+						mExponentDigits = -1;
+					}
+					else
+					{
+						endNumber();	// C belongs to whatever follows
+						continue;
+					}
+					break;
+				case LITERAL:
+					if ( tolower( (unsigned char)C ) != mLiteral[mLiteralAt] )
+						throw error( "jpush : string is not '%s'", mLiteral );
+					if ( mLiteral[++mLiteralAt] == '\0' )
+					{
+						jvalue V;
+						if ( mLiteral[0] != 'n' )
+							V->Bool( mLiteral[0] == 't' );
+						P++;
+						emit( std::move( V ) );
+						continue;
+					}
+					break;
+				default:
+					if ( isspace( (unsigned char)C ) )
+						break;
+					switch( mState )
+					{
+						case VALUE:
+							value( C );
+							break;
+						case ARRAY_FIRST:
+							if ( C == ']' )
+								close( C );
+							else
+								value( C );
+							break;
+						case OBJECT_FIRST:
+							if ( C == '}' )
+							{
+								close( C );
+								break;
+							}
+							// fall through: a key
+						case KEY:
+							if ( C != '"' )
+								throw jerr::error( "jpush : bad pair in object" );
+							mText.clear();
+							mKey = true;
+							mState = STRING;
+							break;
+						case COLON:
+							if ( C != ':' )
+								throw jerr::error( "jpush : bad pair in object" );
+							mState = VALUE;
+							break;
+						case NEXT:
+							if ( C == ',' )
+								mState = mStack.back().mObject ? KEY : VALUE;
+							else
+								close( C );
+							break;
+						default:
+							break;
+					}
+					break;
+			}
+			P++;
+		}
+	}
+	catch ( ... )
+	{
+		mConsumed += P - xData;	// consumed() points at the bad byte
+		throw;
+	}
+	mConsumed += P - xData;
+	return P - xData;
+}
+
+bool
+jpush::finish()
+{
+	if ( mState == NUMBER && mStack.empty() )
+		endNumber();
+	if ( mState == DONE )
+		return true;
+	if ( mState == VALUE && mStack.empty() )
+		return false;	// nothing but white space
+	throw jerr::error( mState == STRING || mState == ESCAPE || mState == UNICODE ? "jpush : found EOF inside string" : "jpush : found EOF inside value" );
+}
@@ -0,0 +1,116 @@
+
+#ifndef jpushHeader
+#define jpushHeader
+
+/*
+ * push parser: build a jvalue from text that arrives in pieces
+ *
+ * all parser state (open containers, a partial string, number or literal)
+ * lives in the jpush object, so feed() can stop at any byte and carry on
+ * when the next chunk arrives -- no thread waits on a slow sender, and
+ * nothing has to be buffered until the body is complete.
+ *
+ *   jpush P;
+ *   while ( (N = recv( Socket, Buffer, sizeof(Buffer), 0 )) > 0 )
+ *   {
+ *       const char *B = Buffer;
+ *       while ( N > 0 )
+ *       {
+ *           size_t Used = P.feed( B, N );	// stops at the end of a value
+ *           B += Used;
+ *           N -= Used;
+ *           if ( P.done() )
+ *               handle( P.take() );		// take() readies P for the next value
+ *       }
+ *   }
+ *   if ( P.finish() )	// end of input: completes a number still being read
+ *       handle( P.take() );
+ *
+ * the grammar accepted is the same as jvalue::parse, and so is the tree built:
+ * \u escapes decode the same way (jutf8: a surrogate pair becomes one 4-byte
+ * character, even when the halves arrive in different feeds); errors throw
+ * jerr::error and leave the parser needing reset()
+ *
+ * with dedup( &Table ) each value is interned as it completes (see jdedup.h),
+ * so repeated strings and subtrees are shared as they are read
+ *
+ */
+
+#include "jvalue.h"
+#include <vector>
+
+class jdedup;
+
+class jpush
+{
+	public:
+		jpush() : mDedup( NULL ) { reset(); }
+
+		void reset();	// forget any partial value
+		void dedup( jdedup *xTable ) { mDedup = xTable; }	// NULL: stop sharing; not changed by reset()
+
+		// consume bytes up to (and including) the end of one value; returns how many
+		size_t feed( const char *xData, size_t xLength );
+		size_t feed( const string& xData ) { return feed( xData.data(), xData.size() ); }
+
+		// end of input: false if only white space was seen, throws if a value is incomplete
+		bool finish();
+
+		bool done() const { return mState == DONE; }
+		jvalue take();	// the completed value; the parser starts over
+
+		size_t depth() const { return mStack.size(); }	// containers open right now
+		size_t consumed() const { return mConsumed; }	// bytes fed since reset(), for error reports
+
+	private:
+		enum state_t
+		{
+			VALUE,			// a value must start here
+			ARRAY_FIRST,	// just after '[': a value or ']'
+			OBJECT_FIRST,	// just after '{': a key or '}'
+			KEY,			// after ',' in an object
+			COLON,
+			NEXT,			// after a member: ',' or the closing bracket
+			STRING,
+			ESCAPE,			// after a backslash
+			UNICODE,		// inside \uXXXX
+			NUMBER,
+			LITERAL,		// null, true, false
+			DONE
+		};
+
+		struct frame
+		{
+			jvalue mContainer;
+			string mKey;	// objects: the key whose value is being read
+			bool   mObject;
+		};
+
+		vector<frame> mStack;
+		state_t       mState;
+		jvalue        mRoot;
+		size_t        mConsumed;
+		jdedup       *mDedup;
+
+		string        mText;		// string or number read so far
+		bool          mKey;			// the string is an object key
+		unsigned int  mUnicode;		// \u value so far
+		unsigned int  mHexDigits;
+		unsigned int  mHigh;		// a high surrogate escape not yet written: the low half may come next
+		bool          mPeriod;		// number flags, as in parseNumber
+		bool          mExponent;
+		int           mExponentDigits;	// -1 until a digit follows 'e' (and its sign)
+		const char   *mLiteral;		// the word being matched
+		size_t        mLiteralAt;
+
+		void value( char C );
+		void open( bool xObject );
+		void close( char C );
+		void emit( jvalue&& xValue );
+		void endString();
+		void endNumber();
+		void unicode( unsigned int xIn );
+		void unpaired();
+};
+
+#endif
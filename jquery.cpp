@@ -0,0 +1,1090 @@
+
+#include "jquery.h"
+#include "jtape.h"
+#include "jreadahead.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <sstream>
+using namespace std;
+
+struct jquery::context
+{
+	unsigned int mThreads;
+};
+
+/*
+ * compiling: recursive descent, one function per precedence level, into
+ * a vector of nodes that refer to each other by position
+ *
+ */
+
+static jerr *	// a message made up on the spot; held per thread until its next one, as jvalue's are
+error( const char *xFormat, ... )
+{
+	static thread_local char Message[256];
+	va_list Args;
+	va_start( Args, xFormat );
+	vsnprintf( Message, sizeof(Message), xFormat, Args );
+	va_end( Args );
+	return jerr::error( Message );
+}
+
+static void
+fail( const char *xWhat, size_t xAt )
+{
+	throw error( "jquery : %s at offset %zu", xWhat, xAt );
+}
+
+static void
+skip( const string& xText, size_t& xAt )
+{
+	while ( xAt < xText.size() && isspace( (unsigned char)xText[xAt] ) )
+		xAt++;
+}
+
+static bool	// consume xToken if it is next
+match( const string& xText, size_t& xAt, const char *xToken )
+{
+	skip( xText, xAt );
+	size_t L = strlen( xToken );
+	if ( xText.compare( xAt, L, xToken ) != 0 )
+		return false;
+	xAt += L;
+	return true;
+}
+
+static inline bool
+identifierChar( char C )
+{
+	return isalnum( (unsigned char)C ) || C == '_';
+}
+
+static string	// an identifier, or "" if none is next
+identifier( const string& xText, size_t& xAt )
+{
+	skip( xText, xAt );
+	size_t Start = xAt;
+	if ( xAt < xText.size() && (isalpha( (unsigned char)xText[xAt] ) || xText[xAt] == '_') )
+		while ( xAt < xText.size() && identifierChar( xText[xAt] ) )
+			xAt++;
+	return xText.substr( Start, xAt - Start );
+}
+
+static bool	// a keyword, not the start of a longer identifier
+keyword( const string& xText, size_t& xAt, const char *xWord )
+{
+	skip( xText, xAt );
+	size_t L = strlen( xWord );
+	if ( xText.compare( xAt, L, xWord ) != 0 || (xAt + L < xText.size() && identifierChar( xText[xAt + L] )) )
+		return false;
+	xAt += L;
+	return true;
+}
+
+static string	// a json string literal at xAt, through the ordinary parser
+literalString( const string& xText, size_t& xAt )
+{
+	istringstream IS( xText.substr( xAt ) );
+	jvalue V;
+	try
+	{
+		V.parse( IS );
+	}
+	catch ( jerr *E )
+	{
+		fail( "bad string", xAt );
+	}
+	xAt += (size_t)IS.tellg();
+	return string( V->String(), V.size() );
+}
+
+jquery::jquery( const string& xExpression ) : mFilter( NONE ), mRest( NONE )
+{
+	size_t At = 0;
+	mRoot = parsePipe( xExpression, At );
+	skip( xExpression, At );
+	if ( At != xExpression.size() )
+		fail( "unexpected text", At );
+
+	// select(p) | rest, or select(p) alone: p may be decided on a tape
+	const node& R = mPlan[mRoot];
+	size_t Select = R.mOp == PIPE ? R.mLeft : mRoot;
+	if ( mPlan[Select].mOp == SELECT && tapeable( mPlan[Select].mLeft ) )
+	{
+		mFilter = mPlan[Select].mLeft;
+		mRest = R.mOp == PIPE ? R.mRight : (size_t)NONE;
+	}
+}
+
+size_t	// private
+jquery::add( op_t xOp, size_t xLeft, size_t xRight )
+{
+	node N;
+	N.mOp = xOp;
+	N.mLeft = xLeft;
+	N.mRight = xRight;
+	N.mSimple = false;	// set below, once the node is in the plan
+	mPlan.push_back( N );
+	mPlan.back().mSimple = tapeable( mPlan.size() - 1 );	// the operands are already there
+	return mPlan.size() - 1;
+}
+
+size_t	// private; f | g, grouped to the right: .[] | f | g runs f | g per element
+jquery::parsePipe( const string& xText, size_t& xAt )
+{
+	size_t L = parseComma( xText, xAt );
+	if ( !match( xText, xAt, "|" ) )
+		return L;
+	size_t R = parsePipe( xText, xAt );
+	return add( PIPE, L, R );
+}
+
+size_t	// private; f, g
+jquery::parseComma( const string& xText, size_t& xAt )
+{
+	size_t L = parseOr( xText, xAt );
+	while ( match( xText, xAt, "," ) )
+	{
+		size_t R = parseOr( xText, xAt );
+		L = add( COMMA, L, R );
+	}
+	return L;
+}
+
+size_t	// private
+jquery::parseOr( const string& xText, size_t& xAt )
+{
+	size_t L = parseAnd( xText, xAt );
+	while ( keyword( xText, xAt, "or" ) )
+	{
+		size_t R = parseAnd( xText, xAt );
+		L = add( OR, L, R );
+	}
+	return L;
+}
+
+size_t	// private
+jquery::parseAnd( const string& xText, size_t& xAt )
+{
+	size_t L = parseCompare( xText, xAt );
+	while ( keyword( xText, xAt, "and" ) )
+	{
+		size_t R = parseCompare( xText, xAt );
+		L = add( AND, L, R );
+	}
+	return L;
+}
+
+size_t	// private; not associative: a < b < c is an error
+jquery::parseCompare( const string& xText, size_t& xAt )
+{
+	static const struct { const char *mToken; op_t mOp; } Ops[] =
+		{ { "==", EQ }, { "!=", NE }, { "<=", LE }, { ">=", GE }, { "<", LT }, { ">", GT } };
+	size_t L = parseSum( xText, xAt );
+	for ( size_t i = 0; i < sizeof(Ops) / sizeof(Ops[0]); i++ )
+		if ( match( xText, xAt, Ops[i].mToken ) )
+		{
+			size_t R = parseSum( xText, xAt );
+			return add( Ops[i].mOp, L, R );
+		}
+	return L;
+}
+
+size_t	// private
+jquery::parseSum( const string& xText, size_t& xAt )
+{
+	size_t L = parseProduct( xText, xAt );
+	for ( ;; )
+	{
+		op_t Op;
+		if ( match( xText, xAt, "+" ) )
+			Op = ADD;
+		else if ( match( xText, xAt, "-" ) )
+			Op = SUB;
+		else
+			return L;
+		size_t R = parseProduct( xText, xAt );
+		L = add( Op, L, R );
+	}
+}
+
+size_t	// private
+jquery::parseProduct( const string& xText, size_t& xAt )
+{
+	size_t L = parsePostfix( xText, xAt );
+	for ( ;; )
+	{
+		op_t Op;
+		if ( match( xText, xAt, "*" ) )
+			Op = MUL;
+		else if ( match( xText, xAt, "/" ) )
+			Op = DIV;
+		else if ( match( xText, xAt, "%" ) )
+			Op = MOD;
+		else
+			return L;
+		size_t R = parsePostfix( xText, xAt );
+		L = add( Op, L, R );
+	}
+}
+
+size_t	// private; .name ."name" [n] [] after a value, any number of times
+jquery::parsePostfix( const string& xText, size_t& xAt )
+{
+	size_t P = parsePrimary( xText, xAt );
+	for ( ;; )
+	{
+		skip( xText, xAt );
+		if ( xAt + 1 < xText.size() && xText[xAt] == '.' && (identifierChar( xText[xAt + 1] ) || xText[xAt + 1] == '"') )
+		{
+			xAt++;
+			string Name = xText[xAt] == '"' ? literalString( xText, xAt ) : identifier( xText, xAt );
+			P = add( FIELD, P );
+			mPlan[P].mName = Name;
+		}
+		else if ( xAt < xText.size() && xText[xAt] == '[' )
+		{
+			xAt++;
+			if ( match( xText, xAt, "]" ) )
+			{
+				P = add( ITERATE, P );
+				continue;
+			}
+			skip( xText, xAt );
+			char *End;
+			long long I = strtoll( xText.c_str() + xAt, &End, 10 );
+			if ( End == xText.c_str() + xAt )
+				fail( "expected an index", xAt );
+			xAt = End - xText.c_str();
+			if ( !match( xText, xAt, "]" ) )
+				fail( "expected ']'", xAt );
+			P = add( INDEX, P );
+			mPlan[P].mValue = I;
+		}
+		else
+			return P;
+	}
+}
+
+size_t	// private
+jquery::parsePrimary( const string& xText, size_t& xAt )
+{
+	skip( xText, xAt );
+	if ( xAt == xText.size() )
+		fail( "expected an expression", xAt );
+	char C = xText[xAt];
+
+	if ( C == '.' )
+	{
+		xAt++;
+		if ( xAt < xText.size() && (identifierChar( xText[xAt] ) || xText[xAt] == '"') )
+		{
+			string Name = xText[xAt] == '"' ? literalString( xText, xAt ) : identifier( xText, xAt );
+			size_t P = add( FIELD );
+			mPlan[P].mName = Name;
+			return P;
+		}
+		return add( IDENTITY );	// .[n] and .[] are read by parsePostfix
+	}
+	if ( isdigit( (unsigned char)C ) || (C == '-' && xAt + 1 < xText.size() && isdigit( (unsigned char)xText[xAt + 1] )) )
+	{
+		const char *Start = xText.c_str() + xAt;
+		char *End;
+		double D = strtod( Start, &End );
+		bool Real = false;
+		for ( const char *P = Start; P < End; P++ )
+			Real = Real || *P == '.' || *P == 'e' || *P == 'E';
+		size_t P = add( LITERAL );
+		if ( Real )
+			mPlan[P].mValue = D;
+		else
+			mPlan[P].mValue = strtoll( Start, NULL, 10 );
+		xAt = End - xText.c_str();
+		return P;
+	}
+	if ( C == '"' )
+	{
+		string S = literalString( xText, xAt );
+		size_t P = add( LITERAL );
+		mPlan[P].mValue = S;
+		return P;
+	}
+	if ( C == '(' )
+	{
+		xAt++;
+		size_t P = parsePipe( xText, xAt );
+		if ( !match( xText, xAt, ")" ) )
+			fail( "expected ')'", xAt );
+		return P;
+	}
+	if ( C == '[' )
+	{
+		xAt++;
+		if ( match( xText, xAt, "]" ) )
+			return add( COLLECT, add( EMPTY ) );
+		size_t P = parsePipe( xText, xAt );
+		if ( !match( xText, xAt, "]" ) )
+			fail( "expected ']'", xAt );
+		return add( COLLECT, P );
+	}
+	if ( C == '{' )
+		return parseObject( xText, xAt );
+
+	size_t Start = xAt;
+	string Name = identifier( xText, xAt );
+	if ( Name == "true" || Name == "false" || Name == "null" )
+	{
+		size_t P = add( LITERAL );
+		if ( Name != "null" )
+			mPlan[P].mValue = Name == "true";
+		return P;
+	}
+
+	static const struct { const char *mName; op_t mOp; bool mArgument; } Functions[] =
+	{
+		{ "select", SELECT, true }, { "map", MAP, true }, { "group_by", GROUP_BY, true }, { "sort_by", SORT_BY, true },
+		{ "sort", SORT, false }, { "length", LENGTH, false }, { "add", SUM, false }, { "min", MIN, false },
+		{ "max", MAX, false }, { "keys", KEYS, false }, { "first", FIRST, false }, { "last", LAST, false },
+		{ "not", NOT, false }, { "empty", EMPTY, false }, { "unique", UNIQUE, false },
+	};
+	for ( size_t i = 0; i < sizeof(Functions) / sizeof(Functions[0]); i++ )
+		if ( Name == Functions[i].mName )
+		{
+			if ( !Functions[i].mArgument )
+				return add( Functions[i].mOp );
+			if ( !match( xText, xAt, "(" ) )
+				fail( "expected '('", xAt );
+			size_t A = parsePipe( xText, xAt );
+			if ( !match( xText, xAt, ")" ) )
+				fail( "expected ')'", xAt );
+			return add( Functions[i].mOp, A );
+		}
+	fail( Name.empty() ? "expected an expression" : "unknown function", Start );
+	return NONE;
+}
+
+size_t	// private; {a: f, "b": g, c}
+jquery::parseObject( const string& xText, size_t& xAt )
+{
+	xAt++;	// the {
+	size_t P = add( OBJECT );
+	if ( match( xText, xAt, "}" ) )
+		return P;
+	do
+	{
+		skip( xText, xAt );
+		string Key = xAt < xText.size() && xText[xAt] == '"' ? literalString( xText, xAt ) : identifier( xText, xAt );
+		if ( Key.empty() )
+			fail( "expected a key", xAt );
+		size_t V;
+		if ( match( xText, xAt, ":" ) )
+			V = parseOr( xText, xAt );
+		else
+		{
+			V = add( FIELD );
+			mPlan[V].mName = Key;
+		}
+		mPlan[P].mKeys.push_back( Key );
+		mPlan[P].mArgs.push_back( V );
+	}
+	while ( match( xText, xAt, "," ) );
+	if ( !match( xText, xAt, "}" ) )
+		fail( "expected '}'", xAt );
+	return P;
+}
+
+bool	// private; members of the input, literals, comparisons, and/or/not of those
+jquery::tapeable( size_t xNode ) const
+{
+	const node& N = mPlan[xNode];
+	switch( N.mOp )
+	{
+		case IDENTITY:
+		case LITERAL:
+			return true;
+		case FIELD:
+		case INDEX:	// a path: what it is taken from must be one too
+		{
+			if ( N.mLeft == NONE )
+				return true;
+			op_t Left = mPlan[N.mLeft].mOp;
+			return (Left == IDENTITY || Left == FIELD || Left == INDEX) && tapeable( N.mLeft );
+		}
+		case AND: case OR: case EQ: case NE: case LT: case LE: case GT: case GE:
+			return tapeable( N.mLeft ) && tapeable( N.mRight );
+		case PIPE:	// f | not
+			return tapeable( N.mLeft ) && mPlan[N.mRight].mOp == NOT;
+		default:
+			return false;
+	}
+}
+
+/*
+ * running
+ *
+ */
+
+static inline bool
+truthy( const jvalue& xValue )
+{
+	return !xValue.isNull() && !(xValue.isBool() && !xValue->Bool());
+}
+
+static inline bool
+isNumber( const jvalue& xValue )
+{
+	return xValue.isInteger() || xValue.isUnsigned() || xValue.isDouble();
+}
+
+static jvalue
+newArray()
+{
+	jvalue A;
+	A->Array( NULL );
+	return A;
+}
+
+static jvalue	// a literal as a result: a node of its own, so changing the result cannot change the plan
+literal( const jvalue& xValue )
+{
+	switch( xValue.type() )
+	{
+		case JBOOL:    return jvalue( xValue->Bool() );
+		case JINTEGER: return jvalue( xValue->Integer() );
+		case JDOUBLE:  return jvalue( xValue->Double() );
+		case JSTRING:  return jvalue( string( xValue->String(), xValue.size() ) );
+		default:       return jvalue();
+	}
+}
+
+static void
+nonObject( const string& xName )
+{
+	throw error( "jquery : cannot take member '%s' of a non-object", xName.c_str() );
+}
+
+static jvalue
+member( const jvalue& xValue, const string& xName )
+{
+	if ( xValue.isNull() )
+		return jvalue();
+	const object_map_t *O = xValue->Object();
+	if ( !O )
+		nonObject( xName );
+	object_map_t::const_iterator IT = O->find( xName );
+	return IT == O->end() ? jvalue() : IT->second;
+}
+
+static jvalue
+element( const jvalue& xValue, long long xIndex )	// negative counts from the end
+{
+	if ( xValue.isNull() )
+		return jvalue();
+	const array_vector_t *A = xValue->Array();
+	if ( !A )
+		throw jerr::error( "jquery : cannot index a non-array" );
+	if ( xIndex < 0 )
+		xIndex += A->size();
+	return xIndex < 0 || (size_t)xIndex >= A->size() ? jvalue() : (*A)[xIndex];
+}
+
+static jtape_value	// member(), on a tape
+member( const jtape_value& xValue, const string& xName )
+{
+	if ( !xValue.isNull() && !xValue.isObject() )
+		nonObject( xName );
+	return xValue[xName];	// null from null, as for a missing member
+}
+
+static jtape_value	// element(), on a tape
+element( const jtape_value& xValue, long long xIndex )
+{
+	if ( !xValue.isNull() && !xValue.isArray() )
+		throw jerr::error( "jquery : cannot index a non-array" );
+	if ( xIndex < 0 )
+		xIndex += xValue.size();
+	return xValue[xIndex < 0 ? xValue.size() : (size_t)xIndex];	// out of range is null
+}
+
+static const array_vector_t *	// an array's elements, NULL for null, or throws
+elements( const jvalue& xValue, const char *xWhat )
+{
+	if ( xValue.isNull() )
+		return NULL;
+	const array_vector_t *A = xValue->Array();
+	if ( !A )
+		throw error( "jquery : %s needs an array", xWhat );
+	return A;
+}
+
+static jvalue
+arithmetic( int xOp, const jvalue& xL, const jvalue& xR )	// xOp: '+' '-' '*' '/' '%'
+{
+	if ( xOp == '+' )
+	{
+		if ( xL.isNull() )
+			return xR;
+		if ( xR.isNull() )
+			return xL;
+		if ( xL.isString() && xR.isString() )
+			return jvalue( string( xL->String(), xL.size() ) + string( xR->String(), xR.size() ) );
+		if ( xL.isArray() && xR.isArray() )
+		{
+			jvalue A = newArray();
+			A->Array()->reserve( xL.size() + xR.size() );
+			A->Array()->insert( A->Array()->end(), xL->Array()->begin(), xL->Array()->end() );
+			A->Array()->insert( A->Array()->end(), xR->Array()->begin(), xR->Array()->end() );
+			return A;
+		}
+		if ( xL.isObject() && xR.isObject() )
+		{
+			jvalue O;
+			O->Object( NULL );
+			*O->Object() = *xL->Object();
+			for ( object_map_t::const_iterator IT = xR->Object()->begin(); IT != xR->Object()->end(); ++IT )
+				(*O->Object())[IT->first] = IT->second;
+			return O;
+		}
+	}
+	if ( !isNumber( xL ) || !isNumber( xR ) )
+		throw jerr::error( "jquery : arithmetic on values that are not numbers" );
+	if ( xOp == '%' )
+	{
+		long long A = xL->Integer(), B = xR->Integer();
+		if ( B == 0 )
+			throw jerr::error( "jquery : modulo by zero" );
+		return jvalue( B == -1 ? 0LL : A % B );	// LLONG_MIN % -1 traps
+	}
+	if ( xL.isInteger() && xR.isInteger() )	// exact while it fits
+	{
+		long long A = xL->Integer(), B = xR->Integer(), R;
+		switch( xOp )
+		{
+			case '+': if ( !__builtin_add_overflow( A, B, &R ) ) return jvalue( R ); break;
+			case '-': if ( !__builtin_sub_overflow( A, B, &R ) ) return jvalue( R ); break;
+			case '*': if ( !__builtin_mul_overflow( A, B, &R ) ) return jvalue( R ); break;
+			case '/': if ( B != 0 && !(A == LLONG_MIN && B == -1) && A % B == 0 ) return jvalue( A / B ); break;	// LLONG_MIN / -1 goes to double
+		}
+	}
+	double A = xL->Double(), B = xR->Double();
+	switch( xOp )
+	{
+		case '+': return jvalue( A + B );
+		case '-': return jvalue( A - B );
+		case '*': return jvalue( A * B );
+	}
+	if ( B == 0 )
+		throw jerr::error( "jquery : division by zero" );
+	return jvalue( A / B );
+}
+
+static jvalue
+binary( int xOp, const jvalue& xL, const jvalue& xR )	// comparisons and arithmetic
+{
+	switch( xOp )
+	{
+		case 'e': return jvalue( xL.equals( xR ) );
+		case 'n': return jvalue( !xL.equals( xR ) );
+		case '<': return jvalue( xL.compare( xR ) < 0 );
+		case 'l': return jvalue( xL.compare( xR ) <= 0 );
+		case '>': return jvalue( xL.compare( xR ) > 0 );
+		case 'g': return jvalue( xL.compare( xR ) >= 0 );
+	}
+	return arithmetic( xOp, xL, xR );
+}
+
+struct keyed	// for sort_by and group_by: the key, then the position for a stable order
+{
+	jvalue mKey;
+	size_t mAt;
+	bool operator<( const keyed& x ) const
+	{
+		int C = mKey.compare( x.mKey );
+		return C != 0 ? C < 0 : mAt < x.mAt;
+	}
+};
+
+/*
+ * threads: elements are split into one contiguous run per thread, results
+ * gathered per run and joined in order
+ *
+ */
+
+struct query_job
+{
+	const jquery          *mQuery;
+	void                  (*mRun)( query_job& );
+	size_t                 mNode;
+	const array_vector_t  *mElements;
+	size_t                 mBegin, mEnd;
+	vector<jvalue>         mOut;
+	string                 mError;	// copied: the worker's own message goes with its thread
+};
+
+void *	// static
+jquery::worker( void *xJob )
+{
+	query_job& J = *(query_job *)xJob;
+	context Single = { 1 };
+	try
+	{
+		for ( size_t i = J.mBegin; i < J.mEnd; i++ )
+			J.mQuery->eval( J.mNode, (*J.mElements)[i], J.mOut, Single );
+	}
+	catch ( jerr *E )
+	{
+		J.mError = E->message();
+	}
+	return NULL;
+}
+
+void	// private; xNode over each element (or member value) of xContainer
+jquery::each( size_t xNode, const jvalue& xContainer, vector<jvalue>& xOut, const context& xContext ) const
+{
+	if ( xContainer.isNull() )
+		return;
+	if ( const object_map_t *O = xContainer->Object() )
+	{
+		for ( object_map_t::const_iterator IT = O->begin(); IT != O->end(); ++IT )
+			eval( xNode, IT->second, xOut, xContext );
+		return;
+	}
+	const array_vector_t *A = elements( xContainer, ".[]" );
+	size_t Threads = xContext.mThreads;
+	if ( Threads > A->size() / PARALLEL_MIN )
+		Threads = A->size() / PARALLEL_MIN;
+#ifndef SINGLE_THREAD
+	if ( Threads > 1 )
+	{
+		vector<query_job> Jobs( Threads );
+		vector<pthread_t> IDs( Threads );
+		vector<bool> Started( Threads, false );
+		for ( size_t t = 0; t < Threads; t++ )
+		{
+			query_job& J = Jobs[t];
+			J.mQuery = this;
+			J.mNode = xNode;
+			J.mElements = A;
+			J.mBegin = A->size() * t / Threads;
+			J.mEnd = A->size() * (t + 1) / Threads;
+			if ( t > 0 )	// the first run is the caller's
+				Started[t] = pthread_create( &IDs[t], NULL, worker, &J ) == 0;
+		}
+		worker( &Jobs[0] );
+		for ( size_t t = 1; t < Threads; t++ )
+			if ( Started[t] )
+				pthread_join( IDs[t], NULL );
+			else
+				worker( &Jobs[t] );	// no thread to be had: do it here
+		for ( size_t t = 0; t < Threads; t++ )
+		{
+			if ( !Jobs[t].mError.empty() )
+				throw error( "%s", Jobs[t].mError.c_str() );
+			xOut.insert( xOut.end(), Jobs[t].mOut.begin(), Jobs[t].mOut.end() );
+		}
+		return;
+	}
+#endif
+	for ( size_t i = 0; i < A->size(); i++ )
+		eval( xNode, (*A)[i], xOut, xContext );
+}
+
+jvalue	// private; the first value xNode yields, or null
+jquery::one( size_t xNode, const jvalue& xInput, const context& xContext ) const
+{
+	if ( mPlan[xNode].mSimple )
+		return value( xNode, xInput );
+	vector<jvalue> Out;
+	eval( xNode, xInput, Out, xContext );
+	return Out.empty() ? jvalue() : Out[0];
+}
+
+jvalue	// private; paths and conditions, without the vectors eval() needs for generators
+jquery::value( size_t xNode, const jvalue& xInput ) const
+{
+	const node& N = mPlan[xNode];
+	switch( N.mOp )
+	{
+		case IDENTITY:
+			return xInput;
+		case LITERAL:
+			return literal( N.mValue );
+		case FIELD:
+			return member( N.mLeft == NONE ? xInput : value( N.mLeft, xInput ), N.mName );
+		case INDEX:
+			return element( N.mLeft == NONE ? xInput : value( N.mLeft, xInput ), N.mValue->Integer() );
+		default:
+			return jvalue( test( xNode, xInput ) );
+	}
+}
+
+jvalue	// private; value(), less the copy of a literal: for operands that are only compared
+jquery::operand( size_t xNode, const jvalue& xInput ) const
+{
+	return mPlan[xNode].mOp == LITERAL ? mPlan[xNode].mValue : value( xNode, xInput );
+}
+
+bool	// private; whether an mSimple node's value is true
+jquery::test( size_t xNode, const jvalue& xInput ) const
+{
+	const node& N = mPlan[xNode];
+	switch( N.mOp )
+	{
+		case AND:
+			return test( N.mLeft, xInput ) && test( N.mRight, xInput );
+		case OR:
+			return test( N.mLeft, xInput ) || test( N.mRight, xInput );
+		case PIPE:	// f | not
+			return !test( N.mLeft, xInput );
+		case EQ:
+			return operand( N.mLeft, xInput ).equals( operand( N.mRight, xInput ) );
+		case NE:
+			return !operand( N.mLeft, xInput ).equals( operand( N.mRight, xInput ) );
+		case LT:
+			return operand( N.mLeft, xInput ).compare( operand( N.mRight, xInput ) ) < 0;
+		case LE:
+			return operand( N.mLeft, xInput ).compare( operand( N.mRight, xInput ) ) <= 0;
+		case GT:
+			return operand( N.mLeft, xInput ).compare( operand( N.mRight, xInput ) ) > 0;
+		case GE:
+			return operand( N.mLeft, xInput ).compare( operand( N.mRight, xInput ) ) >= 0;
+		default:
+			return truthy( value( xNode, xInput ) );
+	}
+}
+
+void	// private
+jquery::eval( size_t xNode, const jvalue& xInput, vector<jvalue>& xOut, const context& xContext ) const
+{
+	const node& N = mPlan[xNode];
+	if ( N.mSimple )
+	{
+		xOut.push_back( value( xNode, xInput ) );
+		return;
+	}
+	switch( N.mOp )
+	{
+		case IDENTITY:
+			xOut.push_back( xInput );
+			return;
+		case LITERAL:
+			xOut.push_back( literal( N.mValue ) );
+			return;
+		case FIELD:
+		case INDEX:
+		case ITERATE:
+		{
+			vector<jvalue> In;
+			if ( N.mLeft == NONE )
+				In.push_back( xInput );
+			else
+				eval( N.mLeft, xInput, In, xContext );
+			for ( size_t i = 0; i < In.size(); i++ )
+				if ( N.mOp == FIELD )
+					xOut.push_back( member( In[i], N.mName ) );
+				else if ( N.mOp == INDEX )
+					xOut.push_back( element( In[i], N.mValue->Integer() ) );
+				else if ( In[i].isObject() )
+					for ( object_map_t::const_iterator IT = In[i]->Object()->begin(); IT != In[i]->Object()->end(); ++IT )
+						xOut.push_back( IT->second );
+				else if ( const array_vector_t *A = elements( In[i], ".[]" ) )
+					xOut.insert( xOut.end(), A->begin(), A->end() );
+			return;
+		}
+		case PIPE:
+		{
+			const node& L = mPlan[N.mLeft];
+			vector<jvalue> In;
+			if ( L.mOp == ITERATE )	// .[] | f: f runs once per element, possibly on several threads
+			{
+				if ( L.mLeft == NONE )
+					In.push_back( xInput );
+				else
+					eval( L.mLeft, xInput, In, xContext );
+				for ( size_t i = 0; i < In.size(); i++ )
+					each( N.mRight, In[i], xOut, xContext );
+				return;
+			}
+			eval( N.mLeft, xInput, In, xContext );
+			for ( size_t i = 0; i < In.size(); i++ )
+				eval( N.mRight, In[i], xOut, xContext );
+			return;
+		}
+		case COMMA:
+			eval( N.mLeft, xInput, xOut, xContext );
+			eval( N.mRight, xInput, xOut, xContext );
+			return;
+		case COLLECT:
+		{
+			jvalue A = newArray();
+			eval( N.mLeft, xInput, *A->Array(), xContext );
+			xOut.push_back( A );
+			return;
+		}
+		case OBJECT:	// one object per combination of the members' values
+		{
+			vector< vector<jvalue> > Values( N.mArgs.size() );
+			for ( size_t i = 0; i < N.mArgs.size(); i++ )
+			{
+				eval( N.mArgs[i], xInput, Values[i], xContext );
+				if ( Values[i].empty() )
+					return;
+			}
+			vector<size_t> Pick( N.mArgs.size(), 0 );
+			for ( ;; )
+			{
+				jvalue O;
+				O->Object( NULL );
+				for ( size_t i = 0; i < N.mArgs.size(); i++ )
+					(*O->Object())[N.mKeys[i]] = Values[i][Pick[i]];
+				xOut.push_back( O );
+				size_t i = N.mArgs.size();
+				while ( i > 0 && ++Pick[i - 1] == Values[i - 1].size() )
+					Pick[--i] = 0;
+				if ( i == 0 )
+					return;
+			}
+		}
+		case AND:
+		case OR:
+		{
+			vector<jvalue> L;
+			eval( N.mLeft, xInput, L, xContext );
+			for ( size_t i = 0; i < L.size(); i++ )
+			{
+				if ( truthy( L[i] ) == (N.mOp == OR) )	// decided by the left side
+				{
+					xOut.push_back( jvalue( N.mOp == OR ) );
+					continue;
+				}
+				vector<jvalue> R;
+				eval( N.mRight, xInput, R, xContext );
+				for ( size_t j = 0; j < R.size(); j++ )
+					xOut.push_back( jvalue( truthy( R[j] ) ) );
+			}
+			return;
+		}
+		case EQ: case NE: case LT: case LE: case GT: case GE:
+		case ADD: case SUB: case MUL: case DIV: case MOD:
+		{
+			static const char Codes[] = { 'e', 'n', '<', 'l', '>', 'g', '+', '-', '*', '/', '%' };
+			int Code = Codes[N.mOp - EQ];
+			vector<jvalue> L, R;
+			eval( N.mLeft, xInput, L, xContext );
+			eval( N.mRight, xInput, R, xContext );
+			for ( size_t j = 0; j < R.size(); j++ )	// as jq: the right side varies slowest
+				for ( size_t i = 0; i < L.size(); i++ )
+					xOut.push_back( binary( Code, L[i], R[j] ) );
+			return;
+		}
+		case SELECT:
+		{
+			if ( mPlan[N.mLeft].mSimple )
+			{
+				if ( test( N.mLeft, xInput ) )
+					xOut.push_back( xInput );
+				return;
+			}
+			vector<jvalue> C;
+			eval( N.mLeft, xInput, C, xContext );
+			for ( size_t i = 0; i < C.size(); i++ )
+				if ( truthy( C[i] ) )
+					xOut.push_back( xInput );
+			return;
+		}
+		case MAP:
+		{
+			jvalue A = newArray();
+			each( N.mLeft, xInput, *A->Array(), xContext );
+			xOut.push_back( A );
+			return;
+		}
+		case GROUP_BY:
+		case SORT_BY:
+		case SORT:
+		case UNIQUE:
+		{
+			const array_vector_t *A = elements( xInput, N.mOp == GROUP_BY ? "group_by" : (N.mOp == SORT_BY ? "sort_by" : (N.mOp == SORT ? "sort" : "unique")) );
+			vector<keyed> Keys;
+			Keys.reserve( A ? A->size() : 0 );
+			for ( size_t i = 0; A && i < A->size(); i++ )
+			{
+				keyed K = { N.mOp == GROUP_BY || N.mOp == SORT_BY ? one( N.mLeft, (*A)[i], xContext ) : (*A)[i], i };
+				Keys.push_back( K );
+			}
+			sort( Keys.begin(), Keys.end() );
+			jvalue R = newArray();
+			for ( size_t i = 0; i < Keys.size(); i++ )
+			{
+				bool Same = i > 0 && Keys[i].mKey.equals( Keys[i - 1].mKey );
+				if ( N.mOp == GROUP_BY )
+				{
+					if ( !Same )
+						R->Array()->push_back( newArray() );
+					R->Array()->back()->Array()->push_back( (*A)[Keys[i].mAt] );
+				}
+				else if ( N.mOp != UNIQUE || !Same )
+					R->Array()->push_back( (*A)[Keys[i].mAt] );
+			}
+			xOut.push_back( R );
+			return;
+		}
+		case LENGTH:
+			if ( xInput.isNull() )
+				xOut.push_back( jvalue( 0 ) );
+			else if ( xInput.isString() )	// in characters
+			{
+				long long Length = 0;
+				for ( size_t i = 0; i < xInput.size(); i++ )
+					Length += ((unsigned char)xInput->String()[i] & 0xC0) != 0x80;
+				xOut.push_back( jvalue( Length ) );
+			}
+			else if ( isNumber( xInput ) )
+				xOut.push_back( xInput->Double() < 0 ? arithmetic( '-', jvalue( 0 ), xInput ) : xInput );
+			else if ( xInput.isArray() || xInput.isObject() )
+				xOut.push_back( jvalue( (long long)xInput.size() ) );
+			else
+				throw jerr::error( "jquery : length of a boolean" );
+			return;
+		case SUM:
+		case MIN:
+		case MAX:
+		{
+			const array_vector_t *A = elements( xInput, N.mOp == SUM ? "add" : (N.mOp == MIN ? "min" : "max") );
+			jvalue R;
+			for ( size_t i = 0; A && i < A->size(); i++ )
+				if ( i == 0 )
+					R = (*A)[i];
+				else if ( N.mOp == SUM )
+					R = arithmetic( '+', R, (*A)[i] );
+				else if ( (*A)[i].compare( R ) * (N.mOp == MIN ? -1 : 1) > 0 )
+					R = (*A)[i];
+			xOut.push_back( R );
+			return;
+		}
+		case KEYS:
+		{
+			jvalue R = newArray();
+			if ( const object_map_t *O = xInput->Object() )
+				for ( object_map_t::const_iterator IT = O->begin(); IT != O->end(); ++IT )
+					R->Array()->push_back( jvalue( IT->first ) );
+			else if ( const array_vector_t *A = elements( xInput, "keys" ) )
+				for ( size_t i = 0; i < A->size(); i++ )
+					R->Array()->push_back( jvalue( (long long)i ) );
+			xOut.push_back( R );
+			return;
+		}
+		case FIRST:
+			xOut.push_back( element( xInput, 0 ) );
+			return;
+		case LAST:
+			xOut.push_back( element( xInput, -1 ) );
+			return;
+		case NOT:
+			xOut.push_back( jvalue( !truthy( xInput ) ) );
+			return;
+		case EMPTY:
+			return;
+	}
+}
+
+jvalue	// private; the tapeable subset, on a value not yet built
+jquery::onTape( size_t xNode, const jtape_value& xInput ) const
+{
+	const node& N = mPlan[xNode];
+	switch( N.mOp )
+	{
+		case IDENTITY:
+			return xInput.toJvalue();
+		case LITERAL:
+			return N.mValue;
+		case FIELD:
+		case INDEX:
+		{
+			if ( N.mLeft != NONE )	// a path: walk it on the tape, build only the end
+			{
+				vector<size_t> Path;
+				for ( size_t P = xNode; P != NONE; P = mPlan[P].mLeft )
+					if ( mPlan[P].mOp != IDENTITY )
+						Path.push_back( P );
+				jtape_value V = xInput;
+				for ( size_t i = Path.size(); i-- > 0; )
+					V = mPlan[Path[i]].mOp == FIELD ? member( V, mPlan[Path[i]].mName ) : element( V, mPlan[Path[i]].mValue->Integer() );
+				return V.toJvalue();
+			}
+			return N.mOp == FIELD ? member( xInput, N.mName ).toJvalue() : element( xInput, N.mValue->Integer() ).toJvalue();
+		}
+		case AND:
+			return jvalue( truthy( onTape( N.mLeft, xInput ) ) && truthy( onTape( N.mRight, xInput ) ) );
+		case OR:
+			return jvalue( truthy( onTape( N.mLeft, xInput ) ) || truthy( onTape( N.mRight, xInput ) ) );
+		case PIPE:	// f | not
+			return jvalue( !truthy( onTape( N.mLeft, xInput ) ) );
+		default:
+		{
+			static const char Codes[] = { 'e', 'n', '<', 'l', '>', 'g' };
+			return binary( Codes[N.mOp - EQ], onTape( N.mLeft, xInput ), onTape( N.mRight, xInput ) );
+		}
+	}
+}
+
+/*
+ * the interface
+ *
+ */
+
+void
+jquery::run( const jvalue& xInput, vector<jvalue>& xOut, unsigned int xThreads ) const
+{
+	context C = { xThreads < 1 ? 1 : xThreads };
+	eval( mRoot, xInput, xOut, C );
+}
+
+jvalue
+jquery::first( const jvalue& xInput, unsigned int xThreads ) const
+{
+	vector<jvalue> Out;
+	run( xInput, Out, xThreads );
+	return Out.empty() ? jvalue() : Out[0];
+}
+
+size_t
+jquery::runText( const char *xText, size_t xLength, vector<jvalue>& xOut ) const
+{
+	context C = { 1 };
+	jtape T;
+	size_t Values = 0;
+	for ( size_t At = 0, Used; At < xLength && T.parse( xText + At, xLength - At, &Used ); At += Used )
+	{
+		Values++;
+		if ( mFilter == NONE )
+			eval( mRoot, T.root().toJvalue(), xOut, C );
+		else if ( truthy( onTape( mFilter, T.root() ) ) )
+		{
+			jvalue V = T.root().toJvalue();
+			if ( mRest == NONE )
+				xOut.push_back( V );
+			else
+				eval( mRest, V, xOut, C );
+		}
+	}
+	return Values;
+}
+
+size_t
+jquery::run( jreadahead& xReader, vector<jvalue>& xOut ) const
+{
+	context C = { 1 };
+	size_t Values = 0;
+	jvalue V;
+	while ( xReader.parse( V ) )
+	{
+		Values++;
+		eval( mRoot, V, xOut, C );
+	}
+	return Values;
+}
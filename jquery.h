@@ -0,0 +1,121 @@
+
+#ifndef jqueryHeader
+#define jqueryHeader
+
+/*
+ * a small jq-like query language: compiled once, run over many documents
+ *
+ *   jquery Q( "[.[] | select(.level == \"ERROR\") | {ts, msg}]" );
+ *   jvalue Errors = Q.first( Logs );
+ *
+ *   jquery G( "group_by(.host) | map({host: .[0].host, n: length, ms: (map(.latency) | add)})" );
+ *   vector<jvalue> Out;
+ *   G.run( Requests, Out, 4 );		// 4 threads where the plan allows
+ *
+ *   jquery S( "select(.status == 500) | .path" );
+ *   S.runText( NDJSON, Length, Out );	// every value in the text, one after another
+ *
+ * the language (as in jq; every expression yields zero or more values):
+ *   .  .a  .a.b  ."a b"  .[2]  .[]  .a[]	input, members, elements, all elements
+ *   f | g   f, g   (f)			pipe, both, grouping
+ *   == != < <= > >=  and or		comparisons use jvalue::equals and compare
+ *   + - * / %				numbers; + also joins strings, arrays, objects
+ *   [f]   {a: f, "b": g, c}		collect; construct ({c} is {c: .c})
+ *   42 "text" true false null		literals
+ *   select(f) map(f) group_by(f) sort_by(f) sort length add min max keys
+ *   first last not empty unique
+ *
+ * differences from jq: null iterates as empty, and a member of something
+ * that is neither an object nor null throws jerr::error, as do compile
+ * errors (with the offset)
+ *
+ * threads: "[.[] | f]" and ".[] | f" split the array between threads when
+ * it is large, keeping the order of the results; f must not depend on
+ * other elements, and none of jquery's own functions do.  documents are
+ * only read, so several threads (or queries) may share them as long as
+ * nobody changes them meanwhile.  built with SINGLE_THREAD everything runs
+ * on the caller's thread.
+ *
+ * pushdown: runText() parses each value into a jtape first.  when the query
+ * starts with select(p) and p only compares members with literals (and, or,
+ * not), p is decided on the tape and a jvalue is built only for the values
+ * that pass.  the answers, and the errors, are those run() would give.
+ *
+ */
+
+#include "jvalue.h"
+#include <vector>
+
+class jtape_value;
+class jreadahead;
+
+class jquery
+{
+	public:
+		explicit jquery( const string& xExpression );
+
+		void run( const jvalue& xInput, vector<jvalue>& xOut, unsigned int xThreads = 1 ) const;	// appends
+		jvalue first( const jvalue& xInput, unsigned int xThreads = 1 ) const;	// or null if none
+		size_t runText( const char *xText, size_t xLength, vector<jvalue>& xOut ) const;	// returns values read
+		size_t runText( const string& xText, vector<jvalue>& xOut ) const { return runText( xText.data(), xText.size(), xOut ); }
+		size_t run( jreadahead& xReader, vector<jvalue>& xOut ) const;	// every value in the file
+
+		bool pushdown() const { return mFilter != NONE; }	// runText() decides a select() on the tape
+
+		enum { PARALLEL_MIN = 4096 };	// elements per thread before splitting pays
+
+	private:
+		enum op_t
+		{
+			IDENTITY, FIELD, INDEX, ITERATE, LITERAL, PIPE, COMMA, COLLECT, OBJECT,
+			AND, OR, EQ, NE, LT, LE, GT, GE, ADD, SUB, MUL, DIV, MOD,
+			SELECT, MAP, GROUP_BY, SORT_BY, SORT, LENGTH, SUM, MIN, MAX, KEYS, FIRST, LAST, NOT, EMPTY, UNIQUE
+		};
+		enum { NONE = (size_t)-1 };
+
+		struct node
+		{
+			op_t           mOp;
+			size_t         mLeft;	// the input (FIELD, INDEX, ITERATE), the argument, or the left operand
+			size_t         mRight;
+			jvalue         mValue;	// LITERAL, and INDEX's position
+			string         mName;	// FIELD
+			vector<string> mKeys;	// OBJECT: key i is built by mArgs[i]
+			vector<size_t> mArgs;
+			bool           mSimple;	// tapeable(): exactly one value, found without generating
+		};
+
+		struct context;
+
+		vector<node> mPlan;
+		size_t       mRoot;
+		size_t       mFilter;	// select()'s argument, when it can run on a tape
+		size_t       mRest;		// what follows that select(), or NONE
+
+		// compiling; xAt moves through the text
+		size_t add( op_t xOp, size_t xLeft = NONE, size_t xRight = NONE );
+		size_t parsePipe( const string& xText, size_t& xAt );
+		size_t parseComma( const string& xText, size_t& xAt );
+		size_t parseOr( const string& xText, size_t& xAt );
+		size_t parseAnd( const string& xText, size_t& xAt );
+		size_t parseCompare( const string& xText, size_t& xAt );
+		size_t parseSum( const string& xText, size_t& xAt );
+		size_t parseProduct( const string& xText, size_t& xAt );
+		size_t parsePostfix( const string& xText, size_t& xAt );
+		size_t parsePrimary( const string& xText, size_t& xAt );
+		size_t parseObject( const string& xText, size_t& xAt );
+		bool tapeable( size_t xNode ) const;
+
+		// running
+		void eval( size_t xNode, const jvalue& xInput, vector<jvalue>& xOut, const context& xContext ) const;
+		void each( size_t xNode, const jvalue& xContainer, vector<jvalue>& xOut, const context& xContext ) const;
+		jvalue one( size_t xNode, const jvalue& xInput, const context& xContext ) const;
+		jvalue value( size_t xNode, const jvalue& xInput ) const;	// mSimple nodes
+		jvalue operand( size_t xNode, const jvalue& xInput ) const;
+		bool test( size_t xNode, const jvalue& xInput ) const;
+		jvalue onTape( size_t xNode, const jtape_value& xInput ) const;
+
+		static void *worker( void *xJob );
+};
+
+#endif
@@ -0,0 +1,214 @@
+
+#include "jreadahead.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace std;
+
+jreadahead::jreadahead( const char *xPath, size_t xBlock, unsigned int xBlocks, bool xDirect ) :
+	mFD( -1 ), mDirect( false ), mBlock( 0 ),
+	mFilled( 0 ), mTaken( 0 ), mReleased( 0 ), mEnd( false ), mError( 0 ), mStop( false ), mStalls( 0 ),
+	mThreaded( false ), mData( NULL ), mLength( 0 )
+{
+	if ( xDirect )
+	{
+		mFD = open( xPath, O_RDONLY | O_DIRECT );
+		mDirect = mFD >= 0;
+	}
+	if ( mFD < 0 )	// not asked for, or the file system said no
+		mFD = open( xPath, O_RDONLY );
+	if ( mFD < 0 )
+		throw jerr::error( "jreadahead : cannot open file" );
+	if ( !mDirect )
+		posix_fadvise( mFD, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+	mBlock = (xBlock + ALIGN - 1) / ALIGN * ALIGN;	// O_DIRECT wants aligned sizes as well as addresses
+	if ( mBlock == 0 )
+		mBlock = ALIGN;
+	mRing.resize( xBlocks < 2 ? 2 : xBlocks );
+	for ( size_t i = 0; i < mRing.size(); i++ )
+	{
+		void *P = NULL;
+		if ( posix_memalign( &P, ALIGN, mBlock ) != 0 )
+		{
+			close();
+			throw jerr::error( "jreadahead : out of memory" );
+		}
+		mRing[i].mData = (char *)P;
+		mRing[i].mLength = 0;
+	}
+
+	pthread_mutex_init( &mLock, NULL );
+	pthread_cond_init( &mReady, NULL );
+	pthread_cond_init( &mFree, NULL );
+#ifndef SINGLE_THREAD
+	mThreaded = pthread_create( &mThread, NULL, run, this ) == 0;	// if not, next() reads for itself
+#endif
+}
+
+jreadahead::~jreadahead()
+{
+	if ( mThreaded )
+	{
+		pthread_mutex_lock( &mLock );
+		mStop = true;
+		pthread_cond_signal( &mFree );
+		pthread_mutex_unlock( &mLock );
+		pthread_join( mThread, NULL );
+	}
+	pthread_cond_destroy( &mFree );
+	pthread_cond_destroy( &mReady );
+	pthread_mutex_destroy( &mLock );
+	close();
+}
+
+void
+jreadahead::close()
+{
+	for ( size_t i = 0; i < mRing.size(); i++ )
+		free( mRing[i].mData );
+	mRing.clear();
+	if ( mFD >= 0 )
+		::close( mFD );
+	mFD = -1;
+}
+
+bool	// reads until the block is full, so only the last one is short
+jreadahead::fill( block& xBlock )
+{
+	xBlock.mLength = 0;
+	while ( xBlock.mLength < mBlock )
+	{
+		ssize_t N = read( mFD, xBlock.mData + xBlock.mLength, mBlock - xBlock.mLength );
+		if ( N > 0 )
+		{
+			xBlock.mLength += N;
+			continue;
+		}
+		if ( N == 0 )
+			break;
+		if ( errno == EINTR )
+			continue;
+		if ( errno == EINVAL && mDirect )	// an unaligned tail: finish without O_DIRECT
+		{
+			mDirect = false;
+			fcntl( mFD, F_SETFL, fcntl( mFD, F_GETFL ) & ~O_DIRECT );
+			continue;
+		}
+		mError = errno;
+		return false;
+	}
+	return xBlock.mLength > 0;
+}
+
+void *	// static
+jreadahead::run( void *xThis )
+{
+	((jreadahead *)xThis)->reader();
+	return NULL;
+}
+
+void
+jreadahead::reader()
+{
+	for ( ;; )
+	{
+		pthread_mutex_lock( &mLock );
+		while ( mFilled - mReleased >= mRing.size() && !mStop )
+			pthread_cond_wait( &mFree, &mLock );
+		bool Stop = mStop;
+		uint64_t Slot = mFilled;
+		pthread_mutex_unlock( &mLock );
+		if ( Stop )
+			return;
+
+		bool More = fill( mRing[Slot % mRing.size()] );	// no lock held while the disk works
+
+		pthread_mutex_lock( &mLock );
+		if ( More )
+			mFilled++;
+		else
+			mEnd = true;
+		pthread_cond_signal( &mReady );
+		pthread_mutex_unlock( &mLock );
+		if ( !More )
+			return;
+	}
+}
+
+bool
+jreadahead::next( const char *&xData, size_t& xLength )
+{
+	if ( !mThreaded )	// read in line: the ring is only ever one block deep
+	{
+		block& B = mRing[0];
+		if ( !mEnd && fill( B ) )
+		{
+			xData = B.mData;
+			xLength = B.mLength;
+			return true;
+		}
+		mEnd = true;
+		if ( mError )
+			throw jerr::error( "jreadahead : read failed" );
+		return false;
+	}
+
+	pthread_mutex_lock( &mLock );
+	if ( mReleased < mTaken )	// the caller is done with the last block
+	{
+		mReleased = mTaken;
+		pthread_cond_signal( &mFree );
+	}
+	if ( mTaken == mFilled && !mEnd )
+	{
+		mStalls++;
+		do
+			pthread_cond_wait( &mReady, &mLock );
+		while ( mTaken == mFilled && !mEnd );
+	}
+	bool Got = mTaken < mFilled;
+	uint64_t Slot = mTaken;
+	if ( Got )
+		mTaken++;
+	int Error = mError;
+	pthread_mutex_unlock( &mLock );
+
+	if ( !Got )
+	{
+		if ( Error )
+			throw jerr::error( "jreadahead : read failed" );
+		return false;
+	}
+	block& B = mRing[Slot % mRing.size()];
+	xData = B.mData;
+	xLength = B.mLength;
+	return true;
+}
+
+bool
+jreadahead::parse( jvalue& xOut )
+{
+	for ( ;; )
+	{
+		while ( mLength > 0 )
+		{
+			size_t Used = mPush.feed( mData, mLength );
+			mData += Used;
+			mLength -= Used;
+			if ( mPush.done() )
+			{
+				xOut = mPush.take();
+				return true;
+			}
+		}
+		if ( !next( mData, mLength ) )
+		{
+			if ( !mPush.finish() )
+				return false;
+			xOut = mPush.take();
+			return true;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+
+#ifndef jreadaheadHeader
+#define jreadaheadHeader
+
+/*
+ * read-ahead file input: a reader thread fills a ring of aligned blocks
+ * while the parser works through the block before them, so the disk and
+ * the parser are busy at the same time instead of taking turns
+ *
+ *   jreadahead R( "events.ndjson" );
+ *   jvalue V;
+ *   while ( R.parse( V ) )	// one value per call, through a jpush
+ *       handle( V );
+ *
+ * or take the blocks directly:
+ *   const char *Data;
+ *   size_t Length;
+ *   while ( R.next( Data, Length ) )	// valid until the next call
+ *       ...
+ *
+ * xDirect asks for O_DIRECT (bypassing the page cache for files read once);
+ * where the file system refuses it the file is read normally.  otherwise
+ * the kernel is told the access is sequential.  built with SINGLE_THREAD
+ * the blocks are read in next() and nothing overlaps.
+ *
+ * parse() hands back a new tree each time: xOut is rebound, not overwritten,
+ * so other handles on its old value are unaffected
+ *
+ */
+
+#include "jvalue.h"
+#include "jpush.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+class jreadahead
+{
+		jreadahead( const jreadahead& );            // not implemented
+		jreadahead& operator=( const jreadahead& ); // not implemented
+	public:
+		enum { BLOCK = 1 << 20, BLOCKS = 4, ALIGN = 4096 };
+
+		jreadahead( const char *xPath, size_t xBlock = BLOCK, unsigned int xBlocks = BLOCKS, bool xDirect = false );
+		~jreadahead();
+
+		bool next( const char *&xData, size_t& xLength );	// false at end of file
+		bool parse( jvalue& xOut );							// false at end of file
+		void dedup( jdedup *xTable ) { mPush.dedup( xTable ); }	// share repeated values across parse() calls
+
+		bool direct() const { return mDirect; }	// O_DIRECT is in effect
+		size_t stalls() const { return mStalls; }	// times next() had to wait for the disk
+
+	private:
+		struct block
+		{
+			char  *mData;
+			size_t mLength;
+		};
+
+		int           mFD;
+		bool          mDirect;
+		size_t        mBlock;
+		vector<block> mRing;
+
+		// blocks counted from the start of the file; guarded by mLock
+		uint64_t      mFilled;		// by the reader
+		uint64_t      mTaken;		// handed to next()
+		uint64_t      mReleased;	// finished with, free to refill
+		bool          mEnd;
+		int           mError;		// errno from a failed read
+		bool          mStop;
+		size_t        mStalls;
+
+		bool            mThreaded;
+		pthread_t       mThread;
+		pthread_mutex_t mLock;
+		pthread_cond_t  mReady;		// a block was filled, or the end was reached
+		pthread_cond_t  mFree;		// a block was released
+
+		jpush         mPush;
+		const char   *mData;		// the unparsed part of the current block
+		size_t        mLength;
+
+		static void *run( void *xThis );
+		void reader();
+		bool fill( block& xBlock );	// false at end of file or error
+		void close();
+};
+
+#endif
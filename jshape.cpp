@@ -0,0 +1,300 @@
+
+#include "jshape.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+static inline const char *
+skip( const char *xAt, const char *xEnd )
+{
+	while ( xAt < xEnd && isspace( (unsigned char)*xAt ) )
+		xAt++;
+	return xAt;
+}
+
+static void
+truncated()
+{
+	throw jerr::error( "jshape : found EOF inside value" );
+}
+
+static inline const char *	// the closing quote of a string whose opening quote is at xAt
+closing( const char *xAt, const char *xEnd )
+{
+	const char *Q = (const char *)memchr( xAt + 1, '"', xEnd - xAt - 1 );
+	if ( !Q )
+		truncated();
+	return Q;
+}
+
+bool
+jshape::parse( const char *xText, size_t xLength, jvalue& xOut, size_t *xUsed )
+{
+	const char *End = xText + xLength;
+	const char *P = skip( xText, End );
+	if ( P == End )
+	{
+		xOut = jvalue();
+		if ( xUsed )
+			*xUsed = xLength;
+		return false;
+	}
+	xOut = *P == '{' ? record( P, End ) : value( P, End );
+	if ( xUsed )
+		*xUsed = P - xText;
+	return true;
+}
+
+jvalue	// private; an object at the top: read against the shape
+jshape::record( const char *&xAt, const char *xEnd )
+{
+	const char *P = xAt + 1;
+	bool Learning = mShape.empty();
+	bool Fits = !Learning;
+	size_t i = 0;
+	jvalue R;
+	R->Object( NULL );
+	if ( Learning )
+		mNext.clear();
+	P = skip( P, xEnd );
+	if ( P < xEnd && *P == '}' )
+		P++;
+	else
+		for ( ;; )
+		{
+			P = skip( P, xEnd );
+			const char *Key = P;
+			string Name;
+			size_t Reserve = 0;
+			if ( Fits && i < mShape.size() && (size_t)(xEnd - P) >= mShape[i].mToken.size()
+				&& memcmp( P, mShape[i].mToken.data(), mShape[i].mToken.size() ) == 0 )
+			{
+				P += mShape[i].mToken.size();
+				Name = mShape[i].mName;
+				Reserve = mShape[i].mType == JARRAY ? mShape[i].mSize : 0;
+			}
+			else
+			{
+				Fits = false;	// the rest, one member at a time
+				if ( !key( P, xEnd, Name ) )
+					throw jerr::error( "jshape : bad pair in object" );
+			}
+			const char *KeyEnd = P;
+			P = skip( P, xEnd );
+			if ( P == xEnd || *P++ != ':' )
+				throw jerr::error( "jshape : bad pair in object" );
+			jvalue V = value( P, xEnd, Reserve );
+			if ( Fits )
+			{
+				mShape[i].mType = V.type();
+				mShape[i].mSize = V.size();
+			}
+			else if ( Learning )
+			{
+				field F;
+				F.mToken.assign( Key, KeyEnd - Key );
+				F.mName = Name;
+				F.mType = V.type();
+				F.mSize = V.size();
+				mNext.push_back( F );
+			}
+			i++;
+			R.insert( std::move( Name ), std::move( V ) );
+			P = skip( P, xEnd );
+			if ( P == xEnd )
+				truncated();
+			if ( *P++ == '}' )
+				break;
+			if ( P[-1] != ',' )
+				throw jerr::error( "jshape : missing comma" );
+		}
+	xAt = P;
+
+	mRecords++;
+	if ( Fits && i == mShape.size() )
+	{
+		mHits++;
+		mMissed = 0;
+	}
+	else if ( Learning )
+	{
+		mShape.swap( mNext );
+		mLearned += !mShape.empty();
+	}
+	else if ( ++mMissed >= RELEARN )	// the stream has changed: learn from the next one
+		reset();
+	return R;
+}
+
+jvalue	// private; any value, with the common cases read in place
+jshape::value( const char *&xAt, const char *xEnd, size_t xReserve )
+{
+	const char *Start = skip( xAt, xEnd ), *P = Start;
+	if ( P == xEnd )
+		truncated();
+	jvalue V;
+	switch( *P )
+	{
+		case '"':
+		{
+			const char *Q = closing( P, xEnd );
+			if ( memchr( P + 1, '\\', Q - P - 1 ) )
+				break;
+			V->String( P + 1, Q - P - 1 );
+			xAt = Q + 1;
+			return V;
+		}
+		case '{':
+		{
+			V->Object( NULL );
+			P = skip( P + 1, xEnd );
+			if ( P < xEnd && *P == '}' )
+			{
+				xAt = P + 1;
+				return V;
+			}
+			for ( ;; )
+			{
+				string Name;
+				P = skip( P, xEnd );
+				if ( !key( P, xEnd, Name ) )
+					throw jerr::error( "jshape : bad pair in object" );
+				P = skip( P, xEnd );
+				if ( P == xEnd || *P++ != ':' )
+					throw jerr::error( "jshape : bad pair in object" );
+				V.insert( std::move( Name ), value( P, xEnd ) );
+				P = skip( P, xEnd );
+				if ( P == xEnd )
+					truncated();
+				if ( *P++ == '}' )
+					break;
+				if ( P[-1] != ',' )
+					throw jerr::error( "jshape : missing comma" );
+			}
+			xAt = P;
+			return V;
+		}
+		case '[':
+		{
+			P = skip( P + 1, xEnd );
+			V->Array( NULL );
+			if ( P < xEnd && *P == ']' )	// empty
+			{
+				xAt = P + 1;
+				return V;
+			}
+			if ( xReserve )
+				V->Array()->reserve( xReserve );
+			for ( ;; )
+			{
+				V.push_back( value( P, xEnd ) );
+				P = skip( P, xEnd );
+				if ( P == xEnd )
+					truncated();
+				if ( *P++ == ']' )
+					break;
+				if ( P[-1] != ',' )
+					throw jerr::error( "jshape : missing comma between values" );
+			}
+			xAt = P;
+			return V;
+		}
+		case '-': case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+		{
+			bool Negative = *P == '-';
+			P += Negative;
+			const char *Digits = P;
+			long long I = 0;
+			for ( ; P < xEnd && isdigit( (unsigned char)*P ); P++ )
+				if ( P - Digits < 18 )	// 18 digits cannot overflow; longer goes the generic way below
+					I = I * 10 + (*P - '0');
+			size_t N = P - Digits;
+			if ( N == 0 || N >= 19 )
+				break;
+			if ( P == xEnd || (*P != '.' && *P != 'e' && *P != 'E') )
+			{
+				V->Integer( Negative ? -I : I );
+				xAt = P;
+				return V;
+			}
+			if ( *P == '.' )
+				for ( P++; P < xEnd && isdigit( (unsigned char)*P ); )
+					P++;
+			if ( P < xEnd && (*P == 'e' || *P == 'E') )
+			{
+				P++;
+				if ( P < xEnd && (*P == '-' || *P == '+') )
+					P++;
+				if ( P == xEnd || !isdigit( (unsigned char)*P ) )
+					break;	// let the generic path say what is wrong
+				while ( P < xEnd && isdigit( (unsigned char)*P ) )
+					P++;
+			}
+			char Text[64];
+			if ( (size_t)(P - Start) >= sizeof(Text) )
+				break;
+			memcpy( Text, Start, P - Start );
+			Text[P - Start] = '\0';
+			V->Double( atof( Text ) );
+			xAt = P;
+			return V;
+		}
+		case 't':
+			if ( xEnd - P >= 4 && memcmp( P, "true", 4 ) == 0 )
+			{
+				V->Bool( true );
+				xAt = P + 4;
+				return V;
+			}
+			break;
+		case 'f':
+			if ( xEnd - P >= 5 && memcmp( P, "false", 5 ) == 0 )
+			{
+				V->Bool( false );
+				xAt = P + 5;
+				return V;
+			}
+			break;
+		case 'n':
+			if ( xEnd - P >= 4 && memcmp( P, "null", 4 ) == 0 )
+			{
+				xAt = P + 4;
+				return V;
+			}
+			break;
+		default:
+			break;
+	}
+	xAt = Start;
+	return generic( xAt, xEnd );
+}
+
+jvalue	// private; escapes, long numbers, odd spellings: whatever jvalue::parse accepts
+jshape::generic( const char *&xAt, const char *xEnd )
+{
+	mPush.reset();
+	size_t Used = mPush.feed( xAt, xEnd - xAt );
+	if ( !mPush.done() && !mPush.finish() )
+		truncated();
+	xAt += Used;
+	return mPush.take();
+}
+
+bool	// private; a key at xAt, unescaped into xName
+jshape::key( const char *&xAt, const char *xEnd, string& xName )
+{
+	if ( xAt == xEnd || *xAt != '"' )
+		return false;
+	const char *Q = closing( xAt, xEnd );
+	if ( memchr( xAt + 1, '\\', Q - xAt - 1 ) )
+	{
+		jvalue K = generic( xAt, xEnd );
+		xName.assign( K->String(), K.size() );
+		return true;
+	}
+	xName.assign( xAt + 1, Q - xAt - 1 );
+	xAt = Q + 1;
+	return true;
+}
@@ -0,0 +1,77 @@
+
+#ifndef jshapeHeader
+#define jshapeHeader
+
+/*
+ * a parser for streams of records that all look alike (NDJSON logs, mostly)
+ *
+ *   jshape S;
+ *   jvalue R;
+ *   size_t Used;
+ *   for ( const char *P = Text; S.parse( P, End - P, R, &Used ); P += Used )
+ *       handle( R );
+ *   cerr << S.hits() << " of " << S.records() << " records had the usual shape";
+ *
+ * the first object read sets the shape: its keys as they appear in the text,
+ * in order, and the kind and size of each value.  each later record is read
+ * expecting that shape: a key is checked with one memcmp against the text
+ * the last records had, taken from the shape rather than unescaped and
+ * copied, and arrays are reserved to the size seen last time.  a key that
+ * does not match sends the rest of the record down the generic path (one
+ * member at a time, any order); after RELEARN such records in a row the
+ * shape is learned again from the next one.
+ *
+ * the grammar is that of jvalue::parse; strings with escapes, unusual
+ * numbers and literals go through a jpush, so the result is the same tree
+ * either way (a surrogate pair escape is one 4-byte character in both).  errors throw jerr::error.  not thread safe: one per stream.
+ *
+ */
+
+#include "jvalue.h"
+#include "jpush.h"
+#include <vector>
+
+class jshape
+{
+		jshape( const jshape& );            // not implemented
+		jshape& operator=( const jshape& ); // not implemented
+	public:
+		enum { RELEARN = 8 };	// records in a row that miss before the shape is replaced
+
+		jshape() : mRecords( 0 ), mHits( 0 ), mLearned( 0 ), mMissed( 0 ) {}
+
+		// one value; false (and xOut null) if the text holds only white space
+		bool parse( const char *xText, size_t xLength, jvalue& xOut, size_t *xUsed = NULL );
+		bool parse( const string& xText, jvalue& xOut, size_t *xUsed = NULL ) { return parse( xText.data(), xText.size(), xOut, xUsed ); }
+
+		void reset() { mShape.clear(); mMissed = 0; }	// forget the shape; the counters stay
+
+		size_t records() const { return mRecords; }	// objects read
+		size_t hits() const { return mHits; }		// ... every key where it was expected
+		size_t learned() const { return mLearned; }	// times a shape was taken
+		size_t keys() const { return mShape.size(); }
+
+	private:
+		struct field
+		{
+			string mToken;	// the key as it is in the text, quotes included
+			string mName;	// and as it is in the tree
+			jType  mType;
+			size_t mSize;	// elements, for arrays
+		};
+
+		vector<field> mShape;
+		vector<field> mNext;	// the record being read, when it will become the shape
+		size_t        mRecords;
+		size_t        mHits;
+		size_t        mLearned;
+		size_t        mMissed;	// records in a row that did not fit
+		jpush         mPush;	// the generic path
+
+		jvalue record( const char *&xAt, const char *xEnd );
+		jvalue value( const char *&xAt, const char *xEnd, size_t xReserve = 0 );
+		jvalue generic( const char *&xAt, const char *xEnd );
+		bool key( const char *&xAt, const char *xEnd, string& xName );
+};
+
+#endif
@@ -0,0 +1,421 @@
+
+#include "jsnapshot.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unordered_map>
+using namespace std;
+
+static const char     MAGIC[8]   = { 'J', 'V', 'S', 'N', 'A', 'P', '0', '1' };
+static const uint32_t ORDER_MARK = 0x01020304;
+static const uint32_t VERSION    = 1;
+
+static const jsnapshot_record NULL_RECORD = { JNULL, 0, 0 };
+
+/*
+ * writing
+ *
+ */
+
+class snapshotWriter
+{
+	public:
+		snapshotWriter( string& xOut ) : mBody( xOut ) {}
+
+		size_t reserve( size_t xBytes )	// space at the end of the body; returns its offset
+			{
+				size_t At = mBody.size();
+				mBody.append( xBytes, '\0' );
+				return At;
+			}
+		void value( const jvalue& xValue, size_t xRecordAt );
+		uint64_t finish();
+
+	private:
+		string& mBody;	// header, records, entries
+		string  mStrings;
+		unordered_map<string,uint64_t> mInterned;
+
+		uint64_t intern( const char *xText, size_t xLength );
+};
+
+uint64_t
+snapshotWriter::intern( const char *xText, size_t xLength )	// identical strings (mostly keys) are stored once
+{
+	string Key( xText, xLength );
+	unordered_map<string,uint64_t>::const_iterator IT = mInterned.find( Key );
+	if ( IT != mInterned.end() )
+		return IT->second;
+	uint64_t At = mStrings.size();
+	mStrings.append( xText, xLength );
+	mStrings += '\0';
+	mInterned.insert( make_pair( Key, At ) );
+	return At;
+}
+
+static uint32_t	// a size as the records hold it
+length32( size_t xLength )
+{
+	if ( xLength > 0xFFFFFFFFULL )
+		throw jerr::error( "jsnapshot::write : item too large" );
+	return (uint32_t)xLength;
+}
+
+void	// fill the record at xRecordAt; children are appended to the body
+snapshotWriter::value( const jvalue& xValue, size_t xRecordAt )
+{
+	private_jvalue_data *V = xValue.get();
+	jsnapshot_record R = { (uint32_t)V->type(), 0, 0 };
+	switch( V->type() )
+	{
+		case JNULL:
+			break;
+		case JBOOL:
+			R.mPayload = V->Bool();
+			break;
+		case JINTEGER:
+			R.mPayload = (uint64_t)V->Integer();
+			break;
+		case JUNSIGNED:
+			R.mPayload = V->Unsigned();
+			break;
+		case JDOUBLE:
+		{
+			double D = V->Double();
+			memcpy( &R.mPayload, &D, sizeof(D) );
+			break;
+		}
+		case JSTRING:
+			R.mLength = length32( V->size() );
+			R.mPayload = intern( V->String(), R.mLength );
+			break;
+		case JBINARY:
+			R.mLength = length32( V->Binary()->size() );
+			R.mPayload = intern( V->Binary()->data(), R.mLength );
+			break;
+		case JARRAY:
+		{
+			const array_vector_t& A = *V->Array();
+			R.mLength = length32( A.size() );
+			R.mPayload = reserve( A.size() * sizeof(jsnapshot_record) );
+			for ( size_t i = 0; i < A.size(); i++ )
+				value( A[i], R.mPayload + i * sizeof(jsnapshot_record) );
+			break;
+		}
+		case JOBJECT:
+		{
+			const object_map_t& O = *V->Object();	// std::map order is the byte order the reader searches by
+			R.mLength = length32( O.size() );
+			R.mPayload = reserve( O.size() * sizeof(jsnapshot_entry) );
+			size_t At = R.mPayload;
+			for ( object_map_t::const_iterator IT = O.begin(); IT != O.end(); IT++, At += sizeof(jsnapshot_entry) )
+			{
+				jsnapshot_entry E;
+				memset( &E, 0, sizeof(E) );
+				E.mKey = intern( IT->first.data(), IT->first.size() );
+				E.mKeyLength = length32( IT->first.size() );
+				memcpy( &mBody[At], &E, sizeof(E) );
+				value( IT->second, At + offsetof( jsnapshot_entry, mValue ) );
+			}
+			break;
+		}
+		case JBAD:
+			throw jerr::error( "jsnapshot::write : accessing deleted jvalue" );
+	}
+	memcpy( &mBody[xRecordAt], &R, sizeof(R) );	// mBody may have moved; write by offset
+}
+
+uint64_t	// append the string table; returns its offset
+snapshotWriter::finish()
+{
+	uint64_t Strings = mBody.size();
+	mBody += mStrings;
+	return Strings;
+}
+
+void	// static
+jsnapshot::write( const jvalue& xValue, string& xOut )
+{
+	xOut.clear();
+	snapshotWriter W( xOut );
+	W.reserve( sizeof(header_t) );
+	W.value( xValue, offsetof( header_t, mRoot ) );
+	uint64_t Strings = W.finish();
+
+	header_t *H = (header_t *)&xOut[0];
+	memcpy( H->mMagic, MAGIC, sizeof(MAGIC) );
+	H->mByteOrder = ORDER_MARK;
+	H->mVersion = VERSION;
+	H->mSize = xOut.size();
+	H->mStrings = Strings;
+	H->mStringsSize = xOut.size() - Strings;
+}
+
+void	// static
+jsnapshot::write( const jvalue& xValue, const char *xPath )
+{
+	string Out;
+	write( xValue, Out );
+	FILE *F = fopen( xPath, "wb" );
+	if ( !F )
+		throw jerr::error( "jsnapshot::write : cannot create file" );
+	bool OK = fwrite( Out.data(), 1, Out.size(), F ) == Out.size();
+	OK = (fclose( F ) == 0) && OK;
+	if ( !OK )
+		throw jerr::error( "jsnapshot::write : cannot write file" );
+}
+
+/*
+ * reading
+ *
+ */
+
+jsnapshot::jsnapshot( const char *xPath ) : mBase( NULL ), mLength( 0 ), mMapped( false )
+{
+	int FD = open( xPath, O_RDONLY );
+	if ( FD < 0 )
+		throw jerr::error( "jsnapshot : cannot open file" );
+	struct stat ST;
+	if ( fstat( FD, &ST ) != 0 || ST.st_size < (off_t)sizeof(header_t) )
+	{
+		close( FD );
+		throw jerr::error( "jsnapshot : file too small" );
+	}
+	void *P = mmap( NULL, ST.st_size, PROT_READ, MAP_SHARED, FD, 0 );	// shared: one copy in the page cache for all readers
+	close( FD );
+	if ( P == MAP_FAILED )
+		throw jerr::error( "jsnapshot : mmap failed" );
+	mBase = (const char *)P;
+	mLength = ST.st_size;
+	mMapped = true;
+	try
+	{
+		check();
+	}
+	catch ( ... )
+	{
+		munmap( (void *)mBase, mLength );
+		throw;
+	}
+}
+
+jsnapshot::jsnapshot( const void *xBuffer, size_t xLength ) : mBase( (const char *)xBuffer ), mLength( xLength ), mMapped( false )
+{
+	if ( (uintptr_t)xBuffer % sizeof(uint64_t) )
+		throw jerr::error( "jsnapshot : buffer must be 8-byte aligned" );
+	check();
+}
+
+jsnapshot::~jsnapshot()
+{
+	if ( mMapped )
+		munmap( (void *)mBase, mLength );
+}
+
+void
+jsnapshot::check()
+{
+	if ( mLength < sizeof(header_t) || memcmp( header()->mMagic, MAGIC, sizeof(MAGIC) ) != 0 )
+		throw jerr::error( "jsnapshot : not a snapshot" );
+	if ( header()->mByteOrder != ORDER_MARK )
+		throw jerr::error( "jsnapshot : written with a different byte order" );
+	if ( header()->mVersion != VERSION )
+		throw jerr::error( "jsnapshot : unsupported version" );
+	if ( header()->mSize != mLength || header()->mStrings > mLength || header()->mStringsSize > mLength - header()->mStrings )
+		throw jerr::error( "jsnapshot : truncated or corrupt" );
+}
+
+const char *
+jsnapshot::at( uint64_t xOffset, uint64_t xBytes ) const
+{
+	if ( xOffset > mLength || xBytes > mLength - xOffset )
+		throw jerr::error( "jsnapshot : offset outside the file" );
+	return mBase + xOffset;
+}
+
+/*
+ * values
+ *
+ */
+
+bool
+jsnapshot_value::Bool() const
+{
+	return type() == JBOOL && mRecord->mPayload;
+}
+
+long long
+jsnapshot_value::Integer() const
+{
+	switch( type() )
+	{
+		case JINTEGER:
+		case JUNSIGNED: return (long long)mRecord->mPayload;
+		case JDOUBLE:   return (long long)Double();
+		case JSTRING:   return atoll( String() );
+		default:        return 0;
+	}
+}
+
+unsigned long long
+jsnapshot_value::Unsigned() const
+{
+	return type() == JUNSIGNED ? mRecord->mPayload : (type() == JSTRING ? strtoull( String(), NULL, 10 ) : (unsigned long long)Integer());
+}
+
+double
+jsnapshot_value::Double() const
+{
+	switch( type() )
+	{
+		case JDOUBLE:
+		{
+			double D;
+			memcpy( &D, &mRecord->mPayload, sizeof(D) );
+			return D;
+		}
+		case JINTEGER:  return (double)(long long)mRecord->mPayload;
+		case JUNSIGNED: return (double)mRecord->mPayload;
+		case JSTRING:   return atof( String() );
+		default:        return 0.0;
+	}
+}
+
+const char *
+jsnapshot_value::String() const
+{
+	if ( type() != JSTRING )
+		return "";
+	return mSnap->text( mRecord->mPayload, mRecord->mLength + 1 );
+}
+
+const void *
+jsnapshot_value::Binary() const
+{
+	if ( type() != JBINARY )
+		return NULL;
+	return mSnap->text( mRecord->mPayload, mRecord->mLength );
+}
+
+size_t
+jsnapshot_value::size() const
+{
+	switch( type() )
+	{
+		case JNULL:   return 0;
+		case JSTRING:
+		case JBINARY:
+		case JARRAY:
+		case JOBJECT: return mRecord->mLength;
+		default:      return 1;
+	}
+}
+
+const jsnapshot_entry *
+jsnapshot_value::entries() const
+{
+	return (const jsnapshot_entry *)mSnap->at( mRecord->mPayload, (uint64_t)mRecord->mLength * sizeof(jsnapshot_entry) );
+}
+
+const jsnapshot_entry *	// binary search over the sorted keys
+jsnapshot_value::find( const char *xKey ) const
+{
+	if ( type() != JOBJECT || !xKey )
+		return NULL;
+	const jsnapshot_entry *E = entries();
+	size_t L = strlen( xKey );
+	size_t Low = 0, High = mRecord->mLength;
+	while ( Low < High )
+	{
+		size_t Mid = Low + (High - Low) / 2;
+		size_t KL = E[Mid].mKeyLength;
+		int C = memcmp( mSnap->text( E[Mid].mKey, KL ), xKey, KL < L ? KL : L );
+		if ( C == 0 )
+			C = KL < L ? -1 : (KL > L ? 1 : 0);
+		if ( C == 0 )
+			return &E[Mid];
+		if ( C < 0 )
+			Low = Mid + 1;
+		else
+			High = Mid;
+	}
+	return NULL;
+}
+
+jsnapshot_value
+jsnapshot_value::operator[]( const char *xKey ) const
+{
+	const jsnapshot_entry *E = find( xKey );
+	return jsnapshot_value( mSnap, E ? &E->mValue : &NULL_RECORD );
+}
+
+bool
+jsnapshot_value::has( const char *xKey ) const
+{
+	return find( xKey ) != NULL;
+}
+
+jsnapshot_value
+jsnapshot_value::operator[]( size_t xIndex ) const
+{
+	if ( type() != JARRAY || xIndex >= mRecord->mLength )
+		return jsnapshot_value( mSnap, &NULL_RECORD );
+	const jsnapshot_record *R = (const jsnapshot_record *)mSnap->at( mRecord->mPayload + xIndex * sizeof(jsnapshot_record), sizeof(jsnapshot_record) );
+	return jsnapshot_value( mSnap, R );
+}
+
+const char *
+jsnapshot_value::key( size_t xIndex ) const
+{
+	if ( type() != JOBJECT || xIndex >= mRecord->mLength )
+		return NULL;
+	const jsnapshot_entry& E = entries()[xIndex];
+	return mSnap->text( E.mKey, E.mKeyLength + 1 );
+}
+
+jsnapshot_value
+jsnapshot_value::value( size_t xIndex ) const
+{
+	if ( type() != JOBJECT || xIndex >= mRecord->mLength )
+		return jsnapshot_value( mSnap, &NULL_RECORD );
+	return jsnapshot_value( mSnap, &entries()[xIndex].mValue );
+}
+
+jvalue
+jsnapshot_value::toJvalue() const
+{
+	jvalue V;
+	switch( type() )
+	{
+		case JNULL:     break;
+		case JBOOL:     V.Bool( Bool() );         break;
+		case JINTEGER:  V.Integer( Integer() );   break;
+		case JUNSIGNED: V.Unsigned( Unsigned() ); break;
+		case JDOUBLE:   V.Double( Double() );     break;
+		case JSTRING:   V.String( String(), size() ); break;
+		case JBINARY:   V.Binary( Binary(), size() ); break;
+		case JARRAY:
+		{
+			V.Array( NULL );
+			array_vector_t& A = *V.Array();
+			A.reserve( size() );
+			for ( size_t i = 0; i < size(); i++ )
+				A.push_back( (*this)[i].toJvalue() );
+			break;
+		}
+		case JOBJECT:
+		{
+			V.Object( NULL );
+			object_map_t& O = *V.Object();
+			for ( size_t i = 0; i < size(); i++ )
+				O.insert( O.end(), make_pair( string( key( i ), entries()[i].mKeyLength ), value( i ).toJvalue() ) );	// already sorted
+			break;
+		}
+		default:
+			throw jerr::error( "jsnapshot : unknown value type" );
+	}
+	return V;
+}
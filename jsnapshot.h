@@ -0,0 +1,144 @@
+
+#ifndef jsnapshotHeader
+#define jsnapshotHeader
+
+/*
+ * read-only binary snapshot of a jvalue, queried straight out of mmap
+ *
+ * write once:
+ *   jsnapshot::write( BigDocument, "reference.jvs" );
+ *
+ * then on every start (no parsing, no allocation; pages are shared by
+ * every process on the host that maps the same file):
+ *   jsnapshot S( "reference.jvs" );
+ *   jsnapshot_value R = S.root();
+ *   cout << R["users"][12]["name"].String() << endl;
+ *   jvalue Editable = R["users"][12].toJvalue();	// a mutable copy of one subtree
+ *
+ * file layout (native byte order; offsets are from the start of the file):
+ *   header   magic "JVSNAP01", byte-order mark, version, root record,
+ *            total size, string table offset and size
+ *   records  16 bytes: type, length/count, payload
+ *              payload is the value itself for scalars, a string table
+ *              offset for strings/binary, a file offset for containers
+ *   arrays   count records, contiguous
+ *   objects  count entries { key offset, key length, record }, sorted by key bytes
+ *   strings  NUL-terminated, identical strings stored once
+ *
+ * a missing key or index yields a null value rather than an error
+ *
+ */
+
+#include "jvalue.h"
+#include <stdint.h>
+
+struct jsnapshot_record
+{
+	uint32_t mType;		// jType
+	uint32_t mLength;	// string/binary bytes, array elements, object entries
+	uint64_t mPayload;
+};
+
+struct jsnapshot_entry
+{
+	uint64_t mKey;		// string table offset
+	uint32_t mKeyLength;
+	uint32_t mPad;
+	jsnapshot_record mValue;
+};
+
+class jsnapshot;
+
+class jsnapshot_value
+{
+	public:
+		jsnapshot_value( const jsnapshot *xSnap, const jsnapshot_record *xRecord ) : mSnap( xSnap ), mRecord( xRecord ) {}
+
+		jType type() const { return (jType)mRecord->mType; }
+
+		bool isNull() const     { return type() == JNULL;     }
+		bool isBool() const     { return type() == JBOOL;     }
+		bool isString() const   { return type() == JSTRING;   }
+		bool isInteger() const  { return type() == JINTEGER;  }
+		bool isDouble() const   { return type() == JDOUBLE;   }
+		bool isObject() const   { return type() == JOBJECT;   }
+		bool isArray() const    { return type() == JARRAY;    }
+		bool isUnsigned() const { return type() == JUNSIGNED; }
+		bool isBinary() const   { return type() == JBINARY;   }
+
+		bool               Bool() const;
+		long long          Integer() const;
+		unsigned long long Unsigned() const;
+		double             Double() const;
+		const char        *String() const;	// "" when not a string
+		const void        *Binary() const;	// NULL when not binary
+
+		size_t size() const;	// elements, entries, or string/binary bytes
+
+		jsnapshot_value operator[]( const char *xKey ) const;
+		jsnapshot_value operator[]( const string& xKey ) const { return operator[]( xKey.c_str() ); }
+		jsnapshot_value operator[]( size_t xIndex ) const;
+		jsnapshot_value operator[]( int xIndex ) const { return operator[]( (size_t)xIndex ); }
+		bool has( const char *xKey ) const;
+
+		// object entries by position, in key order
+		const char     *key( size_t xIndex ) const;
+		jsnapshot_value value( size_t xIndex ) const;
+
+		jvalue toJvalue() const;	// deep copy into an ordinary (mutable) jvalue
+		void print( ostream& os ) const { toJvalue().print( os ); }
+
+	private:
+		const jsnapshot *mSnap;
+		const jsnapshot_record *mRecord;
+
+		const jsnapshot_entry *entries() const;
+		const jsnapshot_entry *find( const char *xKey ) const;
+};
+
+inline ostream& operator<<( ostream& os, const jsnapshot_value& xValue )
+	{ xValue.print( os ); return os; }
+
+class jsnapshot
+{
+		jsnapshot( const jsnapshot& );            // not implemented
+		jsnapshot& operator=( const jsnapshot& ); // not implemented
+	public:
+		jsnapshot( const char *xPath );						// mmap a file written by write()
+		jsnapshot( const void *xBuffer, size_t xLength );	// use memory the caller keeps alive
+		~jsnapshot();
+
+		jsnapshot_value root() const { return jsnapshot_value( this, &header()->mRoot ); }
+		size_t bytes() const { return mLength; }
+
+		static void write( const jvalue& xValue, string& xOut );
+		static void write( const jvalue& xValue, const char *xPath );
+
+	private:
+		friend class jsnapshot_value;
+
+		struct header_t
+		{
+			char     mMagic[8];
+			uint32_t mByteOrder;
+			uint32_t mVersion;
+			jsnapshot_record mRoot;
+			uint64_t mSize;
+			uint64_t mStrings;
+			uint64_t mStringsSize;
+		};
+
+		const char *mBase;
+		size_t      mLength;
+		bool        mMapped;
+
+		const header_t *header() const { return (const header_t *)mBase; }
+		void check();
+
+		// bounds-checked access into the file
+		const char *at( uint64_t xOffset, uint64_t xBytes ) const;
+		const char *text( uint64_t xOffset, uint64_t xBytes ) const
+			{ return at( header()->mStrings + xOffset, xBytes ); }
+};
+
+#endif
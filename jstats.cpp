@@ -0,0 +1,127 @@
+
+#include "jstats.h"
+#include "mutex.h"
+#include <string.h>
+using namespace std;
+
+/*
+ * registry of per-thread counters
+ *   live threads are on a list; exited threads are folded into gRetired
+ *
+ */
+
+static mutex&
+registryLock()	// function-local so it exists before any thread_local registers
+{
+	static mutex TheLock;
+	return TheLock;
+}
+
+static jstats_local *gLive = NULL;
+static unsigned long long gRetired[JSTAT_COUNT];
+
+thread_local jstats_local tStats;
+
+jstats_local::jstats_local() : mNext(NULL), mPrev(NULL)
+{
+	for ( int i = 0; i < JSTAT_COUNT; i++ )
+		mCounter[i].store( 0, memory_order_relaxed );
+	registryLock().lock();
+	if ( (mNext = gLive) )
+		mNext->mPrev = this;
+	gLive = this;
+	registryLock().unlock();
+}
+
+jstats_local::~jstats_local()
+{
+	registryLock().lock();
+	for ( int i = 0; i < JSTAT_COUNT; i++ )
+		gRetired[i] += mCounter[i].load( memory_order_relaxed );
+	if ( mPrev )
+		mPrev->mNext = mNext;
+	else
+		gLive = mNext;
+	if ( mNext )
+		mNext->mPrev = mPrev;
+	registryLock().unlock();
+}
+
+jstats::jstats()
+{
+	memset( mCounter, 0, sizeof(mCounter) );
+}
+
+jstats
+jstats::operator-( const jstats& xOther ) const
+{
+	jstats R;
+	for ( int i = 0; i < JSTAT_COUNT; i++ )
+		R.mCounter[i] = mCounter[i] - xOther.mCounter[i];
+	return R;
+}
+
+jstats	// static
+jstats::snapshot()
+{
+	jstats R;
+	registryLock().lock();
+	for ( int i = 0; i < JSTAT_COUNT; i++ )
+		R.mCounter[i] = gRetired[i];
+	for ( jstats_local *L = gLive; L; L = L->mNext )
+		for ( int i = 0; i < JSTAT_COUNT; i++ )
+			R.mCounter[i] += L->mCounter[i].load( memory_order_relaxed );
+	registryLock().unlock();
+	return R;
+}
+
+void	// static
+jstats::reset()
+{
+	registryLock().lock();
+	memset( gRetired, 0, sizeof(gRetired) );
+	for ( jstats_local *L = gLive; L; L = L->mNext )
+		for ( int i = 0; i < JSTAT_COUNT; i++ )
+			L->mCounter[i].store( 0, memory_order_relaxed );
+	registryLock().unlock();
+}
+
+bool	// static
+jstats::enabled()
+{
+#ifdef JVALUE_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *	// static
+jstats::name( jstat_t xWhich )
+{
+	switch( xWhich )
+	{
+		case JSTAT_NODES_CREATED:   return "nodes_created";
+		case JSTAT_NODES_DESTROYED: return "nodes_destroyed";
+		case JSTAT_STRINGS:         return "strings";
+		case JSTAT_STRING_BYTES:    return "string_bytes";
+		case JSTAT_CONTAINERS:      return "containers";
+		case JSTAT_MAP_NODES:       return "map_nodes";
+		case JSTAT_BYTES_ALLOCATED: return "bytes_allocated";
+		case JSTAT_LOCKS:           return "locks";
+		case JSTAT_LOCKS_CONTENDED: return "locks_contended";
+		case JSTAT_PARSE_BYTES:     return "parse_bytes";
+		case JSTAT_PRINT_BYTES:     return "print_bytes";
+		case JSTAT_COUNT:           break;
+	}
+	return "unknown";
+}
+
+void
+jstats::print( ostream& os ) const
+{
+	os << "{\"enabled\":" << (enabled() ? "true" : "false");
+	for ( int i = 0; i < JSTAT_COUNT; i++ )
+		os << ",\"" << name( (jstat_t)i ) << "\":" << mCounter[i];
+	os << "}";
+}
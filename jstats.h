@@ -0,0 +1,154 @@
+
+#ifndef jstatsHeader
+#define jstatsHeader
+
+/*
+ * optional allocation and lock counters for jvalue
+ *
+ * compile everything with -DJVALUE_STATS to turn them on;
+ * without it the JSTAT() hooks compile away and snapshot() returns zeros
+ *
+ * counters are kept per thread, so the hot path never shares a cache line,
+ * and are summed over all threads (live and exited) when snapshot() is called
+ *
+ * use:
+ *   jstats Before = jstats::snapshot();
+ *   ... handle a request ...
+ *   jstats Used = jstats::snapshot() - Before;
+ *   cout << Used << endl;	// {"nodes_created":12, ... }
+ *   Used[JSTAT_LOCKS]		// just one counter
+ *
+ */
+
+#include <atomic>
+#include <iostream>
+#include <streambuf>
+
+enum jstat_t
+{
+	JSTAT_NODES_CREATED,	// private_jvalue_data constructed
+	JSTAT_NODES_DESTROYED,	// private_jvalue_data destroyed
+	JSTAT_STRINGS,			// string values copied (scopy)
+	JSTAT_STRING_BYTES,		// bytes in those strings, including the terminator
+	JSTAT_CONTAINERS,		// object maps and array vectors created
+	JSTAT_MAP_NODES,		// entries inserted into object maps
+	JSTAT_BYTES_ALLOCATED,	// nodes + strings + containers + map entries + array growth
+	JSTAT_LOCKS,			// acquisitions of mLockData
+	JSTAT_LOCKS_CONTENDED,	// ... that had to wait for another thread
+	JSTAT_PARSE_BYTES,		// characters consumed by jvalue::parse
+	JSTAT_PRINT_BYTES,		// characters produced by jvalue::print
+	JSTAT_COUNT
+};
+
+class jstats
+{
+	public:
+		jstats();
+
+		unsigned long long operator[]( jstat_t xWhich ) const { return mCounter[xWhich]; }
+		jstats operator-( const jstats& xOther ) const;
+
+		static jstats snapshot();	// sum over all threads
+		static void reset();		// zero all threads
+		static bool enabled();		// compiled with JVALUE_STATS?
+		static const char *name( jstat_t xWhich );
+
+		void print( std::ostream& ) const;	// as a json object
+
+		static inline void count( jstat_t xWhich, unsigned long long xCount );
+
+	private:
+		unsigned long long mCounter[JSTAT_COUNT];
+};
+
+inline std::ostream& operator<<( std::ostream& os, const jstats& xStats )
+	{ xStats.print( os ); return os; }
+
+/*
+ * one of these per thread
+ *   only the owning thread writes, so an increment is a relaxed load + store
+ *
+ */
+
+class jstats_local
+{
+		jstats_local( const jstats_local& );            // not implemented
+		jstats_local& operator=( const jstats_local& ); // not implemented
+	public:
+		jstats_local();		// registers with the list of live threads
+		~jstats_local();	// folds the counts into the retired totals
+
+		void add( jstat_t xWhich, unsigned long long xCount )
+			{ mCounter[xWhich].store( mCounter[xWhich].load( std::memory_order_relaxed ) + xCount, std::memory_order_relaxed ); }
+
+		std::atomic<unsigned long long> mCounter[JSTAT_COUNT];
+		jstats_local *mNext;
+		jstats_local *mPrev;
+};
+
+extern thread_local jstats_local tStats;
+
+inline void	// static
+jstats::count( jstat_t xWhich, unsigned long long xCount )
+	{ tStats.add( xWhich, xCount ); }
+
+/*
+ * counts node construction/destruction when embedded in private_jvalue_data
+ *   defined in jvalue.cpp, where sizeof(private_jvalue_data) is known
+ *
+ */
+
+class jstats_node
+{
+	public:
+		jstats_node();
+		jstats_node( const jstats_node& );
+		~jstats_node();
+		jstats_node& operator=( const jstats_node& ) { return *this; }
+};
+
+/*
+ * stream filters used to count parse/print bytes at the outermost call
+ *
+ */
+
+class jstats_inbuf : public std::streambuf
+{
+	public:
+		jstats_inbuf( std::streambuf *xSource ) : mSource( xSource ), mCount( 0 ) {}
+		~jstats_inbuf() { jstats::count( JSTAT_PARSE_BYTES, mCount ); }
+	protected:
+		int_type underflow()               { return mSource->sgetc(); }
+		int_type uflow()                   { int_type C = mSource->sbumpc(); if ( C != traits_type::eof() ) mCount++; return C; }
+		int_type pbackfail( int_type xC )  { mCount--; return xC == traits_type::eof() ? mSource->sungetc() : mSource->sputbackc( traits_type::to_char_type( xC ) ); }
+		std::streamsize showmanyc()        { return mSource->in_avail(); }
+		std::streamsize xsgetn( char *xOut, std::streamsize xCount )
+			{ std::streamsize N = mSource->sgetn( xOut, xCount ); mCount += N; return N; }
+	private:
+		std::streambuf *mSource;
+		unsigned long long mCount;
+};
+
+class jstats_outbuf : public std::streambuf
+{
+	public:
+		jstats_outbuf( std::streambuf *xDest ) : mDest( xDest ), mCount( 0 ) {}
+		~jstats_outbuf() { jstats::count( JSTAT_PRINT_BYTES, mCount ); }
+	protected:
+		int_type overflow( int_type xC )
+			{ if ( xC == traits_type::eof() ) return traits_type::not_eof( xC ); mCount++; return mDest->sputc( traits_type::to_char_type( xC ) ); }
+		std::streamsize xsputn( const char *xIn, std::streamsize xCount )
+			{ std::streamsize N = mDest->sputn( xIn, xCount ); mCount += N; return N; }
+		int sync() { return mDest->pubsync(); }
+	private:
+		std::streambuf *mDest;
+		unsigned long long mCount;
+};
+
+#ifdef JVALUE_STATS
+	#define JSTAT( xWhich, xCount ) jstats::count( (xWhich), (xCount) )
+#else
+	#define JSTAT( xWhich, xCount ) ((void)sizeof( (xCount) ))
+#endif
+
+#endif
@@ -0,0 +1,526 @@
+
+#include "jtape.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+using namespace std;
+
+enum { MAX_DEPTH = 4096 };	// nesting limit; the parser recurses per level
+
+enum
+{
+	COUNT_SHIFT = 32,
+	COUNT_MAX   = 0xFFFFFF,	// element counts at or above this are found by walking
+	INDEX_MAX   = 0xFFFFFFFF
+};
+
+static jerr *	// a message made up on the spot; held per thread until its next one
+error( const char *xFormat, ... )
+{
+	static thread_local char Message[128];
+	va_list Args;
+	va_start( Args, xFormat );
+	vsnprintf( Message, sizeof(Message), xFormat, Args );
+	va_end( Args );
+	return jerr::error( Message );
+}
+
+static inline uint64_t
+tag( char xTag, uint64_t xPayload )
+{
+	return ((uint64_t)(unsigned char)xTag << 56) | xPayload;
+}
+
+static inline char
+tagOf( uint64_t xEntry )
+{
+	return (char)(xEntry >> 56);
+}
+
+static inline uint64_t
+payloadOf( uint64_t xEntry )
+{
+	return xEntry & 0x00FFFFFFFFFFFFFFULL;
+}
+
+/*
+ * the parser
+ *   same grammar as private_jvalue_data::parse, over a buffer instead of an istream
+ *
+ */
+
+class tapeParser
+{
+	public:
+		tapeParser( jtape& xDoc, const char *xText, size_t xLength )
+			: mTape( xDoc.mTape ), mStrings( xDoc.mStrings ), mStart( xText ), mPos( xText ), mEnd( xText + xLength ), mDepth( 0 ) {}
+
+		int  space()	// skip white space; next character or EOF
+			{
+				while ( mPos < mEnd && isspace( (unsigned char)*mPos ) )
+					mPos++;
+				return mPos < mEnd ? (unsigned char)*mPos : EOF;
+			}
+		void value();
+		size_t used() const { return mPos - mStart; }
+
+	private:
+		vector<uint64_t>& mTape;
+		string&           mStrings;
+		const char       *mStart;
+		const char       *mPos;
+		const char       *mEnd;
+		unsigned int      mDepth;
+
+		void number();
+		void quoted( const char *xWhere );
+		void literal( const char *xWord, size_t xLength, char xTag, const char *xError );
+		void container( char xOpen, char xClose );
+};
+
+void
+tapeParser::value()
+{
+	int C = space();
+	if ( isdigit( C ) || C == '.' || C == '-' ) return number();
+	if ( C == '"' ) return quoted( "jtape::parse : found EOF inside string" );
+	if ( C == '{' ) return container( '{', '}' );
+	if ( C == '[' ) return container( '[', ']' );
+	if ( C == 'N' || C == 'n' ) return literal( "null", 4, 'n', "jtape::parse : string is not 'null'" );
+	if ( C == 'T' || C == 't' ) return literal( "true", 4, 't', "jtape::parse : string is not 'true'" );
+	if ( C == 'F' || C == 'f' ) return literal( "false", 5, 'f', "jtape::parse : string is not 'false'" );
+	if ( C == EOF )
+		throw jerr::error( "jtape::parse : missing value" );
+	throw error( "could not determine json type from leading character: %c<%02x>", C, C );
+}
+
+void
+tapeParser::literal( const char *xWord, size_t xLength, char xTag, const char *xError )
+{
+	if ( (size_t)(mEnd - mPos) < xLength || strncasecmp( xWord, mPos, xLength ) != 0 )
+		throw jerr::error( xError );
+	mPos += xLength;
+	mTape.push_back( tag( xTag, 0 ) );
+}
+
+void
+tapeParser::number()
+{
+	const char *Start = mPos;
+	bool period = false;
+	bool exponent = false;
+
+	if ( *mPos == '-' )
+		mPos++;
+	while ( mPos < mEnd )
+	{
+		char C = *mPos;
+		if ( isdigit( (unsigned char)C ) )
+			mPos++;
+		else if ( C == '.' && !period )
+		{
+			period = true;
+			mPos++;
+		}
+		else if ( (C == 'e' || C == 'E') && !exponent )
+		{
+			mPos++;
+			if ( mPos < mEnd && (*mPos == '-' || *mPos == '+') )
+				mPos++;
+			if ( mPos >= mEnd || !isdigit( (unsigned char)*mPos ) )
+				throw jerr::error( "jtape::parse : bad exponential format" );
+			exponent = true;
+		}
+		else
+			break;
+	}
+
+	size_t L = mPos - Start;
+	bool Negative = *Start == '-';
+	if ( !period && !exponent && L < 19 )	// fits in a long long: no conversion call
+	{
+		long long I = 0;
+		for ( const char *P = Start + Negative; P < mPos; P++ )
+			I = I * 10 + (*P - '0');
+		mTape.push_back( tag( 'l', 0 ) );
+		mTape.push_back( (uint64_t)(Negative ? -I : I) );
+		return;
+	}
+
+	char Small[64];	// the conversions need a terminated copy
+	string Large;
+	const char *Text = Small;
+	if ( L < sizeof(Small) )
+	{
+		memcpy( Small, Start, L );
+		Small[L] = '\0';
+	}
+	else
+	{
+		Large.assign( Start, L );
+		Text = Large.c_str();
+	}
+	if ( period | exponent )
+	{
+		double D = atof( Text );
+		uint64_t Bits;
+		memcpy( &Bits, &D, sizeof(Bits) );
+		mTape.push_back( tag( 'd', 0 ) );
+		mTape.push_back( Bits );
+	}
+	else if ( !Negative )	// may not fit in a long long
+	{
+		unsigned long long U = strtoull( Text, NULL, 10 );
+		mTape.push_back( tag( U > LLONG_MAX ? 'u' : 'l', 0 ) );
+		mTape.push_back( U );
+	}
+	else
+	{
+		mTape.push_back( tag( 'l', 0 ) );
+		mTape.push_back( (uint64_t)atoll( Text ) );
+	}
+}
+
+void	// appends { length, bytes, NUL } to the string buffer and its entry to the tape
+tapeParser::quoted( const char *xWhere )
+{
+	mPos++;	// the opening quote
+	size_t At = mStrings.size();
+	uint32_t Length = 0;
+	mStrings.append( (const char *)&Length, sizeof(Length) );
+	for ( ;; )
+	{
+		const char *Run = mPos;	// copy plain runs in one go
+		while ( mPos < mEnd && *mPos != '"' && *mPos != '\\' )
+			mPos++;
+		mStrings.append( Run, mPos - Run );
+		if ( mPos >= mEnd )
+			throw jerr::error( xWhere );
+		if ( *mPos++ == '"' )
+			break;
+		if ( mPos >= mEnd )
+			throw jerr::error( xWhere );
+		char C = *mPos++;
+		switch( C )
+		{
+			case 'b': mStrings += '\b'; break;
+			case 'f': mStrings += '\f'; break;
+			case 'n': mStrings += '\n'; break;
+			case 'r': mStrings += '\r'; break;
+			case 't': mStrings += '\t'; break;
+			case 'u':
+				if ( !(mPos = jutf8::escape( mPos, mEnd, mStrings )) )
+					throw jerr::error( "bad hex character" );
+				break;
+			default:  mStrings += C;    break;
+		}
+	}
+	size_t L = mStrings.size() - At - sizeof(Length);
+	if ( L > INDEX_MAX )
+		throw jerr::error( "jtape::parse : string too long" );
+	Length = L;
+	memcpy( &mStrings[At], &Length, sizeof(Length) );
+	mStrings += '\0';
+	mTape.push_back( tag( '"', At ) );
+}
+
+void
+tapeParser::container( char xOpen, char xClose )
+{
+	if ( ++mDepth > MAX_DEPTH )
+		throw jerr::error( "jtape::parse : nesting too deep" );
+	mPos++;	// the opening bracket
+	size_t Open = mTape.size();
+	mTape.push_back( 0 );	// filled in below
+	size_t Count = 0;
+	bool Object = xOpen == '{';
+
+	if ( space() == xClose )
+		mPos++;
+	else for ( ;; )
+	{
+		if ( Object )
+		{
+			if ( space() != '"' )
+				throw jerr::error( "jtape::parse : bad pair in object" );
+			quoted( "jtape::parse : found EOF inside string" );
+			if ( space() != ':' )
+				throw jerr::error( "jtape::parse : bad pair in object" );
+			mPos++;
+		}
+		value();
+		Count++;
+		int C = space();
+		if ( C == EOF )
+			throw jerr::error( Object ? "jtape::parse : missing comma" : "jtape::parse : missing comma between values" );
+		mPos++;
+		if ( C == xClose )
+			break;
+		if ( C != ',' )
+			throw jerr::error( Object ? "jtape::parse : missing comma" : "jtape::parse : missing comma between values" );
+	}
+
+	size_t Close = mTape.size();
+	if ( Close > INDEX_MAX )
+		throw jerr::error( "jtape::parse : document too large" );
+	mTape.push_back( tag( xClose, Open ) );
+	mTape[Open] = tag( xOpen, ((uint64_t)(Count < COUNT_MAX ? Count : COUNT_MAX) << COUNT_SHIFT) | Close );
+	mDepth--;
+}
+
+bool
+jtape::parse( const char *xText, size_t xLength, size_t *xUsed )
+{
+	mTape.clear();		// keeps the capacity from the last parse
+	mStrings.clear();
+	tapeParser P( *this, xText, xLength );
+	bool Found = P.space() != EOF;
+	if ( Found )
+		P.value();
+	else
+		mTape.push_back( tag( 'n', 0 ) );
+	if ( xUsed )
+		*xUsed = P.used();
+	return Found;
+}
+
+/*
+ * values
+ *
+ */
+
+uint64_t
+jtape_value::entry() const
+{
+	return mDoc->mTape[mIndex];
+}
+
+uint64_t
+jtape_value::raw() const
+{
+	return mDoc->mTape[mIndex + 1];
+}
+
+size_t
+jtape_value::next() const
+{
+	uint64_t E = entry();
+	switch( tagOf( E ) )
+	{
+		case '{':
+		case '[': return (E & INDEX_MAX) + 1;
+		case 'l':
+		case 'u':
+		case 'd': return mIndex + 2;
+		default:  return mIndex + 1;
+	}
+}
+
+jType
+jtape_value::type() const
+{
+	switch( tagOf( entry() ) )
+	{
+		case 't':
+		case 'f': return JBOOL;
+		case '"': return JSTRING;
+		case 'l': return JINTEGER;
+		case 'u': return JUNSIGNED;
+		case 'd': return JDOUBLE;
+		case '{': return JOBJECT;
+		case '[': return JARRAY;
+		default:  return JNULL;
+	}
+}
+
+bool
+jtape_value::Bool() const
+{
+	return tagOf( entry() ) == 't';
+}
+
+long long
+jtape_value::Integer() const
+{
+	switch( tagOf( entry() ) )
+	{
+		case 'l':
+		case 'u': return (long long)raw();
+		case 'd': return (long long)Double();
+		case '"': return atoll( String() );
+		default:  return 0;
+	}
+}
+
+unsigned long long
+jtape_value::Unsigned() const
+{
+	char T = tagOf( entry() );
+	return T == 'u' ? raw() : (T == '"' ? strtoull( String(), NULL, 10 ) : (unsigned long long)Integer());
+}
+
+double
+jtape_value::Double() const
+{
+	switch( tagOf( entry() ) )
+	{
+		case 'd':
+		{
+			uint64_t Bits = raw();
+			double D;
+			memcpy( &D, &Bits, sizeof(D) );
+			return D;
+		}
+		case 'l': return (double)(long long)raw();
+		case 'u': return (double)raw();
+		case '"': return atof( String() );
+		default:  return 0.0;
+	}
+}
+
+const char *
+jtape_value::String() const
+{
+	uint64_t E = entry();
+	if ( tagOf( E ) != '"' )
+		return "";
+	return mDoc->mStrings.data() + payloadOf( E ) + sizeof(uint32_t);
+}
+
+size_t
+jtape_value::size() const
+{
+	uint64_t E = entry();
+	switch( tagOf( E ) )
+	{
+		case 'n': return 0;
+		case '"':
+		{
+			uint32_t L;
+			memcpy( &L, mDoc->mStrings.data() + payloadOf( E ), sizeof(L) );
+			return L;
+		}
+		case '{':
+		case '[':
+		{
+			size_t N = (E >> COUNT_SHIFT) & COUNT_MAX;
+			if ( N < COUNT_MAX )
+				return N;
+			N = 0;	// saturated: count them
+			for ( jtape_iterator IT = begin(); IT != end(); ++IT )
+				N++;
+			return N;
+		}
+		default:  return 1;
+	}
+}
+
+jtape_iterator
+jtape_value::begin() const
+{
+	char T = tagOf( entry() );
+	if ( T != '{' && T != '[' )
+		return end();
+	return jtape_iterator( mDoc, mIndex + 1, T == '{' );
+}
+
+jtape_iterator
+jtape_value::end() const
+{
+	uint64_t E = entry();
+	char T = tagOf( E );
+	return jtape_iterator( mDoc, (T == '{' || T == '[') ? (size_t)(E & INDEX_MAX) : next(), T == '{' );
+}
+
+const char *
+jtape_iterator::key() const
+{
+	return mObject ? jtape_value( mDoc, mIndex ).String() : NULL;
+}
+
+size_t
+jtape_iterator::keySize() const
+{
+	return mObject ? jtape_value( mDoc, mIndex ).size() : 0;
+}
+
+static const jtape&
+nullDoc()	// missing keys and indexes point here
+{
+	static jtape Null;
+	static bool Ready = Null.parse( "null", 4 );
+	(void)Ready;
+	return Null;
+}
+
+jtape_value
+jtape_value::operator[]( const char *xKey ) const
+{
+	if ( tagOf( entry() ) == '{' && xKey )
+	{
+		size_t L = strlen( xKey );
+		for ( jtape_iterator IT = begin(); IT != end(); ++IT )
+		{
+			jtape_value K( mDoc, IT.mIndex );
+			if ( K.size() == L && memcmp( K.String(), xKey, L ) == 0 )
+				return IT.value();
+		}
+	}
+	return nullDoc().root();
+}
+
+bool
+jtape_value::has( const char *xKey ) const
+{
+	return tagOf( entry() ) == '{' && (*this)[xKey].mDoc == mDoc;
+}
+
+jtape_value
+jtape_value::operator[]( size_t xIndex ) const
+{
+	if ( tagOf( entry() ) == '[' )
+	{
+		jtape_iterator IT = begin();
+		for ( jtape_iterator End = end(); IT != End && xIndex > 0; ++IT )
+			xIndex--;
+		if ( IT != end() )
+			return IT.value();
+	}
+	return nullDoc().root();
+}
+
+jvalue
+jtape_value::toJvalue() const
+{
+	jvalue V;
+	switch( tagOf( entry() ) )
+	{
+		case 't': V.Bool( true );         break;
+		case 'f': V.Bool( false );        break;
+		case 'l': V.Integer( Integer() ); break;
+		case 'u': V.Unsigned( Unsigned() ); break;
+		case 'd': V.Double( Double() );   break;
+		case '"': V.String( String(), size() ); break;
+		case '[':
+		{
+			V.Array( NULL );
+			array_vector_t& A = *V.Array();
+			A.reserve( size() );
+			for ( jtape_iterator IT = begin(); IT != end(); ++IT )
+				A.push_back( IT.value().toJvalue() );
+			break;
+		}
+		case '{':
+		{
+			V.Object( NULL );
+			object_map_t& O = *V.Object();
+			for ( jtape_iterator IT = begin(); IT != end(); ++IT )
+				O[string( IT.key(), IT.keySize() )] = IT.value().toJvalue();	// a later duplicate replaces, as in jvalue::parse
+			break;
+		}
+		default:
+			break;
+	}
+	return V;
+}
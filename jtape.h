@@ -0,0 +1,141 @@
+
+#ifndef jtapeHeader
+#define jtapeHeader
+
+/*
+ * read-only json document stored as one flat tape
+ *
+ * a parsed jtape is two buffers: a vector of 64-bit tape entries and one
+ * string buffer.  no per-value allocation, no shared_ptr, no mutex -- for
+ * documents that are parsed, read, and thrown away (or parsed again into
+ * the same jtape, which reuses both buffers).
+ *
+ *   jtape T;
+ *   T.parse( Text );
+ *   jtape_value R = T.root();
+ *   cout << R["user"]["name"].String() << endl;
+ *   for ( jtape_iterator IT = R["tags"].begin(); IT != R["tags"].end(); ++IT )
+ *       cout << (*IT).String() << endl;
+ *   jvalue Editable = R["user"].toJvalue();	// mutable copy of one subtree
+ *
+ * tape entries: top 8 bits tag, low 56 bits payload
+ *   '{' '['   index of the matching close entry (low 32 bits), element count (next 24, saturating)
+ *   '}' ']'   index of the matching open entry
+ *   '"'       offset in the string buffer of { uint32 length, bytes, NUL }
+ *   'l' 'u' 'd'  integer / unsigned / double; the raw 64 bits follow in the next entry
+ *   't' 'f' 'n'  true / false / null
+ * objects alternate key ('"') and value; keys keep document order and
+ * duplicates are kept (lookup finds the first, toJvalue() keeps the last)
+ *
+ * jtape_value and jtape_iterator point into their jtape: they are valid
+ * until that jtape is parsed again or destroyed
+ *
+ * the grammar accepted is the same as jvalue::parse, and \u escapes decode the
+ * same way (jutf8); errors throw jerr::error
+ *
+ */
+
+#include "jvalue.h"
+#include <stdint.h>
+#include <vector>
+
+class jtape;
+class jtape_iterator;
+
+class jtape_value
+{
+	public:
+		jtape_value( const jtape *xDoc, size_t xIndex ) : mDoc( xDoc ), mIndex( xIndex ) {}
+
+		jType type() const;
+
+		bool isNull() const     { return type() == JNULL;     }
+		bool isBool() const     { return type() == JBOOL;     }
+		bool isString() const   { return type() == JSTRING;   }
+		bool isInteger() const  { return type() == JINTEGER;  }
+		bool isDouble() const   { return type() == JDOUBLE;   }
+		bool isObject() const   { return type() == JOBJECT;   }
+		bool isArray() const    { return type() == JARRAY;    }
+		bool isUnsigned() const { return type() == JUNSIGNED; }
+
+		bool               Bool() const;
+		long long          Integer() const;
+		unsigned long long Unsigned() const;
+		double             Double() const;
+		const char        *String() const;	// "" when not a string
+		size_t             size() const;	// elements, entries, or string bytes (strings may hold \u0000); 0 for null
+
+		// lookups walk the container: O(size)
+		jtape_value operator[]( const char *xKey ) const;	// null when missing
+		jtape_value operator[]( const string& xKey ) const { return operator[]( xKey.c_str() ); }
+		jtape_value operator[]( size_t xIndex ) const;		// null when out of range
+		jtape_value operator[]( int xIndex ) const { return operator[]( (size_t)xIndex ); }
+		bool has( const char *xKey ) const;
+
+		jtape_iterator begin() const;	// elements of an array, entries of an object
+		jtape_iterator end() const;
+
+		jvalue toJvalue() const;	// deep copy into an ordinary (mutable) jvalue
+		void print( ostream& os ) const { toJvalue().print( os ); }
+
+	private:
+		friend class jtape_iterator;
+
+		const jtape *mDoc;
+		size_t       mIndex;
+
+		uint64_t entry() const;
+		uint64_t raw() const;	// the word after a number entry
+		size_t   next() const;	// index of the following sibling
+};
+
+inline ostream& operator<<( ostream& os, const jtape_value& xValue )
+	{ xValue.print( os ); return os; }
+
+class jtape_iterator
+{
+	public:
+		jtape_iterator( const jtape *xDoc, size_t xIndex, bool xObject ) : mDoc( xDoc ), mIndex( xIndex ), mObject( xObject ) {}
+
+		jtape_value operator*() const { return value(); }
+		jtape_value value() const { return jtape_value( mDoc, mObject ? mIndex + 1 : mIndex ); }
+		const char *key() const;	// NULL for array elements
+		size_t keySize() const;		// bytes in key(), which may hold \u0000; 0 for array elements
+
+		jtape_iterator& operator++() { mIndex = value().next(); return *this; }
+		bool operator==( const jtape_iterator& x ) const { return mIndex == x.mIndex; }
+		bool operator!=( const jtape_iterator& x ) const { return mIndex != x.mIndex; }
+
+	private:
+		friend class jtape_value;
+
+		const jtape *mDoc;
+		size_t       mIndex;
+		bool         mObject;
+};
+
+class jtape
+{
+	public:
+		jtape() {}
+
+		// parse one value; false (and a null root) if the text holds only white space
+		// xUsed (if given) receives the number of bytes consumed
+		bool parse( const char *xText, size_t xLength, size_t *xUsed = NULL );
+		bool parse( const string& xText, size_t *xUsed = NULL ) { return parse( xText.data(), xText.size(), xUsed ); }
+
+		jtape_value root() const { return jtape_value( this, 0 ); }
+
+		size_t tapeSize() const { return mTape.size(); }		// entries
+		size_t stringBytes() const { return mStrings.size(); }
+
+	private:
+		friend class jtape_value;
+		friend class jtape_iterator;
+		friend class tapeParser;
+
+		vector<uint64_t> mTape;
+		string           mStrings;
+};
+
+#endif
@@ -1,13 +1,42 @@
 
 #include "jvalue.h"
-#include "crbncpy.h"
+#include <math.h>
+#include <algorithm>
 #include <set>
+#include <sstream>
+#include <unordered_map>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
+#define MAP_NODE_BYTES (sizeof(object_map_t::value_type) + 4 * sizeof(void *))	// entry + red/black tree links
+#define CONTROL_BLOCK_BYTES (2 * sizeof(void *) + 2 * sizeof(int))	// shared_ptr's: vtable, pointer, use and weak counts
+#define NODE_BYTES (sizeof(private_jvalue_data) + CONTROL_BLOCK_BYTES)
+
+#ifdef JVALUE_STATS
+jstats_node::jstats_node()
+{
+	JSTAT( JSTAT_NODES_CREATED, 1 );
+	JSTAT( JSTAT_BYTES_ALLOCATED, sizeof(private_jvalue_data) );
+}
+
+jstats_node::jstats_node( const jstats_node& )
+{
+	JSTAT( JSTAT_NODES_CREATED, 1 );
+	JSTAT( JSTAT_BYTES_ALLOCATED, sizeof(private_jvalue_data) );
+}
+
+jstats_node::~jstats_node()
+{
+	JSTAT( JSTAT_NODES_DESTROYED, 1 );
+}
+#endif
+
 jerr *
 jerr::error( const char *xMsg )
 {
-	static jerr TheOne;
+	static thread_local jerr TheOne;	// one per thread: a throw here cannot change what another is catching
 	TheOne.mMsg = xMsg;
 	return &TheOne;
 }
@@ -28,13 +57,19 @@ private_jvalue_data::operator=( const private_jvalue_data& xData )
 			mValue.mDouble = xData.mValue.mDouble;
 			break;
 		case JSTRING:
-			mValue.mString = scopy( xData.mValue.mString );
+			setStringNL( xData.stringNL(), xData.mLength );
 			break;
 		case JOBJECT:
-			mValue.mObject = new object_map_t( *xData.mValue.mObject );
+			mValue.mObject = newObject( xData.mValue.mObject );
 			break;
 		case JARRAY:
-			mValue.mArray = new array_vector_t( *xData.mValue.mArray );
+			mValue.mArray = newArray( xData.mValue.mArray );
+			break;
+		case JUNSIGNED:
+			mValue.mUnsigned = xData.mValue.mUnsigned;
+			break;
+		case JBINARY:
+			mValue.mBinary = new binary_t( *xData.mValue.mBinary );
 			break;
 		case JNULL:
 		case JBAD:
@@ -45,43 +80,71 @@ private_jvalue_data::operator=( const private_jvalue_data& xData )
 	return *this;
 }
 
+void
+private_jvalue_data::push_back( const string& xValue )
+{
+	append( jvalue( xValue ) );
+}
+
 void
 private_jvalue_data::push_back( const char *xValue )
 {
-	toJARRAY();										// if not already an array, make it so
-	mValue.mArray->push_back( jvalue( xValue ) );	// push a jvalue string onto the array
-	unlock();
+	append( jvalue( xValue ) );	// push a jvalue string onto the array
 }
 
 void
 private_jvalue_data::push_back( long long xValue )
 {
-	toJARRAY();
-	mValue.mArray->push_back( jvalue( xValue ) );
-	unlock();
+	append( jvalue( xValue ) );
 }
 
 void
 private_jvalue_data::push_back( double xValue )
 {
-	toJARRAY();
-	mValue.mArray->push_back( jvalue( xValue ) );
-	unlock();
+	append( jvalue( xValue ) );
 }
 
 void
 private_jvalue_data::push_back( bool xValue )
 {
-	toJARRAY();
-	mValue.mArray->push_back( jvalue( xValue ) );
-	unlock();
+	append( jvalue( xValue ) );
 }
 
 void
-private_jvalue_data::push_back( jvalue& xValue )
+private_jvalue_data::push_back( unsigned long long xValue )
 {
-	toJARRAY();
+	append( jvalue( xValue ) );
+}
+
+void
+private_jvalue_data::push_back( const jvalue& xValue )
+{
+	append( xValue );
+}
+
+void
+private_jvalue_data::push_back( jvalue&& xValue )
+{
+	append( std::move( xValue ) );
+}
+
+void	// private
+private_jvalue_data::append( const jvalue& xValue )
+{
+	toJARRAY();										// if not already an array, make it so
+	size_t Capacity = mValue.mArray->capacity();
 	mValue.mArray->push_back( xValue );
+	JSTAT( JSTAT_BYTES_ALLOCATED, (mValue.mArray->capacity() - Capacity) * sizeof(jvalue) );
+	unlock();
+}
+
+void	// private
+private_jvalue_data::append( jvalue&& xValue )
+{
+	toJARRAY();
+	size_t Capacity = mValue.mArray->capacity();
+	mValue.mArray->push_back( std::move( xValue ) );
+	JSTAT( JSTAT_BYTES_ALLOCATED, (mValue.mArray->capacity() - Capacity) * sizeof(jvalue) );
 	unlock();
 }
 
@@ -89,8 +152,10 @@ jvalue&
 private_jvalue_data::operator[]( size_t xPos )
 {
 	toJARRAY();								// convert to an array if not already one
+	size_t Capacity = mValue.mArray->capacity();
 	while ( xPos >= mValue.mArray->size() )		// if array not large enough
 		mValue.mArray->push_back( jvalue() );	//   push NULL's so access is always valid
+	JSTAT( JSTAT_BYTES_ALLOCATED, (mValue.mArray->capacity() - Capacity) * sizeof(jvalue) );
 	jvalue& Q = (*mValue.mArray)[xPos];				// return reference to appropriate location
 	unlock();
 	return Q;
@@ -102,38 +167,96 @@ private_jvalue_data::operator[]( const char *xName )
 	if ( !xName )
 		throw jerr::error( "missing object-element identifier" );
 	lock(__LINE__);
+	changedNL();
 	if ( mType != JOBJECT )		// convert to object if not already one
 	{
 		deleteValueNL();
 		mType = JOBJECT;
-		mValue.mObject = new object_map_t;
+		mValue.mObject = newObject();
 	}
+	size_t Before = mValue.mObject->size();
 	jvalue& Q = (*mValue.mObject)[xName];	// return reference to appropriate location (create if not there)
+	JSTAT( JSTAT_MAP_NODES, mValue.mObject->size() - Before );
+	JSTAT( JSTAT_BYTES_ALLOCATED, (mValue.mObject->size() - Before) * MAP_NODE_BYTES );
+	unlock();
+	return Q;
+}
+
+jvalue&
+private_jvalue_data::operator[]( string&& xName )
+{
+	lock(__LINE__);
+	changedNL();
+	if ( mType != JOBJECT )		// convert to object if not already one
+	{
+		deleteValueNL();
+		mType = JOBJECT;
+		mValue.mObject = newObject();
+	}
+	size_t Before = mValue.mObject->size();
+	jvalue& Q = (*mValue.mObject)[std::move( xName )];	// a new key keeps xName's buffer
+	JSTAT( JSTAT_MAP_NODES, mValue.mObject->size() - Before );
+	JSTAT( JSTAT_BYTES_ALLOCATED, (mValue.mObject->size() - Before) * MAP_NODE_BYTES );
 	unlock();
 	return Q;
 }
 
+void
+private_jvalue_data::insert( string&& xName, jvalue&& xValue )	// unlike operator[], no placeholder value is built
+{
+	lock(__LINE__);
+	changedNL();
+	if ( mType != JOBJECT )
+	{
+		deleteValueNL();
+		mType = JOBJECT;
+		mValue.mObject = newObject();
+	}
+	object_map_t::iterator IT = mValue.mObject->lower_bound( xName );
+	if ( IT != mValue.mObject->end() && IT->first == xName )
+		IT->second = std::move( xValue );
+	else
+	{
+		mValue.mObject->emplace_hint( IT, std::move( xName ), std::move( xValue ) );
+		JSTAT( JSTAT_MAP_NODES, 1 );
+		JSTAT( JSTAT_BYTES_ALLOCATED, MAP_NODE_BYTES );
+	}
+	unlock();
+}
+
+void
+private_jvalue_data::insert( const string& xName, const jvalue& xValue )
+{
+	insert( string( xName ), jvalue( xValue ) );
+}
+
 void
 private_jvalue_data::deleteValueNL()	// private function to delete data in union if necessary
 {
+	changedNL();
 	switch( mType )		// special case for strings, objects, arrays
 	{
-		case JSTRING: delete[] mValue.mString; break;
+		case JSTRING: if ( mLength >= INLINE_STRING ) sfree( mValue.mString ); break;
 		case JOBJECT: delete mValue.mObject; break;	// will potentially be recursive
 		case JARRAY:  delete mValue.mArray;  break;	// will potentially be recursive
+		case JBINARY: delete mValue.mBinary; break;
 		case JBAD:    throw jerr::error( "deleting deleted jvalue value?" );
 		default: break;	// most don't require extra work
 	}
+	mLength = 0;	// a container made next starts with no PRINT_ flags
 }
 
 void
 private_jvalue_data::toJARRAY_NL()	// convert to array if necessary
 {
 	if ( mType == JARRAY )
+	{
+		changedNL();
 		return;
+	}
 	deleteValueNL();
 	mType = JARRAY;
-	mValue.mArray = new array_vector_t;
+	mValue.mArray = newArray();
 }
 
 /*
@@ -143,6 +266,20 @@ private_jvalue_data::toJARRAY_NL()	// convert to array if necessary
  *
  */
 
+void
+jvalue::print( std::ostream& os ) const	// outermost entry point; nested values call private_jvalue_data::print
+{
+#ifdef JVALUE_STATS
+	jstats_outbuf Counter( os.rdbuf() );
+	ostream Counted( &Counter );
+	Counted.copyfmt( os );
+	get()->print( Counted );
+	os.setstate( Counted.rdstate() );
+#else
+	get()->print( os );
+#endif
+}
+
 static void
 cr( std::ostream& os, unsigned int xLevel )
 {
@@ -156,8 +293,6 @@ printChar( std::ostream& os, unsigned char *xBuffer )
 {
 	char buffer[16];
 	unsigned char C = *xBuffer++;
-	if ( C == 0 )
-		return NULL;
 	if ( C == '"' )
 		os << "\\\"";
 	else if ( C == '\\' )
@@ -202,7 +337,10 @@ printChar( std::ostream& os, unsigned char *xBuffer )
 		}
 		else
 			Q = C;
-		sprintf( buffer, "\\u%04x", Q );
+		if ( Q > 0xFFFF )	// beyond the BMP: a surrogate pair
+			sprintf( buffer, "\\u%04x\\u%04x", 0xD800 + ((Q - 0x10000) >> 10), 0xDC00 + ((Q - 0x10000) & 0x3FF) );
+		else
+			sprintf( buffer, "\\u%04x", Q );
 		os << buffer;
 	}
 	else
@@ -211,11 +349,35 @@ printChar( std::ostream& os, unsigned char *xBuffer )
 }
 
 static inline void
-printString( std::ostream& os, const char *xString )
+printString( std::ostream& os, const char *xString, size_t xLength )	// by length: \0 prints as \u0000
+{
+	os << '"';
+	unsigned char *String = (unsigned char *)xString;
+	unsigned char *End = String + xLength;
+	while ( String < End )
+		String = printChar( os, String );
+	os << '"';
+}
+
+static void
+printBase64( std::ostream& os, const binary_t& xBytes )	// binary values have no json form; print as a base64 string
 {
+	static const char Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const unsigned char *B = (const unsigned char *)xBytes.data();
+	size_t N = xBytes.size();
+	char Out[4];
 	os << '"';
-	if ( unsigned char *String = (unsigned char *)xString )
-		while ( String = printChar( os, String ) );
+	for ( size_t i = 0; i < N; i += 3 )
+	{
+		unsigned int Q = B[i] << 16;
+		if ( i + 1 < N ) Q |= B[i + 1] << 8;
+		if ( i + 2 < N ) Q |= B[i + 2];
+		Out[0] = Digits[(Q >> 18) & 0x3F];
+		Out[1] = Digits[(Q >> 12) & 0x3F];
+		Out[2] = i + 1 < N ? Digits[(Q >> 6) & 0x3F] : '=';
+		Out[3] = i + 2 < N ? Digits[Q & 0x3F] : '=';
+		os.write( Out, 4 );
+	}
 	os << '"';
 }
 
@@ -241,11 +403,13 @@ private_jvalue_data::sizeNL() const
 	{
 		case JNULL:    return 0;
 		case JBOOL:    return 1;
-		case JSTRING:  return mValue.mString ? strlen( mValue.mString ) : 0;
+		case JSTRING:  return mLength;
 		case JINTEGER: return 1;
 		case JDOUBLE:  return 1;
 		case JOBJECT:  return mValue.mObject ? mValue.mObject->size() : 0;
 		case JARRAY:   return mValue.mArray ? mValue.mArray->size() : 0;
+		case JUNSIGNED: return 1;
+		case JBINARY:  return mValue.mBinary->size();
 		case JBAD:     throw jerr::error( "accessing deleted jvalue (size)" );
 	}
 	return 0;
@@ -273,11 +437,13 @@ private_jvalue_data::emptyNL() const
 	{
 		case JNULL:    return true;
 		case JBOOL:    return false;
-		case JSTRING:  return mValue.mString == NULL || mValue.mString[0] == 0;
+		case JSTRING:  return mLength == 0;
 		case JINTEGER: return false;
 		case JDOUBLE:  return false;
 		case JOBJECT:  return mValue.mObject ? mValue.mObject->empty() : true;
 		case JARRAY:   return mValue.mArray ? mValue.mArray->empty() : true;
+		case JUNSIGNED: return false;
+		case JBINARY:  return mValue.mBinary->empty();
 		case JBAD:     throw jerr::error( "accessing deleted jvalue (empty)" );
 	}
 	return false;
@@ -287,12 +453,79 @@ char *	// static
 private_jvalue_data::scopy( const char *xIn )
 {
 	if ( !xIn ) xIn = "";	// always return something
-	size_t len = strlen( xIn );
-	char *RV = new char[len + 1];
-	strcpy( RV, xIn );
+	return scopy( xIn, strlen( xIn ) );
+}
+
+char *	// static; the copy keeps its capacity, so a shorter string can reuse it later
+private_jvalue_data::scopy( const char *xIn, size_t xLength )
+{
+	char *RV = new char[STRING_HEADER + xLength + 1] + STRING_HEADER;
+	memcpy( RV - STRING_HEADER, &xLength, sizeof(xLength) );
+	memcpy( RV, xIn, xLength );
+	RV[xLength] = '\0';
+	JSTAT( JSTAT_STRINGS, 1 );
+	JSTAT( JSTAT_STRING_BYTES, xLength + 1 );
+	JSTAT( JSTAT_BYTES_ALLOCATED, STRING_HEADER + xLength + 1 );
 	return RV;
 }
 
+size_t	// static
+private_jvalue_data::scapacity( const char *xString )
+{
+	size_t Capacity;
+	memcpy( &Capacity, xString - STRING_HEADER, sizeof(Capacity) );
+	return Capacity;
+}
+
+void	// static
+private_jvalue_data::sfree( char *xString )
+{
+	delete[] (xString - STRING_HEADER);
+}
+
+void	// private; the old value must already be deleted
+private_jvalue_data::setStringNL( const char *xValue, size_t xLength )
+{
+	if ( xLength > UINT_MAX )
+		throw jerr::error( "string too long" );
+	mType = JSTRING;
+	mLength = xLength;
+	if ( xLength < INLINE_STRING )
+	{
+		memcpy( mValue.mInline, xValue, xLength );
+		mValue.mInline[xLength] = '\0';
+	}
+	else
+		mValue.mString = scopy( xValue, xLength );
+}
+
+int
+private_jvalue_data::compareString( const char *xValue, size_t xLength ) const
+{
+	size_t L = stringLength();
+	int C = memcmp( String(), xValue, L < xLength ? L : xLength );
+	if ( C != 0 )
+		return C;
+	return L < xLength ? -1 : (L > xLength ? 1 : 0);
+}
+
+object_map_t *	// static
+private_jvalue_data::newObject( const object_map_t *xFrom )
+{
+	JSTAT( JSTAT_CONTAINERS, 1 );
+	JSTAT( JSTAT_BYTES_ALLOCATED, sizeof(object_map_t) + (xFrom ? xFrom->size() * MAP_NODE_BYTES : 0) );
+	JSTAT( JSTAT_MAP_NODES, xFrom ? xFrom->size() : 0 );
+	return xFrom ? new object_map_t( *xFrom ) : new object_map_t;
+}
+
+array_vector_t *	// static
+private_jvalue_data::newArray( const array_vector_t *xFrom )
+{
+	JSTAT( JSTAT_CONTAINERS, 1 );
+	JSTAT( JSTAT_BYTES_ALLOCATED, sizeof(array_vector_t) + (xFrom ? xFrom->size() * sizeof(jvalue) : 0) );
+	return xFrom ? new array_vector_t( *xFrom ) : new array_vector_t;
+}
+
 void
 private_jvalue_data::print( std::ostream& os, unsigned int xLevel ) const
 {
@@ -300,11 +533,13 @@ private_jvalue_data::print( std::ostream& os, unsigned int xLevel ) const
 	{
 		case JNULL:    os << "null";                            break;
 		case JBOOL:    os << (mValue.mBool ? "true" : "false"); break;
-		case JSTRING:  printString( os, mValue.mString );       break;
+		case JSTRING:  printString( os, stringNL(), mLength );   break;
 		case JINTEGER: os << mValue.mInteger;                   break;
 		case JDOUBLE:  os << mValue.mDouble;                    break;
-		case JOBJECT:  printObject( os, xLevel + 1 );           break;
-		case JARRAY:   printArray( os, xLevel + 1 );            break;
+		case JOBJECT:  if ( (mLength & (PRINT_CACHE | PRINT_SMALL)) == PRINT_CACHE ) printCached( os, xLevel + 1 ); else printObject( os, xLevel + 1 ); break;
+		case JARRAY:   if ( (mLength & (PRINT_CACHE | PRINT_SMALL)) == PRINT_CACHE ) printCached( os, xLevel + 1 ); else printArray( os, xLevel + 1 );  break;
+		case JUNSIGNED: os << mValue.mUnsigned;                 break;
+		case JBINARY:  printBase64( os, *mValue.mBinary );      break;
 		case JBAD:     throw jerr::error( "accessing deleted jvalue (print)" );
 	}
 }
@@ -322,7 +557,7 @@ private_jvalue_data::printObject( std::ostream& os, unsigned int xLevel ) const
 		{
 			if ( IT != BG )
 				os << ", ";
-			printString( os, IT->first.c_str() );
+			printString( os, IT->first.data(), IT->first.size() );
 			os << ":";
 			IT->second->print( os, xLevel + 1 );
 		}
@@ -334,7 +569,7 @@ private_jvalue_data::printObject( std::ostream& os, unsigned int xLevel ) const
 			if ( IT != BG )
 				os << ",";
 			cr( os, xLevel );
-			printString( os, IT->first.c_str() );
+			printString( os, IT->first.data(), IT->first.size() );
 			os << ":";
 			IT->second->print( os, xLevel + 1 );
 		}
@@ -354,22 +589,22 @@ private_jvalue_data::printArray( std::ostream& os, unsigned int xLevel ) const
 	}
 	else if ( Vector.size() <= 4 )
 	{
-		os << Vector[0];
+		Vector[0]->print( os );
 		for ( size_t index = 1; index < Vector.size(); index++ )
 		{
 			os << ",";
-			os << Vector[index];
+			Vector[index]->print( os );
 		}
 	}
 	else
 	{
 		cr( os, xLevel );
-		os << Vector[0];
+		Vector[0]->print( os );
 		for ( size_t index = 1; index < Vector.size(); index++ )
 		{
 			os << ",";
 			cr( os, xLevel );
-			os << Vector[index];
+			Vector[index]->print( os );
 		}
 		cr( os, xLevel );
 	}
@@ -377,135 +612,1115 @@ private_jvalue_data::printArray( std::ostream& os, unsigned int xLevel ) const
 }
 
 /*
- * the parser functions
+ * the node cache
+ *   printed text and structural hash of containers, keyed by node; a node's
+ *   PRINT_CACHED/HASH_CACHED flags say it has an entry, so nodes without one
+ *   never touch the table
  *
  */
 
-static inline int
-flushSpace( istream& is )
+struct node_cache_entry
 {
-	int C = is.peek();
-	while ( isspace( C ) )
+	node_cache_entry() : mLevel( 0 ), mPrecision( 0 ), mFlags(), mFill( 0 ), mHash( 0 ) {}
+	unsigned int mLevel;	// indentation and number format the text was made with
+	streamsize   mPrecision;
+	ios_base::fmtflags mFlags;
+	char         mFill;
+	shared_ptr<const string> mText;	// shared: written out after the table lock is released
+	uint64_t     mHash;
+
+	bool printedLike( const ostream& os, unsigned int xLevel ) const
+		{ return mText && mLevel == xLevel && mPrecision == os.precision() && mFlags == os.flags() && mFill == os.fill(); }
+};
+
+typedef unordered_map<const private_jvalue_data *, node_cache_entry> node_cache_t;
+
+/*
+ * the table is split by node address, each part with its own lock, so
+ *   cached prints and hashes of unrelated documents do not wait for each
+ *   other.  a part's lock may be taken while holding a node's lock (as
+ *   dropCache() does) but never the other way round
+ *
+ */
+
+enum { NODE_CACHE_PARTS = 16 };	// a power of two
+
+struct node_cache_part
+{
+	node_cache_t mTable;
+#ifndef SINGLE_THREAD
+	mutex        mLock;
+#endif
+};
+
+class node_cache_lock	// the part of the table that holds xNode, locked while in scope
+{
+	public:
+		node_cache_lock( const private_jvalue_data *xNode ) : mPart( part( xNode ) ) { lock(); }
+		~node_cache_lock() { unlock(); }
+		node_cache_t& table() { return mPart.mTable; }
+	private:
+		node_cache_part& mPart;
+
+		static node_cache_part&
+		part( const private_jvalue_data *xNode )
+			{
+				static node_cache_part Parts[NODE_CACHE_PARTS];	// function-local: usable from static destructors
+				unsigned long long H = ((unsigned long long)(uintptr_t)xNode >> 4) * 0x9E3779B97F4A7C15ULL;
+				return Parts[(H >> 32) & (NODE_CACHE_PARTS - 1)];
+			}
+#ifdef SINGLE_THREAD
+		void lock()   {}
+		void unlock() {}
+#else
+		void lock()   { mPart.mLock.lock(); }
+		void unlock() { mPart.mLock.unlock(); }
+#endif
+};
+
+void	// private; the node is locked, or being destroyed
+private_jvalue_data::dropCache()
+{
+	if ( mLength & (PRINT_CACHED | HASH_CACHED) )
 	{
-		is.get();		// flush whitespace
-		C = is.peek();	// look at next character
+		node_cache_lock L( this );
+		L.table().erase( this );
 	}
-	return C;
+	mLength &= ~(PRINT_CACHED | PRINT_SMALL | HASH_CACHED | HASH_SMALL);
 }
 
-bool	// returns false if there is a parsing error
-private_jvalue_data::parse( istream& is )
+void	// private; containers below this one cache too (xFlag); each is locked in turn, as changedNL() expects
+private_jvalue_data::cacheChildren( unsigned int xFlag ) const
 {
-	Null();	// clean out anything already here...
-	int C = flushSpace( is );
-	if ( C < 0 ) return false;	// EOF
-	// dispatch to correct parse function based on leading character of the object
-	if ( isdigit( C ) || C == '.' || C == '-' ) return parseNumber( is );
-	if ( C == '"' ) return parseString( is );
-	if ( C == '{' ) return parseObject( is );
-	if ( C == '[' ) return parseArray( is );
-	if ( C == 'N' || C == 'n' ) return parseNull( is );
-	if ( C == 'T' || C == 't' ) return parseTrue( is );
-	if ( C == 'F' || C == 'f' ) return parseFalse( is );
-	// none of the above -- bad stream
-	char buffer[128];
-	sprintf( buffer, "could not determine json type from leading character: %c<%02x>", C, C );
-	throw jerr::error( crbncpy( buffer ) );
-	return false;
+	if ( mType == JOBJECT )
+	{
+		for ( object_map_t::const_iterator IT = mValue.mObject->begin(); IT != mValue.mObject->end(); ++IT )
+			if ( IT->second.isObject() || IT->second.isArray() )
+				IT->second->cacheFlag( xFlag );
+	}
+	else
+		for ( size_t i = 0; i < mValue.mArray->size(); i++ )
+			if ( (*mValue.mArray)[i].isObject() || (*mValue.mArray)[i].isArray() )
+				(*mValue.mArray)[i]->cacheFlag( xFlag );
 }
 
-static inline size_t
-readHex( istream& is )
+void	// private; sets xFlag in mLength under the node's own lock: the cache is not part of the value
+private_jvalue_data::cacheFlag( unsigned int xFlag ) const
 {
-	int C = is.get();
-	if ( isdigit( C ) )
-		return C - '0';
-	if ( 'A' <= C && C <= 'F' )
-		return C - 'A' + 10;
-	if ( 'a' <= C && C <= 'f' )
-		return C - 'a' + 10;
-	throw jerr::error( "bad hex character" );
-	return 0;
+	private_jvalue_data *Self = const_cast<private_jvalue_data *>( this );
+	Self->lock(__LINE__);
+	Self->mLength |= xFlag;
+	Self->unlock();
 }
 
-static inline size_t
-readHex4( istream& is )
+void	// private; printCache() and hashCache()
+private_jvalue_data::cache( unsigned int xFlag, bool xOn )
 {
-	return
-		(readHex( is ) << 12) |
-		(readHex( is ) << 8)  |
-		(readHex( is ) << 4)  |
-		 readHex( is );
+	if ( mType != JOBJECT && mType != JARRAY )
+		return;
+	lock(__LINE__);
+	changedNL();
+	if ( xOn )
+		mLength |= xFlag;	// children pick it up as they are printed or hashed
+	else
+		mLength &= ~xFlag;
+	unlock();
+	if ( xOn )
+		return;
+	if ( mType == JOBJECT )
+		for ( object_map_t::iterator IT = mValue.mObject->begin(); IT != mValue.mObject->end(); ++IT )
+			IT->second->cache( xFlag, false );
+	else
+		for ( size_t i = 0; i < mValue.mArray->size(); i++ )
+			(*mValue.mArray)[i]->cache( xFlag, false );
 }
 
-static inline void
-utfEncode( size_t xIn, string& xString ) // encode xIn into UTF-8, append to xString
+void	// private; a container with PRINT_CACHE set
+private_jvalue_data::printCached( std::ostream& os, unsigned int xLevel ) const
 {
-	if ( xIn <= 0x7F )
+	private_jvalue_data *Self = const_cast<private_jvalue_data *>( this );	// the cache is not part of the value
+	shared_ptr<const string> Text;
+	if ( mLength & PRINT_CACHED )
 	{
-		// single character
-		xString += xIn;
-		return;
+		node_cache_lock L( this );
+		node_cache_t::const_iterator IT = L.table().find( this );
+		if ( IT != L.table().end() && IT->second.printedLike( os, xLevel ) )
+			Text = IT->second.mText;
 	}
-	if ( xIn <= 0x7FF )
+
+	if ( !Text )
 	{
-		// two characters
-		int C1 = ((xIn >> 6) & 0x1F) | 0xC0;
-		int C2 = (xIn        & 0x3F) | 0x80;
-		xString += C1;
-		xString += C2;
-		return;
+		cacheChildren( PRINT_CACHE );
+		ostringstream Out;
+		Out.copyfmt( os );
+		if ( mType == JOBJECT )
+			printObject( Out, xLevel );
+		else
+			printArray( Out, xLevel );
+		if ( Out.str().size() < PRINT_CACHE_MIN )	// printed straight out from now on, until it changes
+		{
+			cacheFlag( PRINT_SMALL );
+			os << Out.str();
+			return;
+		}
+		Text = make_shared<const string>( Out.str() );
+		Self->lock(__LINE__);	// the entry and the flag together, so changedNL() drops both or neither
+		{
+			node_cache_lock L( this );
+			node_cache_entry& E = L.table()[this];
+			E.mLevel = xLevel;
+			E.mPrecision = os.precision();
+			E.mFlags = os.flags();
+			E.mFill = os.fill();
+			E.mText = Text;
+		}
+		Self->mLength |= PRINT_CACHED;
+		Self->unlock();
 	}
-	if ( xIn <= 0xFFFF )
+	os.write( Text->data(), Text->size() );
+}
+
+/*
+ * deep structure: equality, order and hash
+ *   numbers compare by value whatever their type, exactly: 9007199254740993 is
+ *   not 9007199254740992.0 even though the double of one is the other; every
+ *   NaN equals every other NaN and sorts after all numbers, so compare() is a
+ *   total order and hash() agrees with equals()
+ *
+ */
+
+static inline bool
+isNumberType( jType xType )
+{
+	return xType == JINTEGER || xType == JUNSIGNED || xType == JDOUBLE;
+}
+
+static int	// null < bool < number < string < binary < array < object
+typeRank( jType xType )
+{
+	switch( xType )
 	{
-		// three characters
-		int C1 = ((xIn >> 12) & 0x0F) | 0xE0;
-		int C2 = ((xIn >> 6)  & 0x3F) | 0x80;
-		int C3 = ( xIn        & 0x3F) | 0x80;
-		xString += C1;
-		xString += C2;
-		xString += C3;
-		return;
+		case JNULL:     return 0;
+		case JBOOL:     return 1;
+		case JINTEGER:
+		case JUNSIGNED:
+		case JDOUBLE:   return 2;
+		case JSTRING:   return 3;
+		case JBINARY:   return 4;
+		case JARRAY:    return 5;
+		case JOBJECT:   return 6;
+		case JBAD:      break;
 	}
-	if ( xIn <= 0x10FFFF )
+	throw jerr::error( "accessing deleted jvalue (compare)" );
+}
+
+static int
+compareNumbers( const private_jvalue_data& xA, const private_jvalue_data& xB )
+{
+	jType A = xA.type();
+	jType B = xB.type();
+	if ( A == JDOUBLE || B == JDOUBLE )
 	{
-		// four characters
-		int C1 = ((xIn >> 18) & 0x07) | 0xF0;
-		int C2 = ((xIn >> 12) & 0x3F) | 0x80;
-		int C3 = ((xIn >> 6)  & 0x3F) | 0x80;
-		int C4 = ( xIn        & 0x3F) | 0x80;
-		xString += C1;
-		xString += C2;
-		xString += C3;
-		xString += C4;
-		return;
+		bool ANaN = A == JDOUBLE && xA.Double() != xA.Double();
+		bool BNaN = B == JDOUBLE && xB.Double() != xB.Double();
+		if ( ANaN || BNaN )
+			return ANaN - BNaN;
+		// long double holds every 64-bit integer exactly on x86; elsewhere
+		// integers beyond 2^53 compare against doubles approximately
+		long double AV = A == JDOUBLE ? (long double)xA.Double() : (A == JINTEGER ? (long double)xA.Integer() : (long double)xA.Unsigned());
+		long double BV = B == JDOUBLE ? (long double)xB.Double() : (B == JINTEGER ? (long double)xB.Integer() : (long double)xB.Unsigned());
+		return AV < BV ? -1 : (AV > BV ? 1 : 0);
 	}
-	// illegal character
-	xString += "<BADC>";
+	if ( A == JINTEGER && B == JINTEGER )
+		return xA.Integer() < xB.Integer() ? -1 : (xA.Integer() > xB.Integer() ? 1 : 0);
+	if ( A == JINTEGER && xA.Integer() < 0 )	// below any unsigned
+		return -1;
+	if ( B == JINTEGER && xB.Integer() < 0 )
+		return 1;
+	unsigned long long AU = xA.Unsigned();
+	unsigned long long BU = xB.Unsigned();
+	return AU < BU ? -1 : (AU > BU ? 1 : 0);
 }
 
-static bool
-rawParseString( istream& is, string& xString )	// helper function for parseString, parsePair
+static int
+compareBytes( const char *xA, size_t xALength, const char *xB, size_t xBLength )
 {
-	xString.clear();
-	int FirstC = flushSpace( is );
-	if ( FirstC != '"' )
+	int RV = memcmp( xA, xB, xALength < xBLength ? xALength : xBLength );
+	if ( RV != 0 )
+		return RV < 0 ? -1 : 1;
+	return xALength < xBLength ? -1 : (xALength > xBLength ? 1 : 0);
+}
+
+bool
+private_jvalue_data::equals( const private_jvalue_data& xOther ) const
+{
+	if ( this == &xOther )
+		return true;
+	if ( mType != xOther.mType )
+		return isNumberType( mType ) && isNumberType( xOther.mType ) && compareNumbers( *this, xOther ) == 0;
+	switch( mType )
+	{
+		case JNULL:     return true;
+		case JBOOL:     return mValue.mBool == xOther.mValue.mBool;
+		case JINTEGER:  return mValue.mInteger == xOther.mValue.mInteger;
+		case JUNSIGNED: return mValue.mUnsigned == xOther.mValue.mUnsigned;
+		case JDOUBLE:   return compareNumbers( *this, xOther ) == 0;
+		case JSTRING:   return mLength == xOther.mLength && memcmp( stringNL(), xOther.stringNL(), mLength ) == 0;
+		case JBINARY:   return *mValue.mBinary == *xOther.mValue.mBinary;
+		case JBAD:      throw jerr::error( "accessing deleted jvalue (equals)" );
+		default:        break;
+	}
+
+	uint64_t A, B;	// two cached hashes that differ settle it
+	if ( (mLength & HASH_CACHED) && (xOther.mLength & HASH_CACHED) && cachedHash( A ) && xOther.cachedHash( B ) && A != B )
 		return false;
-	is.get();	// flush the double quotes
-	for ( ;; )
+	if ( mType == JARRAY )
 	{
-		int C = is.get();
-		if ( C == EOF )
-			throw jerr::error( "private_jvalue_data::parseString : found EOF inside string" );
-		if ( C == '"' )
-			break;
-		if ( C == '\\' )
-		{
-			switch( C = is.get() )
-			{
-				case 'b':
-					xString += '\b';
-					break;
+		const array_vector_t& AA = *mValue.mArray;
+		const array_vector_t& BA = *xOther.mValue.mArray;
+		if ( AA.size() != BA.size() )
+			return false;
+		for ( size_t i = 0; i < AA.size(); i++ )
+			if ( !AA[i].equals( BA[i] ) )
+				return false;
+		return true;
+	}
+	const object_map_t& AO = *mValue.mObject;
+	const object_map_t& BO = *xOther.mValue.mObject;
+	if ( AO.size() != BO.size() )
+		return false;
+	for ( object_map_t::const_iterator IT = AO.begin(), JT = BO.begin(); IT != AO.end(); ++IT, ++JT )
+		if ( IT->first != JT->first || !IT->second.equals( JT->second ) )
+			return false;
+	return true;
+}
+
+int
+private_jvalue_data::compare( const private_jvalue_data& xOther ) const
+{
+	if ( this == &xOther )
+		return 0;
+	int A = typeRank( mType );
+	int B = typeRank( xOther.mType );
+	if ( A != B )
+		return A < B ? -1 : 1;
+	switch( mType )
+	{
+		case JNULL:     return 0;
+		case JBOOL:     return (int)mValue.mBool - (int)xOther.mValue.mBool;
+		case JSTRING:   return compareBytes( stringNL(), mLength, xOther.stringNL(), xOther.mLength );
+		case JBINARY:   return compareBytes( mValue.mBinary->data(), mValue.mBinary->size(), xOther.mValue.mBinary->data(), xOther.mValue.mBinary->size() );
+		case JARRAY:
+		{
+			const array_vector_t& AA = *mValue.mArray;
+			const array_vector_t& BA = *xOther.mValue.mArray;
+			for ( size_t i = 0; i < AA.size() && i < BA.size(); i++ )
+				if ( int RV = AA[i].compare( BA[i] ) )
+					return RV;
+			return AA.size() < BA.size() ? -1 : (AA.size() > BA.size() ? 1 : 0);
+		}
+		case JOBJECT:	// as sorted lists of (key, value)
+		{
+			const object_map_t& AO = *mValue.mObject;
+			const object_map_t& BO = *xOther.mValue.mObject;
+			object_map_t::const_iterator IT = AO.begin(), JT = BO.begin();
+			for ( ; IT != AO.end() && JT != BO.end(); ++IT, ++JT )
+			{
+				if ( int RV = compareBytes( IT->first.data(), IT->first.size(), JT->first.data(), JT->first.size() ) )
+					return RV;
+				if ( int RV = IT->second.compare( JT->second ) )
+					return RV;
+			}
+			return IT != AO.end() ? 1 : (JT != BO.end() ? -1 : 0);
+		}
+		default:        return compareNumbers( *this, xOther );
+	}
+}
+
+/*
+ * the hash: FNV-1a over bytes, children folded in order with a
+ * boost-style combine and finished with the murmur3 avalanche.  objects
+ * are folded in key order (the map's), so two objects built in a different
+ * order hash alike.  fixed constants only: the same document hashes the same
+ * in every run and every process
+ *
+ */
+
+enum { HASH_NULL = 1, HASH_FALSE, HASH_TRUE, HASH_NUMBER, HASH_NAN, HASH_STRING, HASH_BINARY, HASH_ARRAY, HASH_OBJECT };
+
+static inline uint64_t
+hashCombine( uint64_t xHash, uint64_t xValue )
+{
+	return xHash ^ (xValue + 0x9e3779b97f4a7c15ULL + (xHash << 6) + (xHash >> 2));
+}
+
+static inline uint64_t
+hashFinish( uint64_t xHash )
+{
+	xHash ^= xHash >> 33;
+	xHash *= 0xff51afd7ed558ccdULL;
+	xHash ^= xHash >> 33;
+	xHash *= 0xc4ceb9fe1a85ec53ULL;
+	xHash ^= xHash >> 33;
+	return xHash;
+}
+
+static uint64_t
+hashBytes( uint64_t xTag, const char *xData, size_t xLength )
+{
+	uint64_t H = 0xcbf29ce484222325ULL ^ xTag;
+	for ( size_t i = 0; i < xLength; i++ )
+		H = (H ^ (unsigned char)xData[i]) * 0x100000001b3ULL;
+	return hashFinish( H );
+}
+
+static uint64_t	// numbers that compare equal hash alike: an integral double hashes as its integer
+hashNumber( const private_jvalue_data& xValue )
+{
+	uint64_t Bits;
+	switch( xValue.type() )
+	{
+		case JINTEGER:  Bits = (uint64_t)xValue.Integer(); break;
+		case JUNSIGNED: Bits = xValue.Unsigned();          break;
+		default:
+		{
+			double D = xValue.Double();
+			if ( D != D )
+				return hashFinish( HASH_NAN );
+			if ( D == floor( D ) && D >= -9223372036854775808.0 && D < 0.0 )
+				Bits = (uint64_t)(long long)D;
+			else if ( D == floor( D ) && D >= 0.0 && D < 18446744073709551616.0 )
+				Bits = (uint64_t)D;	// 0.0 and -0.0 both land here
+			else
+				memcpy( &Bits, &D, sizeof( Bits ) );
+			break;
+		}
+	}
+	return hashFinish( hashCombine( HASH_NUMBER, Bits ) );
+}
+
+uint64_t
+private_jvalue_data::hash() const
+{
+	size_t Work = 0;
+	return hash( Work );
+}
+
+uint64_t	// private
+private_jvalue_data::hash( size_t& xWork ) const
+{
+	xWork++;
+	switch( mType )
+	{
+		case JNULL:     return hashFinish( HASH_NULL );
+		case JBOOL:     return hashFinish( mValue.mBool ? HASH_TRUE : HASH_FALSE );
+		case JSTRING:   xWork += mLength; return hashBytes( HASH_STRING, stringNL(), mLength );
+		case JBINARY:   xWork += mValue.mBinary->size(); return hashBytes( HASH_BINARY, mValue.mBinary->data(), mValue.mBinary->size() );
+		case JBAD:      throw jerr::error( "accessing deleted jvalue (hash)" );
+		case JARRAY:
+		case JOBJECT:   break;
+		default:        return hashNumber( *this );
+	}
+
+	bool Cache = (mLength & (HASH_CACHE | HASH_SMALL)) == HASH_CACHE;	// HASH_SMALL: children already flagged
+	if ( Cache )
+	{
+		uint64_t H;
+		if ( (mLength & HASH_CACHED) && cachedHash( H ) )
+			return H;
+		cacheChildren( HASH_CACHE );
+	}
+
+	size_t Work = 0;
+	uint64_t H;
+	if ( mType == JARRAY )
+	{
+		H = HASH_ARRAY;
+		for ( size_t i = 0; i < mValue.mArray->size(); i++ )
+			H = hashCombine( H, (*mValue.mArray)[i]->hash( Work ) );
+	}
+	else
+	{
+		H = HASH_OBJECT;
+		for ( object_map_t::const_iterator IT = mValue.mObject->begin(); IT != mValue.mObject->end(); ++IT )
+		{
+			Work += IT->first.size();
+			H = hashCombine( H, hashCombine( hashBytes( HASH_STRING, IT->first.data(), IT->first.size() ), IT->second->hash( Work ) ) );
+		}
+	}
+	H = hashFinish( H );
+	xWork += Work;
+
+	if ( Cache )
+	{
+		private_jvalue_data *Self = const_cast<private_jvalue_data *>( this );	// the cache is not part of the value
+		Self->lock(__LINE__);
+		if ( Work >= HASH_CACHE_MIN )
+		{
+			node_cache_lock L( this );
+			L.table()[this].mHash = H;
+		}
+		Self->mLength |= Work >= HASH_CACHE_MIN ? HASH_CACHED : HASH_SMALL;
+		Self->unlock();
+	}
+	return H;
+}
+
+bool	// private; with HASH_CACHED seen set
+private_jvalue_data::cachedHash( uint64_t& xHash ) const
+{
+	node_cache_lock L( this );
+	node_cache_t::const_iterator IT = L.table().find( this );
+	bool Found = IT != L.table().end() && (mLength & HASH_CACHED);
+	if ( Found )
+		xHash = IT->second.mHash;
+	return Found;
+}
+
+/*
+ * memory accounting
+ *   what the allocator was asked for, not what it keeps for itself
+ *
+ */
+
+static inline size_t
+heapBytes( const string& xString )	// 0 when the characters fit inside the string object
+{
+	const char *P = xString.data();
+	if ( P >= (const char *)&xString && P < (const char *)(&xString + 1) )
+		return 0;
+	return xString.capacity() + 1;
+}
+
+size_t
+private_jvalue_data::memoryUsage() const
+{
+	unordered_set<const private_jvalue_data *> Shared;
+	return memoryUsage( Shared );
+}
+
+size_t	// private
+private_jvalue_data::memoryUsage( unordered_set<const private_jvalue_data *>& xShared ) const
+{
+	size_t Bytes = NODE_BYTES;
+	switch( mType )
+	{
+		case JSTRING:
+			return Bytes + (mLength >= INLINE_STRING ? STRING_HEADER + scapacity( mValue.mString ) + 1 : 0);
+		case JBINARY:
+			return Bytes + sizeof(binary_t) + heapBytes( *mValue.mBinary );
+		case JBAD:
+			throw jerr::error( "accessing deleted jvalue (memoryUsage)" );
+		case JARRAY:
+		case JOBJECT:
+			break;
+		default:
+			return Bytes;
+	}
+
+	if ( mLength & PRINT_CACHED )
+	{
+		node_cache_lock L( this );
+		node_cache_t::const_iterator IT = L.table().find( this );
+		if ( IT != L.table().end() && IT->second.mText )
+			Bytes += sizeof(string) + CONTROL_BLOCK_BYTES + heapBytes( *IT->second.mText );
+	}
+	if ( mLength & (PRINT_CACHED | HASH_CACHED) )
+		Bytes += sizeof(node_cache_t::value_type) + 2 * sizeof(void *);	// the entry, its hash node and bucket
+
+	if ( mType == JARRAY )
+	{
+		Bytes += sizeof(array_vector_t) + mValue.mArray->capacity() * sizeof(jvalue);
+		for ( size_t i = 0; i < mValue.mArray->size(); i++ )
+		{
+			const jvalue& V = (*mValue.mArray)[i];
+			if ( V.use_count() == 1 || xShared.insert( V.get() ).second )
+				Bytes += V->memoryUsage( xShared );
+		}
+	}
+	else
+	{
+		Bytes += sizeof(object_map_t);
+		for ( object_map_t::const_iterator IT = mValue.mObject->begin(); IT != mValue.mObject->end(); ++IT )
+		{
+			Bytes += MAP_NODE_BYTES + heapBytes( IT->first );
+			if ( IT->second.use_count() == 1 || xShared.insert( IT->second.get() ).second )
+				Bytes += IT->second->memoryUsage( xShared );
+		}
+	}
+	return Bytes;
+}
+
+/*
+ * strict json: the rules validate() and a strict stream hold text to
+ *
+ */
+
+static int
+strictWord()	// the iword() of a stream that says it is strict
+{
+	static const int Word = ios_base::xalloc();
+	return Word;
+}
+
+static inline bool
+strictParse( istream& is )
+{
+	return is.iword( strictWord() ) != 0;
+}
+
+void	// static
+jvalue::strict( istream& is, bool xOn )
+{
+	is.iword( strictWord() ) = xOn;
+}
+
+/*
+ * parse errors: the parser returns false up the stack rather than throw;
+ *   the first error found is kept, per thread, and callers further out
+ *   only pass it on
+ *
+ */
+
+struct parse_error
+{
+	jparse_code mCode;
+	const char *mMessage;
+	char        mText[80];	// for messages made up on the spot
+};
+
+static thread_local parse_error tParseError;
+
+static bool
+parseFailed( jparse_code xCode, const char *xMessage )
+{
+	if ( tParseError.mCode == JPARSE_OK )
+	{
+		tParseError.mCode = xCode;
+		tParseError.mMessage = xMessage;
+	}
+	return false;
+}
+
+static inline bool
+parseError( istream& is, jparse_code xCode, const char *xMessage )	// a value cut short by the end of input says so
+{
+	return parseFailed( is.good() ? xCode : JPARSE_TRUNCATED, xMessage );
+}
+
+/*
+ * parse limits: the caps a stream was given, and what the document being
+ *   read has used of them, behind the stream's pword(); streams without
+ *   limits hold NULL there
+ *
+ */
+
+struct parse_limits
+{
+	size_t mMaxBytes, mMaxDepth, mMaxString, mMaxElements;	// (size_t)-1 for none
+	size_t mBytes, mDepth, mElements;
+};
+
+static int
+limitsWord()
+{
+	static const int Word = ios_base::xalloc();
+	return Word;
+}
+
+static inline parse_limits *
+limitsOf( istream& is )
+{
+	return (parse_limits *)is.pword( limitsWord() );
+}
+
+static void
+limitsEvent( ios_base::event xEvent, ios_base& xStream, int xWord )	// the stream owns its copy
+{
+	void *&P = xStream.pword( xWord );
+	if ( !P )
+		return;
+	if ( xEvent == ios_base::erase_event )
+	{
+		delete (parse_limits *)P;
+		P = NULL;
+	}
+	else if ( xEvent == ios_base::copyfmt_event )	// P is still the other stream's
+		P = new parse_limits( *(const parse_limits *)P );
+}
+
+static bool
+limitsCharge( parse_limits *xLimits, size_t xBytes, size_t xElements )	// before allocating; false instead
+{
+	if ( (xLimits->mBytes += xBytes) > xLimits->mMaxBytes )
+		return parseFailed( JPARSE_LIMIT, "private_jvalue_data::parse : document passes the byte limit" );
+	if ( (xLimits->mElements += xElements) > xLimits->mMaxElements )
+		return parseFailed( JPARSE_LIMIT, "private_jvalue_data::parse : document passes the element limit" );
+	return true;
+}
+
+static bool
+limitsString()
+{
+	return parseFailed( JPARSE_LIMIT, "private_jvalue_data::parse : string passes the length limit" );
+}
+
+struct limits_depth	// one level of object or array, for as long as it is being read; check mOK
+{
+	limits_depth( parse_limits *xLimits ) : mLimits( xLimits ), mOK( true )
+		{
+			if ( mLimits && mLimits->mDepth++ >= mLimits->mMaxDepth )
+			{
+				mLimits->mDepth--;
+				mLimits = NULL;
+				mOK = parseFailed( JPARSE_LIMIT, "private_jvalue_data::parse : document passes the depth limit" );
+			}
+		}
+	~limits_depth() { if ( mLimits ) mLimits->mDepth--; }
+	parse_limits *mLimits;
+	bool          mOK;
+};
+
+static inline void
+limitsReset( istream& is )	// a new document
+{
+	if ( parse_limits *L = limitsOf( is ) )
+		L->mBytes = L->mDepth = L->mElements = 0;
+}
+
+void	// static
+jvalue::limits( istream& is, const jlimits& xLimits )
+{
+	void *&P = is.pword( limitsWord() );
+	delete (parse_limits *)P;
+	P = NULL;
+	if ( !xLimits.mBytes && !xLimits.mDepth && !xLimits.mString && !xLimits.mElements )
+		return;
+	static const size_t None = (size_t)-1;
+	parse_limits L = { xLimits.mBytes ? xLimits.mBytes : None, xLimits.mDepth ? xLimits.mDepth : None,
+		xLimits.mString ? xLimits.mString : None, xLimits.mElements ? xLimits.mElements : None, 0, 0, 0 };
+	P = new parse_limits( L );
+	long& Registered = is.iword( limitsWord() );	// copyfmt() carries it along with the callback
+	if ( !Registered )
+	{
+		is.register_callback( limitsEvent, limitsWord() );
+		Registered = 1;
+	}
+}
+
+static inline bool
+jsonSpace( int C )	// RFC 8259 white space; isspace() also takes \v and \f
+{
+	return C == ' ' || C == '\n' || C == '\r' || C == '\t';
+}
+
+static size_t	// length of the UTF-8 sequence at xAt, 0 if it is not one
+utf8Sequence( const unsigned char *xAt, const unsigned char *xEnd )
+{
+	unsigned char C = xAt[0];
+	if ( C < 0x80 )
+		return 1;
+	if ( C < 0xC2 )	// a continuation byte, or an overlong two-byte form
+		return 0;
+	if ( C < 0xE0 )
+		return xEnd - xAt >= 2 && (xAt[1] & 0xC0) == 0x80 ? 2 : 0;
+	if ( C < 0xF0 )
+	{
+		if ( xEnd - xAt < 3 || (xAt[1] & 0xC0) != 0x80 || (xAt[2] & 0xC0) != 0x80 )
+			return 0;
+		if ( (C == 0xE0 && xAt[1] < 0xA0) || (C == 0xED && xAt[1] >= 0xA0) )	// overlong, or a surrogate
+			return 0;
+		return 3;
+	}
+	if ( C < 0xF5 )
+	{
+		if ( xEnd - xAt < 4 || (xAt[1] & 0xC0) != 0x80 || (xAt[2] & 0xC0) != 0x80 || (xAt[3] & 0xC0) != 0x80 )
+			return 0;
+		if ( (C == 0xF0 && xAt[1] < 0x90) || (C == 0xF4 && xAt[1] >= 0x90) )	// overlong, or past U+10FFFF
+			return 0;
+		return 4;
+	}
+	return 0;
+}
+
+static inline bool
+jsonDigit( unsigned char C )	// no locale lookup
+{
+	return (unsigned char)(C - '0') < 10;
+}
+
+static bool	// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?; xAt is left after it
+scanNumber( const unsigned char *&xAt, const unsigned char *xEnd )
+{
+	const unsigned char *P = xAt;
+	if ( P < xEnd && *P == '-' )
+		P++;
+	if ( P < xEnd && *P == '0' )
+		P++;
+	else if ( P < xEnd && '1' <= *P && *P <= '9' )
+		while ( ++P < xEnd && jsonDigit( *P ) )
+			;
+	else
+		return false;
+	if ( P < xEnd && *P == '.' )
+	{
+		if ( ++P == xEnd || !jsonDigit( *P ) )
+			return false;
+		while ( ++P < xEnd && jsonDigit( *P ) )
+			;
+	}
+	if ( P < xEnd && (*P == 'e' || *P == 'E') )
+	{
+		if ( ++P < xEnd && (*P == '+' || *P == '-') )
+			P++;
+		if ( P == xEnd || !jsonDigit( *P ) )
+			return false;
+		while ( ++P < xEnd && jsonDigit( *P ) )
+			;
+	}
+	xAt = P;
+	return true;
+}
+
+/*
+ * the parser functions
+ *
+ */
+
+static vector<const private_jvalue_data *>&
+reparseSeen()	// members reparse() has written, a stretch per object being read
+{
+	static thread_local vector<const private_jvalue_data *> Seen;
+	return Seen;
+}
+
+static bool	// jvalue::parse and reparse, without throwing: false with tParseError.mCode JPARSE_OK is the end of input
+outermost( istream& is, private_jvalue_data *xData, bool (private_jvalue_data::*xParse)( istream& ) )
+{
+	tParseError.mCode = JPARSE_OK;
+#ifdef JVALUE_STATS
+	jstats_inbuf Counter( is.rdbuf() );
+	istream Counted( &Counter );
+	Counted.copyfmt( is );	// strict() and limits() travel in iword()s and pword()s
+	limitsReset( Counted );
+	istream& In = Counted;
+#else
+	limitsReset( is );
+	istream& In = is;
+#endif
+	bool RV;
+	try
+	{
+		RV = (xData->*xParse)( In );
+	}
+	catch ( jerr *E )	// from a setter: a string over 4GB
+	{
+		RV = parseFailed( JPARSE_LIMIT, E->message() );
+	}
+#ifdef JVALUE_STATS
+	is.setstate( Counted.rdstate() );
+#endif
+	return RV;
+}
+
+static bool
+thrown( bool xParsed )	// what the throwing API makes of it
+{
+	if ( !xParsed && tParseError.mCode != JPARSE_OK )
+		throw jerr::error( tParseError.mMessage );
+	return xParsed;
+}
+
+static void	// where the error was: bytes from Start, and the line and column, by reading them again
+locate( streambuf *xBuf, streamoff xStart, jparse_status& xStatus )
+{
+	xStatus.mOffset = (size_t)-1;
+	xStatus.mLine = xStatus.mColumn = 0;
+	if ( xStart < 0 )	// the stream cannot seek
+		return;
+	streamoff End = xBuf->pubseekoff( 0, ios_base::cur, ios_base::in );
+	if ( End < 0 || End < xStart )
+		return;
+	xStatus.mOffset = End - xStart;
+	if ( xBuf->pubseekpos( xStart, ios_base::in ) != xStart )
+		return;
+	size_t Line = 1, Column = 1;
+	char Block[4096];
+	for ( streamoff Left = End - xStart; Left > 0; )
+	{
+		streamsize N = xBuf->sgetn( Block, Left < (streamoff)sizeof(Block) ? Left : sizeof(Block) );
+		if ( N <= 0 )
+			break;
+		for ( streamsize i = 0; i < N; i++ )
+			if ( Block[i] == '\n' )
+			{
+				Line++;
+				Column = 1;
+			}
+			else
+				Column++;
+		Left -= N;
+	}
+	xBuf->pubseekpos( End, ios_base::in );
+	xStatus.mLine = Line;
+	xStatus.mColumn = Column;
+}
+
+static bool
+withStatus( istream& is, private_jvalue_data *xData, bool (private_jvalue_data::*xParse)( istream& ), jparse_status& xStatus )
+{
+	streambuf *B = is.rdbuf();
+	streamoff Start = B ? (streamoff)B->pubseekoff( 0, ios_base::cur, ios_base::in ) : -1;	// -1 when it cannot seek
+	bool RV = outermost( is, xData, xParse );
+	xStatus.mCode = RV ? JPARSE_OK : (tParseError.mCode == JPARSE_OK ? JPARSE_EMPTY : tParseError.mCode);
+	snprintf( xStatus.mMessage, sizeof(xStatus.mMessage), "%s", xStatus.mCode == JPARSE_EMPTY ? "nothing to parse" : (RV ? "" : tParseError.mMessage) );
+	xStatus.mOffset = (size_t)-1;
+	xStatus.mLine = xStatus.mColumn = 0;
+	if ( !RV && B && xStatus.mCode != JPARSE_EMPTY )
+		locate( B, Start, xStatus );
+	return RV;
+}
+
+bool
+jvalue::parse( istream& is )
+{
+	return thrown( outermost( is, get(), &private_jvalue_data::parse ) );
+}
+
+bool
+jvalue::parse( istream& is, jparse_status& xStatus )
+{
+	return withStatus( is, get(), &private_jvalue_data::parse, xStatus );
+}
+
+bool
+jvalue::reparse( istream& is )
+{
+	reparseSeen().clear();	// in case the last one failed
+	return thrown( outermost( is, get(), &private_jvalue_data::reparse ) );
+}
+
+bool
+jvalue::reparse( istream& is, jparse_status& xStatus )
+{
+	reparseSeen().clear();
+	return withStatus( is, get(), &private_jvalue_data::reparse, xStatus );
+}
+
+static inline int
+flushSpace( istream& is )
+{
+	int C = is.peek();
+	while ( jsonSpace( C ) || (isspace( C ) && !strictParse( is )) )
+	{
+		is.get();		// flush whitespace
+		C = is.peek();	// look at next character
+	}
+	return C;
+}
+
+bool	// returns false if there is a parsing error
+private_jvalue_data::parse( istream& is )
+{
+	Null();	// clean out anything already here...
+	int C = flushSpace( is );
+	if ( C < 0 ) return false;	// EOF
+	if ( parse_limits *L = limitsOf( is ) )
+		if ( !limitsCharge( L, NODE_BYTES, 1 ) )
+			return false;
+	// dispatch to correct parse function based on leading character of the object
+	if ( isdigit( C ) || C == '.' || C == '-' ) return parseNumber( is );
+	if ( C == '"' ) return parseString( is );
+	if ( C == '{' ) return parseObject( is );
+	if ( C == '[' ) return parseArray( is );
+	if ( C == 'N' || C == 'n' ) return parseNull( is );
+	if ( C == 'T' || C == 't' ) return parseTrue( is );
+	if ( C == 'F' || C == 'f' ) return parseFalse( is );
+	// none of the above -- bad stream
+	if ( tParseError.mCode == JPARSE_OK )
+		snprintf( tParseError.mText, sizeof(tParseError.mText), "could not determine json type from leading character: %c<%02x>", C, C );
+	return parseFailed( JPARSE_BAD_CHARACTER, tParseError.mText );
+}
+
+static inline bool
+readHex4( istream& is, size_t& xCode )
+{
+	xCode = 0;
+	for ( int i = 0; i < 4; i++ )
+	{
+		int C = is.get();
+		if ( isdigit( C ) )
+			xCode = xCode << 4 | (C - '0');
+		else if ( 'A' <= C && C <= 'F' )
+			xCode = xCode << 4 | (C - 'A' + 10);
+		else if ( 'a' <= C && C <= 'f' )
+			xCode = xCode << 4 | (C - 'a' + 10);
+		else
+			return parseError( is, JPARSE_BAD_STRING, "bad hex character" );
+	}
+	return true;
+}
+
+void	// static
+jutf8::append( unsigned long xIn, string& xString )
+{
+	if ( xIn <= 0x7F )
+	{
+		// single character
+		xString += xIn;
+		return;
+	}
+	if ( xIn <= 0x7FF )
+	{
+		// two characters
+		int C1 = ((xIn >> 6) & 0x1F) | 0xC0;
+		int C2 = (xIn        & 0x3F) | 0x80;
+		xString += C1;
+		xString += C2;
+		return;
+	}
+	if ( xIn <= 0xFFFF )
+	{
+		// three characters
+		int C1 = ((xIn >> 12) & 0x0F) | 0xE0;
+		int C2 = ((xIn >> 6)  & 0x3F) | 0x80;
+		int C3 = ( xIn        & 0x3F) | 0x80;
+		xString += C1;
+		xString += C2;
+		xString += C3;
+		return;
+	}
+	if ( xIn <= 0x10FFFF )
+	{
+		// four characters
+		int C1 = ((xIn >> 18) & 0x07) | 0xF0;
+		int C2 = ((xIn >> 12) & 0x3F) | 0x80;
+		int C3 = ((xIn >> 6)  & 0x3F) | 0x80;
+		int C4 = ( xIn        & 0x3F) | 0x80;
+		xString += C1;
+		xString += C2;
+		xString += C3;
+		xString += C4;
+		return;
+	}
+	// illegal character
+	xString += "<BADC>";
+}
+
+static inline bool
+hex4( const char *xAt, const char *xEnd, unsigned long& xCode )
+{
+	if ( xEnd - xAt < 4 )
+		return false;
+	xCode = 0;
+	for ( int i = 0; i < 4; i++ )
+	{
+		int C = (unsigned char)xAt[i];
+		if ( isdigit( C ) )
+			xCode = xCode << 4 | (C - '0');
+		else if ( 'A' <= C && C <= 'F' )
+			xCode = xCode << 4 | (C - 'A' + 10);
+		else if ( 'a' <= C && C <= 'f' )
+			xCode = xCode << 4 | (C - 'a' + 10);
+		else
+			return false;
+	}
+	return true;
+}
+
+const char *	// static
+jutf8::escape( const char *xAt, const char *xEnd, string& xOut )
+{
+	unsigned long Code, Low;
+	if ( !hex4( xAt, xEnd, Code ) )
+		return NULL;
+	xAt += 4;
+	if ( high( Code ) && xEnd - xAt >= 6 && xAt[0] == '\\' && xAt[1] == 'u' && hex4( xAt + 2, xEnd, Low ) && low( Low ) )
+	{
+		append( pair( Code, Low ), xOut );
+		return xAt + 6;
+	}
+	append( Code, xOut );
+	return xAt;
+}
+
+static bool	// after \\u: a pair of surrogates makes one character, as jutf8::escape() has it
+readUnicodeEscape( istream& is, string& xString, bool xStrict )
+{
+	size_t Code;
+	if ( !readHex4( is, Code ) )
+		return false;
+	while ( jutf8::high( Code ) && is.peek() == '\\' )
+	{
+		is.get();
+		if ( is.peek() != 'u' )
+		{
+			is.unget();	// some other escape: the caller reads it
+			break;
+		}
+		is.get();
+		size_t Low;
+		if ( !readHex4( is, Low ) )
+			return false;
+		if ( jutf8::low( Low ) )
+		{
+			jutf8::append( jutf8::pair( Code, Low ), xString );
+			return true;
+		}
+		if ( xStrict )
+			return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : unpaired surrogate in \\u escape" );
+		jutf8::append( Code, xString );
+		Code = Low;	// which may be the high half of the next pair
+	}
+	if ( xStrict && 0xD800 <= Code && Code <= 0xDFFF )
+		return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : unpaired surrogate in \\u escape" );
+	jutf8::append( Code, xString );
+	return true;
+}
+
+static bool	// strict: a raw byte below 0x20 or above 0x7F in a string
+strictCharacter( istream& is, int C, string& xString )
+{
+	if ( C < 0x20 )
+		return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : control character in string" );
+	unsigned char Bytes[4] = { (unsigned char)C };
+	size_t N = C >= 0xF0 ? 4 : (C >= 0xE0 ? 3 : 2);
+	size_t Got = 1;
+	while ( Got < N && (is.peek() & 0xC0) == 0x80 )	// EOF is not a continuation byte either
+		Bytes[Got++] = is.get();
+	if ( utf8Sequence( Bytes, Bytes + Got ) != N )
+		return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : invalid UTF-8 in string" );
+	xString.append( (const char *)Bytes, N );
+	return true;
+}
+
+static bool
+rawParseString( istream& is, string& xString )	// helper function for parseString, parsePair
+{
+	xString.clear();
+	int FirstC = flushSpace( is );
+	if ( FirstC != '"' )
+		return false;
+	is.get();	// flush the double quotes
+	bool Strict = strictParse( is );
+	parse_limits *L = limitsOf( is );
+	size_t Longest = L ? L->mMaxString : (size_t)-1;
+	for ( ;; )
+	{
+		if ( xString.size() > Longest )
+			return limitsString();
+		int C = is.get();
+		if ( C == EOF )
+			return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : found EOF inside string" );
+		if ( C == '"' )
+			break;
+		if ( C == '\\' )
+		{
+			switch( C = is.get() )
+			{
+				case 'b':
+					xString += '\b';
+					break;
 				case 'f':
 					xString += '\f';
 					break;
@@ -519,28 +1734,42 @@ rawParseString( istream& is, string& xString )	// helper function for parseStrin
 					xString += '\t';
 					break;
 				case EOF:
-					return false;
+					return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : found EOF inside string" );
 				case 'u':
-					utfEncode( readHex4( is ), xString ); // encode into UTF-8
+					if ( !readUnicodeEscape( is, xString, Strict ) ) // encode into UTF-8
+						return false;
 					break;
 				default:
+					if ( Strict && C != '"' && C != '\\' && C != '/' )
+						return parseError( is, JPARSE_BAD_STRING, "private_jvalue_data::parseString : unknown escape" );
 					xString += C;
 					break;
 			}
 		}
+		else if ( Strict && (C < 0x20 || C >= 0x80) )
+		{
+			if ( !strictCharacter( is, C, xString ) )
+				return false;
+		}
 		else
 			xString += C;
 	}
+	if ( xString.size() > Longest )
+		return limitsString();
 	return true;
 }
 
 bool
 private_jvalue_data::parseString( istream& is )
 {
-	string Answer;
+	static thread_local string Answer;	// keeps its capacity: one exact-size copy per string
 	if ( !rawParseString( is, Answer ) )
 		return false;
-	String( Answer.c_str() );
+	parse_limits *L;
+	if ( Answer.size() >= INLINE_STRING && (L = limitsOf( is )) )
+		if ( !limitsCharge( L, STRING_HEADER + Answer.size() + 1, 0 ) )
+			return false;
+	String( Answer.data(), Answer.size() );
 	return true;
 }
 
@@ -550,6 +1779,8 @@ private_jvalue_data::parseNumber( istream& is )
 	bool period = false;
 	bool exponent = false;
 	string Answer;
+	parse_limits *L = limitsOf( is );
+	size_t Longest = L ? L->mMaxString : (size_t)-1;
 
 	if ( is.peek() == '-' )
 	{
@@ -559,6 +1790,8 @@ private_jvalue_data::parseNumber( istream& is )
 
 	while ( !is.eof() )
 	{
+		if ( Answer.size() > Longest )
+			return limitsString();
 		int C = is.get();
 		if ( isdigit( C ) )
 			Answer += C;
@@ -580,11 +1813,11 @@ private_jvalue_data::parseNumber( istream& is )
 				Answer += C;
 				C = is.get();
 				if ( !isdigit( C ) )
-					throw jerr::error( "private_jvalue_data::parseNumber : missing digits in exponent" );
+					return parseError( is, JPARSE_BAD_NUMBER, "private_jvalue_data::parseNumber : missing digits in exponent" );
 				Answer += C;
 			}
 			else
-				throw jerr::error( "private_jvalue_data::parseNumber : bad exponential format" );
+				return parseError( is, JPARSE_BAD_NUMBER, "private_jvalue_data::parseNumber : bad exponential format" );
 			exponent = true;
 		}
 		else
@@ -593,9 +1826,20 @@ private_jvalue_data::parseNumber( istream& is )
 			break;
 		}
 	}
+	if ( Answer.size() > Longest )
+		return limitsString();
+
+	if ( strictParse( is ) )	// what was taken must be a number by the letter of the grammar
+	{
+		const unsigned char *P = (const unsigned char *)Answer.data();
+		if ( !scanNumber( P, P + Answer.size() ) || P != (const unsigned char *)Answer.data() + Answer.size() )
+			return parseError( is, JPARSE_BAD_NUMBER, "private_jvalue_data::parseNumber : not a json number" );
+	}
 
 	if ( period | exponent )
 		Double( atof( Answer.c_str() ) );
+	else if ( Answer[0] != '-' && Answer.size() >= 19 )	// may not fit in a long long
+		Number( strtoull( Answer.c_str(), NULL, 10 ) );
 	else
 		Integer( atoll( Answer.c_str() ) );
 
@@ -608,8 +1852,8 @@ private_jvalue_data::parseNull( istream& is )
 	char buffer[4];
 	is.read( buffer, sizeof(buffer) );
 
-	if ( strncasecmp( "null", buffer, 4 ) != 0 )
-		throw jerr::error( "private_jvalue_data::parseNull : string is not 'null'" );
+	if ( (strictParse( is ) ? strncmp : strncasecmp)( "null", buffer, 4 ) != 0 )
+		return parseError( is, JPARSE_BAD_LITERAL, "private_jvalue_data::parseNull : string is not 'null'" );
 
 	Null();
 
@@ -622,8 +1866,8 @@ private_jvalue_data::parseTrue( istream& is )
 	char buffer[4];
 	is.read( buffer, sizeof(buffer) );
 
-	if ( strncasecmp( "true", buffer, sizeof(buffer) ) != 0 )
-		throw jerr::error( "private_jvalue_data::parseTrue : string is not 'true'" );
+	if ( (strictParse( is ) ? strncmp : strncasecmp)( "true", buffer, sizeof(buffer) ) != 0 )
+		return parseError( is, JPARSE_BAD_LITERAL, "private_jvalue_data::parseTrue : string is not 'true'" );
 
 	Bool( true );
 
@@ -636,8 +1880,8 @@ private_jvalue_data::parseFalse( istream& is )
 	char buffer[5];
 	is.read( buffer, sizeof(buffer) );
 
-	if ( strncasecmp( "false", buffer, sizeof(buffer) ) != 0 )
-		throw jerr::error( "private_jvalue_data::parseNull : string is not 'false'" );
+	if ( (strictParse( is ) ? strncmp : strncasecmp)( "false", buffer, sizeof(buffer) ) != 0 )
+		return parseError( is, JPARSE_BAD_LITERAL, "private_jvalue_data::parseNull : string is not 'false'" );
 
 	Bool( false );
 
@@ -653,14 +1897,17 @@ private_jvalue_data::parsePair( istream& is )	// helper function for parseObject
 	string Name;
 	if ( !rawParseString( is, Name ) )
 		return false;
+	if ( parse_limits *L = limitsOf( is ) )
+		if ( !limitsCharge( L, MAP_NODE_BYTES + heapBytes( Name ), 0 ) )
+			return false;
 	flushSpace( is );
 	int C = is.get();
 	if ( C != ':' )
 		return false;
 	jvalue Value;
-	if ( !Value.parse( is ) )
+	if ( !Value->parse( is ) )
 		return false;
-	(*this)[Name] = Value;
+	insert( std::move( Name ), std::move( Value ) );
 	return true;
 }
 
@@ -669,10 +1916,16 @@ private_jvalue_data::parseObject( istream& is )
 {
 	int FirstC = is.get();
 	if ( FirstC != '{' )
-		throw jerr::error( "private_jvalue_data::parseObject : first character is not '{'" );
+		return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : first character is not '{'" );
+	limits_depth Depth( limitsOf( is ) );
+	if ( !Depth.mOK )
+		return false;
+	if ( Depth.mLimits )
+		if ( !limitsCharge( Depth.mLimits, sizeof(object_map_t), 0 ) )
+			return false;
 	deleteValue();
 	mType = JOBJECT;
-	mValue.mObject = new object_map_t;
+	mValue.mObject = newObject();
 	unlock();
 	flushSpace( is );
 	int SecondC = is.peek();	// nothing in the object?
@@ -684,13 +1937,13 @@ private_jvalue_data::parseObject( istream& is )
 	for ( ;; )
 	{
 		if ( !parsePair( is ) )
-			throw jerr::error( "private_jvalue_data::parseObject : bad pair in object" );
+			return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : bad pair in object" );
 		flushSpace( is );
 		int LastC = is.get();
 		if ( LastC == '}' )
 			break;
 		if ( LastC != ',' )
-			throw jerr::error( "private_jvalue_data::parseObject : missing comma" );
+			return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : missing comma" );
 	}
 	return true;
 }
@@ -700,11 +1953,17 @@ private_jvalue_data::parseArray( istream& is )
 {
 	int FirstC = is.get();
 	if ( FirstC != '[' )
-		throw jerr::error( "private_jvalue_data::parseArray : first character is not '['" );
+		return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : first character is not '['" );
+	limits_depth Depth( limitsOf( is ) );
+	if ( !Depth.mOK )
+		return false;
 	int LastC = flushSpace( is );
 	if ( LastC == ']' )
 	{
 		is.get();	// flush the ]
+		if ( Depth.mLimits && !limitsCharge( Depth.mLimits, sizeof(array_vector_t), 0 ) )
+			return false;
+		Array( NULL );	// empty, not null
 	}
 	else
 	{
@@ -712,20 +1971,483 @@ private_jvalue_data::parseArray( istream& is )
 		{
 			jvalue Value;
 			if ( !Value->parse( is ) )
-				throw jerr::error( "private_jvalue_data::parseArray : issue parsing value in array" );
-			push_back( Value );
+				return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : issue parsing value in array" );
+			if ( Depth.mLimits && (mType != JARRAY || mValue.mArray->size() == mValue.mArray->capacity()) )	// about to grow
+			{
+				size_t Capacity = mType == JARRAY ? mValue.mArray->capacity() : 0;
+				if ( !limitsCharge( Depth.mLimits, (Capacity ? Capacity : 1) * sizeof(jvalue) + (mType == JARRAY ? 0 : sizeof(array_vector_t)), 0 ) )
+					return false;
+			}
+			push_back( std::move( Value ) );
 			flushSpace( is );
 			LastC = is.get();
 			if ( LastC == ']' )
 				break;
 			if ( LastC != ',' )
-				throw jerr::error( "private_jvalue_data::parseArray : missing comma between values" );
+				return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : missing comma between values" );
+			flushSpace( is );
+		}
+	}
+	return true;
+}
+
+/*
+ * reparsing: the same grammar, written over the tree already there
+ *   a node held only by this tree is parsed into where it stands, so a
+ *   message shaped like the last one allocates nothing: members are found
+ *   by key, arrays keep their capacity, long strings their buffers when the
+ *   new text is no longer.  a node someone else holds a handle on is
+ *   replaced rather than changed under them
+ *
+ */
+
+bool
+private_jvalue_data::reparse( istream& is )
+{
+	int C = flushSpace( is );
+	if ( C != '"' && C != '{' && C != '[' )
+		return parse( is );	// scalars are set in place anyway
+	if ( parse_limits *L = limitsOf( is ) )
+		if ( !limitsCharge( L, NODE_BYTES, 1 ) )
+			return false;
+	if ( C == '"' ) return reparseString( is );
+	if ( C == '{' ) return reparseObject( is );
+	return reparseArray( is );
+}
+
+bool
+private_jvalue_data::reparseString( istream& is )
+{
+	static thread_local string Answer;
+	if ( !rawParseString( is, Answer ) )
+		return false;
+	size_t N = Answer.size();
+	if ( N >= INLINE_STRING )
+	{
+		if ( parse_limits *L = limitsOf( is ) )
+			if ( !limitsCharge( L, STRING_HEADER + N + 1, 0 ) )
+				return false;
+		if ( mType == JSTRING && mLength >= INLINE_STRING && N <= scapacity( mValue.mString ) )	// fits the buffer already held
+		{
+			lock(__LINE__);
+			memcpy( mValue.mString, Answer.data(), N );
+			mValue.mString[N] = '\0';
+			mLength = N;
+			unlock();
+			return true;
+		}
+	}
+	String( Answer.data(), N );
+	return true;
+}
+
+bool
+private_jvalue_data::reparsePair( istream& is )	// helper function for reparseObject
+{
+	int FirstC = flushSpace( is );
+	if ( FirstC == '}' )
+		return false;
+	static thread_local string Name;	// copied into the map only when new
+	if ( !rawParseString( is, Name ) )
+		return false;
+	if ( parse_limits *L = limitsOf( is ) )
+		if ( !limitsCharge( L, MAP_NODE_BYTES + Name.size(), 0 ) )	// roughly: a short key costs nothing extra
+			return false;
+	flushSpace( is );
+	int C = is.get();
+	if ( C != ':' )
+		return false;
+	object_map_t::iterator IT = mValue.mObject->lower_bound( Name );
+	bool OK;
+	if ( IT == mValue.mObject->end() || IT->first != Name )
+	{
+		IT = mValue.mObject->emplace_hint( IT, Name, jvalue() );	// before the value: it may reuse Name
+		OK = IT->second->parse( is );
+	}
+	else if ( IT->second.use_count() == 1 )
+		OK = IT->second->reparse( is );
+	else
+	{
+		jvalue Value;
+		OK = Value->parse( is );
+		IT->second = std::move( Value );
+	}
+	reparseSeen().push_back( IT->second.get() );
+	return OK;
+}
+
+bool
+private_jvalue_data::reparseObject( istream& is )
+{
+	int FirstC = is.get();
+	if ( FirstC != '{' )
+		return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : first character is not '{'" );
+	limits_depth Depth( limitsOf( is ) );
+	if ( !Depth.mOK )
+		return false;
+	if ( Depth.mLimits )
+		if ( !limitsCharge( Depth.mLimits, sizeof(object_map_t), 0 ) )
+			return false;
+	if ( mType == JOBJECT )
+	{
+		lock(__LINE__);
+		changedNL();
+	}
+	else
+	{
+		deleteValue();
+		mType = JOBJECT;
+		mValue.mObject = newObject();
+	}
+	unlock();
+	vector<const private_jvalue_data *>& Seen = reparseSeen();	// the members written, after those of the objects around this one
+	size_t Base = Seen.size();
+	flushSpace( is );
+	if ( is.peek() == '}' )
+		is.get();
+	else
+		for ( ;; )
+		{
+			if ( !reparsePair( is ) )
+				return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : bad pair in object" );
 			flushSpace( is );
+			int LastC = is.get();
+			if ( LastC == '}' )
+				break;
+			if ( LastC != ',' )
+				return parseError( is, JPARSE_BAD_OBJECT, "private_jvalue_data::parseObject : missing comma" );
+		}
+
+	sort( Seen.begin() + Base, Seen.end() );	// a key may come twice
+	size_t Written = unique( Seen.begin() + Base, Seen.end() ) - (Seen.begin() + Base);
+	if ( Written != mValue.mObject->size() )	// drop the members this text did not have
+		for ( object_map_t::iterator IT = mValue.mObject->begin(); IT != mValue.mObject->end(); )
+			if ( binary_search( Seen.begin() + Base, Seen.begin() + Base + Written, IT->second.get() ) )
+				++IT;
+			else
+				mValue.mObject->erase( IT++ );
+	Seen.resize( Base );
+	return true;
+}
+
+bool
+private_jvalue_data::reparseArray( istream& is )
+{
+	int FirstC = is.get();
+	if ( FirstC != '[' )
+		return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : first character is not '['" );
+	limits_depth Depth( limitsOf( is ) );
+	if ( !Depth.mOK )
+		return false;
+	if ( mType == JARRAY )
+	{
+		lock(__LINE__);
+		changedNL();
+	}
+	else
+	{
+		deleteValue();
+		mType = JARRAY;
+		mValue.mArray = newArray();
+	}
+	unlock();
+	if ( Depth.mLimits )
+		if ( !limitsCharge( Depth.mLimits, sizeof(array_vector_t), 0 ) )
+			return false;
+	array_vector_t& A = *mValue.mArray;
+	size_t N = 0;
+	if ( flushSpace( is ) == ']' )
+		is.get();	// flush the ]: empty, as parse() has it
+	else for ( ;; )
+	{
+		if ( Depth.mLimits )
+			if ( !limitsCharge( Depth.mLimits, sizeof(jvalue), 0 ) )
+				return false;
+		bool OK;
+		if ( N < A.size() && A[N].use_count() == 1 )
+			OK = A[N]->reparse( is );
+		else
+		{
+			jvalue Value;
+			OK = Value->parse( is );
+			if ( N < A.size() )
+				A[N] = std::move( Value );
+			else
+				A.push_back( std::move( Value ) );
+		}
+		if ( !OK )
+			return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : issue parsing value in array" );
+		N++;
+		flushSpace( is );
+		int LastC = is.get();
+		if ( LastC == ']' )
+			break;
+		if ( LastC != ',' )
+			return parseError( is, JPARSE_BAD_ARRAY, "private_jvalue_data::parseArray : missing comma between values" );
+		flushSpace( is );
+	}
+	if ( N < A.size() )
+		A.erase( A.begin() + N, A.end() );	// the capacity stays
+	return true;
+}
+
+/*
+ * validation: strict json over a buffer without building anything
+ *   string bodies, most of the bytes in most documents, are skipped a block
+ *   at a time until a quote, backslash, control or non-ASCII byte turns up;
+ *   the grammar around them is a loop with an explicit stack, so depth costs
+ *   no recursion
+ *
+ */
+
+static inline bool
+invalid( const char *&xWhy, const char *xReason )
+{
+	xWhy = xReason;
+	return false;
+}
+
+static inline const unsigned char *	// the first byte from xAt a string body has to look at
+scanString( const unsigned char *xAt, const unsigned char *xEnd )
+{
+#ifdef __SSE2__
+	const __m128i Quote = _mm_set1_epi8( '"' );
+	const __m128i Backslash = _mm_set1_epi8( '\\' );
+	const __m128i Space = _mm_set1_epi8( 0x20 );
+	for ( ; xEnd - xAt >= 16; xAt += 16 )
+	{
+		__m128i V = _mm_loadu_si128( (const __m128i *)xAt );
+		__m128i Stop = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( V, Quote ), _mm_cmpeq_epi8( V, Backslash ) ),
+			_mm_cmplt_epi8( V, Space ) );	// signed: bytes from 0x80 up count as below 0x20 too
+		if ( int Mask = _mm_movemask_epi8( Stop ) )
+			return xAt + __builtin_ctz( Mask );
+	}
+#else
+	const uint64_t Ones = 0x0101010101010101ULL;
+	const uint64_t Highs = 0x8080808080808080ULL;
+	for ( ; xEnd - xAt >= 8; xAt += 8 )
+	{
+		uint64_t V;
+		memcpy( &V, xAt, sizeof( V ) );
+		uint64_t Q = V ^ (Ones * '"');
+		uint64_t B = V ^ (Ones * '\\');
+		uint64_t Stop = ((Q - Ones) & ~Q) | ((B - Ones) & ~B) | (V - Ones * 0x20) | V;	// a zero byte, a small one, or a high bit
+		if ( Stop & Highs )	// somewhere in these 8, or a false alarm
+			for ( int i = 0; i < 8; i++ )
+				if ( xAt[i] == '"' || xAt[i] == '\\' || xAt[i] < 0x20 || xAt[i] >= 0x80 )
+					return xAt + i;
+	}
+#endif
+	while ( xAt < xEnd && *xAt != '"' && *xAt != '\\' && 0x20 <= *xAt && *xAt < 0x80 )
+		xAt++;
+	return xAt;
+}
+
+static inline int
+hexDigit( unsigned char C )
+{
+	if ( isdigit( C ) )
+		return C - '0';
+	if ( 'A' <= C && C <= 'F' )
+		return C - 'A' + 10;
+	if ( 'a' <= C && C <= 'f' )
+		return C - 'a' + 10;
+	return -1;
+}
+
+static bool	// xAt at the 'u' of \uXXXX; left after it
+scanHex4( const unsigned char *&xAt, const unsigned char *xEnd, unsigned int& xCode )
+{
+	if ( xEnd - xAt < 5 )
+		return false;
+	xCode = 0;
+	for ( int i = 1; i <= 4; i++ )
+	{
+		int D = hexDigit( xAt[i] );
+		if ( D < 0 )
+			return false;
+		xCode = (xCode << 4) | D;
+	}
+	xAt += 5;
+	return true;
+}
+
+static bool	// xAt at the opening quote; left after the closing one
+scanStringBody( const unsigned char *&xAt, const unsigned char *xEnd, const char *&xWhy )
+{
+	const unsigned char *P = xAt + 1;
+	for ( ;; )
+	{
+		P = scanString( P, xEnd );
+		xAt = P;
+		if ( P == xEnd )
+			return invalid( xWhy, "unterminated string" );
+		if ( *P == '"' )
+			break;
+		if ( *P == '\\' )
+		{
+			if ( ++P == xEnd )
+				return invalid( xWhy, "unterminated string" );
+			switch( *P )
+			{
+				case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+					P++;
+					continue;
+				case 'u':
+					break;
+				default:
+					return invalid( xWhy, "unknown escape" );
+			}
+			unsigned int Code, Low;
+			if ( !scanHex4( P, xEnd, Code ) )
+				return invalid( xWhy, "bad \\u escape" );
+			if ( 0xDC00 <= Code && Code <= 0xDFFF )
+				return invalid( xWhy, "unpaired surrogate in \\u escape" );
+			if ( 0xD800 <= Code && Code <= 0xDBFF )
+			{
+				if ( xEnd - P < 2 || P[0] != '\\' || P[1] != 'u' )
+					return invalid( xWhy, "unpaired surrogate in \\u escape" );
+				P++;
+				if ( !scanHex4( P, xEnd, Low ) )
+					return invalid( xWhy, "bad \\u escape" );
+				if ( Low < 0xDC00 || 0xDFFF < Low )
+					return invalid( xWhy, "unpaired surrogate in \\u escape" );
+			}
+			continue;
 		}
+		if ( *P < 0x20 )
+			return invalid( xWhy, "control character in string" );
+		size_t N = utf8Sequence( P, xEnd );
+		if ( N == 0 )
+			return invalid( xWhy, "invalid UTF-8 in string" );
+		P += N;
 	}
+	xAt = P + 1;
+	return true;
+}
+
+static inline const unsigned char *
+skipSpace( const unsigned char *xAt, const unsigned char *xEnd )
+{
+	while ( xAt < xEnd && jsonSpace( *xAt ) )
+		xAt++;
+	return xAt;
+}
+
+static bool	// xAt where a key should start; left after its ':'
+scanKey( const unsigned char *&xAt, const unsigned char *xEnd, const char *&xWhy )
+{
+	xAt = skipSpace( xAt, xEnd );
+	if ( xAt == xEnd || *xAt != '"' )
+		return invalid( xWhy, "expected a string key" );
+	if ( !scanStringBody( xAt, xEnd, xWhy ) )
+		return false;
+	xAt = skipSpace( xAt, xEnd );
+	if ( xAt == xEnd || *xAt != ':' )
+		return invalid( xWhy, "expected ':'" );
+	xAt++;
 	return true;
 }
 
+bool	// static
+jvalue::validate( const char *xData, size_t xLength, size_t *xOffset, const char **xReason )
+{
+	const unsigned char *Begin = (const unsigned char *)xData;
+	const unsigned char *End = Begin + xLength;
+	const unsigned char *P = Begin;
+	const char *Why = NULL;
+	string Open;	// '{' or '[' for each container not yet closed
+
+	for ( ;; )
+	{
+		// a value starts here
+		P = skipSpace( P, End );
+		if ( P == End )
+		{
+			Why = "expected a value";
+			break;
+		}
+		unsigned char C = *P;
+		if ( C == '{' || C == '[' )
+		{
+			P = skipSpace( P + 1, End );
+			if ( P < End && *P == (C == '{' ? '}' : ']') )
+				P++;	// empty: complete already
+			else
+			{
+				Open += C;
+				if ( C == '{' && !scanKey( P, End, Why ) )
+					break;
+				continue;
+			}
+		}
+		else if ( C == '"' )
+		{
+			if ( !scanStringBody( P, End, Why ) )
+				break;
+		}
+		else if ( C == '-' || jsonDigit( C ) )
+		{
+			if ( !scanNumber( P, End ) )
+			{
+				Why = "bad number";
+				break;
+			}
+		}
+		else if ( End - P >= 4 && (memcmp( P, "true", 4 ) == 0 || memcmp( P, "null", 4 ) == 0) )
+			P += 4;
+		else if ( End - P >= 5 && memcmp( P, "false", 5 ) == 0 )
+			P += 5;
+		else
+		{
+			Why = "expected a value";
+			break;
+		}
+
+		// a value ended: then a comma, a closing bracket, or the end of the text
+		for ( ;; )
+		{
+			P = skipSpace( P, End );
+			if ( Open.empty() )
+			{
+				if ( P == End )
+				{
+					if ( xOffset ) *xOffset = xLength;
+					if ( xReason ) *xReason = NULL;
+					return true;
+				}
+				Why = "text after the value";
+				break;
+			}
+			if ( P == End )
+			{
+				Why = Open[Open.size() - 1] == '{' ? "unterminated object" : "unterminated array";
+				break;
+			}
+			if ( *P == (Open[Open.size() - 1] == '{' ? '}' : ']') )
+			{
+				P++;
+				Open.resize( Open.size() - 1 );
+				continue;
+			}
+			if ( *P != ',' )
+			{
+				Why = Open[Open.size() - 1] == '{' ? "expected ',' or '}'" : "expected ',' or ']'";
+				break;
+			}
+			P++;
+			if ( Open[Open.size() - 1] == '{' && !scanKey( P, End, Why ) )
+				break;
+			break;	// the next value
+		}
+		if ( Why )
+			break;
+	}
+	if ( xOffset ) *xOffset = P - Begin;
+	if ( xReason ) *xReason = Why;
+	return false;
+}
+
 #if 0
 #ifndef SINGLE_THREAD
 static mutex ONE;
@@ -17,7 +17,6 @@
  *            will not cause error during delete, but objects will not be deleted, causing memory-leak
  *
  * DOES NOT CURRENTLY IMPLEMENT THESE ASPECTS OF THE JSON GRAMMAR:
- *   missing: unsigned long long
  *   missing: long long long
  *
  * use:
@@ -34,35 +33,144 @@
  *   A[1]["xyz"] = 3;		// update the object in A[1] with another entry
  *   cout << B << endl;		// produces [2, {"abc":2 "xyz":3}]
  *
+ * moving:
+ *   A.push_back( std::move( V ) );			// no reference-count traffic
+ *   A.insert( std::move( Key ), std::move( V ) );	// the map node keeps Key's buffer
+ *   a moved-from jvalue holds no value: assign to it (V = 5, V = Other) before using it again
+ *
+ * locking:
+ *   each value embeds a pthread mutex by default
+ *   -DJVALUE_STRIPED_LOCKS hashes values onto a shared table of padded mutexes instead
+ *     (56 -> 16 bytes per value on x86_64, no pthread_mutex_init/destroy per value)
+ *   -DSINGLE_THREAD drops locking altogether
+ *
+ * print cache:
+ *   A->printCache( true );	// containers under A keep their printed text
+ *   cout << A;			// prints, filling the caches
+ *   A["list"][3] = 7;		// drops the text of A and A["list"] only
+ *   cout << A;			// reprints those two, copies the rest
+ *   a container's text is dropped whenever it goes through operator[], push_back,
+ *   insert or a setter; a change made through a handle held on a child, or through
+ *   Object()/Array(), is not seen by its parents: call changed() on each of them
+ *   (or printCache( false ) then true on the root).  costs memory: each level of
+ *   the tree keeps its own copy of its text
+ *
+ * deep equality and hashing:
+ *   A.equals( B )		// same structure and values: 1 == 1.0, member order does not matter
+ *   A.compare( B )		// <0, 0, >0; null < bool < number < string < binary < array < object
+ *   A.hash()			// 64 bits, the same in every run; A.equals( B ) implies equal hashes
+ *   A == B			// still "the same node"
+ *   unordered_set<jvalue, jvalue_hash, jvalue_equal> holds one of each distinct document
+ *   A.hashCache();		// containers under A keep their hash, dropped as the print cache is;
+ *				// unchanged subtrees then cost one lookup, and equals() between two
+ *				// trees with different cached hashes returns at once
+ *
+ * strict parsing:
+ *   by default the parser is forgiving: "NULL", ".5", "01", control characters and
+ *   invalid UTF-8 in strings, and \q for q are all taken as they come
+ *   jvalue::validate( Body )	// RFC 8259 exactly, UTF-8 and surrogate pairs included;
+ *				// no tree is built, strings are scanned 16 bytes at a time
+ *   jvalue::strict( is );	// values parsed from is get the same checks, and throw
+ *
+ * memory and limits:
+ *   A.memoryUsage()		// heap bytes held by A: nodes and their shared_ptr control
+ *				// blocks, long strings, map entries and keys, vector capacity,
+ *				// cached print text; a node reachable twice counts once
+ *   jlimits L;
+ *   L.mBytes = 1 << 20; L.mDepth = 64; L.mString = 4096; L.mElements = 100000;
+ *   jvalue::limits( is, L );	// each parse() from is throws as soon as the document it is
+ *				// reading would pass one, before allocating for it; the byte
+ *				// count is memoryUsage() of what is built so far.  0 is no limit
+ *
+ * errors:
+ *   parse() throws a jerr (one per thread) for bad input; underneath, the parser returns
+ *   false up the stack and keeps the first error, so nothing unwinds through it
+ *   jparse_status S;
+ *   if ( !V.parse( is, S ) && S.mCode != JPARSE_EMPTY )	// never throws a jerr
+ *       cerr << S.mMessage << " at line " << S.mLine << ", column " << S.mColumn;
+ *				// S.mOffset counts bytes from where the parse began; offset, line
+ *				// and column need a stream that can seek: the bytes from where the
+ *				// parse began to the error are read again to count lines, and the
+ *				// stream is then put back where the parse stopped
+ *
+ * reparsing:
+ *   while ( Msg.reparse( is ) )	// like parse(), but writes over the tree Msg already holds:
+ *       handle( Msg );		// nodes, map entries, vector capacity and long string buffers
+ *				// are kept where the new text has the same shape, so a stream of
+ *				// alike messages parses with next to no allocation.  members the
+ *				// text lacks are erased; a node with a handle held elsewhere is
+ *				// replaced, not overwritten.  handles held to Msg itself see the change
+ *
  * comments:
  *   has seperate holders for integer and doubles
- *   all integer types mapped onto long long (so no unsigned long long)
+ *   integer types mapped onto long long; unsigned values that do not fit become JUNSIGNED
+ *   JBINARY holds raw bytes (from CBOR/MessagePack); printed as a base64 json string
+ *   strings keep their length (so size() is O(1) and \u0000 survives); strings under
+ *     8 bytes are stored inside the value itself, longer ones on the heap
  *   could implement "copy" function to actually make a complete copy when desired
  *
  */
 
 // #define SINGLE_THREAD
+// #define JVALUE_STRIPED_LOCKS	// share a table of padded mutexes instead of one mutex per value
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <map>
+#include <unordered_set>
 #include <vector>
 
 #ifndef SINGLE_THREAD
 #include "mutex.h"
 #endif
+#include "jstats.h"	// JSTAT() hooks, compiled away unless JVALUE_STATS
 
 using namespace std;
 class jvalue;
 
 typedef map<string,jvalue> object_map_t;
 typedef vector<jvalue> array_vector_t;
+typedef string binary_t;	// raw bytes, not necessarily text
+
+enum jparse_code	// what parse( is, jparse_status& ) found
+{
+	JPARSE_OK,
+	JPARSE_EMPTY,		// only white space before the end of input: not an error
+	JPARSE_BAD_CHARACTER,	// no value starts with it
+	JPARSE_BAD_LITERAL,	// not null, true or false
+	JPARSE_BAD_NUMBER,
+	JPARSE_BAD_STRING,	// escapes; control characters, UTF-8 and surrogates when strict()
+	JPARSE_BAD_OBJECT,	// a pair or comma
+	JPARSE_BAD_ARRAY,
+	JPARSE_TRUNCATED,	// the input ended inside a value
+	JPARSE_LIMIT		// one of limits() passed
+};
 
-enum jType { JNULL, JBOOL, JSTRING, JINTEGER, JDOUBLE, JOBJECT, JARRAY, JBAD };
+struct jparse_status
+{
+	jparse_code mCode;
+	char        mMessage[80];	// what parse( is ) throws; a copy, so the status can be kept and passed between threads
+	size_t      mOffset;	// bytes read when the error showed: the culprit is the last, or the next; -1 if the stream cannot seek
+	size_t      mLine;		// of that point, from 1; 0 if the stream cannot seek
+	size_t      mColumn;	// in bytes, from 1
+};
+
+struct jlimits	// for jvalue::limits(); 0 is no limit
+{
+	jlimits() : mBytes( 0 ), mDepth( 0 ), mString( 0 ), mElements( 0 ) {}
+	size_t mBytes;		// memoryUsage() of the document being read
+	size_t mDepth;		// objects and arrays inside one another
+	size_t mString;		// bytes in one string, key or number
+	size_t mElements;	// values, containers and the root included
+};
+
+enum jType { JNULL, JBOOL, JSTRING, JINTEGER, JDOUBLE, JOBJECT, JARRAY, JUNSIGNED, JBINARY, JBAD };
 
 class jerr
 {
@@ -77,6 +185,27 @@ class jerr
 		const char *mMsg;
 };
 
+/*
+ * \u escapes into UTF-8, shared by every parser here so that all of them
+ * build the same string: a high surrogate escape followed at once by a low
+ * one is a single 4-byte character; any other surrogate is written on its
+ * own, 3 bytes (strict parsing rejects those before they get here)
+ *
+ */
+
+class jutf8
+{
+	public:
+		static void append( unsigned long xCode, string& xOut );	// 1 to 4 bytes
+		// xAt is just past "\u": the escape, and a low half right after it, into xOut;
+		// returns where reading goes on, or NULL for a bad hex digit
+		static const char *escape( const char *xAt, const char *xEnd, string& xOut );
+
+		static bool high( unsigned long xCode ) { return 0xD800 <= xCode && xCode <= 0xDBFF; }
+		static bool low( unsigned long xCode )  { return 0xDC00 <= xCode && xCode <= 0xDFFF; }
+		static unsigned long pair( unsigned long xHigh, unsigned long xLow ) { return 0x10000 + ((xHigh - 0xD800) << 10) + (xLow - 0xDC00); }
+};
+
 class private_jvalue_data
 {
 
@@ -85,11 +214,11 @@ class private_jvalue_data
 		private_jvalue_data() : mType(JNULL)                             {}
 		private_jvalue_data( bool xValue ) : mType(JNULL)                { Bool( xValue ); }
 		private_jvalue_data( const char *xValue ) : mType(JNULL)         { String( xValue ); }
-		private_jvalue_data( const string& xValue ) : mType(JNULL)       { String( xValue.c_str() ); }
+		private_jvalue_data( const string& xValue ) : mType(JNULL)       { String( xValue.data(), xValue.size() ); }
 		private_jvalue_data( long long xValue ) : mType(JNULL)           { Integer( xValue ); }
 		private_jvalue_data( unsigned int xValue ) : mType(JNULL)        { Integer( xValue ); }
-		private_jvalue_data( unsigned long int xValue ) : mType(JNULL)   { Integer( xValue ); }
-		private_jvalue_data( unsigned long long xValue ) : mType(JNULL)  { Integer( xValue ); }
+		private_jvalue_data( unsigned long int xValue ) : mType(JNULL)   { Number( xValue ); }
+		private_jvalue_data( unsigned long long xValue ) : mType(JNULL)  { Number( xValue ); }
 		private_jvalue_data( int xValue ) : mType(JNULL)                 { Integer( xValue ); }
 		private_jvalue_data( char xValue ) : mType(JNULL)                { Integer( xValue ); }
 		private_jvalue_data( float xValue ) : mType(JNULL)               { Double( xValue ); }
@@ -104,15 +233,15 @@ class private_jvalue_data
 
 		private_jvalue_data& operator=( const private_jvalue_data& xData );
 
-		private_jvalue_data& operator=( const string& xValue )      {  String( xValue.c_str() ); return *this; }
+		private_jvalue_data& operator=( const string& xValue )      {  String( xValue.data(), xValue.size() ); return *this; }
 		private_jvalue_data& operator=( const char *xValue )        {  String( xValue ); return *this; }
 		private_jvalue_data& operator=( long long xValue )          { Integer( xValue ); return *this; }
 		private_jvalue_data& operator=( double xValue )             {  Double( xValue ); return *this; }
 		private_jvalue_data& operator=( bool xValue )               {    Bool( xValue ); return *this; }
 
 		private_jvalue_data& operator=( unsigned int xValue )       { return operator=( (long long)xValue ); }
-		private_jvalue_data& operator=( unsigned long int xValue )  { return operator=( (long long)xValue ); }
-		private_jvalue_data& operator=( unsigned long long xValue ) { return operator=( (long long)xValue ); }
+		private_jvalue_data& operator=( unsigned long int xValue )  { return operator=( (unsigned long long)xValue ); }
+		private_jvalue_data& operator=( unsigned long long xValue ) {  Number( xValue ); return *this; }
 		private_jvalue_data& operator=( int xValue )                { return operator=( (long long)xValue ); }
 		private_jvalue_data& operator=( char xValue )               { return operator=( (long long)xValue ); }
 		private_jvalue_data& operator=( float xValue )              { return operator=( (double)xValue ); }
@@ -120,6 +249,7 @@ class private_jvalue_data
 		jvalue& operator[]( size_t xPos );
 		jvalue& operator[]( const char *xString );
 		jvalue& operator[]( const string& xString )     { return operator[]( xString.c_str() ); }
+		jvalue& operator[]( string&& xString );	// a new key takes over xString's buffer
 
 		jvalue& operator[]( unsigned long long xValue ) { return operator[]( (size_t)xValue ); }
 		jvalue& operator[]( int xValue )                { if ( xValue < 0 ) throw jerr::error( "negative array index" ); return operator[]( (size_t)xValue ); }
@@ -127,38 +257,43 @@ class private_jvalue_data
 		jvalue& operator[]( char xValue )               { size_t V = xValue; V &= 0xFF; return operator[]( V ); }
 
 		// add elements to an Array
-		void push_back( const string& xValue ) { push_back( xValue.c_str() ); }
+		void push_back( const string& xValue );
 		void push_back( const char *xValue );
 		void push_back( long long xValue );
 		void push_back( double xValue );
 		void push_back( bool xValue );
-		void push_back( jvalue& xValue );
+		void push_back( const jvalue& xValue );
+		void push_back( jvalue&& xValue );	// moved in: no reference-count traffic
 
 		void push_back( unsigned int xValue )       { push_back( (long long)xValue ); }
-		void push_back( unsigned long int xValue )  { push_back( (long long)xValue ); }
+		void push_back( unsigned long int xValue )  { push_back( (unsigned long long)xValue ); }
 		void push_back( int xValue )                { push_back( (long long)xValue ); }
 		void push_back( char xValue )               { push_back( (long long)xValue ); }
 		void push_back( unsigned char xValue )      { push_back( (long long)xValue ); }
-		void push_back( unsigned long long xValue ) { push_back( (long long)xValue ); }
+		void push_back( unsigned long long xValue );
 		void push_back( float xValue )              { push_back( (double)xValue );    }
 
+		// add (or replace) an Object member, moving both key and value in
+		void insert( string&& xName, jvalue&& xValue );
+		void insert( const string& xName, const jvalue& xValue );
+
 		// comparisons
 
-		bool operator==( const string& xValue )      const { return strcmp( String(), xValue.c_str() ) == 0; }
-		bool operator==( const char *xValue )        const { return xValue ? strcmp( String(), xValue ) == 0 : false; }
+		bool operator==( const string& xValue )      const { return stringLength() == xValue.size() && memcmp( String(), xValue.data(), xValue.size() ) == 0; }
+		bool operator==( const char *xValue )        const { return xValue ? compareString( xValue, strlen( xValue ) ) == 0 : false; }
 		bool operator==( long long xValue )          const { return Integer() == xValue; }
 		bool operator==( double xValue )             const { return Double() == xValue; }
 		bool operator==( bool xValue )               const { return Bool() == xValue; }
 
 		bool operator==( unsigned int xValue )       const { return operator==( (long long)xValue ); }
-		bool operator==( unsigned long int xValue )  const { return operator==( (long long)xValue ); }
-		bool operator==( unsigned long long xValue ) const { return operator==( (long long)xValue ); }
+		bool operator==( unsigned long int xValue )  const { return operator==( (unsigned long long)xValue ); }
+		bool operator==( unsigned long long xValue ) const { return mType == JUNSIGNED ? mValue.mUnsigned == xValue : xValue <= LLONG_MAX && Integer() == (long long)xValue; }
 		bool operator==( int xValue )                const { return operator==( (long long)xValue ); }
 		bool operator==( char xValue )               const { return operator==( (long long)xValue ); }
 		bool operator==( float xValue )              const { return operator==( (double)xValue ); }
 
-		bool operator<=( const string& xValue )      const { return strcmp( String(), xValue.c_str() ) <= 0; }
-		bool operator<=( const char *xValue )        const { return xValue ? strcmp( String(), xValue ) <= 0 : false; }
+		bool operator<=( const string& xValue )      const { return compareString( xValue.data(), xValue.size() ) <= 0; }
+		bool operator<=( const char *xValue )        const { return xValue ? compareString( xValue, strlen( xValue ) ) <= 0 : false; }
 		bool operator<=( long long xValue )          const { return Integer() <= xValue; }
 		bool operator<=( double xValue )             const { return Double() <= xValue; }
 		bool operator<=( bool xValue )               const { return true; }
@@ -170,8 +305,8 @@ class private_jvalue_data
 		bool operator<=( char xValue )               const { return operator<=( (long long)xValue ); }
 		bool operator<=( float xValue )              const { return operator<=( (double)xValue ); }
 
-		bool operator<( const string& xValue )      const { return strcmp( String(), xValue.c_str() ) < 0; }
-		bool operator<( const char *xValue )        const { return xValue ? strcmp( String(), xValue ) < 0 : false; }
+		bool operator<( const string& xValue )      const { return compareString( xValue.data(), xValue.size() ) < 0; }
+		bool operator<( const char *xValue )        const { return xValue ? compareString( xValue, strlen( xValue ) ) < 0 : false; }
 		bool operator<( long long xValue )          const { return Integer() < xValue; }
 		bool operator<( double xValue )             const { return Double() < xValue; }
 		bool operator<( bool xValue )               const { return (int)Bool() < (int)xValue; }
@@ -186,19 +321,25 @@ class private_jvalue_data
 		// misc functions
 
 		bool            Bool()    const { return mType == JBOOL && mValue.mBool;            }
-		const char     *String()  const { return mType == JSTRING && mValue.mString ? mValue.mString : "";   }
-		long long       Integer() const { return mType == JINTEGER ? mValue.mInteger : (mType == JDOUBLE ? (long long)mValue.mDouble : (mType == JSTRING && mValue.mString ? atoll( mValue.mString ) : 0LL)); }
-		double          Double()  const { return mType == JDOUBLE  ? mValue.mDouble : (mType == JINTEGER ? (double)mValue.mInteger : (mType == JSTRING && mValue.mString ? atof( mValue.mString ) : 0.0)); }
+		const char     *String()  const { return mType == JSTRING ? stringNL() : "";   }
+		long long       Integer() const { return mType == JINTEGER ? mValue.mInteger : (mType == JUNSIGNED ? (long long)mValue.mUnsigned : (mType == JDOUBLE ? (long long)mValue.mDouble : (mType == JSTRING ? atoll( stringNL() ) : 0LL))); }
+		double          Double()  const { return mType == JDOUBLE  ? mValue.mDouble : (mType == JINTEGER ? (double)mValue.mInteger : (mType == JUNSIGNED ? (double)mValue.mUnsigned : (mType == JSTRING ? atof( stringNL() ) : 0.0))); }
+		unsigned long long Unsigned() const { return mType == JUNSIGNED ? mValue.mUnsigned : (mType == JSTRING ? strtoull( stringNL(), NULL, 10 ) : (unsigned long long)Integer()); }
+		const binary_t *Binary()  const { return mType == JBINARY  ? mValue.mBinary : NULL; }
 		object_map_t   *Object()  const { return mType == JOBJECT  ? mValue.mObject : NULL; }
 		array_vector_t *Array()   const { return mType == JARRAY   ? mValue.mArray : NULL;  }
 
 		void Null()                          { deleteValue(); mType = JNULL;                                                          unlock(); }
 		void Bool( bool xValue )             { deleteValue(); mType = JBOOL;    mValue.mBool = xValue;                                unlock(); }
-		void String( const char *xValue )    { deleteValue(); mType = JSTRING;  mValue.mString = scopy( xValue );                     unlock(); }
+		void String( const char *xValue )    { String( xValue ? xValue : "", xValue ? strlen( xValue ) : 0 ); }
+		void String( const char *xValue, size_t xLength ) { deleteValue(); setStringNL( xValue, xLength );                           unlock(); }	// may hold \0
 		void Integer( long long xValue )     { deleteValue(); mType = JINTEGER; mValue.mInteger = xValue;                             unlock(); }
 		void Double( double xValue )         { deleteValue(); mType = JDOUBLE;  mValue.mDouble = xValue;                              unlock(); }
-		void Object( object_map_t *xValue )  { deleteValue(); mType = JOBJECT;  mValue.mObject = xValue ? xValue : new object_map_t;  unlock(); }
-		void Array( array_vector_t *xValue ) { deleteValue(); mType = JARRAY;   mValue.mArray = xValue ? xValue : new array_vector_t; unlock(); }
+		void Object( object_map_t *xValue )  { deleteValue(); mType = JOBJECT;  mValue.mObject = xValue ? xValue : newObject();    unlock(); }
+		void Array( array_vector_t *xValue ) { deleteValue(); mType = JARRAY;   mValue.mArray = xValue ? xValue : newArray();      unlock(); }
+		void Unsigned( unsigned long long xValue )       { deleteValue(); mType = JUNSIGNED; mValue.mUnsigned = xValue;                    unlock(); }
+		void Binary( const void *xData, size_t xLength ) { deleteValue(); mType = JBINARY;   mValue.mBinary = new binary_t( (const char *)xData, xLength ); unlock(); }
+		void Number( unsigned long long xValue )         { if ( xValue > LLONG_MAX ) Unsigned( xValue ); else Integer( (long long)xValue ); }	// JINTEGER when it fits
 
 		jType type() const { return mType; }
 
@@ -219,6 +360,8 @@ class private_jvalue_data
 		bool isDouble() const  { return mType == JDOUBLE;  }
 		bool isObject() const  { return mType == JOBJECT;  }
 		bool isArray() const   { return mType == JARRAY;   }
+		bool isUnsigned() const { return mType == JUNSIGNED; }
+		bool isBinary() const  { return mType == JBINARY;  }
 
 		// THESE ONLY WORK IF JVALUE IS ALREADY AN OBJECT
 		// UNDEFINED BEHAVIOUR IF NOT
@@ -228,34 +371,70 @@ class private_jvalue_data
 		object_map_t::iterator end() { return mValue.mObject->end(); }
 
 		void print( ostream&, unsigned int xLevel = 0 ) const;
+
+		void printCache( bool xOn ) { cache( PRINT_CACHE, xOn ); }	// on: keep printed text for this subtree; off: drop it all
+		void changed() { lock(__LINE__); changedNL(); unlock(); }	// after editing through Object()/Array()
+
+		// deep structure: numbers compare by value (1 == 1.0), objects by key
+		bool equals( const private_jvalue_data& xOther ) const;
+		int compare( const private_jvalue_data& xOther ) const;	// a total order, consistent with equals
+		uint64_t hash() const;	// stable across runs; equal values hash alike
+		void hashCache( bool xOn ) { cache( HASH_CACHE, xOn ); }	// on: containers keep their hash until changed
+		size_t memoryUsage() const;	// heap bytes under this node, itself included
 		bool parse( istream& is );
+		bool reparse( istream& is );	// parse() into the tree already here, reusing what fits
 
 	protected:
 
 		union
 		{
 			bool            mBool;
-			char           *mString;
+			char           *mString;	// JSTRING of INLINE_STRING bytes or more
+			char            mInline[sizeof(char *)];	// shorter JSTRING, NUL-terminated
 			long long       mInteger;
 			double          mDouble;
 			object_map_t   *mObject;
 			array_vector_t *mArray;
+			unsigned long long mUnsigned;
+			binary_t       *mBinary;
 		} mValue;
 
 		jType mType;
+		unsigned int mLength;	// JSTRING bytes, container PRINT_ flags; sits in what was padding, so values stay the same size
 
-		#ifndef SINGLE_THREAD
+		#if !defined(SINGLE_THREAD) && !defined(JVALUE_STRIPED_LOCKS)
 			mutex mLockData;	// if mutable, unexpected optimizations occur
 		#endif
 
+		#ifdef JVALUE_STATS
+			jstats_node mStats;	// counts construction/destruction
+		#endif
+
 	private:
 
+		#ifdef JVALUE_STRIPED_LOCKS
+			mutex& lockData() { return mutex_stripes::forAddress( this ); }
+		#elif !defined(SINGLE_THREAD)
+			mutex& lockData() { return mLockData; }
+		#endif
+
 		#ifdef SINGLE_THREAD
 			void lock( int xLine ) {}
 			void unlock() {}
+		#elif defined(JVALUE_STATS)
+			void lock( int xLine )
+				{
+					if ( !lockData().trylock() )
+					{
+						JSTAT( JSTAT_LOCKS_CONTENDED, 1 );
+						lockData().lock();
+					}
+					JSTAT( JSTAT_LOCKS, 1 );
+				}
+			void unlock() { lockData().unlock(); }
 		#else
-			void lock( int xLine ) { mLockData.lock(); }
-			void unlock() { mLockData.unlock(); }
+			void lock( int xLine ) { lockData().lock(); }
+			void unlock() { lockData().unlock(); }
 		#endif
 
 		void deleteValue()
@@ -272,7 +451,40 @@ class private_jvalue_data
 			}
 		void toJARRAY_NL();
 
+		void append( const jvalue& xValue );	// push_back helpers
+		void append( jvalue&& xValue );
+
 		static char *scopy( const char *xIn );
+		static char *scopy( const char *xIn, size_t xLength );	// no strlen
+		static size_t scapacity( const char *xString );	// bytes scopy() made room for, less the NUL
+		static void sfree( char *xString );
+
+		enum { INLINE_STRING = sizeof(char *) };	// strings shorter than this live in mValue.mInline
+		enum { STRING_HEADER = sizeof(size_t) };	// a heap string's capacity sits just before its first byte
+
+		enum	// in mLength of a container
+		{
+			PRINT_CACHE = 1, PRINT_CACHED = 2, PRINT_SMALL = 4,	// text wanted, held, too short to keep
+			HASH_CACHE = 8, HASH_CACHED = 16, HASH_SMALL = 32	// hash wanted, held, too cheap to keep
+		};
+		enum { PRINT_CACHE_MIN = 64 };	// shorter text is cheaper to reprint than to keep
+		enum { HASH_CACHE_MIN = 64 };	// and a hash over fewer bytes and nodes is cheaper to redo
+		bool cachedNL() const { return (mType == JOBJECT || mType == JARRAY) && (mLength & (PRINT_CACHED | PRINT_SMALL | HASH_CACHED | HASH_SMALL)); }
+		void changedNL() { if ( cachedNL() ) dropCache(); }
+		void dropCache();
+		void cache( unsigned int xFlag, bool xOn );
+		void cacheChildren( unsigned int xFlag ) const;
+		void cacheFlag( unsigned int xFlag ) const;
+		void printCached( ostream&, unsigned int ) const;
+		bool cachedHash( uint64_t& xHash ) const;
+		uint64_t hash( size_t& xWork ) const;	// adds the bytes and nodes it went through
+		size_t memoryUsage( unordered_set<const private_jvalue_data *>& xShared ) const;	// nodes held twice are counted once
+		const char *stringNL() const { return mLength < INLINE_STRING ? mValue.mInline : mValue.mString; }
+		void setStringNL( const char *xValue, size_t xLength );	// mType and mLength too; value must be deleted
+		size_t stringLength() const { return mType == JSTRING ? mLength : 0; }
+		int compareString( const char *xValue, size_t xLength ) const;	// memcmp order, shorter first on a tie
+		static object_map_t *newObject( const object_map_t *xFrom = NULL );
+		static array_vector_t *newArray( const array_vector_t *xFrom = NULL );
 
 		void printObject( ostream&, unsigned int ) const;
 		void printArray( ostream&, unsigned int ) const;
@@ -285,6 +497,10 @@ class private_jvalue_data
 		bool parsePair(   istream& is );	// for objects
 		bool parseObject( istream& is );
 		bool parseArray(  istream& is );
+		bool reparseString( istream& is );
+		bool reparsePair(   istream& is );
+		bool reparseObject( istream& is );
+		bool reparseArray(  istream& is );
 
 };
 
@@ -310,20 +526,22 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		jvalue( bool xValue )               : shared_ptr<private_jvalue_data>( new private_jvalue_data( xValue ) ) {}
 
 		jvalue( const jvalue& xValue ) = default;
+		jvalue( jvalue&& xValue ) noexcept = default;	// lets vector<jvalue> move on growth
 
 		~jvalue() {}	// deletes shared_ptr, which may delete the associated private_jvalue_data
 
 		jvalue& operator=( const jvalue& xValue ) = default;
+		jvalue& operator=( jvalue&& xValue ) noexcept = default;
 
-		jvalue& operator=( const std::string& xValue ) { shared_ptr<private_jvalue_data>::get()->operator=( xValue ); return *this; }
-		jvalue& operator=( const char *xValue )        { shared_ptr<private_jvalue_data>::get()->operator=( xValue ); return *this; }
-		jvalue& operator=( long long xValue )          { shared_ptr<private_jvalue_data>::get()->operator=( xValue ); return *this; }
-		jvalue& operator=( double xValue )             { shared_ptr<private_jvalue_data>::get()->operator=( xValue ); return *this; }
-		jvalue& operator=( bool xValue )               { shared_ptr<private_jvalue_data>::get()->operator=( xValue ); return *this; }
+		jvalue& operator=( const std::string& xValue ) { assignable()->operator=( xValue ); return *this; }
+		jvalue& operator=( const char *xValue )        { assignable()->operator=( xValue ); return *this; }
+		jvalue& operator=( long long xValue )          { assignable()->operator=( xValue ); return *this; }
+		jvalue& operator=( double xValue )             { assignable()->operator=( xValue ); return *this; }
+		jvalue& operator=( bool xValue )               { assignable()->operator=( xValue ); return *this; }
 
 		jvalue& operator=( unsigned int xValue )       { return operator=( (long long)xValue ); }
-		jvalue& operator=( unsigned long int xValue )  { return operator=( (long long)xValue ); }
-		jvalue& operator=( unsigned long long xValue ) { return operator=( (long long)xValue ); }
+		jvalue& operator=( unsigned long int xValue )  { return operator=( (unsigned long long)xValue ); }
+		jvalue& operator=( unsigned long long xValue ) { assignable()->operator=( xValue ); return *this; }
 		jvalue& operator=( int xValue )                { return operator=( (long long)xValue ); }
 		jvalue& operator=( char xValue )               { return operator=( (long long)xValue ); }
 		jvalue& operator=( float xValue )              { return operator=( (double)xValue ); }
@@ -333,9 +551,10 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		jvalue& operator[]( long long xPos )             { return shared_ptr<private_jvalue_data>::get()->operator[]( (size_t)xPos ); }	// fixes problem with A[0]
 		jvalue& operator[]( const char *xString )        { return shared_ptr<private_jvalue_data>::get()->operator[]( xString ); }
 		jvalue& operator[]( const std::string& xString ) { return shared_ptr<private_jvalue_data>::get()->operator[]( xString ); }
+		jvalue& operator[]( std::string&& xString )      { return shared_ptr<private_jvalue_data>::get()->operator[]( std::move( xString ) ); }
 
 		// add elements to an Array
-		void push_back( const std::string& xValue ) { push_back( xValue.c_str() ); }
+		void push_back( const std::string& xValue ) { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
 		void push_back( const char *xValue )        { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
 		void push_back( long long xValue )          { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
 		void push_back( double xValue )             { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
@@ -349,7 +568,12 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		void push_back( unsigned long long xValue ) { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
 		void push_back( float xValue )              { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
 
-		void push_back( jvalue xValue )             { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
+		void push_back( const jvalue& xValue )      { shared_ptr<private_jvalue_data>::get()->push_back( xValue ); }
+		void push_back( jvalue&& xValue )           { shared_ptr<private_jvalue_data>::get()->push_back( std::move( xValue ) ); }
+
+		// add (or replace) an Object member; the rvalue form moves key and value in
+		void insert( std::string&& xName, jvalue&& xValue )        { shared_ptr<private_jvalue_data>::get()->insert( std::move( xName ), std::move( xValue ) ); }
+		void insert( const std::string& xName, const jvalue& xValue ) { shared_ptr<private_jvalue_data>::get()->insert( xName, xValue ); }
 
 		// compare various things
 
@@ -360,8 +584,8 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		bool operator==( bool xValue )               const { return shared_ptr<private_jvalue_data>::get()->operator==( xValue ); }
 
 		bool operator==( unsigned int xValue )       const { return operator==( (long long)xValue ); }
-		bool operator==( unsigned long int xValue )  const { return operator==( (long long)xValue ); }
-		bool operator==( unsigned long long xValue ) const { return operator==( (long long)xValue ); }
+		bool operator==( unsigned long int xValue )  const { return operator==( (unsigned long long)xValue ); }
+		bool operator==( unsigned long long xValue ) const { return shared_ptr<private_jvalue_data>::get()->operator==( xValue ); }
 		bool operator==( int xValue )                const { return operator==( (long long)xValue ); }
 		bool operator==( char xValue )               const { return operator==( (long long)xValue ); }
 		bool operator==( float xValue )              const { return operator==( (double)xValue ); }
@@ -405,6 +629,8 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		bool isDouble() const  { return type() == JDOUBLE;  }
 		bool isObject() const  { return type() == JOBJECT;  }
 		bool isArray() const   { return type() == JARRAY;   }
+		bool isUnsigned() const { return type() == JUNSIGNED; }
+		bool isBinary() const  { return type() == JBINARY;  }
 
 		bool            Bool()    { return shared_ptr<private_jvalue_data>::get()->Bool()    ; }
 		const char     *String()  { return shared_ptr<private_jvalue_data>::get()->String()  ; }
@@ -412,29 +638,65 @@ class jvalue : public shared_ptr<private_jvalue_data>		// a jvalue is only an ov
 		double          Double()  { return shared_ptr<private_jvalue_data>::get()->Double()  ; }
 		object_map_t   *Object()  { return shared_ptr<private_jvalue_data>::get()->Object()  ; }
 		array_vector_t *Array()   { return shared_ptr<private_jvalue_data>::get()->Array()   ; }
+		unsigned long long Unsigned() { return shared_ptr<private_jvalue_data>::get()->Unsigned(); }
+		const binary_t *Binary()  { return shared_ptr<private_jvalue_data>::get()->Binary()  ; }
 
 		void Null()                          { shared_ptr<private_jvalue_data>::get()->Null();            }
 		void Bool( bool xValue )             { shared_ptr<private_jvalue_data>::get()->Bool(    xValue ); }
 		void String( const char *xValue )    { shared_ptr<private_jvalue_data>::get()->String(  xValue ); }
+		void String( const char *xValue, size_t xLength ) { shared_ptr<private_jvalue_data>::get()->String( xValue, xLength ); }
 		void Integer( long long xValue )     { shared_ptr<private_jvalue_data>::get()->Integer( xValue ); }
 		void Double( double xValue )         { shared_ptr<private_jvalue_data>::get()->Double(  xValue ); }
 		void Object( object_map_t *xValue )  { shared_ptr<private_jvalue_data>::get()->Object(  xValue ); }
 		void Array( array_vector_t *xValue ) { shared_ptr<private_jvalue_data>::get()->Array(   xValue ); }
+		void Unsigned( unsigned long long xValue )       { shared_ptr<private_jvalue_data>::get()->Unsigned( xValue ); }
+		void Binary( const void *xData, size_t xLength ) { shared_ptr<private_jvalue_data>::get()->Binary( xData, xLength ); }
+		void Number( unsigned long long xValue )         { shared_ptr<private_jvalue_data>::get()->Number( xValue ); }
 
 		// THESE ONLY WORK IF JVALUE IS ALREADY AN OBJECT
 		object_map_t::const_iterator begin() const { return shared_ptr<private_jvalue_data>::get()->begin(); }
 		object_map_t::const_iterator end() const { return shared_ptr<private_jvalue_data>::get()->end(); }
 
-		void print( std::ostream& os ) const { shared_ptr<private_jvalue_data>::get()->print( os ); }
-		bool parse( std::istream& is ) { return shared_ptr<private_jvalue_data>::get()->parse( is ); }
+		void print( std::ostream& os ) const;
+		bool parse( std::istream& is );	// false at the end of input; throws on an error
+		bool reparse( std::istream& is );	// the same, reusing this tree's nodes and buffers where the shape matches
+		bool parse( std::istream& is, jparse_status& xStatus );	// never throws a jerr: false, and xStatus says why
+		bool reparse( std::istream& is, jparse_status& xStatus );
+
+		// strict RFC 8259 and UTF-8 over a whole buffer, building nothing; on failure
+		// *xOffset is the offending byte and *xReason says what is wrong with it
+		static bool validate( const char *xData, size_t xLength, size_t *xOffset = NULL, const char **xReason = NULL );
+		static bool validate( const std::string& xText, size_t *xOffset = NULL, const char **xReason = NULL )
+			{ return validate( xText.data(), xText.size(), xOffset, xReason ); }
+		static void strict( std::istream& is, bool xOn = true );	// parse() from is checks what validate() does
+		static void limits( std::istream& is, const jlimits& xLimits );	// parse() from is stops at these
+
+		size_t memoryUsage() const { return get()->memoryUsage(); }
+
+		void printCache( bool xOn = true ) { shared_ptr<private_jvalue_data>::get()->printCache( xOn ); }
+		void changed()                     { shared_ptr<private_jvalue_data>::get()->changed(); }
+
+		// deep comparison; operator== on two jvalues still compares the pointers
+		bool equals( const jvalue& xOther ) const  { return get() == xOther.get() || get()->equals( *xOther ); }
+		int compare( const jvalue& xOther ) const  { return get() == xOther.get() ? 0 : get()->compare( *xOther ); }
+		uint64_t hash() const                      { return get()->hash(); }
+		void hashCache( bool xOn = true )          { get()->hashCache( xOn ); }
 
 		void print() const { cout << *this << endl; }
 
+	private:
+		private_jvalue_data *assignable()	// a moved-from handle gets a node of its own again
+			{ if ( !get() ) reset( new private_jvalue_data() ); return get(); }
 };
 
 inline std::ostream& operator<<( std::ostream& os, const jvalue& xJV )
 	{ xJV.print( os ); return os; }
 
+// for documents as keys: unordered_map<jvalue, T, jvalue_hash, jvalue_equal>, map<jvalue, T, jvalue_less>
+struct jvalue_hash  { size_t operator()( const jvalue& xValue ) const { return (size_t)xValue.hash(); } };
+struct jvalue_equal { bool operator()( const jvalue& xA, const jvalue& xB ) const { return xA.equals( xB ); } };
+struct jvalue_less  { bool operator()( const jvalue& xA, const jvalue& xB ) const { return xA.compare( xB ) < 0; } };
+
 inline std::istream& operator>>( std::istream& is, jvalue& xJV )
 	{ xJV.parse( is ); return is; }
 
@@ -4,7 +4,9 @@
 void
 lock( mutex& x1, mutex& x2 )
 {
-	if ( &x1 < &x2 )	// defined order
+	if ( &x1 == &x2 )	// same stripe
+		x1.lock();
+	else if ( &x1 < &x2 )	// defined order
 	{
 		x1.lock();
 		x2.lock();
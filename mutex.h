@@ -3,6 +3,7 @@
 #define mutexHeader
 
 #include <pthread.h>
+#include <stdint.h>
 
 // wrapper for mutex functions
 
@@ -25,9 +26,29 @@ class mutex
 		pthread_mutex_t mMutex;
 };
 
+// fixed table of cache-line padded mutexes, chosen by hashing an address
+//   lets many small objects share a few locks instead of embedding one each
+//   two objects may share a mutex, so never hold two of them at once
+//   (except through lock( x1, x2 ) below, which handles x1 == x2)
+
+class mutex_stripes
+{
+	public:
+		enum { COUNT = 1024, LINE = 64 };	// COUNT must be a power of two
+		static mutex& forAddress( const void *xAddress )
+			{
+				static padded Table[COUNT];	// function-local: usable during static initialization
+				unsigned long long H = (unsigned long long)(uintptr_t)xAddress;
+				H = (H >> 4) * 0x9E3779B97F4A7C15ULL;	// fibonacci hashing; low bits of heap addresses are mostly zero
+				return Table[(H >> 32) & (COUNT - 1)].mMutex;
+			}
+	private:
+		struct alignas(LINE) padded { mutex mMutex; };
+};
+
 extern void lock( mutex& x1, mutex& x2 );
 static inline void unlock( mutex& x1, mutex& x2 )
-	{ x1.unlock(); x2.unlock(); }
+	{ x1.unlock(); if ( &x1 != &x2 ) x2.unlock(); }
 
 #endif
 
@@ -3,9 +3,63 @@
 #include <sstream>
 
 #include "jvalue.h"
+#include "jcbor.h"
+#include "jmsgpack.h"
+#include "jsnapshot.h"
+#include "jtape.h"
+#include "jbind.h"
+#include "jpush.h"
+#include "jreadahead.h"
+#include "jpatch.h"
+#include "jdedup.h"
+#include "jindex.h"
+#include "jquery.h"
+#include "jcolumns.h"
+#include "jshape.h"
+#include "jbatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace std;
 
+struct point
+{
+	int x, y;
+};
+
+JBIND_BEGIN( point )
+	JBIND_FIELD( x )
+	JBIND_FIELD( y )
+JBIND_END()
+
+struct shape
+{
+	string name;
+	vector<point> points;
+	map<string,double> weights;
+	jbind_optional<long long> id;
+	jvalue extra;
+	bool closed;
+};
+
+JBIND_BEGIN( shape )
+	JBIND_FIELD( name )
+	JBIND_KEY( points, "pts" )
+	JBIND_FIELD( weights )
+	JBIND_FIELD( id )
+	JBIND_FIELD( extra )
+	JBIND_FIELD( closed )
+JBIND_END()
+
+class unseekable : public std::streambuf	// the default seekoff(): a pipe, as the parser sees it
+{
+	public:
+		unseekable( const string& xText ) : mText( xText ) { setg( &mText[0], &mText[0], &mText[0] + mText.size() ); }
+	private:
+		string mText;
+};
+
 int
 main()
 {
@@ -134,6 +188,594 @@ main()
 	SS >> PP;
 	cout << PP << endl;
 
+	cout << endl;
+	cout << "unsigned and binary values" << endl;
+	jvalue U( 18446744073709551615ULL );
+	cout << U << " unsigned: " << U.isUnsigned() << endl;
+	SS << "[9223372036854775807, 9223372036854775808]";
+	SS >> PP;
+	cout << PP << " " << PP[0].isInteger() << PP[1].isUnsigned() << endl;
+	jvalue BIN;
+	BIN.Binary( "\x00\x01\xfe\xff", 4 );
+	cout << BIN << " size " << BIN.size() << endl;
+
+	cout << endl;
+	cout << "cbor and msgpack round trips" << endl;
+	jvalue RT;
+	RT["int"] = -1000000;
+	RT["big"] = 18446744073709551615ULL;
+	RT["pi"] = 3.25;
+	RT["e"] = 2.718281828;
+	RT["s"] = "text";
+	RT["bin"] = BIN;
+	RT["list"] = A;
+	string CBOR = jcbor::encode( RT );
+	cout << "cbor " << CBOR.size() << " bytes: " << jcbor::decode( CBOR.data(), CBOR.size() ) << endl;
+	string MP = jmsgpack::encode( RT );
+	cout << "msgpack " << MP.size() << " bytes: " << jmsgpack::decode( MP.data(), MP.size() ) << endl;
+	const unsigned char Indefinite[] = { 0x9F, 0x01, 0x7F, 0x61, 0x61, 0x61, 0x62, 0xFF, 0xF9, 0x3C, 0x00, 0xFF };	// [_ 1, (_ "a", "b"), 1.0 (half)]
+	cout << "cbor indefinite: " << jcbor::decode( Indefinite, sizeof(Indefinite) ) << endl;
+
+	cout << endl;
+	cout << "snapshot" << endl;
+	string SNAP;
+	jsnapshot::write( RT, SNAP );
+	jsnapshot S( SNAP.data(), SNAP.size() );
+	cout << "snapshot " << S.bytes() << " bytes: " << S.root() << endl;
+	cout << "list[1] = " << S.root()["list"][1] << ", s = " << S.root()["s"].String() << ", missing = " << S.root()["nope"] << endl;
+
+	cout << endl;
+	cout << "tape document" << endl;
+	jtape T;
+	T.parse( "{\"name\":\"tape\",\"n\":[1,-2,3.5,18446744073709551615],\"ok\":true,\"esc\":\"a\\u00e9\\n\"}" );
+	cout << "tape " << T.tapeSize() << " entries, " << T.stringBytes() << " string bytes: " << T.root() << endl;
+	cout << "name = " << T.root()["name"].String() << ", n[2] = " << T.root()["n"][2].Double() << ", missing = " << T.root()["nope"] << endl;
+	for ( jtape_iterator IT = T.root().begin(); IT != T.root().end(); ++IT )
+		cout << IT.key() << ":" << (*IT).size() << " ";
+	cout << endl;
+	const char *TK = "{\"a\\u0000b\":1,\"a\":2}";	// keys that differ after a nul
+	T.parse( TK );
+	jvalue TKV;
+	istringstream( TK ) >> TKV;
+	cout << T.root().begin().keySize() << " " << TKV.size() << " " << jpatch::equal( T.root().toJvalue(), TKV ) << endl;
+	T.parse( "{\"a\":[],\"b\":[[]]}" );	// the same tree as the parser builds
+	istringstream( "{\"a\":[],\"b\":[[]]}" ) >> TKV;
+	cout << T.root().toJvalue() << " " << jpatch::equal( T.root().toJvalue(), TKV ) << endl;
+
+	cout << endl;
+	cout << "typed binding" << endl;
+	shape SH = shape();
+	jbind::parse( "{\"closed\":true,\"name\":\"tri\\u00e9\",\"skip\":[{\"a\":1}],\"pts\":[{\"x\":1,\"y\":2},{\"y\":4,\"x\":3}],"
+		"\"weights\":{\"a\":0.5,\"b\":2},\"id\":null,\"extra\":{\"any\":[1,2]}}", SH );
+	cout << SH.name << " closed=" << SH.closed << " id=" << (SH.id.has() ? "set" : "unset") << " extra=" << SH.extra;
+	for ( size_t i = 0; i < SH.points.size(); i++ )
+		cout << " (" << SH.points[i].x << "," << SH.points[i].y << ")";
+	cout << " weights a=" << SH.weights["a"] << " b=" << SH.weights["b"] << endl;
+	vector<long long> Longs;
+	jbind::parse( "[1, -2, 9007199254740993]", Longs );
+	cout << Longs.size() << " longs, last " << Longs.back() << endl;
+	cout << jbind::print( SH ) << endl;
+	SH.id = 7;
+	SH.name = "quote\" tab\t";
+	SH.weights["c"] = 0.1;
+	cout << jbind::print( SH ) << endl;
+
+	cout << endl;
+	cout << "moving values in" << endl;
+	jvalue MV;
+	jvalue Item( string( "moved" ) );
+	MV["list"].push_back( std::move( Item ) );
+	string Key( "key" );
+	MV.insert( std::move( Key ), jvalue( 42 ) );
+	MV.insert( string( "key" ), jvalue( 43 ) );	// replaces
+	cout << MV << endl;
+	jvalue MA( "x" );
+	jvalue MB( std::move( MA ) );
+	MA = 5;		// a moved-from handle takes a new node
+	cout << MA << " " << MB << endl;
+
+	cout << endl;
+	cout << "short and embedded-nul strings" << endl;
+	jvalue SS1( "abc" );
+	jvalue SS2( string( "a\0b", 3 ) );
+	jvalue SS3( "a much longer string stored on the heap" );
+	cout << SS1 << " " << SS1.size() << " " << SS2 << " " << SS2.size() << " " << SS3.size() << endl;
+	cout << (SS1 == "abc") << (SS1 < "abd") << (SS1 < "ab") << (SS2 == string( "a\0b", 3 )) << (SS2 == "a") << endl;
+	istringstream NUL( "\"x\\u0000y\"" );
+	jvalue SS4;
+	NUL >> SS4;
+	cout << SS4 << " " << SS4.size() << endl;
+
+	cout << endl;
+	cout << "push parser, one byte at a time" << endl;
+	const char *PT = "{\"a\": [1, -2.5e3, true, null], \"s\": \"x\\u00e9\\n\", \"o\": {}} 12345678901234567890 [\"t\"] 7";
+	jpush JP;
+	for ( const char *P = PT; *P; )
+	{
+		P += JP.feed( P, 1 );	// 0 when the byte only ended a number
+		if ( JP.done() )
+			cout << JP.take() << endl;
+	}
+	if ( JP.finish() )	// the last value ended with the input
+		cout << JP.take() << endl;
+	try
+	{
+		JP.feed( "[1 2]" );
+	}
+	catch ( jerr *E )
+	{
+		cout << E->message() << " at byte " << JP.consumed() << endl;
+	}
+	JP.reset();
+	JP.feed( "[[], {\"a\": []}, [[]]]" );
+	jvalue JPV;
+	istringstream( "[[], {\"a\": []}, [[]]]" ) >> JPV;
+	cout << JP.take() << " " << JPV << endl;
+	try
+	{
+		JP.feed( "[1, @]" );
+	}
+	catch ( jerr *E )
+	{
+		cout << E->message() << endl;
+	}
+
+	cout << endl;
+	cout << "read-ahead file parsing" << endl;
+	char RAPath[] = "/tmp/testJSON.XXXXXX";
+	int RAFD = mkstemp( RAPath );
+	FILE *RAF = fdopen( RAFD, "w" );
+	for ( int i = 0; i < 500; i++ )	// ~15KB: several 4KB blocks, values split across them
+		fprintf( RAF, "{\"n\":%d,\"s\":\"record %d\"}\n", i, i );
+	fclose( RAF );
+	{
+		jreadahead RA( RAPath, 4096, 2 );
+		jvalue RV;
+		long long RASum = 0;
+		int RACount = 0;
+		while ( RA.parse( RV ) )
+		{
+			RASum += RV["n"].Integer();
+			RACount++;
+		}
+		cout << RACount << " records, sum " << RASum << ", last " << RV << endl;
+	}
+	unlink( RAPath );
+
+	cout << endl;
+	cout << "json patch, merge patch and diff" << endl;
+	istringstream PD( "{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":\"x\"},\"e/f\":null}" );
+	istringstream PO( "[{\"op\":\"add\",\"path\":\"/b/1\",\"value\":9},{\"op\":\"remove\",\"path\":\"/a\"},"
+		"{\"op\":\"move\",\"from\":\"/c/d\",\"path\":\"/g\"},{\"op\":\"copy\",\"from\":\"/b\",\"path\":\"/e~1f\"},"
+		"{\"op\":\"test\",\"path\":\"/b/3\",\"value\":3.0},{\"op\":\"replace\",\"path\":\"/b/-\",\"value\":0}]" );
+	jvalue PDoc, POps;
+	PD >> PDoc;
+	PO >> POps;
+	jvalue PBefore = jpatch::copy( PDoc );
+	try
+	{
+		jpatch::apply( PDoc, POps );
+	}
+	catch ( jerr *E )
+	{
+		cout << E->message() << ": " << PDoc << endl;	// the last op has no element "-" to replace
+	}
+	jvalue PDiff = jpatch::diff( PBefore, PDoc );
+	cout << PDiff << endl;
+	jpatch::apply( PBefore, PDiff );
+	cout << "diff applied: " << (jpatch::equal( PBefore, PDoc ) ? "equal" : "different") << endl;
+	istringstream PM( "{\"b\":null,\"c\":{\"d\":null,\"n\":1},\"z\":[true]}" );
+	jvalue PMerge;
+	PM >> PMerge;
+	jpatch::merge( PDoc, PMerge );
+	cout << PDoc << endl;
+
+	cout << endl;
+	cout << "print cache" << endl;
+	istringstream PCI( "{\"users\":[{\"name\":\"ann\",\"tags\":[\"a\",\"b\",\"c\",\"d\",\"e\"]},{\"name\":\"bob\",\"tags\":[]}],\"total\":2,\"meta\":{\"source\":\"a long enough value to be kept\"}}" );
+	jvalue PC;
+	PCI >> PC;
+	PC.printCache();
+	ostringstream PC1, PC2, PC3;
+	PC1 << PC;
+	PC["users"][1]["name"] = "carol";	// drops PC, users and users[1]
+	PC2 << PC;
+	PC.printCache( false );
+	PC3 << PC;
+	cout << (PC1.str() != PC2.str()) << (PC2.str() == PC3.str()) << endl;
+	cout << PC["users"][1] << endl;
+	jvalue PF;
+	istringstream( "{\"rate\":2.5,\"note\":\"long enough to be kept in the print cache\"}" ) >> PF;
+	PF.printCache();
+	ostringstream PF1, PF2;
+	PF1 << fixed << PF;
+	PF2 << PF;		// not the fixed text kept from the first
+	cout << PF1.str() << " " << PF2.str() << endl;
+
+	cout << endl;
+	cout << "deep equality and hashing" << endl;
+	istringstream EQI( "{\"a\":[1,2.0,\"x\",{\"b\":true,\"c\":null,\"d\":3,\"e\":4}],\"f\":18446744073709551615}" );
+	istringstream EQJ( "{\"f\":18446744073709551615,\"a\":[1.0,2,\"x\",{\"e\":4,\"d\":3.0,\"c\":null,\"b\":true}]}" );
+	jvalue EQ1, EQ2;
+	EQI >> EQ1;
+	EQJ >> EQ2;
+	cout << (EQ1 == EQ2) << EQ1.equals( EQ2 ) << (EQ1.hash() == EQ2.hash()) << EQ1.compare( EQ2 ) << endl;
+	EQ2.hashCache();
+	uint64_t EQH = EQ2.hash();
+	EQ2["a"][3]["e"] = 5;	// drops the cached hashes of EQ2, a and a[3]
+	cout << EQ1.equals( EQ2 ) << (EQ2.hash() != EQH) << EQ1.compare( EQ2 ) << EQ2.compare( EQ1 ) << endl;
+	jvalue EQN( (long long)9007199254740993LL ), EQD( 9007199254740992.0 );
+	cout << EQN.equals( EQD ) << EQN.compare( EQD ) << jvalue( "b" ).compare( jvalue( 2 ) ) << jvalue().compare( jvalue( false ) ) << endl;
+
+	cout << endl;
+	cout << "dedup" << endl;
+	const char *DDT = "[{\"city\":\"Amsterdam\",\"zip\":1011,\"tags\":[\"home\",\"work\"]},{\"city\":\"Amsterdam\",\"zip\":1011,\"tags\":[\"home\",\"work\"]},{\"city\":\"Amsterdam\",\"zip\":1011.0,\"tags\":[\"home\"]}]";
+	istringstream DDI( DDT );
+	jvalue DD;
+	DDI >> DD;
+	jdedup DDS;
+	DDS.share( DD );
+	cout << DD << endl;
+	cout << (DD[0].get() == DD[1].get()) << (DD[0].get() == DD[2].get()) << (DD[0]["city"].get() == DD[2]["city"].get()) << (DD[0]["zip"].get() == DD[2]["zip"].get()) << " " << DDS.values() << " " << DDS.shared() << " " << DDS.distinct() << " " << (DDS.saved() > 0) << endl;
+	DDS.clear();
+	jdedup::own( jdedup::own( jdedup::own( DD[1] )["tags"] )[0] ) = "away";	// DD[0] keeps its tags
+	cout << DD[0]["tags"] << " " << DD[1]["tags"] << " " << (DD[0]["city"].get() == DD[1]["city"].get()) << endl;
+	jdedup DDP;
+	jpush DDJ;
+	DDJ.dedup( &DDP );
+	DDJ.feed( DDT, strlen( DDT ) );
+	jvalue DDV = DDJ.take();
+	cout << (DDV[0].get() == DDV[1].get()) << " " << DDP.shared() << " " << DDV[0].equals( DD[0] ) << DDV[1].equals( DD[1] ) << endl;
+
+	cout << endl;
+	cout << "validation and strict parsing" << endl;
+	const char *VT[] = {
+		"{\"a\":[1,-0.5e+3,true,null,\"\\u00e9\\ud83d\\ude00\"]}", " [ ] ", "\"caf\xc3\xa9\"", "0",
+		"NULL", ".5", "01", "1.", "[1,]", "{\"a\" 1}", "\"\\ud83d\"", "\"\\q\"", "\"a\tb\"",
+		"\"\xc3\x28\"", "\"\xed\xa0\x80\"", "\"\xf0\x82\x82\xac\"", "[1] 2", "[[1]", "\v1",
+	};
+	for ( size_t i = 0; i < sizeof(VT) / sizeof(VT[0]); i++ )
+	{
+		size_t At;
+		const char *Why;
+		bool OK = jvalue::validate( VT[i], strlen( VT[i] ), &At, &Why );
+		istringstream Lax( VT[i] ), Strict( VT[i] );
+		jvalue::strict( Strict );
+		jvalue L, S;
+		string LR, SR;
+		try { Lax >> L; LR = "ok"; } catch ( jerr *E ) { LR = "throws"; }
+		try { Strict >> S; SR = "ok"; } catch ( jerr *E ) { SR = "throws"; }
+		cout << i << ": " << (OK ? "valid" : Why) << (OK ? "" : " at ") << (OK ? string() : to_string( At )) << "; lax " << LR << ", strict " << SR << endl;
+	}
+	istringstream VS( "\"\\ud83d\\ude00\"" );
+	jvalue VSV;
+	VS >> VSV;
+	cout << VSV.size() << " " << VSV << endl;
+
+	cout << endl;
+	cout << "array index" << endl;
+	istringstream IXI( "[{\"id\":7,\"user\":{\"name\":\"ann\"}},{\"id\":\"7\"},{\"no\":1},{\"id\":9,\"user\":{\"name\":\"bob\"}},{\"id\":7.0}]" );
+	jvalue IX;
+	IXI >> IX;
+	jindex IXD( IX, "/id" ), IXN( IX, "/user/name" );
+	vector<size_t> IXA = IXD.findAll( 7 );
+	cout << IXD.indexed() << " " << IXD.find( 7 ) << " " << IXD.find( "7" ) << " " << (IXD.find( 8 ) == jindex::npos) << " " << IXA.size() << IXA[1] << " " << IXN.get( "bob" )["id"] << endl;
+	jvalue IXE;
+	IXE["id"] = 8;
+	IX.push_back( IXE );	// appended behind the index's back
+	IXD.set( 0, IXE );
+	cout << IXD.find( 8 ) << " " << IXD.findAll( 8 ).size() << " " << IXD.find( 7 ) << " " << (IXN.find( "ann" ) == jindex::npos) << endl;
+
+	cout << endl;
+	cout << "query" << endl;
+	istringstream QI( "[{\"h\":\"a\",\"s\":200,\"ms\":12},{\"h\":\"b\",\"s\":500,\"ms\":40},{\"h\":\"a\",\"s\":500,\"ms\":3.5},{\"h\":\"c\",\"s\":404}]" );
+	jvalue QV;
+	QI >> QV;
+	cout << jquery( "[.[] | select(.s >= 400 and .h != \"c\") | {h, ms}]" ).first( QV ) << endl;
+	cout << jquery( "group_by(.h) | map({h: .[0].h, n: length, ms: (map(.ms) | add)})" ).first( QV, 4 ) << endl;
+	cout << jquery( "[.[].ms] | sort" ).first( QV ) << " " << jquery( "map(.s) | unique | length" ).first( QV ) << " " << jquery( "(7 / 2), (8 / 2), (1, 2) * 10, \"ab\" + \"c\"" ).first( jvalue() ) << endl;
+	vector<jvalue> QO;
+	jquery( "(7 / 2), (8 / 2), (1, 2) * 10, \"ab\" + \"c\", .[-1].h" ).run( QV, QO );
+	for ( size_t i = 0; i < QO.size(); i++ )
+		cout << QO[i] << " ";
+	cout << endl;
+	jquery QS( "select(.s == 500 and (.h == \"a\" | not)) | .ms" );
+	QO.clear();
+	cout << QS.pushdown() << jquery( "[.[] | .ms]" ).pushdown() << " " << QS.runText( "{\"h\":\"a\",\"s\":500,\"ms\":1} {\"h\":\"b\",\"s\":500,\"ms\":2}\n{\"h\":\"b\",\"s\":200,\"ms\":3}", QO ) << " ";
+	cout << QO.size() << " " << QO[0] << endl;
+	jquery QL( "{a: 1}" );
+	jvalue QLV = QL.first( jvalue() );
+	QLV["a"] = 2;		// the result is the caller's: the plan's literal stays 1
+	cout << QL.first( jvalue() ) << endl;
+	jvalue QMV;
+	istringstream( "{\"a\":-9223372036854775808,\"b\":-1}" ) >> QMV;
+	QO.clear();
+	jquery( ".a % .b, .a / .b, .a % 7" ).run( QMV, QO );	// the one quotient that does not fit
+	cout << QO[0] << " " << QO[1] << " " << QO[2] << endl;
+	const char *QP[][2] = {	// run() and runText() (decided on the tape) give the same answers
+		{ "select(.[-1] == 3)", "[1,2,3] [3,2,1]" },
+		{ "select(.[-5] == null and .[0] == 1)", "[1,2,3]" },
+		{ "select(.a.b == 1)", "{\"a\":{\"b\":1}} {\"a\":null}" },
+		{ "select(.a.b == 1)", "{\"a\":5}" },
+		{ "select(.a[0] == 1)", "{\"a\":{\"0\":1}}" },
+		{ "select(\"x\".a == 1)", "{\"a\":1}" },
+		{ "select(.a)", "{\"a\":[]} {\"a\":null}" } };
+	for ( size_t i = 0; i < sizeof(QP) / sizeof(QP[0]); i++ )
+	{
+		jquery Q( QP[i][0] );
+		string Answers[2];
+		for ( int Text = 0; Text < 2; Text++ )
+			try
+			{
+				vector<jvalue> Out;
+				if ( Text )
+					Q.runText( QP[i][1], Out );
+				else
+				{
+					istringstream QPI( QP[i][1] );
+					for ( jvalue QPV; QPV.parse( QPI ); QPV = jvalue() )	// a new tree each: Out holds the last
+						Q.run( QPV, Out );
+				}
+				ostringstream OS;
+				for ( size_t j = 0; j < Out.size(); j++ )
+					OS << Out[j] << " ";
+				Answers[Text] = OS.str();
+			}
+			catch ( jerr *E )
+			{
+				Answers[Text] = E->message();
+			}
+		cout << Q.pushdown() << (Answers[0] == Answers[1]) << " " << Answers[1] << endl;
+	}
+	const char *QBad[] = { ".a |", "frob(.a)", "[.a", ".a.b" };
+	for ( size_t i = 0; i < sizeof(QBad) / sizeof(QBad[0]); i++ )
+		try
+		{
+			jquery( QBad[i] ).first( QV );
+			cout << "no error" << endl;
+		}
+		catch ( jerr *E )
+		{
+			cout << E->message() << endl;
+		}
+
+	cout << endl;
+	cout << "columns" << endl;
+	jcolumns CO;
+	CO.parse( "{\"id\":1,\"ms\":12,\"host\":\"a\",\"ok\":true} {\"id\":2,\"ms\":2.5,\"host\":\"b\",\"ok\":false}\n"
+		"[{\"id\":3,\"host\":\"a\",\"ok\":null,\"tag\":[1]},{\"id\":4,\"ms\":7,\"host\":\"c\",\"ok\":true,\"tag\":\"x\"}]" );
+	cout << CO.size() << " " << CO.columns() << " " << CO.type( "id" ) << CO.type( "ms" ) << CO.type( "host" ) << CO.type( "ok" ) << CO.type( "tag" ) << " " << CO.distinct( "host" ) << endl;
+	cout << CO.row( 2 ) << " " << CO.row( 0 ) << endl;
+	jcolumns::mask_t COM;
+	cout << CO.filter( "ms", jcolumns::GT, 2.5, COM ) << CO.filter( "host", jcolumns::LE, "b", COM ) << " " << CO.sum( "ms", &COM ) << " " << CO.sum( "id" ) << " " << CO.sum( "host" ) << endl;
+	cout << CO.min( "ms" ) << " " << CO.max( "host" ) << " " << CO.min( "ok" ) << " " << CO.max( "tag" ) << " " << CO.max( "none" ) << endl;
+	COM.clear();
+	cout << CO.filter( "ok", jcolumns::EQ, jvalue(), COM ) << CO.filter( "id", jcolumns::LT, "x", COM ) << " ";
+	COM.clear();
+	cout << CO.filter( "id", jcolumns::LT, 2.5, COM ) << " ";
+	vector<jvalue> COR;
+	CO.rows( COM, COR );
+	cout << COR.size() << " " << COR[1]["host"] << " " << jpatch::equal( jcolumns( CO.toJvalue() ).toJvalue(), CO.toJvalue() ) << endl;
+	jcolumns COK;
+	COK.parse( "{\"a\\u0000b\":1,\"a\":2}" );
+	cout << COK.columns() << endl;
+	jcolumns COE;
+	COE.parse( "{\"a\":[],\"b\":[[]]}" );	// rows come back as the parser reads them
+	jvalue COEV;
+	istringstream( "{\"a\":[],\"b\":[[]]}" ) >> COEV;
+	cout << COE.row( 0 ) << " " << jpatch::equal( COE.row( 0 ), COEV ) << endl;
+
+	cout << endl;
+	cout << "shape-learning parser" << endl;
+	string SPT = "{\"id\":1,\"tags\":[\"a\",\"b\"],\"ms\":1.5e1}\n{\"id\":2, \"tags\" : [], \"ms\":-3}\n"
+		"{\"id\":3,\"tags\":[\"c\\u00e9\",{\"k\":null}],\"ms\":TRUE}\n{\"ms\":4,\"id\":4}\n"
+		"{\"id\":5,\"tags\":[1],\"ms\":12345678901234567890}\n[1,\"x\"] 7\n";
+	jshape SP;
+	istringstream SPI( SPT );
+	jvalue SPV, SPW;
+	size_t SPU;
+	bool SPSame = true;
+	for ( const char *P = SPT.data(); SP.parse( P, SPT.data() + SPT.size() - P, SPV, &SPU ); P += SPU )
+	{
+		SPI >> SPW;
+		SPSame = SPSame && jpatch::equal( SPV, SPW );
+		cout << SPV << " ";
+	}
+	cout << endl << SPSame << " " << SP.records() << " " << SP.hits() << " " << SP.learned() << " " << SP.keys() << endl;
+
+	cout << endl;
+	cout << "surrogate escapes, every parser" << endl;
+	string UT = "[\"\\ud83d\\ude00\",\"\\ud83dx\",\"\\ud800\\ud800\\udc00\",\"\\udc00\\ud83d\",\"\\ud83d\\n\"]";
+	jvalue UV[5];
+	istringstream( UT ) >> UV[0];
+	jpush UP;
+	for ( size_t i = 0; i < UT.size(); i++ )	// the pair split across feeds
+		UP.feed( UT.data() + i, 1 );
+	UV[1] = UP.take();
+	jshape US;
+	US.parse( UT.data(), UT.size(), UV[2] );
+	jtape UTP;
+	UTP.parse( UT );
+	UV[3] = UTP.root().toJvalue();
+	vector<string> UB;
+	jbind::parse( UT, UB );
+	for ( size_t i = 0; i < UB.size(); i++ )
+		UV[4].push_back( jvalue( UB[i] ) );
+	for ( int i = 1; i < 5; i++ )
+		cout << jpatch::equal( UV[0], UV[i] );
+	cout << " ";
+	for ( size_t i = 0; i < UV[0][0].size(); i++ )
+		cout << hex << (UV[0][0]->String()[i] & 0xFF);
+	cout << dec << " " << UV[0][2].size() << endl;
+	jquery UQ( "select(.s == \"\\ud83d\\ude00\") | .n" );
+	string UQT = "{\"s\":\"\\ud83d\\ude00\",\"n\":1} {\"s\":\"\\ud83d\",\"n\":2}";
+	vector<jvalue> UQO[2];
+	istringstream UQI( UQT );
+	for ( jvalue UQV; UQV.parse( UQI ); UQV = jvalue() )
+		UQ.run( UQV, UQO[0] );
+	UQ.runText( UQT, UQO[1] );
+	cout << UQ.pushdown() << UQO[0].size() << UQO[1].size() << " " << UQO[1][0] << endl;
+
+	cout << endl;
+	cout << "memory and limits" << endl;
+	string MLT = "{\"name\":\"a string long enough for the heap\",\"list\":[1,2,3,[4,[5]]],\"a key longer than sixteen bytes\":{\"x\":true}}";
+	jvalue MLV;
+	istringstream( MLT ) >> MLV;
+	size_t MLU = MLV.memoryUsage();
+	jvalue MLS = MLV["list"];
+	MLV.insert( "again", MLS );	// held twice, counted once
+	cout << (MLU > 0) << (MLV.memoryUsage() > MLU) << (MLV.memoryUsage() - MLU < MLS.memoryUsage()) << (jvalue( 7 ).memoryUsage() > sizeof(private_jvalue_data)) << endl;
+	jlimits MLL[6];
+	MLL[0].mBytes = MLU;		// as much as the document takes: fits
+	MLL[1].mBytes = MLU - 1;
+	MLL[2].mDepth = 4;
+	MLL[3].mDepth = 3;
+	MLL[4].mString = 31;
+	MLL[5].mElements = 11;
+	for ( size_t i = 0; i < 6; i++ )
+	{
+		istringstream MLI( MLT + " " + MLT );
+		jvalue::limits( MLI, MLL[i] );
+		try
+		{
+			MLI >> MLV >> MLV;	// the second one gets a fresh allowance
+			cout << "ok ";
+		}
+		catch ( jerr *E )
+		{
+			cout << E->message() << " ";
+		}
+	}
+	cout << endl;
+	for ( size_t i = 0; i < 2; i++ )
+	{
+		jlimits MLN;
+		MLN.mString = 4;
+		istringstream MLI( i ? "123456" : "\"abcdef\"" );
+		jvalue::limits( MLI, MLN );
+		try
+		{
+			MLI >> MLV;
+			cout << "ok ";
+		}
+		catch ( jerr *E )
+		{
+			cout << E->message() << " ";
+		}
+	}
+	cout << endl;
+
+	cout << endl;
+	cout << "reparse" << endl;
+	const char *RPT[] = {
+		"{\"id\":1,\"name\":\"first message\",\"tags\":[1,2,3],\"pos\":{\"x\":1.5,\"y\":2}}",
+		"{\"id\":2,\"name\":\"second\",\"tags\":[4,5,6],\"pos\":{\"x\":2.5,\"y\":3}}",
+		"{\"name\":\"a longer name than before\",\"tags\":[7],\"pos\":[1,2],\"id\":3,\"id\":4}",
+		"{\"id\":\"five\",\"tags\":[],\"extra\":{\"deep\":[{\"a\":null}]}}",
+		"[1,{\"id\":6},\"x\"]",
+		"7" };
+	jvalue RPV, RPW;
+	for ( size_t i = 0; i < sizeof(RPT) / sizeof(RPT[0]); i++ )
+	{
+		istringstream RPI( RPT[i] ), RPJ( RPT[i] );
+		RPV.reparse( RPI );
+		RPJ >> RPW;
+		cout << RPV << " " << RPV.equals( RPW ) << endl;
+	}
+	istringstream( RPT[0] ) >> RPV;
+	const private_jvalue_data *RPP = RPV["pos"].get();
+	jvalue RPH = RPV["tags"];	// held here: replaced, not overwritten
+	istringstream RPI( RPT[1] );
+	RPV.reparse( RPI );
+	cout << (RPV["pos"].get() == RPP) << (RPV["tags"].get() == RPH.get()) << " " << RPH << " " << RPV["tags"] << endl;
+	const char *RPS[] = { "\"a long string, on the heap\"", "\"shorter, still heap\"", "\"a long string, on the heap\"" };
+	size_t RPM[3];
+	for ( size_t i = 0; i < 3; i++ )	// the buffer stays, and keeps being counted
+	{
+		istringstream RPSI( RPS[i] );
+		RPV.reparse( RPSI );
+		RPM[i] = RPV.memoryUsage();
+	}
+	RPV = jvalue( "a long string, on the heap" );
+	cout << RPV.size() << " " << (RPM[0] == RPM[1]) << (RPM[1] == RPM[2]) << (RPM[2] == RPV.memoryUsage()) << endl;
+
+	cout << endl;
+	cout << "parse status" << endl;
+	const char *PST[] = { "{\"a\":1}", "  ", "{\"a\":1,\n \"b\":tru}", "[1,2", "\n\n  @", "{\"a\" 1}", "\"\\x\"", "[1,[2,[3]]]" };
+	for ( size_t i = 0; i < sizeof(PST) / sizeof(PST[0]); i++ )
+	{
+		istringstream PSI( PST[i] );
+		if ( i + 1 == sizeof(PST) / sizeof(PST[0]) )
+		{
+			jlimits PSL;
+			PSL.mDepth = 2;
+			jvalue::limits( PSI, PSL );
+		}
+		else if ( i == 6 )
+			jvalue::strict( PSI );
+		jparse_status PSS;
+		jvalue PSV;
+		bool PSR = PSV.parse( PSI, PSS );
+		cout << PSR << " " << PSS.mCode << " " << (long)PSS.mOffset << " " << PSS.mLine << ":" << PSS.mColumn << " " << PSS.mMessage << endl;
+	}
+	unseekable PSB( "[1,\n@]" );
+	istream PSN( &PSB );
+	jparse_status PSS;
+	jvalue PSV;
+	cout << PSV.parse( PSN, PSS ) << " " << PSS.mCode << " " << (long)PSS.mOffset << " " << PSS.mLine << ":" << PSS.mColumn << " (cannot seek)" << endl;
+
+	cout << endl;
+	cout << "batch parse" << endl;
+	vector<string> BPT;
+	for ( int i = 0; i < 50; i++ )	// a few chunks, so some are taken by the other threads
+	{
+		ostringstream BPO;
+		if ( i % 17 == 5 )
+			BPO << "{\"id\":" << i << ",\"bad\":tru}";
+		else
+			BPO << "{\"id\":" << i << ",\"tags\":[" << i % 3 << "," << i % 5 << "],\"name\":\"doc " << i << "\"}";
+		BPT.push_back( BPO.str() );
+	}
+	vector<jbatch::text> BPI;
+	for ( size_t i = 0; i < BPT.size(); i++ )
+		BPI.push_back( jbatch::text( BPT[i].data(), BPT[i].size() ) );
+	jbatch BPB( 3 );
+	vector<jvalue> BPV;
+	vector<jparse_status> BPS;
+	size_t BPG = BPB.parse( BPI, BPV, &BPS );
+	size_t BPE = 0;
+	for ( size_t i = 0; i < BPT.size(); i++ )
+	{
+		istringstream BPJ( BPT[i] );
+		jvalue BPW;
+		jparse_status BPX;
+		bool BPR = BPW.parse( BPJ, BPX );
+		BPE += (BPR ? BPV[i].equals( BPW ) : BPV[i].isNull()) && BPX.mCode == BPS[i].mCode && BPX.mOffset == BPS[i].mOffset;
+	}
+	cout << BPG << " of " << BPT.size() << " parsed, " << BPE << " as parse( is, status ) would have" << endl;
+	cout << BPV[0] << " " << BPV[5] << " " << BPV[49] << endl;
+	cout << BPS[22].mCode << " " << BPS[22].mColumn << " " << BPS[22].mMessage << endl;
+	{
+		jbatch BPO( 1 );	// each status keeps its own message, not the worker thread's last one
+		vector<jbatch::text> BPX;
+		BPX.push_back( jbatch::text( "@", 1 ) );
+		BPX.push_back( jbatch::text( "#", 1 ) );
+		vector<jvalue> BPY;
+		vector<jparse_status> BPZ;
+		BPO.parse( BPX, BPY, &BPZ );
+		cout << BPZ[0].mMessage << " / " << BPZ[1].mMessage << endl;
+	}
+	BPB.reuse();
+	BPB.strict();
+	BPT[0] = "{\"id\":0,\"tags\":[0,0],\"name\":\"doc 0\",}";
+	BPI[0] = jbatch::text( BPT[0].data(), BPT[0].size() );
+	const private_jvalue_data *BPP = BPV[1]["tags"].get();
+	cout << BPB.parse( BPI, BPV, &BPS ) << " " << BPS[0].mCode << " " << BPV[0] << " " << (BPV[1]["tags"].get() == BPP) << endl;
+
+	cout << endl;
+	cout << "statistics (all zero unless built with -DJVALUE_STATS)" << endl;
+	cout << jstats::snapshot() << endl;
+
 #else
 
 	jvalue PP;